@@ -46,6 +46,10 @@ public:
 	virtual int FinishRead(void)=0;
 	virtual void CancelRead(void)=0;
 
+	// Hint that these sectors are likely to be read soon. Readers that can
+	// fetch them in the background may do so, the default ignores it.
+	virtual void Prefetch(uint sector, uint count) {}
+
 	virtual void Close(void)=0;
 
 	virtual uint GetBlockCount(void) const=0;
@@ -74,8 +78,34 @@ class FlatFileReader : public AsyncFileReader
 
 	bool asyncInProgress;
 #elif defined(__linux__)
+	// An aligned piece of the file, read (or being read) ahead of the requests.
+	struct ReadUnit
+	{
+		struct iocb cb;
+		u8* buffer;
+		s64 index;    // file offset / m_unitSize, -1 when unused
+		int result;   // bytes read, or -errno
+		bool pending;
+	};
+
 	int m_fd; // FIXME don't know if overlap as an equivalent on linux
 	io_context_t m_aio_context;
+
+	ReadUnit* m_units;
+	uint m_unitCount;
+	uint m_unitSize;
+	uint m_queueDepth;      // units read ahead of a sequential request
+	s64 m_lastIndex;        // last unit of the previous request
+
+	void* m_request_buffer; // request between BeginRead() and FinishRead()
+	u64 m_request_offset;
+	uint m_request_size;
+
+	bool AllocateUnits();
+	void FreeUnits();
+	ReadUnit* FindUnit(s64 index);
+	ReadUnit* SubmitUnit(s64 index, bool wait);
+	bool ReapUnits(bool wait);
 #elif defined(__POSIX__)
 	int m_fd; // TODO OSX don't know if overlap as an equivalent on OSX
 	struct aiocb m_aiocb;
@@ -96,6 +126,10 @@ public:
 	virtual int FinishRead(void);
 	virtual void CancelRead(void);
 
+#if defined(__linux__)
+	virtual void Prefetch(uint sector, uint count);
+#endif
+
 	virtual void Close(void);
 
 	virtual uint GetBlockCount(void) const;
@@ -133,6 +167,8 @@ public:
 	virtual int FinishRead(void);
 	virtual void CancelRead(void);
 
+	virtual void Prefetch(uint sector, uint count);
+
 	virtual void Close(void);
 
 	virtual uint GetBlockCount(void) const;
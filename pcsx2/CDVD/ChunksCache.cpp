@@ -16,37 +16,234 @@
 #include "PrecompiledHeader.h"
 #include "ChunksCache.h"
 
-void ChunksCache::SetLimit(uint megabytes) {
-	m_limit = (PX_off_t)megabytes * 1024 * 1024;
-	MatchLimit();
-}
-
-void ChunksCache::MatchLimit(bool removeAll) {
-	std::list<CacheEntry*>::reverse_iterator rit;
-	while (!m_entries.empty() && (removeAll || m_size > m_limit)) {
-		rit = m_entries.rbegin();
-		m_size -= (*rit)->size;
-		delete(*rit);
-		m_entries.pop_back();
+using namespace Threading;
+
+ChunksCache::Shared& ChunksCache::GetShared() {
+	static Shared shared;
+	return shared;
+}
+
+PX_off_t ChunksCache::GetLimit() {
+	const int mb = std::min(std::max(EmuConfig.Cdvd.CompressedCacheMB, CHUNKSCACHE_MIN_MB), CHUNKSCACHE_MAX_MB);
+	return (PX_off_t)mb * _1mb;
+}
+
+uint ChunksCache::GetSlabChunks(uint chunkSize) {
+	return std::max(1u, (uint)CHUNKSCACHE_SLAB_SIZE / chunkSize);
+}
+
+// Takes a chunk from the fullest slab with room, so that the sparse ones drain.
+// A new slab is only allocated when the least recently used chunks can't make
+// room within the budget, and never when a slab is excluded (see Compact()).
+void* ChunksCache::AllocChunk(Shared& shared, uint chunkSize, const u8* exclude) {
+	const size_t slabBytes = (size_t)GetSlabChunks(chunkSize) * chunkSize;
+
+	while (!exclude && !shared.pools[chunkSize].free && shared.tail && shared.size + (PX_off_t)slabBytes > GetLimit())
+		shared.tail->owner->Remove(shared, shared.tail);
+
+	SlabPool& pool = shared.pools[chunkSize];
+	Slab* best = NULL;
+	for (auto& slab : pool.slabs) {
+		if (slab.base != exclude && !slab.free.empty() && (!best || slab.free.size() < best->free.size()))
+			best = &slab;
+	}
+
+	if (!best) {
+		if (exclude)
+			return NULL;
+
+		u8* base = (u8*)_aligned_malloc(slabBytes, 64);
+		if (!base)
+			return NULL;
+
+		pool.slabs.push_back(Slab());
+		best = &pool.slabs.back();
+		best->base = base;
+		best->live = 0;
+		for (uint i = GetSlabChunks(chunkSize); i-- > 0;)
+			best->free.push_back(base + (size_t)i * chunkSize);
+		pool.free += best->free.size();
+		shared.size += slabBytes;
+	}
+
+	void* chunk = best->free.back();
+	best->free.pop_back();
+	best->live++;
+	pool.free--;
+	return chunk;
+}
+
+void ChunksCache::FreeChunk(Shared& shared, uint chunkSize, void* chunk) {
+	SlabPool& pool = shared.pools[chunkSize];
+	const size_t slabBytes = (size_t)GetSlabChunks(chunkSize) * chunkSize;
+
+	for (size_t i = 0; i < pool.slabs.size(); i++) {
+		Slab& slab = pool.slabs[i];
+		if ((u8*)chunk < slab.base || (u8*)chunk >= slab.base + slabBytes)
+			continue;
+
+		slab.free.push_back(chunk);
+		pool.free++;
+
+		// Give the memory back as soon as the slab is empty
+		if (--slab.live == 0) {
+			_aligned_free(slab.base);
+			pool.free -= slab.free.size();
+			shared.size -= slabBytes;
+			pool.slabs.erase(pool.slabs.begin() + i);
+			if (pool.slabs.empty())
+				shared.pools.erase(chunkSize);
+		}
+		return;
 	}
+
+	pxAssertMsg(false, "ChunksCache: freed chunk isn't in a slab");
 }
 
-void ChunksCache::Take(void* pMallocedSrc, PX_off_t offset, int length, int coverage) {
-	m_entries.push_front(new CacheEntry(pMallocedSrc, offset, length, coverage));
-	m_size += length;
-	MatchLimit();
+// Moves the live chunks of the sparsest slab of a pool to the free chunks of its
+// other slabs, which frees it. Returns false when no pool has the room for it.
+bool ChunksCache::Compact(Shared& shared) {
+	for (auto& it : shared.pools) {
+		const uint chunkSize = it.first;
+		SlabPool& pool = it.second;
+
+		const Slab* sparse = NULL;
+		for (const auto& slab : pool.slabs) {
+			if (!sparse || slab.live < sparse->live)
+				sparse = &slab;
+		}
+		if (pool.slabs.size() < 2 || sparse->live > pool.free - sparse->free.size())
+			continue;
+
+		const u8* base = sparse->base;
+		const u8* end = base + (size_t)GetSlabChunks(chunkSize) * chunkSize;
+		for (CacheEntry* e = shared.head; e; e = e->next) {
+			if (e->owner->m_chunkSize != chunkSize || (u8*)e->data < base || (u8*)e->data >= end)
+				continue;
+
+			void* data = AllocChunk(shared, chunkSize, base);
+			memcpy(data, e->data, e->size);
+			std::swap(data, e->data);
+			FreeChunk(shared, chunkSize, data); // frees the slab with its last chunk
+		}
+		return true;
+	}
+
+	return false;
+}
+
+void ChunksCache::Unlink(Shared& shared, CacheEntry* e) {
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		shared.head = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		shared.tail = e->prev;
+}
+
+void ChunksCache::LinkFront(Shared& shared, CacheEntry* e) {
+	e->prev = NULL;
+	e->next = shared.head;
+	if (shared.head)
+		shared.head->prev = e;
+	else
+		shared.tail = e;
+	shared.head = e;
+}
+
+void ChunksCache::Remove(Shared& shared, CacheEntry* e) {
+	Unlink(shared, e);
+	m_entries.erase(e->offset / m_chunkSize);
+	FreeChunk(shared, m_chunkSize, e->data);
+	delete e;
+}
+
+// Only needed when the slabs went over the budget anyway: it was lowered, or
+// the chunks evicted to make room were in the pool of another chunk size.
+void ChunksCache::MatchLimit(Shared& shared) {
+	while (shared.tail && shared.size > GetLimit()) {
+		if (!Compact(shared))
+			shared.tail->owner->Remove(shared, shared.tail);
+	}
+}
+
+void ChunksCache::ClearLocked(Shared& shared) {
+	while (!m_entries.empty())
+		Remove(shared, m_entries.begin()->second);
+}
+
+void ChunksCache::Clear() {
+	Shared& shared = GetShared();
+	ScopedLock lock(shared.lock);
+	ClearLocked(shared);
+}
+
+void ChunksCache::SetChunkSize(uint chunkSize) {
+	Shared& shared = GetShared();
+	ScopedLock lock(shared.lock);
+	ClearLocked(shared);
+	m_chunkSize = chunkSize;
+}
+
+void ChunksCache::Insert(const void* pSrc, PX_off_t offset, int length) {
+	pxAssert(m_chunkSize && offset % m_chunkSize == 0 && length <= (int)m_chunkSize);
+
+	Shared& shared = GetShared();
+	ScopedLock lock(shared.lock);
+
+	auto it = m_entries.find(offset / m_chunkSize);
+	if (it != m_entries.end()) {
+		// Already there (e.g. extracted concurrently), just refresh it
+		CacheEntry* e = it->second;
+		Unlink(shared, e);
+		LinkFront(shared, e);
+		return;
+	}
+
+	void* data = AllocChunk(shared, m_chunkSize);
+	if (!data)
+		return;
+	memcpy(data, pSrc, length);
+
+	CacheEntry* e = new CacheEntry;
+	e->owner = this;
+	e->data = data;
+	e->offset = offset;
+	e->size = length;
+
+	m_entries[offset / m_chunkSize] = e;
+	LinkFront(shared, e);
+	MatchLimit(shared);
 }
 
 // By design, succeed only if the entire request is in a single cached chunk
 int ChunksCache::Read(void* pDest, PX_off_t offset, int length) {
-	for (auto it = m_entries.begin(); it != m_entries.end(); it++) {
-		CacheEntry* e = *it;
-		if (e && offset >= e->offset && (offset + length) <= (e->offset + e->coverage)) {
-			if (it != m_entries.begin())
-				m_entries.splice(m_entries.begin(), m_entries, it); // Move to top (MRU)
-			return CopyAvailable(e->data, e->offset, e->size, pDest, offset, length);
-		}
+	if (!m_chunkSize || (int)(offset % m_chunkSize) + length > (int)m_chunkSize)
+		return -1;
+
+	Shared& shared = GetShared();
+	ScopedLock lock(shared.lock);
+
+	auto it = m_entries.find(offset / m_chunkSize);
+	if (it == m_entries.end())
+		return -1;
+
+	CacheEntry* e = it->second;
+	if (e != shared.head) {
+		Unlink(shared, e); // Move to top (MRU)
+		LinkFront(shared, e);
 	}
-	return -1;
+	return CopyAvailable(e->data, e->offset, e->size, pDest, offset, length);
 }
 
+bool ChunksCache::Contains(PX_off_t offset) {
+	if (!m_chunkSize)
+		return false;
+
+	Shared& shared = GetShared();
+	ScopedLock lock(shared.lock);
+	return m_entries.find(offset / m_chunkSize) != m_entries.end();
+}
@@ -15,19 +15,40 @@
 
 #pragma once
 
+#include <unordered_map>
+#include "Utilities/Threading.h"
 #include "zlib_indexed.h"
 
 #define CLAMP(val, minval, maxval) (std::min(maxval, std::max(minval, val)))
 
+#define CHUNKSCACHE_MIN_MB 16   /* bounds of EmuConfig.Cdvd.CompressedCacheMB, the memory */
+#define CHUNKSCACHE_MAX_MB 4096 /* shared by the caches of all the compressed readers */
+#define CHUNKSCACHE_SLAB_SIZE (4 * 1024 * 1024) /* chunk buffers are carved from blocks of this size */
+
+// Cache of fixed size chunks of extracted data, stored at chunk-aligned offsets.
+// - Lookup is a hash probe on the chunk offset.
+// - All the caches share a single memory budget and a single LRU order, so
+//   inserting into one cache may evict the least recently used chunk of another.
+// - Chunk buffers are carved from slabs and recycled instead of malloc'ed per entry.
+//   The budget counts the slabs, a slab is freed as soon as it's empty. Over the
+//   budget, the live chunks of the sparsest slab are moved to the free chunks of
+//   the others when they fit, otherwise the least recently used chunks are evicted.
+// - Thread safe.
 class ChunksCache {
 public:
-	ChunksCache(uint initialLimitMb) : m_entries(0), m_size(0), m_limit(initialLimitMb * 1024 * 1024) {};
+	ChunksCache(uint chunkSize) : m_chunkSize(chunkSize) {};
 	~ChunksCache() { Clear(); };
-	void SetLimit(uint megabytes);
-	void Clear() { MatchLimit(true); };
 
-	void Take(void* pMallocedSrc, PX_off_t offset, int length, int coverage);
+	void Clear();
+
+	// Also clears the cache
+	void SetChunkSize(uint chunkSize);
+	uint GetChunkSize() const { return m_chunkSize; }
+
+	// offset must be aligned to the chunk size, length is the chunk size except at the end of the data
+	void Insert(const void* pSrc, PX_off_t offset, int length);
 	int  Read(void* pDest,        PX_off_t offset, int length);
+	bool Contains(PX_off_t offset);
 
 	static int CopyAvailable(void* pSrc, PX_off_t srcOffset, int srcSize,
 							 void* pDst, PX_off_t dstOffset, int maxCopySize) {
@@ -37,27 +58,55 @@ public:
 	};
 
 private:
-	class CacheEntry {
-	public:
-		CacheEntry(void* pMallocedSrc, PX_off_t offset, int length, int coverage) :
-			data(pMallocedSrc),
-			offset(offset),
-			coverage(coverage),
-			size(length)
-		{};
-
-		~CacheEntry() { if (data) free(data); };
-
+	struct CacheEntry {
+		ChunksCache* owner;
+		CacheEntry* prev; // Global LRU list, most recently used first
+		CacheEntry* next;
 		void* data;
 		PX_off_t offset;
-		int coverage;
 		int size;
 	};
 
-	std::list<CacheEntry*> m_entries;
-	void MatchLimit(bool removeAll = false);
-	PX_off_t m_size;
-	PX_off_t m_limit;
+	struct Slab {
+		u8* base;
+		std::vector<void*> free;
+		uint live;
+	};
+
+	struct SlabPool {
+		std::vector<Slab> slabs;
+		uint free; // free chunks in all the slabs
+
+		SlabPool() : free(0) {}
+	};
+
+	// State shared by all the caches
+	struct Shared {
+		Threading::Mutex lock;
+		CacheEntry* head;
+		CacheEntry* tail;
+		PX_off_t size; // memory of all the slabs
+		std::unordered_map<uint, SlabPool> pools; // by chunk size
+
+		Shared() : head(0), tail(0), size(0) {}
+	};
+
+	static Shared& GetShared();
+	static PX_off_t GetLimit();
+	static uint GetSlabChunks(uint chunkSize);
+
+	// Must be called with the shared lock held
+	static void* AllocChunk(Shared& shared, uint chunkSize, const u8* exclude = NULL);
+	static void FreeChunk(Shared& shared, uint chunkSize, void* chunk);
+	static bool Compact(Shared& shared);
+	static void Unlink(Shared& shared, CacheEntry* e);
+	static void LinkFront(Shared& shared, CacheEntry* e);
+	static void MatchLimit(Shared& shared);
+	void Remove(Shared& shared, CacheEntry* e);
+	void ClearLocked(Shared& shared);
+
+	uint m_chunkSize;
+	std::unordered_map<PX_off_t, CacheEntry*> m_entries; // by chunk index
 };
 
 #undef CLAMP
@@ -26,9 +26,15 @@
 #ifdef _WIN32
 #   define PX_wfilename(name_wxstr) (name_wxstr.wc_str())
 #   define PX_fopen_rb(name_wxstr) (_wfopen(PX_wfilename(name_wxstr), L"rb"))
+#   define PX_fopen_wb(name_wxstr) (_wfopen(PX_wfilename(name_wxstr), L"wb"))
+#   define PX_fopen_ab(name_wxstr) (_wfopen(PX_wfilename(name_wxstr), L"ab"))
+#   define PX_fopen_rwb(name_wxstr) (_wfopen(PX_wfilename(name_wxstr), L"r+b"))
 #else
 #   define PX_wfilename(name_wxstr) (name_wxstr.mbc_str())
 #   define PX_fopen_rb(name_wxstr) (fopen(PX_wfilename(name_wxstr), "rb"))
+#   define PX_fopen_wb(name_wxstr) (fopen(PX_wfilename(name_wxstr), "wb"))
+#   define PX_fopen_ab(name_wxstr) (fopen(PX_wfilename(name_wxstr), "ab"))
+#   define PX_fopen_rwb(name_wxstr) (fopen(PX_wfilename(name_wxstr), "r+b"))
 #endif
 
 #ifdef _WIN32
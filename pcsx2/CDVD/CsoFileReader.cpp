@@ -17,6 +17,7 @@
 #include "AsyncFileReader.h"
 #include "CompressedFileReaderUtils.h"
 #include "CsoFileReader.h"
+#include "x86emitter/tools.h"
 #include "Pcsx2Types.h"
 #ifdef __POSIX__
 #include <zlib.h>
@@ -89,6 +90,8 @@ bool CsoFileReader::Open(const wxString& fileName) {
 		Close();
 		return false;
 	}
+
+	StartDecoders();
 	return true;
 }
 
@@ -134,6 +137,8 @@ bool CsoFileReader::InitializeBuffers() {
 	// This is a buffer for the most recently decompressed frame.
 	m_zlibBuffer = new u8[m_frameSize + (1 << m_indexShift)];
 	m_zlibBufferFrame = numFrames;
+	m_cache.SetChunkSize(m_frameSize);
+	m_framesPerJob = std::max(1u, (u32)CSO_JOB_SIZE / m_frameSize);
 
 	const u32 indexSize = numFrames + 1;
 	m_index = new u32[indexSize];
@@ -154,11 +159,62 @@ bool CsoFileReader::InitializeBuffers() {
 	return true;
 }
 
+void CsoFileReader::StartDecoders() {
+	// Leave a core for the EE and one for the GS
+	const u32 wanted = std::min(std::max(EmuConfig.Cdvd.CsoDecodeThreads, 0), CSO_MAX_DECODE_THREADS);
+	const u32 threads = std::min<u32>(wanted, std::max<u32>(x86caps.LogicalCores, 3) - 2);
+
+	m_quit = false;
+	m_nextJob = 0;
+	for (u32 i = 0; i < threads; i++) {
+		DecodeThread* decoder = new DecodeThread(*this);
+		if (!decoder->Init()) {
+			delete decoder;
+			break;
+		}
+		decoder->Start();
+		m_decoders.push_back(decoder);
+	}
+}
+
+void CsoFileReader::StopDecoders() {
+	m_quit = true;
+	m_sem_jobs.Post(m_decoders.size());
+	for (auto decoder : m_decoders) {
+		if (decoder->IsRunning())
+			decoder->Block();
+		delete decoder;
+	}
+	m_decoders.clear();
+	m_jobs.clear();
+	m_hints.clear();
+}
+
+void CsoFileReader::ResetStats() {
+	m_statBytes = 0;
+	m_statTicks = 0;
+	m_statFramesSync = 0;
+	m_statFramesAsync = 0;
+}
+
+// Compare with Cdvd.CsoDecodeThreads set to 0 to measure the gain of the read-ahead
+// pipeline, tools/csodecode times the decoding alone
+void CsoFileReader::LogStats() {
+	if (m_statBytes && m_statTicks) {
+		double seconds = (double)m_statTicks / GetTickFrequency();
+		DevCon.WriteLn(Color_Gray, L"CSO: %.1f MB read at %.1f MB/s (%u decoding threads, frames decoded: %u ahead, %u on demand)",
+			(double)m_statBytes / _1mb, (double)m_statBytes / _1mb / seconds,
+			(u32)m_decoders.size(), m_statFramesAsync.load(), m_statFramesSync);
+	}
+	ResetStats();
+}
+
 void CsoFileReader::Close() {
+	StopDecoders();
+	LogStats();
+
 	m_filename.Empty();
-#if CSO_USE_CHUNKSCACHE
 	m_cache.Clear();
-#endif
 
 	if (m_src) {
 		fclose(m_src);
@@ -191,6 +247,8 @@ int CsoFileReader::ReadSync(void* pBuffer, uint sector, uint count) {
 	// Note that, in practice, count will always be 1.  It seems one sector is read
 	// per interrupt, even if multiple are requested by the application.
 
+	u64 start = GetCPUTicks();
+
 	u8* dest = (u8*)pBuffer;
 	// We do it this way in case m_blocksize is not well aligned to our frame size.
 	u64 pos = (u64)sector * (u64)m_blocksize;
@@ -198,33 +256,22 @@ int CsoFileReader::ReadSync(void* pBuffer, uint sector, uint count) {
 	int bytes = 0;
 
 	while (remaining > 0) {
-		int readBytes;
-
-#if CSO_USE_CHUNKSCACHE
-		// Try first to read from the cache.
-		readBytes = m_cache.Read(dest + bytes, pos + bytes, remaining);
-#else
-		readBytes = -1;
-#endif
-		if (readBytes < 0) {
-			readBytes = ReadFromFrame(dest + bytes, pos + bytes, remaining);
-			if (readBytes == 0) {
-				// We hit EOF.
-				break;
-			}
-
-#if CSO_USE_CHUNKSCACHE
-			// Add the bytes into the cache.  We need to allocate a buffer for it.
-			void *cached = malloc(readBytes);
-			memcpy(cached, dest + bytes, readBytes);
-			m_cache.Take(cached, pos + bytes, readBytes, readBytes);
-#endif
+		int readBytes = ReadFromFrame(dest + bytes, pos + bytes, remaining);
+		if (readBytes == 0) {
+			// We hit EOF.
+			break;
 		}
 
 		bytes += readBytes;
 		remaining -= readBytes;
 	}
 
+	if (bytes)
+		ScheduleReadAhead((u32)((pos + bytes - 1) >> m_frameShift) / m_framesPerJob + 1);
+
+	m_statBytes += bytes;
+	m_statTicks += GetCPUTicks() - start;
+
 	return bytes;
 }
 
@@ -239,17 +286,9 @@ int CsoFileReader::ReadFromFrame(u8 *dest, u64 pos, int maxBytes) {
 	// This is how many bytes we will actually be reading from this frame.
 	const u32 bytes = (u32)(std::min(m_blocksize, static_cast<uint>(m_frameSize - offset)));
 
-	// Grab the index data for the frame we're about to read.
-	const bool compressed = (m_index[frame + 0] & 0x80000000) == 0;
-	const u32 index0 = m_index[frame + 0] & 0x7FFFFFFF;
-	const u32 index1 = m_index[frame + 1] & 0x7FFFFFFF;
-
-	// Calculate where the compressed payload is (if compressed.)
-	const u64 frameRawPos = (u64)index0 << m_indexShift;
-	const u64 frameRawSize = (u64)(index1 - index0) << m_indexShift;
-
-	if (!compressed) {
+	if (!IsCompressed(frame)) {
 		// Just read directly, easy.
+		const u64 frameRawPos = (u64)(m_index[frame] & 0x7FFFFFFF) << m_indexShift;
 		if (PX_fseeko(m_src, m_dataoffset + frameRawPos + offset, SEEK_SET) != 0) {
 			Console.Error("Unable to seek to uncompressed CSO data.");
 			return 0;
@@ -258,16 +297,30 @@ int CsoFileReader::ReadFromFrame(u8 *dest, u64 pos, int maxBytes) {
 	} else {
 		// We don't need to decompress if we already did this same frame last time.
 		if (m_zlibBufferFrame != frame) {
-			if (PX_fseeko(m_src, m_dataoffset + frameRawPos, SEEK_SET) != 0) {
-				Console.Error("Unable to seek to compressed CSO data.");
-				return 0;
+			// Or if it's still in the cache.
+			int cached = m_cache.Read(dest, pos, bytes);
+			if (cached >= 0) {
+				return cached;
 			}
-			// This might be less bytes than frameRawSize in case of padding on the last frame.
-			// This is because the index positions must be aligned.
-			const u32 readRawBytes = fread(m_readBuffer, 1, frameRawSize, m_src);
-			if (!DecompressFrame(frame, readRawBytes)) {
+
+			// Or if a decoding thread is about to put it there.
+			if (!m_decoders.empty()) {
+				WaitForFrame(frame);
+				cached = m_cache.Read(dest, pos, bytes);
+				if (cached >= 0) {
+					return cached;
+				}
+			}
+
+			const u32 readRawBytes = ReadRawFrame(m_src, frame, m_readBuffer);
+			if (!DecompressFrame(m_z_stream, m_readBuffer, readRawBytes, m_zlibBuffer)) {
+				m_zlibBufferFrame = (u32)-1;
 				return 0;
 			}
+			// Our buffer now contains this frame.
+			m_zlibBufferFrame = frame;
+			m_statFramesSync++;
+			m_cache.Insert(m_zlibBuffer, (u64)frame << m_frameShift, m_frameSize);
 		}
 
 		// Now we just copy the offset data from the cache.
@@ -277,37 +330,229 @@ int CsoFileReader::ReadFromFrame(u8 *dest, u64 pos, int maxBytes) {
 	return bytes;
 }
 
-bool CsoFileReader::DecompressFrame(u32 frame, u32 readBufferSize) {
-	m_z_stream->next_in = m_readBuffer;
-	m_z_stream->avail_in = readBufferSize;
-	m_z_stream->next_out = m_zlibBuffer;
-	m_z_stream->avail_out = m_frameSize;
-
-	int status = inflate(m_z_stream, Z_FINISH);
-	bool success = status == Z_STREAM_END && m_z_stream->total_out == m_frameSize;
-	if (success) {
-		// Our buffer now contains this frame.
-		m_zlibBufferFrame = frame;
-	} else {
+// Returns the number of compressed bytes read, 0 on failure
+u32 CsoFileReader::ReadRawFrame(FILE* src, u32 frame, u8* readBuffer) {
+	// Calculate where the compressed payload is.
+	const u32 index0 = m_index[frame + 0] & 0x7FFFFFFF;
+	const u32 index1 = m_index[frame + 1] & 0x7FFFFFFF;
+	const u64 frameRawPos = (u64)index0 << m_indexShift;
+	const u64 frameRawSize = (u64)(index1 - index0) << m_indexShift;
+
+	if (PX_fseeko(src, m_dataoffset + frameRawPos, SEEK_SET) != 0) {
+		Console.Error("Unable to seek to compressed CSO data.");
+		return 0;
+	}
+	// This might be less bytes than frameRawSize in case of padding on the last frame.
+	// This is because the index positions must be aligned.
+	return fread(readBuffer, 1, frameRawSize, src);
+}
+
+bool CsoFileReader::DecompressFrame(z_stream* strm, u8* readBuffer, u32 readBufferSize, u8* zlibBuffer) {
+	strm->next_in = readBuffer;
+	strm->avail_in = readBufferSize;
+	strm->next_out = zlibBuffer;
+	strm->avail_out = m_frameSize;
+
+	int status = inflate(strm, Z_FINISH);
+	bool success = status == Z_STREAM_END && strm->total_out == m_frameSize;
+	if (!success) {
 		Console.Error("Unable to decompress CSO frame using zlib.");
-		m_zlibBufferFrame = (u32)-1;
 	}
 
-	inflateReset(m_z_stream);
+	inflateReset(strm);
 	return success;
 }
 
+// Queues the jobs from firstJob to the end of the read-ahead window. A read
+// outside of the current window is a seek: the pending jobs are dropped.
+void CsoFileReader::ScheduleReadAhead(u32 firstJob) {
+	if (m_decoders.empty())
+		return;
+
+	const u32 numJobs = (GetFrameCount() + m_framesPerJob - 1) / m_framesPerJob;
+	const u32 lastJob = std::min(firstJob + CSO_READ_AHEAD_JOBS, numJobs);
+
+	int posted = 0;
+	{
+		ScopedLock lock(m_mtx_jobs);
+
+		if (firstJob > m_nextJob || m_nextJob > lastJob) {
+			m_jobs.clear();
+			m_nextJob = firstJob;
+		}
+
+		for (; m_nextJob < lastJob; m_nextJob++, posted++)
+			m_jobs.push_back(m_nextJob);
+	}
+
+	if (posted)
+		m_sem_jobs.Post(posted);
+}
+
+// Queues the jobs of a region the game is expected to read next. They are
+// decoded when the read-ahead queue is empty, the oldest hints are dropped.
+void CsoFileReader::Prefetch(uint sector, uint count) {
+	if (!m_src || m_decoders.empty() || !count)
+		return;
+
+	const u32 numFrames = GetFrameCount();
+	const u64 pos = (u64)sector * m_blocksize;
+	const u32 firstFrame = (u32)(pos >> m_frameShift);
+	const u32 lastFrame = std::min((u32)((pos + (u64)count * m_blocksize - 1) >> m_frameShift), numFrames - 1);
+	if (firstFrame > lastFrame)
+		return;
+
+	const u32 firstJob = firstFrame / m_framesPerJob;
+	const u32 lastJob = std::min(lastFrame / m_framesPerJob, firstJob + CSO_PREFETCH_JOBS - 1);
+
+	int posted = 0;
+	{
+		ScopedLock lock(m_mtx_jobs);
+		for (u32 job = firstJob; job <= lastJob; job++, posted++)
+			m_hints.push_back(job);
+		while (m_hints.size() > CSO_PREFETCH_JOBS)
+			m_hints.pop_front();
+	}
+
+	m_sem_jobs.Post(posted);
+}
+
+// Blocks while a decoding thread works on the job containing frame
+void CsoFileReader::WaitForFrame(u32 frame) {
+	const s64 job = frame / m_framesPerJob;
+	DecodeThread* busy = NULL;
+	{
+		ScopedLock lock(m_mtx_jobs);
+		for (auto decoder : m_decoders) {
+			if (decoder->m_job == job)
+				busy = decoder;
+		}
+	}
+
+	if (busy) {
+		ScopedLock wait(busy->m_mtx_busy);
+	}
+}
+
+CsoFileReader::DecodeThread::DecodeThread(CsoFileReader& reader)
+	: m_job(-1)
+	, m_reader(reader)
+	, m_src(NULL)
+	, m_z_stream(NULL)
+	, m_readBuffer(NULL)
+	, m_zlibBuffer(NULL)
+{
+	m_name = L"CsoDecoder";
+}
+
+CsoFileReader::DecodeThread::~DecodeThread()
+{
+	try {
+		_parent::Cancel();
+	}
+	DESTRUCTOR_CATCHALL
+
+	if (m_src)
+		fclose(m_src);
+	if (m_z_stream) {
+		inflateEnd(m_z_stream);
+		delete m_z_stream;
+	}
+	delete[] m_readBuffer;
+	delete[] m_zlibBuffer;
+}
+
+bool CsoFileReader::DecodeThread::Init()
+{
+	m_src = PX_fopen_rb(m_reader.m_filename);
+	if (!m_src)
+		return false;
+
+	const u32 alignment = 1 << m_reader.m_indexShift;
+	m_readBuffer = new u8[m_reader.m_frameSize + alignment];
+	m_zlibBuffer = new u8[m_reader.m_frameSize + alignment];
+
+	m_z_stream = new z_stream;
+	m_z_stream->zalloc = Z_NULL;
+	m_z_stream->zfree = Z_NULL;
+	m_z_stream->opaque = Z_NULL;
+	if (inflateInit2(m_z_stream, -15) != Z_OK) {
+		delete m_z_stream;
+		m_z_stream = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+void CsoFileReader::DecodeThread::ExecuteTaskInThread()
+{
+	const u32 numFrames = m_reader.GetFrameCount();
+
+	while (true) {
+		m_reader.m_sem_jobs.WaitWithoutYield();
+		if (m_reader.m_quit)
+			return;
+
+		u32 job;
+		{
+			ScopedLock lock(m_reader.m_mtx_jobs);
+			std::deque<u32>& queue = m_reader.m_jobs.empty() ? m_reader.m_hints : m_reader.m_jobs;
+			if (queue.empty())
+				continue; // dropped by a seek
+
+			job = queue.front();
+			queue.pop_front();
+
+			// Taken before releasing m_mtx_jobs so WaitForFrame() can't miss it
+			m_mtx_busy.Acquire();
+			m_job = job;
+		}
+
+		const u32 first = job * m_reader.m_framesPerJob;
+		const u32 last = std::min(first + m_reader.m_framesPerJob, numFrames);
+		for (u32 frame = first; frame < last && !m_reader.m_quit; frame++) {
+			const u64 pos = (u64)frame << m_reader.m_frameShift;
+			if (!m_reader.IsCompressed(frame) || m_reader.m_cache.Contains(pos))
+				continue;
+
+			const u32 readRawBytes = m_reader.ReadRawFrame(m_src, frame, m_readBuffer);
+			if (!m_reader.DecompressFrame(m_z_stream, m_readBuffer, readRawBytes, m_zlibBuffer))
+				break;
+
+			m_reader.m_cache.Insert(m_zlibBuffer, pos, m_reader.m_frameSize);
+			m_reader.m_statFramesAsync++;
+		}
+
+		m_job = -1;
+		m_mtx_busy.Release();
+	}
+}
+
 void CsoFileReader::BeginRead(void* pBuffer, uint sector, uint count) {
-	// TODO: No async support yet, implement as sync.
-	m_bytesRead = ReadSync(pBuffer, sector, count);
+	// Let the decoding threads work on the request until FinishRead()
+	m_pendingBuffer = pBuffer;
+	m_pendingSector = sector;
+	m_pendingCount = count;
+	if (m_src && !m_decoders.empty()) {
+		ScheduleReadAhead((u32)(((u64)sector * m_blocksize) >> m_frameShift) / m_framesPerJob);
+	} else {
+		m_bytesRead = ReadSync(pBuffer, sector, count);
+		m_pendingBuffer = NULL;
+	}
 }
 
 int CsoFileReader::FinishRead() {
+	if (m_pendingBuffer) {
+		m_bytesRead = ReadSync(m_pendingBuffer, m_pendingSector, m_pendingCount);
+		m_pendingBuffer = NULL;
+	}
+
 	int res = m_bytesRead;
 	m_bytesRead = -1;
 	return res;
 }
 
 void CsoFileReader::CancelRead() {
-	// TODO: No async read support yet.
+	m_pendingBuffer = NULL;
 }
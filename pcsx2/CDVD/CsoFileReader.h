@@ -15,22 +15,20 @@
 
 #pragma once
 
-// Based on testing, the overhead of using this cache is high.
-//
-// The test was done with CSO files using a block size of 16KB.
-// Cache hit rates were observed in the range of 25%.
-// Cache overhead added 35% to the overall read time.
-//
-// For this reason, it's currently disabled.
-#define CSO_USE_CHUNKSCACHE 0
-
+#include <deque>
+#include "Utilities/PersistentThread.h"
 #include "AsyncFileReader.h"
 #include "ChunksCache.h"
 
+using namespace Threading;
+
 struct CsoHeader;
 typedef struct z_stream_s z_stream;
 
-static const uint CSO_CHUNKCACHE_SIZE_MB = 200;
+#define CSO_MAX_DECODE_THREADS 8      /* upper bound of EmuConfig.Cdvd.CsoDecodeThreads */
+#define CSO_JOB_SIZE (64 * 1024)      /* frames are given to the decoding threads in runs of this many bytes */
+#define CSO_READ_AHEAD_JOBS 8         /* runs decoded ahead of the last read */
+#define CSO_PREFETCH_JOBS 64          /* max runs queued by Prefetch() hints */
 
 class CsoFileReader : public AsyncFileReader
 {
@@ -47,11 +45,16 @@ public:
 		m_totalSize(0),
 		m_src(0),
 		m_z_stream(0),
-#if CSO_USE_CHUNKSCACHE
-		m_cache(CSO_CHUNKCACHE_SIZE_MB),
-#endif
-		m_bytesRead(0) {
+		m_cache(0),
+		m_framesPerJob(1),
+		m_nextJob(0),
+		m_quit(false),
+		m_bytesRead(0),
+		m_pendingSector(0),
+		m_pendingCount(0),
+		m_pendingBuffer(0) {
 		m_blocksize = 2048;
+		ResetStats();
 	};
 
 	virtual ~CsoFileReader(void) { Close(); };
@@ -65,6 +68,8 @@ public:
 	virtual int FinishRead(void);
 	virtual void CancelRead(void);
 
+	virtual void Prefetch(uint sector, uint count);
+
 	virtual void Close(void);
 
 	virtual uint GetBlockCount(void) const {
@@ -75,11 +80,43 @@ public:
 	virtual void SetDataOffset(int bytes) { m_dataoffset = bytes; }
 
 private:
+	// Decodes runs of upcoming frames into the cache, with its own file handle and zlib stream.
+	class DecodeThread : public Threading::pxThread {
+		typedef pxThread _parent;
+	public:
+		DecodeThread(CsoFileReader& reader);
+		virtual ~DecodeThread();
+
+		bool Init();
+
+		Mutex m_mtx_busy;         // held while m_job is being decoded
+		std::atomic<s64> m_job;   // job being decoded, or -1
+
+	protected:
+		void ExecuteTaskInThread();
+
+	private:
+		CsoFileReader& m_reader;
+		FILE* m_src;
+		z_stream* m_z_stream;
+		u8* m_readBuffer;
+		u8* m_zlibBuffer;
+	};
+
 	static bool ValidateHeader(const CsoHeader& hdr);
 	bool ReadFileHeader();
 	bool InitializeBuffers();
+	void StartDecoders();
+	void StopDecoders();
 	int ReadFromFrame(u8 *dest, u64 pos, int maxBytes);
-	bool DecompressFrame(u32 frame, u32 readBufferSize);
+	u32 ReadRawFrame(FILE* src, u32 frame, u8* readBuffer);
+	bool DecompressFrame(z_stream* strm, u8* readBuffer, u32 readBufferSize, u8* zlibBuffer);
+	bool IsCompressed(u32 frame) const { return (m_index[frame] & 0x80000000) == 0; }
+	u32 GetFrameCount() const { return (u32)((m_totalSize + m_frameSize - 1) / m_frameSize); }
+	void ScheduleReadAhead(u32 firstJob);
+	void WaitForFrame(u32 frame);
+	void ResetStats();
+	void LogStats();
 
 	u32 m_frameSize;
 	u8 m_frameShift;
@@ -93,10 +130,29 @@ private:
 	FILE* m_src;
 	z_stream* m_z_stream;
 
-#if CSO_USE_CHUNKSCACHE
+	// Decompressed frames. The chunk size is the frame size of the file.
 	ChunksCache m_cache;
-#endif
+
+	// Read-ahead pipeline
+	std::vector<DecodeThread*> m_decoders;
+	std::deque<u32> m_jobs;   // pending jobs (runs of m_framesPerJob frames), guarded by m_mtx_jobs
+	std::deque<u32> m_hints;  // jobs from Prefetch(), decoded when m_jobs is empty and kept across seeks
+	Mutex m_mtx_jobs;
+	Semaphore m_sem_jobs;
+	u32 m_framesPerJob;
+	u32 m_nextJob;            // first job after the scheduled read-ahead window
+	std::atomic<bool> m_quit;
+
+	// Throughput statistics, logged on Close()
+	u64 m_statBytes;
+	u64 m_statTicks;
+	u32 m_statFramesSync;
+	std::atomic<u32> m_statFramesAsync;
 
 	// The result of a read is stored here between BeginRead() and FinishRead().
 	int m_bytesRead;
+	// The pending request between BeginRead() and FinishRead().
+	uint m_pendingSector;
+	uint m_pendingCount;
+	void* m_pendingBuffer;
 };
@@ -86,10 +86,10 @@ static void WriteIndexToFile(Access* index, const wxString filename) {
 	std::ofstream outfile(PX_wfilename(filename), std::ofstream::binary);
 	outfile.write(GZIP_ID, GZIP_ID_LEN);
 
-	Point* tmp = index->list;
-	index->list = 0; // current pointer is useless on disk, normalize it as 0.
-	outfile.write((char*)index, sizeof(Access));
-	index->list = tmp;
+	// Don't touch index itself, readers may use it concurrently
+	Access header = *index;
+	header.list = 0; // current pointer is useless on disk, normalize it as 0.
+	outfile.write((char*)&header, sizeof(Access));
 
 	outfile.write((char*)index->list, sizeof(Point) * index->have);
 	outfile.close();
@@ -102,6 +102,133 @@ static void WriteIndexToFile(Access* index, const wxString filename) {
 	}
 }
 
+#define GZIP_PARTIAL_ID "PCSX2.index.gzip.v1.partial|"
+#define GZIP_PARTIAL_ID_LEN (sizeof(GZIP_PARTIAL_ID) - 1)
+
+// Partial index file format is:
+// - [GZIP_PARTIAL_ID_LEN] GZIP_PARTIAL_ID (no \0)
+// - [sizeof(s32)] span
+// - [rest] the access points found so far, appended as the build progresses
+//
+// have is the number of valid points ReadPartialIndexFromFile() found in the file. New
+// points are written right after them, over the incomplete point an interrupted write may
+// have left. What remains of it past the new end is always shorter than a point, so the
+// next read drops it the same way.
+static FILE* CreatePartialIndexFile(const wxString& filename, s32 span, int have) {
+	FILE* f = have && wxFileName::FileExists(filename) ? PX_fopen_rwb(filename) : 0;
+	if (f) {
+		char fileId[GZIP_PARTIAL_ID_LEN + 1] = { 0 };
+		s32 fileSpan = 0;
+		if (fread(fileId, 1, GZIP_PARTIAL_ID_LEN, f) == GZIP_PARTIAL_ID_LEN
+		    && fread(&fileSpan, sizeof(fileSpan), 1, f) == 1
+		    && !memcmp(fileId, GZIP_PARTIAL_ID, GZIP_PARTIAL_ID_LEN) && fileSpan == span
+		    && PX_fseeko(f, GZIP_PARTIAL_ID_LEN + sizeof(s32) + (PX_off_t)have * sizeof(Point), SEEK_SET) == 0)
+			return f;
+
+		// Changed under us since it was read, start it over
+		fclose(f);
+	}
+
+	f = PX_fopen_wb(filename);
+	if (!f) {
+		Console.Warning(L"Warning: Can't create partial index file, the build won't be resumable: '%s'", WX_STR(filename));
+		return 0;
+	}
+
+	fwrite(GZIP_PARTIAL_ID, 1, GZIP_PARTIAL_ID_LEN, f);
+	fwrite(&span, sizeof(span), 1, f);
+	fflush(f);
+	return f;
+}
+
+// Returns an index with the access points of a previous interrupted build, or 0
+static Access* ReadPartialIndexFromFile(const wxString& filename, s32 span) {
+	s64 size = fsize(filename);
+	if (size < (s64)(GZIP_PARTIAL_ID_LEN + sizeof(s32)))
+		return 0;
+
+	std::ifstream infile(PX_wfilename(filename), std::ifstream::binary);
+
+	char fileId[GZIP_PARTIAL_ID_LEN + 1] = { 0 };
+	s32 fileSpan = 0;
+	infile.read(fileId, GZIP_PARTIAL_ID_LEN);
+	infile.read((char*)&fileSpan, sizeof(fileSpan));
+	if (wxString::From8BitData(GZIP_PARTIAL_ID) != wxString::From8BitData(fileId) || fileSpan != span) {
+		Console.Warning(L"Warning: Ignoring incompatible partial gzip index: '%s'", WX_STR(filename));
+		infile.close();
+		wxRemoveFile(filename);
+		return 0;
+	}
+
+	// An interrupted write leaves an incomplete point at the end, ignore it
+	int have = (int)((size - GZIP_PARTIAL_ID_LEN - sizeof(s32)) / sizeof(Point));
+	if (!have) {
+		infile.close();
+		return 0;
+	}
+
+	Access* index = (Access*)malloc(sizeof(Access));
+	index->list = (Point*)malloc(sizeof(Point) * have);
+	infile.read((char*)index->list, sizeof(Point) * have);
+	infile.close();
+
+	index->have = have;
+	index->size = have;
+	index->span = span;
+	index->uncompressed_size = index->list[have - 1].out;
+	return index;
+}
+
+// The gzip trailer only stores the uncompressed size modulo 4GB. Deflate can't shrink
+// data more than 1032:1, nor grow it by more than 5 bytes per 64KB stored block (plus
+// the gzip header), which bounds the sizes that fit it. Returns true if only one size
+// fits, or if hint (> 0) picks one: the fitting size nearest to it.
+static bool EstimateUncompressedSize(const wxString& filename, PX_off_t hint, PX_off_t& size) {
+	s64 compressedSize = fsize(filename);
+	size = 0;
+	if (compressedSize < 4)
+		return false;
+
+	std::ifstream infile(PX_wfilename(filename), std::ifstream::binary);
+	u8 isize[4] = { 0 };
+	infile.seekg(compressedSize - 4);
+	infile.read((char*)isize, 4);
+	infile.close();
+
+	s64 smallest = compressedSize - compressedSize / 8192 - 0x10000;
+	s64 largest = compressedSize * 1032;
+
+	size = isize[0] | (isize[1] << 8) | (isize[2] << 16) | ((PX_off_t)isize[3] << 24);
+	while (size < smallest)
+		size += 0x100000000LL;
+
+	if (size + 0x100000000LL > largest)
+		return true;
+	if (hint <= 0)
+		return false;
+
+	while (size + 0x100000000LL <= largest && hint - size > size + 0x100000000LL - hint)
+		size += 0x100000000LL;
+	return true;
+}
+
+// Size of the ISO9660 volume, from its primary volume descriptor (sector 16), in 2048
+// byte sectors or raw 2352 byte (mode 1 or mode 2) ones. 0 if data isn't an ISO9660 image.
+static PX_off_t GetIsoVolumeSize(const unsigned char* data, int len) {
+	static const struct { int sector, offset; } layouts[] = { { 2048, 0 }, { 2352, 16 }, { 2352, 24 } };
+
+	for (const auto& layout : layouts) {
+		const int pvd = 16 * layout.sector + layout.offset;
+		if (pvd + 84 > len || data[pvd] != 1 || memcmp(data + pvd + 1, "CD001", 5))
+			continue;
+
+		const unsigned char* blocks = data + pvd + 80; // both-endian u32, little endian half first
+		return (PX_off_t)(blocks[0] | (blocks[1] << 8) | (blocks[2] << 16) | ((u32)blocks[3] << 24)) * layout.sector;
+	}
+
+	return 0;
+}
+
 static wxString INDEX_TEMPLATE_KEY(L"$(f)");
 // template:
 // must contain one and only one instance of '$(f)' (without the quotes)
@@ -181,8 +308,12 @@ GzippedFileReader::GzippedFileReader(void) :
 	mBytesRead(0),
 	m_pIndex(0),
 	m_zstates(0),
+	m_zstatesCount(0),
 	m_src(0),
-	m_cache(GZFILE_CACHE_SIZE_MB) {
+	m_cache(GZFILE_READ_CHUNK_SIZE),
+	m_indexBuilder(0),
+	m_indexComplete(false),
+	m_indexProgress(0) {
 	m_blocksize = 2048;
 	AsyncPrefetchReset();
 };
@@ -192,90 +323,197 @@ void GzippedFileReader::InitZstates() {
 		delete[] m_zstates;
 		m_zstates = 0;
 	}
+	m_zstatesCount = 0;
+	m_zstateOverflow.Kill();
 	if (!m_pIndex)
 		return;
 
 	// having another extra element helps avoiding logic for last (so 2+ instead of 1+)
 	int size = 2 + m_pIndex->uncompressed_size / m_pIndex->span;
 	m_zstates = new Czstate[size]();
+	m_zstatesCount = size;
+}
+
+// The size is only estimated while the index is being built, spans past it share one state
+GzippedFileReader::Czstate& GzippedFileReader::GetZstate(int spanix) {
+	return spanix < m_zstatesCount ? m_zstates[spanix] : m_zstateOverflow;
 }
 
-#ifndef _WIN32
-void GzippedFileReader::AsyncPrefetchReset() {};
-void GzippedFileReader::AsyncPrefetchOpen() {};
-void GzippedFileReader::AsyncPrefetchClose() {};
-void GzippedFileReader::AsyncPrefetchChunk(PX_off_t dummy) {};
-void GzippedFileReader::AsyncPrefetchCancel() {};
-#else
 // AsyncPrefetch works as follows:
-// ater extracting a chunk from the compressed file, ask the OS to asynchronously
-// read the next chunk from the file, and then completely ignore the result and
-// cancel the async read before the next extract. the next extract then reads the
-// data from the disk buf if it's overlapping/contained within the chunk we've
-// asked the OS to prefetch, then the OS is likely to already have it cached.
-// This procedure is frequently able to overcome seek time due to fragmentation of the
-// compressed file on disk without any meaningful penalty.
-// This system is only enabled for win32 where we have this async read request.
+// after each read, the prefetch thread is asked to extract the next
+// GZFILE_PREFETCH_CHUNKS chunks in the direction of the reads (forward for
+// typical streaming, backward if the game reads decreasing offsets) into the
+// cache. Sequential reads then hit the cache instead of inflating on the EE
+// thread. A new read supersedes the pending request, so a seek abandons the
+// speculation after at most one chunk.
 void GzippedFileReader::AsyncPrefetchReset() {
-	hOverlappedFile = INVALID_HANDLE_VALUE;
-	asyncInProgress = false;
+	m_prefetch = NULL;
+	m_lastReadOffset = -1;
+	m_readDirection = 1;
 }
 
 void GzippedFileReader::AsyncPrefetchOpen() {
-	hOverlappedFile = CreateFile(
-		m_filename,
-		GENERIC_READ,
-		FILE_SHARE_READ,
-		NULL,
-		OPEN_EXISTING,
-		FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_OVERLAPPED,
-		NULL);
+	m_prefetch = new PrefetchThread(*this);
+	m_prefetch->Start();
 };
 
 void GzippedFileReader::AsyncPrefetchClose()
 {
-	AsyncPrefetchCancel();
-
-	if (hOverlappedFile != INVALID_HANDLE_VALUE)
-		CloseHandle(hOverlappedFile);
+	if (m_prefetch) {
+		m_prefetch->Stop();
+		delete m_prefetch;
+	}
 
 	AsyncPrefetchReset();
 };
 
-void GzippedFileReader::AsyncPrefetchChunk(PX_off_t start)
+void GzippedFileReader::AsyncPrefetchChunk(PX_off_t offset, uint bytesRead)
 {
-	if (hOverlappedFile == INVALID_HANDLE_VALUE || asyncInProgress) {
-		Console.Warning(L"Unexpected file handle or progress state. Aborting prefetch.");
+	if (!m_prefetch)
 		return;
+
+	if (m_lastReadOffset >= 0 && offset != m_lastReadOffset)
+		m_readDirection = offset > m_lastReadOffset ? 1 : -1;
+	m_lastReadOffset = offset;
+
+	if (m_readDirection > 0)
+		m_prefetch->Request(offset + bytesRead, 1);
+	else
+		m_prefetch->Request(offset - 1, -1);
+};
+
+void GzippedFileReader::AsyncPrefetchCancel()
+{
+	if (m_prefetch)
+		m_prefetch->Request(-1, 0);
+};
+
+GzippedFileReader::PrefetchThread::PrefetchThread(GzippedFileReader& reader)
+	: m_reader(reader)
+	, m_reqOffset(-1)
+	, m_reqDirection(0)
+	, m_reqSerial(0)
+	, m_quit(false)
+	, m_extracting(-1)
+{
+	m_name = L"GzipPrefetch";
+	m_src = PX_fopen_rb(reader.m_filename);
+}
+
+GzippedFileReader::PrefetchThread::~PrefetchThread()
+{
+	try {
+		_parent::Cancel();
 	}
+	DESTRUCTOR_CATCHALL
 
-	LARGE_INTEGER offset;
-	offset.QuadPart = start;
+	m_zstate.Kill();
+	if (m_src)
+		fclose(m_src);
+}
 
-	DWORD bytesToRead = GZFILE_READ_CHUNK_SIZE;
+void GzippedFileReader::PrefetchThread::Stop()
+{
+	m_quit = true;
+	m_sem_event.Post();
+	if (IsRunning())
+		Block();
+}
 
-	ZeroMemory(&asyncOperationContext, sizeof(asyncOperationContext));
-	asyncOperationContext.hEvent = 0;
-	asyncOperationContext.Offset = offset.LowPart;
-	asyncOperationContext.OffsetHigh = offset.HighPart;
+void GzippedFileReader::PrefetchThread::Request(PX_off_t offset, int direction)
+{
+	{
+		ScopedLock lock(m_mtx_request);
+		m_reqOffset = offset;
+		m_reqDirection = direction;
+		m_reqSerial++;
+	}
+	m_sem_event.Post();
+}
 
-	ReadFile(hOverlappedFile, mDummyAsyncPrefetchTarget, bytesToRead, NULL, &asyncOperationContext);
-	asyncInProgress = true;
-};
+void GzippedFileReader::PrefetchThread::WaitChunk(PX_off_t chunkOffset)
+{
+	if (m_extracting.load(std::memory_order_acquire) == chunkOffset) {
+		ScopedLock lock(m_mtx_extract);
+	}
+}
 
-void GzippedFileReader::AsyncPrefetchCancel()
+void GzippedFileReader::PrefetchThread::ExecuteTaskInThread()
 {
-	if (!asyncInProgress)
+	if (!m_src)
 		return;
 
-	if (!CancelIo(hOverlappedFile)) {
-		Console.Warning("canceling gz prefetch failed. following prefetching will not work.");
-		return;
+	while (!m_quit) {
+		m_sem_event.WaitWithoutYield();
+
+		PX_off_t offset;
+		int direction;
+		u32 serial;
+		{
+			ScopedLock lock(m_mtx_request);
+			offset = m_reqOffset;
+			direction = m_reqDirection;
+			serial = m_reqSerial;
+		}
+
+		if (offset < 0 || direction == 0)
+			continue;
+
+		PX_off_t size;
+		{
+			ScopedLock lock(m_reader.m_mtx_index);
+			size = m_reader.m_pIndex->uncompressed_size;
+		}
+
+		PX_off_t chunk = offset / GZFILE_READ_CHUNK_SIZE * GZFILE_READ_CHUNK_SIZE;
+		for (int i = 0; i < GZFILE_PREFETCH_CHUNKS && !m_quit; i++, chunk += direction * GZFILE_READ_CHUNK_SIZE) {
+			{
+				ScopedLock lock(m_mtx_request);
+				if (serial != m_reqSerial)
+					break; // superseded by a newer read
+			}
+
+			if (chunk < 0 || chunk >= size)
+				break;
+
+			if (!PrefetchChunk(chunk))
+				break;
+		}
 	}
+}
 
-	asyncInProgress = false;
-};
-#endif /* _WIN32 */
+// Returns false if the chunk couldn't be extracted
+bool GzippedFileReader::PrefetchThread::PrefetchChunk(PX_off_t chunkOffset)
+{
+	if (m_reader.m_cache.Contains(chunkOffset))
+		return true;
+
+	ScopedLock lock(m_mtx_extract);
+	m_extracting.store(chunkOffset, std::memory_order_release);
+
+	// Continue the previous extraction when it stopped right before this
+	// chunk (sequential forward reads), otherwise start at the index point
+	Access* index = m_reader.m_pIndex;
+	PX_off_t extractOffset;
+	if (m_zstate.state.isValid && m_zstate.state.out_offset <= chunkOffset
+		&& chunkOffset - m_zstate.state.out_offset < index->span)
+		extractOffset = m_zstate.state.out_offset;
+	else if (index->span % GZFILE_READ_CHUNK_SIZE)
+		extractOffset = chunkOffset;
+	else
+		extractOffset = index->span * (chunkOffset / index->span);
+
+	int size = chunkOffset + GZFILE_READ_CHUNK_SIZE - extractOffset;
+	unsigned char* extracted = (unsigned char*)malloc(size);
+	int res = m_reader.Extract(m_src, extractOffset, extracted, size, &m_zstate.state);
+	if (res >= 0)
+		m_reader.CacheExtracted(extracted, extractOffset, res, size);
+	else
+		free(extracted);
+
+	m_extracting.store(-1, std::memory_order_release);
+	return res > 0;
+}
 
 // TODO: do better than just checking existance and extension
 bool GzippedFileReader::CanHandle(const wxString& fileName) {
@@ -299,33 +537,316 @@ bool GzippedFileReader::OkIndex() {
 			Console.Warning(L"It will work fine, but if you want to generate a new index with default intervals, delete this index file.");
 			Console.Warning(L"(smaller intervals mean bigger index file and quicker but more frequent decompressions)");
 		}
+		m_indexComplete = true;
+		m_indexProgress = 100;
 		InitZstates();
 		return true;
 	}
 
-	// No valid index file. Generate an index
-	Console.Warning(L"This may take a while (but only once). Scanning compressed file to generate a quick access index...");
+	// No valid index file. Generate an index in the background, resuming an interrupted build if possible
+	Access* index = ReadPartialIndexFromFile(indexfile + L".partial", GZFILE_SPAN_DEFAULT);
+	if (index) {
+		Console.WriteLn(Color_Green, L"Resuming the interrupted gzip index build of '%s'", WX_STR(m_filename));
+	} else {
+		index = (Access*)malloc(sizeof(Access));
+		index->list = (Point*)malloc(sizeof(Point) * 8);
+		index->size = 8;
+		index->have = 0;
+		index->span = GZFILE_SPAN_DEFAULT;
+		index->uncompressed_size = 0;
+	}
+	Console.Warning(L"Scanning compressed file in the background to generate a quick access index (only once). Seeking will be slow until it completes...");
 
-	Access *index;
-	FILE* infile = PX_fopen_rb(m_filename);
-	int len = build_index(infile, GZFILE_SPAN_DEFAULT, &index);
-	printf("\n"); // build_index prints progress without \n's
-	fclose(infile);
+	m_pIndex = index;
+	m_indexComplete = false;
+	m_indexProgress = 0;
 
-	if (len >= 0) {
-		m_pIndex = index;
-		WriteIndexToFile((Access*)m_pIndex, indexfile);
-	} else {
-		Console.Error(L"ERROR (%d): index could not be generated for file '%s'", len, WX_STR(m_filename));
-		free_index(index);
+	m_indexBuilder = new IndexBuilderThread(*this, indexfile);
+	m_indexBuilder->Start();
+
+	if (!m_indexBuilder->WaitFirstPoint()) {
+		Console.Error(L"ERROR: index could not be generated for file '%s'", WX_STR(m_filename));
+		m_indexBuilder->Stop();
+		delete m_indexBuilder;
+		m_indexBuilder = 0;
+		free_index(m_pIndex);
+		m_pIndex = 0;
 		InitZstates();
 		return false;
 	}
 
+	// The block count is read once when the image is opened, don't report a guess. The
+	// gzip trailer has the size modulo 4GB, the volume size of the image picks the rest.
+	// Only images that aren't ISO9660 have to wait for the index to be complete.
+	PX_off_t estimate;
+	bool exactSize = EstimateUncompressedSize(m_filename, 0, estimate);
+	if (!exactSize) {
+		const int len = 16 * 2352 + 24 + 84;
+		unsigned char* head = (unsigned char*)malloc(len);
+		Czstate state;
+		int res = Extract(m_src, 0, head, len, &state.state);
+		exactSize = EstimateUncompressedSize(m_filename, res > 0 ? GetIsoVolumeSize(head, res) : 0, estimate);
+		free(head);
+	}
+	{
+		ScopedLock lock(m_mtx_index);
+		if (!m_indexComplete)
+			m_pIndex->uncompressed_size = std::max(m_pIndex->uncompressed_size, estimate);
+	}
 	InitZstates();
+
+	if (!exactSize) {
+		Console.WriteLn(L"The uncompressed size of '%s' isn't known until the index is complete, waiting for it...", WX_STR(m_filename));
+		m_indexBuilder->Block();
+		if (!m_indexComplete) {
+			Console.Error(L"ERROR: index could not be generated for file '%s'", WX_STR(m_filename));
+			delete m_indexBuilder;
+			m_indexBuilder = 0;
+			free_index(m_pIndex);
+			m_pIndex = 0;
+			InitZstates();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// While the index is being built, extract() works on a copy of the access
+// point to start from, so the builder can keep growing the list meanwhile.
+int GzippedFileReader::Extract(FILE* src, PX_off_t offset, unsigned char* buf, int len, Zstate* state) {
+	if (m_indexComplete)
+		return extract(src, m_pIndex, offset, buf, len, state);
+
+	Point point;
+	Access snapshot;
+	{
+		ScopedLock lock(m_mtx_index);
+		Point* here = m_pIndex->list;
+		int ret = m_pIndex->have;
+		while (--ret > 0 && here[1].out <= offset)
+			here++;
+
+		point = *here;
+		snapshot = *m_pIndex;
+	}
+
+	snapshot.list = &point;
+	snapshot.have = 1;
+	snapshot.size = 1;
+	return extract(src, &snapshot, offset, buf, len, state);
+}
+
+GzippedFileReader::IndexBuilderThread::IndexBuilderThread(GzippedFileReader& reader, const wxString& indexfile)
+	: m_reader(reader)
+	, m_indexfile(indexfile)
+	, m_partialfile(indexfile + L".partial")
+	, m_partial(0)
+	, m_quit(false)
+{
+	m_name = L"GzipIndexBuilder";
+	m_compressedSize = fsize(reader.m_filename);
+}
+
+GzippedFileReader::IndexBuilderThread::~IndexBuilderThread()
+{
+	try {
+		_parent::Cancel();
+	}
+	DESTRUCTOR_CATCHALL
+
+	if (m_partial)
+		fclose(m_partial);
+}
+
+void GzippedFileReader::IndexBuilderThread::Stop()
+{
+	m_quit = true;
+	if (IsRunning())
+		Block();
+}
+
+bool GzippedFileReader::IndexBuilderThread::WaitFirstPoint()
+{
+	m_sem_firstPoint.WaitNoCancel();
+
+	ScopedLock lock(m_reader.m_mtx_index);
+	return m_reader.m_pIndex->have > 0;
+}
+
+void GzippedFileReader::IndexBuilderThread::ExecuteTaskInThread()
+{
+	int ret = Build();
+
+	if (ret < 0 && !m_quit)
+		Console.Error(L"ERROR (%d): gzip index build failed for file '%s'", ret, WX_STR(m_reader.m_filename));
+
+	// Release the waiter if the build ended before the first access point
+	m_sem_firstPoint.Post();
+}
+
+bool GzippedFileReader::IndexBuilderThread::AddPoint(int bits, PX_off_t in, PX_off_t out, unsigned left, unsigned char* window)
+{
+	Access* index = m_reader.m_pIndex;
+	{
+		ScopedLock lock(m_reader.m_mtx_index);
+
+		// Grow the list here: addpoint() frees the whole index when it fails to
+		if (index->have == index->size) {
+			Point* next = (Point*)realloc(index->list, sizeof(Point) * index->size * 2);
+			if (!next)
+				return false;
+			index->list = next;
+			index->size *= 2;
+		}
+
+		addpoint(index, bits, in, out, left, window);
+		index->uncompressed_size = std::max(index->uncompressed_size, out);
+	}
+
+	// Only this thread modifies the list, no need to lock to read it
+	if (m_partial) {
+		fwrite(&index->list[index->have - 1], sizeof(Point), 1, m_partial);
+		fflush(m_partial);
+	}
+
+	if (index->have == 1)
+		m_sem_firstPoint.Post();
+
 	return true;
 }
 
+// Same as build_index(), but can start from the last access point of the
+// index and is interruptible. Returns the number of access points or a zlib error
+int GzippedFileReader::IndexBuilderThread::Build()
+{
+	int ret;
+	PX_off_t totin, totout, last; /* our own total counters to avoid 4GB limit */
+	z_stream strm;
+	unsigned char input[CHUNK];
+	unsigned char window[WINSIZE];
+	Access* index = m_reader.m_pIndex;
+
+	FILE* in = PX_fopen_rb(m_reader.m_filename);
+	if (!in)
+		return Z_ERRNO;
+
+	m_partial = CreatePartialIndexFile(m_partialfile, index->span, index->have);
+
+	strm.zalloc = Z_NULL;
+	strm.zfree = Z_NULL;
+	strm.opaque = Z_NULL;
+	strm.avail_in = 0;
+	strm.next_in = Z_NULL;
+
+	if (index->have == 0) {
+		ret = inflateInit2(&strm, 47); /* automatic zlib or gzip decoding */
+		totin = totout = last = 0;
+	} else {
+		// Resume from the last access point, like extract() does
+		Point* here = &index->list[index->have - 1];
+		ret = inflateInit2(&strm, -15); /* raw inflate */
+		if (ret == Z_OK && PX_fseeko(in, here->in - (here->bits ? 1 : 0), SEEK_SET) == -1)
+			ret = Z_ERRNO;
+		if (ret == Z_OK && here->bits) {
+			int c = getc(in);
+			if (c == -1)
+				ret = ferror(in) ? Z_ERRNO : Z_DATA_ERROR;
+			else
+				inflatePrime(&strm, here->bits, c >> (8 - here->bits));
+		}
+		if (ret == Z_OK)
+			inflateSetDictionary(&strm, here->window, WINSIZE);
+		totin = here->in;
+		totout = last = here->out;
+		m_sem_firstPoint.Post();
+	}
+
+	if (ret != Z_OK) {
+		fclose(in);
+		return ret;
+	}
+
+	strm.avail_out = 0;
+	do {
+		if (m_quit) {
+			ret = Z_OK; // interrupted, the partial index is kept for the next time
+			goto build_end;
+		}
+
+		/* get some compressed data from input file */
+		strm.avail_in = fread(input, 1, CHUNK, in);
+		if (ferror(in)) {
+			ret = Z_ERRNO;
+			goto build_end;
+		}
+		if (strm.avail_in == 0) {
+			ret = Z_DATA_ERROR;
+			goto build_end;
+		}
+		strm.next_in = input;
+
+		/* process all of that, or until end of stream */
+		do {
+			/* reset sliding window if necessary */
+			if (strm.avail_out == 0) {
+				strm.avail_out = WINSIZE;
+				strm.next_out = window;
+			}
+
+			totin += strm.avail_in;
+			totout += strm.avail_out;
+			ret = inflate(&strm, Z_BLOCK); /* return at end of block */
+			totin -= strm.avail_in;
+			totout -= strm.avail_out;
+			if (ret == Z_NEED_DICT)
+				ret = Z_DATA_ERROR;
+			if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+				goto build_end;
+			if (ret == Z_STREAM_END)
+				break;
+
+			/* see build_index() for the conditions to add an access point */
+			if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+			    ((totout == 0 && index->have == 0) || totout - last > index->span)) {
+				if (!AddPoint(strm.data_type & 7, totin, totout, strm.avail_out, window)) {
+					ret = Z_MEM_ERROR;
+					goto build_end;
+				}
+				last = totout;
+			}
+		} while (strm.avail_in != 0);
+
+		int progress = m_compressedSize > 0 ? (int)(totin * 100 / m_compressedSize) : 0;
+		if (progress / 10 != m_reader.m_indexProgress / 10)
+			Console.WriteLn(Color_Gray, L"gzip index: %d%%", progress);
+		m_reader.m_indexProgress = std::min(progress, 99);
+	} while (ret != Z_STREAM_END);
+
+	{
+		ScopedLock lock(m_reader.m_mtx_index);
+		index->uncompressed_size = totout;
+		m_reader.m_indexComplete = true;
+	}
+	m_reader.m_indexProgress = 100;
+
+	// No more changes to the index from here on
+	WriteIndexToFile(index, m_indexfile);
+
+	if (m_partial) {
+		fclose(m_partial);
+		m_partial = 0;
+	}
+	wxRemoveFile(m_partialfile);
+
+	ret = index->have;
+
+build_end:
+	(void)inflateEnd(&strm);
+	fclose(in);
+	return ret;
+}
+
 bool GzippedFileReader::Open(const wxString& fileName) {
 	Close();
 	m_filename = fileName;
@@ -359,13 +880,15 @@ int GzippedFileReader::ReadSync(void* pBuffer, uint sector, uint count) {
 	int res = _ReadSync(pBuffer, offset, bytesToRead);
 	if (res < 0)
 		Console.Error(L"Error: iso-gzip read unsuccessful.");
+	else
+		AsyncPrefetchChunk(offset, res);
 	return res;
 }
 
 // If we have a valid and adequate zstate for this span, use it, else, use the index
 PX_off_t GzippedFileReader::GetOptimalExtractionStart(PX_off_t offset) {
 	int span = m_pIndex->span;
-	Czstate& cstate = m_zstates[offset / span];
+	Czstate& cstate = GetZstate(offset / span);
 	PX_off_t stateOffset = cstate.state.isValid ? cstate.state.out_offset : 0;
 	if (stateOffset && stateOffset <= offset)
 		return stateOffset; // state is faster than indexed
@@ -405,6 +928,14 @@ int GzippedFileReader::_ReadSync(void* pBuffer, PX_off_t offset, uint bytesToRea
 	if (res >= 0)
 		return res;
 
+	// The prefetch thread may be inflating this very chunk, waiting for it is cheaper than doing it again
+	if (m_prefetch) {
+		m_prefetch->WaitChunk(offset / GZFILE_READ_CHUNK_SIZE * GZFILE_READ_CHUNK_SIZE);
+		res = m_cache.Read(pBuffer, offset, bytesToRead);
+		if (res >= 0)
+			return res;
+	}
+
 	// Not available from cache. Decompress from optimal starting
 	// point in GZFILE_READ_CHUNK_SIZE chunks and cache each chunk.
 	PTT s = NOW();
@@ -414,43 +945,33 @@ int GzippedFileReader::_ReadSync(void* pBuffer, PX_off_t offset, uint bytesToRea
 
 	int span = m_pIndex->span;
 	int spanix = extractOffset / span;
-	AsyncPrefetchCancel();
-	res = extract(m_src, m_pIndex, extractOffset, extracted, size, &(m_zstates[spanix].state));
+	res = Extract(m_src, extractOffset, extracted, size, &(GetZstate(spanix).state));
 	if (res < 0) {
 		free(extracted);
 		return res;
 	}
-	AsyncPrefetchChunk(getInOffset(&(m_zstates[spanix].state)));
 
 	int copied = ChunksCache::CopyAvailable(extracted, extractOffset, res, pBuffer, offset, bytesToRead);
 
-	if (m_zstates[spanix].state.isValid && (extractOffset + res) / span != offset / span) {
+	Czstate& source = GetZstate(spanix);
+	if (source.state.isValid && (extractOffset + res) / span != offset / span) {
 		// The state no longer matches this span.
 		// move the state to the appropriate span because it will be faster than using the index
-		int targetix = (extractOffset + res) / span;
-		m_zstates[targetix].Kill();
-		// We have elements for the entire file, and another one.
-		m_zstates[targetix].state.in_offset = m_zstates[spanix].state.in_offset;
-		m_zstates[targetix].state.isValid = m_zstates[spanix].state.isValid;
-		m_zstates[targetix].state.out_offset = m_zstates[spanix].state.out_offset;
-		inflateCopy(&m_zstates[targetix].state.strm, &m_zstates[spanix].state.strm);
-
-		m_zstates[spanix].Kill();
-	}
-
-	if (size <= GZFILE_READ_CHUNK_SIZE)
-		m_cache.Take(extracted, extractOffset, res, size);
-	else { // split into cacheable chunks
-		for (int i = 0; i < size; i += GZFILE_READ_CHUNK_SIZE) {
-			int available = CLAMP(res - i, 0, GZFILE_READ_CHUNK_SIZE);
-			void* chunk = available ? malloc(available) : 0;
-			if (available)
-				memcpy(chunk, extracted + i, available);
-			m_cache.Take(chunk, extractOffset + i, available, std::min(size - i, GZFILE_READ_CHUNK_SIZE));
+		Czstate& target = GetZstate((extractOffset + res) / span);
+		if (&target != &source) {
+			target.Kill();
+			// We have elements for the entire file, and another one.
+			target.state.in_offset = source.state.in_offset;
+			target.state.isValid = source.state.isValid;
+			target.state.out_offset = source.state.out_offset;
+			inflateCopy(&target.state.strm, &source.state.strm);
+
+			source.Kill();
 		}
-		free(extracted);
 	}
 
+	CacheExtracted(extracted, extractOffset, res, size);
+
 	int duration = NOW() - s;
 	if (duration > 10)
 		Console.WriteLn(Color_Gray, L"gunzip: chunk #%5d-%2d : %1.2f MB - %d ms",
@@ -462,7 +983,28 @@ int GzippedFileReader::_ReadSync(void* pBuffer, PX_off_t offset, uint bytesToRea
 	return copied;
 }
 
+// Splits extracted data into cache chunks. extractOffset is always at a chunk boundary. Frees extracted.
+void GzippedFileReader::CacheExtracted(unsigned char* extracted, PX_off_t extractOffset, int res, int size) {
+	for (int i = 0; i < size; i += GZFILE_READ_CHUNK_SIZE) {
+		int available = CLAMP(res - i, 0, GZFILE_READ_CHUNK_SIZE);
+		if (available)
+			m_cache.Insert(extracted + i, extractOffset + i, available);
+	}
+	free(extracted);
+}
+
 void GzippedFileReader::Close() {
+	// The prefetch and index builder threads use the index and the cache
+	AsyncPrefetchClose();
+
+	if (m_indexBuilder) {
+		m_indexBuilder->Stop();
+		delete m_indexBuilder;
+		m_indexBuilder = 0;
+	}
+	m_indexComplete = false;
+	m_indexProgress = 0;
+
 	m_filename.Empty();
 	if (m_pIndex) {
 		free_index((Access*)m_pIndex);
@@ -476,6 +1018,4 @@ void GzippedFileReader::Close() {
 		fclose(m_src);
 		m_src = 0;
 	}
-
-	AsyncPrefetchClose();
 }
@@ -17,13 +17,16 @@
 
 typedef struct zstate Zstate;
 
+#include "Utilities/PersistentThread.h"
 #include "AsyncFileReader.h"
 #include "ChunksCache.h"
 #include "zlib_indexed.h"
 
+using namespace Threading;
+
 #define GZFILE_SPAN_DEFAULT (1048576L * 4)   /* distance between direct access points when creating a new index */
 #define GZFILE_READ_CHUNK_SIZE (256 * 1024)  /* zlib extraction chunks size (at 0-based boundaries) */
-#define GZFILE_CACHE_SIZE_MB 200             /* cache size for extracted data. must be at least GZFILE_READ_CHUNK_SIZE (in MB)*/
+#define GZFILE_PREFETCH_CHUNKS 8             /* chunks extracted ahead of the last read by the prefetch thread */
 
 class GzippedFileReader : public AsyncFileReader
 {
@@ -47,6 +50,8 @@ public:
 	virtual uint GetBlockCount(void) const {
 		// type and formula copied from FlatFileReader
 		// FIXME? : Shouldn't it be uint and (size - m_dataoffset) / m_blocksize ?
+		// Note: exact even while the index is being built, OkIndex() takes it from the gzip
+		// trailer and the ISO9660 volume size, or waits for the index if that's not enough
 		return (int)((m_pIndex ? m_pIndex->uncompressed_size : 0) / m_blocksize);
 	};
 
@@ -65,29 +70,99 @@ private:
 		Zstate state;
 	};
 
+	// Inflates the chunks which follow the last read, in the direction the game
+	// reads, into the cache. It has its own file handle and zlib state so it
+	// never competes with the reader for them.
+	class PrefetchThread : public Threading::pxThread {
+		typedef pxThread _parent;
+	public:
+		PrefetchThread(GzippedFileReader& reader);
+		virtual ~PrefetchThread();
+
+		void Stop();
+		void Request(PX_off_t offset, int direction);
+		void WaitChunk(PX_off_t chunkOffset); // Blocks while chunkOffset is being extracted
+
+	protected:
+		void ExecuteTaskInThread();
+
+	private:
+		bool PrefetchChunk(PX_off_t chunkOffset);
+
+		GzippedFileReader& m_reader;
+		FILE* m_src;
+		Czstate m_zstate;
+
+		Mutex m_mtx_request;
+		PX_off_t m_reqOffset; // guarded by m_mtx_request
+		int m_reqDirection;   // guarded by m_mtx_request
+		u32 m_reqSerial;      // guarded by m_mtx_request, incremented on each request
+		std::atomic<bool> m_quit;
+
+		Mutex m_mtx_extract;  // held while m_extracting is being inflated
+		std::atomic<PX_off_t> m_extracting;
+	};
+
+	// Builds the access index in the background so the game can start right
+	// away. Until it completes, reads past the last access point found so far
+	// are slow seeks. Access points are also appended to a partial index file
+	// as they are found, so an interrupted build resumes from there.
+	class IndexBuilderThread : public Threading::pxThread {
+		typedef pxThread _parent;
+	public:
+		IndexBuilderThread(GzippedFileReader& reader, const wxString& indexfile);
+		virtual ~IndexBuilderThread();
+
+		void Stop();
+		bool WaitFirstPoint(); // false if the build failed before producing an access point
+
+	protected:
+		void ExecuteTaskInThread();
+
+	private:
+		int  Build();
+		bool AddPoint(int bits, PX_off_t in, PX_off_t out, unsigned left, unsigned char* window);
+
+		GzippedFileReader& m_reader;
+		wxString m_indexfile;
+		wxString m_partialfile;
+		FILE* m_partial;
+		PX_off_t m_compressedSize;
+		Semaphore m_sem_firstPoint;
+		std::atomic<bool> m_quit;
+	};
+
 	bool	OkIndex();  // Verifies that we have an index, or try to create one
 	PX_off_t GetOptimalExtractionStart(PX_off_t offset);
 	int     _ReadSync(void* pBuffer, PX_off_t offset, uint bytesToRead);
+	int     Extract(FILE* src, PX_off_t offset, unsigned char* buf, int len, Zstate* state);
+	void	CacheExtracted(unsigned char* extracted, PX_off_t extractOffset, int res, int size);
 	void	InitZstates();
+	Czstate& GetZstate(int spanix);
 
 	int		mBytesRead; // Temp sync read result when simulating async read
 	Access* m_pIndex;   // Quick access index
 	Czstate* m_zstates;
+	int		m_zstatesCount;
+	Czstate m_zstateOverflow; // used past the estimated size while the index is being built
 	FILE*	m_src;
 
-	ChunksCache m_cache;
+	// m_pIndex->list may be reallocated by the builder until the index is complete
+	IndexBuilderThread* m_indexBuilder;
+	Mutex m_mtx_index;
+	std::atomic<bool> m_indexComplete;
+	std::atomic<int> m_indexProgress; // percentage of the file scanned, for the console
+
+	ChunksCache m_cache; // thread safe, shared with the prefetch thread
 
-#ifdef _WIN32
 	// Used by async prefetch
-	HANDLE hOverlappedFile;
-	OVERLAPPED asyncOperationContext;
-	bool asyncInProgress;
-	byte mDummyAsyncPrefetchTarget[GZFILE_READ_CHUNK_SIZE];
-#endif
+	PrefetchThread* m_prefetch;
+	PX_off_t m_lastReadOffset;
+	int m_readDirection;
 
 	void AsyncPrefetchReset();
 	void AsyncPrefetchOpen();
 	void AsyncPrefetchClose();
-	void AsyncPrefetchChunk(PX_off_t dummy);
+	void AsyncPrefetchChunk(PX_off_t offset, uint bytesRead);
 	void AsyncPrefetchCancel();
 };
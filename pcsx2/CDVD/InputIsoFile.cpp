@@ -17,9 +17,13 @@
 #include "PrecompiledHeader.h"
 #include "IopCommon.h"
 #include "IsoFileFormats.h"
+#include "AppConfig.h"
 
 #include <errno.h>
 
+// Profile extents prefetched ahead of the one being read
+static const int ProfilePrefetchExtents = 2;
+
 static const char* nameFromType(int type)
 {
     switch(type)
@@ -78,6 +82,25 @@ void InputIsoFile::BeginRead2(uint lsn)
 
 	m_reader->BeginRead(m_readbuffer, m_read_lsn, m_read_count);
 	m_read_inprogress = true;
+
+	m_trace.Record(IsoTrace_Read, m_read_lsn, m_read_count);
+
+	// Entering a new region of the profile: the next ones will be loaded soon.
+	int extent = m_profile.Find(lsn);
+	if (extent >= 0 && extent != m_profileLast)
+	{
+		m_profileLast = extent;
+		PrefetchProfile(extent + 1);
+	}
+}
+
+void InputIsoFile::PrefetchProfile(int extent)
+{
+	for (int i = extent; i < m_profile.GetCount() && i < extent + ProfilePrefetchExtents; i++)
+	{
+		const IsoProfileExtent& e = m_profile.GetExtent(i);
+		m_reader->Prefetch(e.lsn, e.count);
+	}
 }
 
 int InputIsoFile::FinishRead3(u8* dst, uint mode)
@@ -101,6 +124,8 @@ int InputIsoFile::FinishRead3(u8* dst, uint mode)
 		if(ret < 0)
 			return ret;
 	}
+
+	m_trace.Record(IsoTrace_Sector, m_current_lsn, 1, mode);
 		
 	switch (mode)
 	{
@@ -178,6 +203,7 @@ void InputIsoFile::_init()
 	ReadUnit = 0;
 	m_current_lsn = -1;
 	m_read_lsn = -1;
+	m_profileLast = -1;
 	m_reader = NULL;
 }
 
@@ -275,11 +301,22 @@ bool InputIsoFile::Open( const wxString& srcfile, bool testOnly )
 	DevCon.WriteLn ("blocksize   = %u", m_blocksize);
 	DevCon.WriteLn ("blockoffset = %d", m_blockofs);
 
+	// Read trace and prefetch profile, see IsoAccessTrace.h
+	const wxString isoname(Path::GetFilename(m_filename));
+	if (EmuConfig.CdvdTraceReads)
+		m_trace.Open(Path::Combine(GetLogFolder(), wxFileName(isoname + L".cdvdtrace")), m_blocks, m_blocksize);
+
+	if (m_profile.Load(Path::Combine(GetLogFolder(), wxFileName(isoname + L".prefetch")), m_blocks))
+		PrefetchProfile(0);
+
 	return true;
 }
 
 void InputIsoFile::Close()
 {
+	m_trace.Close();
+	m_profile.Clear();
+
 	delete m_reader;
 	m_reader = NULL;
 	
@@ -0,0 +1,164 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+#include "CompressedFileReaderUtils.h"
+#include "IsoAccessTrace.h"
+
+#include <algorithm>
+
+// Records are written in batches of this many
+static const size_t TRACE_FLUSH_RECORDS = 4096;
+
+IsoAccessTrace::IsoAccessTrace()
+	: m_file(NULL)
+	, m_start(0)
+{
+}
+
+IsoAccessTrace::~IsoAccessTrace()
+{
+	Close();
+}
+
+bool IsoAccessTrace::Open(const wxString& filename, u32 blocks, u32 blocksize)
+{
+	Close();
+
+	m_file = PX_fopen_ab(filename);
+	if (!m_file) {
+		Console.Warning(L"isoFile: unable to open the read trace '%s'", WX_STR(filename));
+		return false;
+	}
+
+	// A new file gets the header, an existing one is appended to.
+	PX_fseeko(m_file, 0, SEEK_END);
+	if (PX_ftello(m_file) == 0) {
+		IsoTraceHeader header = {};
+		memcpy(header.magic, ISO_TRACE_MAGIC, sizeof(header.magic));
+		header.version = ISO_TRACE_VERSION;
+		header.blocks = blocks;
+		header.blocksize = blocksize;
+		fwrite(&header, sizeof(header), 1, m_file);
+	}
+
+	m_records.reserve(TRACE_FLUSH_RECORDS);
+	m_start = GetCPUTicks();
+	Record(IsoTrace_Boot, 0, 0);
+
+	Console.WriteLn(Color_Green, L"isoFile: tracing reads to '%s'", WX_STR(filename));
+	return true;
+}
+
+void IsoAccessTrace::Close()
+{
+	if (!m_file)
+		return;
+
+	Flush();
+	fclose(m_file);
+	m_file = NULL;
+}
+
+void IsoAccessTrace::Record(IsoTraceKind kind, uint lsn, uint count, uint mode)
+{
+	if (!m_file)
+		return;
+
+	IsoTraceRecord record;
+	record.lsn = lsn;
+	record.time = (u32)((GetCPUTicks() - m_start) * 1000 / GetTickFrequency());
+	record.count = (u16)std::min(count, 0xFFFFu);
+	record.mode = (u8)mode;
+	record.kind = (u8)kind;
+	m_records.push_back(record);
+
+	if (m_records.size() >= TRACE_FLUSH_RECORDS)
+		Flush();
+}
+
+void IsoAccessTrace::Flush()
+{
+	if (m_records.empty())
+		return;
+
+	fwrite(m_records.data(), sizeof(IsoTraceRecord), m_records.size(), m_file);
+	fflush(m_file);
+	m_records.clear();
+}
+
+bool IsoPrefetchProfile::Load(const wxString& filename, u32 blocks)
+{
+	Clear();
+
+	if (!wxFileName::FileExists(filename))
+		return false;
+
+	FILE* fp = PX_fopen_rb(filename);
+	if (!fp)
+		return false;
+
+	IsoProfileHeader header;
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1
+		&& !memcmp(header.magic, ISO_PROFILE_MAGIC, sizeof(header.magic))
+		&& header.version == ISO_PROFILE_VERSION;
+
+	if (ok) {
+		m_extents.resize(header.count);
+		ok = fread(m_extents.data(), sizeof(IsoProfileExtent), header.count, fp) == header.count;
+	}
+	fclose(fp);
+
+	// Drop what doesn't fit this image, the profile might be from another dump.
+	if (ok) {
+		m_extents.erase(std::remove_if(m_extents.begin(), m_extents.end(),
+			[blocks](const IsoProfileExtent& e) { return e.count == 0 || e.lsn >= blocks || e.count > blocks - e.lsn; }),
+			m_extents.end());
+	}
+
+	if (!ok || m_extents.empty()) {
+		Console.Warning(L"isoFile: ignoring invalid prefetch profile '%s'", WX_STR(filename));
+		Clear();
+		return false;
+	}
+
+	m_byLsn.resize(m_extents.size());
+	for (size_t i = 0; i < m_extents.size(); i++)
+		m_byLsn[i] = (int)i;
+	std::sort(m_byLsn.begin(), m_byLsn.end(),
+		[this](int a, int b) { return m_extents[a].lsn < m_extents[b].lsn; });
+
+	Console.WriteLn(Color_Green, L"isoFile: loaded prefetch profile '%s' (%d regions)", WX_STR(filename), GetCount());
+	return true;
+}
+
+void IsoPrefetchProfile::Clear()
+{
+	m_extents.clear();
+	m_byLsn.clear();
+}
+
+int IsoPrefetchProfile::Find(uint lsn) const
+{
+	// Last extent starting at or before lsn. The tool writes disjoint extents.
+	auto it = std::upper_bound(m_byLsn.begin(), m_byLsn.end(), lsn,
+		[this](uint value, int index) { return value < m_extents[index].lsn; });
+	if (it == m_byLsn.begin())
+		return -1;
+
+	const int index = *(it - 1);
+	const IsoProfileExtent& e = m_extents[index];
+	return (lsn - e.lsn < e.count) ? index : -1;
+}
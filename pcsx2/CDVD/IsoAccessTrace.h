@@ -0,0 +1,114 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------------------------------------
+//  Sector access traces and prefetch profiles
+// --------------------------------------------------------------------------------------
+// With CdvdTraceReads enabled, InputIsoFile appends every sector access to
+// <logs>/<iso name>.cdvdtrace. tools/cdvdtrace turns a trace into a prefetch
+// profile (<iso name>.prefetch, same folder): the regions the game loads, in
+// the order it loads them. When a profile exists, reaching one region asks the
+// reader to prefetch the next ones.
+//
+// Both files are little endian, a header followed by fixed size entries. A
+// trace is appended to by every boot, each one starting with an IsoTrace_Boot
+// record.
+
+#define ISO_TRACE_MAGIC "CDVDTRC"
+#define ISO_TRACE_VERSION 1
+#define ISO_PROFILE_MAGIC "CDVDPFP"
+#define ISO_PROFILE_VERSION 1
+
+enum IsoTraceKind
+{
+	IsoTrace_Boot = 0,   // new session, time restarts at 0
+	IsoTrace_Read,       // reader request issued by BeginRead2 (lsn, count)
+	IsoTrace_Sector,     // sector delivered by FinishRead3 (lsn, mode)
+};
+
+#pragma pack(push, 1)
+struct IsoTraceHeader
+{
+	char magic[8];
+	u32 version;
+	u32 blocks;
+	u32 blocksize;
+};
+
+struct IsoTraceRecord
+{
+	u32 lsn;
+	u32 time;   // milliseconds since the boot record
+	u16 count;
+	u8 mode;
+	u8 kind;
+};
+
+struct IsoProfileHeader
+{
+	char magic[8];
+	u32 version;
+	u32 count;
+};
+
+struct IsoProfileExtent
+{
+	u32 lsn;
+	u32 count;
+};
+#pragma pack(pop)
+
+class IsoAccessTrace
+{
+	DeclareNoncopyableObject( IsoAccessTrace );
+
+public:
+	IsoAccessTrace();
+	~IsoAccessTrace();
+
+	bool Open(const wxString& filename, u32 blocks, u32 blocksize);
+	void Close();
+	bool IsOpened() const { return m_file != NULL; }
+
+	void Record(IsoTraceKind kind, uint lsn, uint count, uint mode = 0);
+
+protected:
+	void Flush();
+
+	FILE* m_file;
+	u64 m_start;
+	std::vector<IsoTraceRecord> m_records;
+};
+
+class IsoPrefetchProfile
+{
+public:
+	bool Load(const wxString& filename, u32 blocks);
+	void Clear();
+
+	int GetCount() const { return (int)m_extents.size(); }
+	const IsoProfileExtent& GetExtent(int index) const { return m_extents[index]; }
+
+	// Index of the extent containing lsn, or -1.
+	int Find(uint lsn) const;
+
+protected:
+	std::vector<IsoProfileExtent> m_extents;	// in load order
+	std::vector<int> m_byLsn;					// extent indices sorted by lsn
+};
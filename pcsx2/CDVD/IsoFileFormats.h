@@ -19,6 +19,7 @@
 #include "wx/wfstream.h"
 #include "AsyncFileReader.h"
 #include "CompressedFileReader.h"
+#include "IsoAccessTrace.h"
 #include <memory>
 
 enum isoType
@@ -64,6 +65,10 @@ protected:
 	uint		m_read_lsn;
 	uint		m_read_count;
 	u8			m_readbuffer[MaxReadUnit * CD_FRAMESIZE_RAW];
+
+	IsoAccessTrace		m_trace;
+	IsoPrefetchProfile	m_profile;
+	int			m_profileLast;	// profile extent of the last read, -1 if none
 	
 public:	
 	InputIsoFile();
@@ -92,6 +97,7 @@ public:
 	
 protected:
 	void _init();
+	void PrefetchProfile(int extent);
 
 	bool tryIsoType(u32 _size, s32 _offset, s32 _blockofs);
 	void FindParts();
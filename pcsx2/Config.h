@@ -248,6 +248,14 @@ struct Pcsx2Config
 				PreBlockCheckIOP:1;
 			bool
 				EnableEECache   :1;
+			bool
+				EnableVifCache  :1;		// keep the VIF unpack routines of each game on disk
+			bool
+				EnableVUCache   :1;		// keep the microVU programs of each game on disk
+			bool
+				EnableEETiering :1;		// recompile hot EE blocks as traces
+			bool
+				EESubpageTracking :1;	// manual blocks check subpage write counters instead of their code
 		BITFIELD_END
 
 		RecompilerOptions();
@@ -299,6 +307,9 @@ struct Pcsx2Config
 
 		int		VsyncQueueSize;
 
+		int		MtgsRingSizeFactor;	// MTGS ringbuffer size, as a power of 2 of qwords
+		int		MtgsWakeupQwc;		// qwords queued before the MTGS thread is woken up
+
 		bool		FrameLimitEnable;
 		bool		FrameSkipEnable;
 		VsyncMode	VsyncEnable;
@@ -320,6 +331,8 @@ struct Pcsx2Config
 			return
 				OpEqu( SynchronousMTGS )		&&
 				OpEqu( VsyncQueueSize )			&&
+				OpEqu( MtgsRingSizeFactor )		&&
+				OpEqu( MtgsWakeupQwc )			&&
 				
 				OpEqu( FrameSkipEnable )		&&
 				OpEqu( FrameLimitEnable )		&&
@@ -397,7 +410,8 @@ struct Pcsx2Config
 				IntcStat		:1,		// tells Pcsx2 to fast-forward through intc_stat waits.
 				WaitLoop		:1,		// enables constant loop detection and fast-forwarding
 				vuFlagHack		:1,		// microVU specific flag hack
-				vuThread        :1;		// Enable Threaded VU1
+				vuThread        :1,		// Enable Threaded VU1
+				ipuThread		:1;		// Decode IPU commands on a worker thread
 		BITFIELD_END
 
 		s8	EECycleRate;		// EE cycle rate selector (1.0, 1.5, 2.0)
@@ -448,11 +462,56 @@ struct Pcsx2Config
 		}
 	};
 
+	// ------------------------------------------------------------------------
+	struct RewindOptions
+	{
+		bool	Enabled;
+		int		Interval;		// frames between two captured states
+		int		BufferSizeMB;	// memory for the ring, newest state and deltas
+
+		RewindOptions();
+		void LoadSave( IniInterface& conf );
+
+		bool operator ==( const RewindOptions& right ) const
+		{
+			return OpEqu( Enabled ) && OpEqu( Interval ) && OpEqu( BufferSizeMB );
+		}
+
+		bool operator !=( const RewindOptions& right ) const
+		{
+			return !this->operator ==( right );
+		}
+	};
+
+	// ------------------------------------------------------------------------
+	struct CdvdOptions
+	{
+		int		CsoDecodeThreads;	// threads decoding CSO frames ahead of the reads, 0 decodes on the EE thread only
+		int		FlatFileQueueDepth;	// reads kept in flight ahead of sequential iso accesses (Linux)
+		int		FlatFileUnitSectors;	// sectors per read of the iso (Linux)
+		int		CompressedCacheMB;	// memory for the extracted data of compressed isos (CSO, gzip)
+
+		CdvdOptions();
+		void LoadSave( IniInterface& conf );
+
+		bool operator ==( const CdvdOptions& right ) const
+		{
+			return OpEqu( CsoDecodeThreads ) && OpEqu( FlatFileQueueDepth ) && OpEqu( FlatFileUnitSectors ) &&
+				OpEqu( CompressedCacheMB );
+		}
+
+		bool operator !=( const CdvdOptions& right ) const
+		{
+			return !this->operator ==( right );
+		}
+	};
+
 	BITFIELD32()
 		bool
 			CdvdVerboseReads	:1,		// enables cdvd read activity verbosely dumped to the console
 			CdvdDumpBlocks		:1,		// enables cdvd block dumping
 			CdvdShareWrite		:1,		// allows the iso to be modified while it's loaded
+			CdvdTraceReads		:1,		// logs every sector read of the iso, see CDVD/IsoAccessTrace.h
 			EnablePatches		:1,		// enables patch detection and application
 			EnableCheats		:1,		// enables cheat detection and application
 			EnableWideScreenPatches		:1,
@@ -479,6 +538,8 @@ struct Pcsx2Config
 	GamefixOptions		Gamefixes;
 	ProfilerOptions		Profiler;
 	DebugOptions		Debugger;
+	RewindOptions		Rewind;
+	CdvdOptions			Cdvd;
 
 	TraceLogFilters		Trace;
 
@@ -503,6 +564,8 @@ struct Pcsx2Config
 			OpEqu( Speedhacks )	&&
 			OpEqu( Gamefixes )	&&
 			OpEqu( Profiler )	&&
+			OpEqu( Rewind )		&&
+			OpEqu( Cdvd )		&&
 			OpEqu( Trace )		&&
 			OpEqu( BiosFilename );
 	}
@@ -528,6 +591,7 @@ TraceLogFilters&				SetTraceConfig();
 // ------------ CPU / Recompiler Options ---------------
 
 #define THREAD_VU1					(EmuConfig.Cpu.Recompiler.UseMicroVU1 && EmuConfig.Speedhacks.vuThread)
+#define THREAD_IPU					(EmuConfig.Speedhacks.ipuThread)
 #define CHECK_MICROVU0				(EmuConfig.Cpu.Recompiler.UseMicroVU0)
 #define CHECK_MICROVU1				(EmuConfig.Cpu.Recompiler.UseMicroVU1)
 #define CHECK_EEREC					(EmuConfig.Cpu.Recompiler.EnableEE && GetCpuProviders().IsRecAvailable_EE())
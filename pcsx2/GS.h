@@ -304,6 +304,17 @@ struct MTGS_FreezeData
 	s32			retval;		// value returned from the call, valid only after an mtgsWaitGS()
 };
 
+// EE <-> MTGS handoff counters, see SysMtgsThread::GetFrameStats().
+struct MTGS_RingStats
+{
+	u64		StallTicks;		// EE time spent waiting for room in the ringbuffer
+	u64		VsyncWaitTicks;	// EE time spent waiting on the VsyncQueueSize limit
+	u32		Stalls;
+	u32		Wakeups;		// times the MTGS thread was woken up
+	u32		Frames;
+	u32		FillLevels[8];	// ringbuffer occupancy at each vsync, in eighths of the ring
+};
+
 // --------------------------------------------------------------------------------------
 //  SysMtgsThread
 // --------------------------------------------------------------------------------------
@@ -313,17 +324,48 @@ class SysMtgsThread : public SysThreadBase
 
 public:
 	// note: when m_ReadPos == m_WritePos, the fifo is empty
-	// Threading info: m_ReadPos is updated by the MTGS thread. m_WritePos is updated by the EE thread
-	std::atomic<unsigned int> m_ReadPos;  // cur pos gs is reading from
-	std::atomic<unsigned int> m_WritePos; // cur pos ee thread is writing to
+	// Threading info: m_ReadPos is updated by the MTGS thread. m_WritePos is updated by the EE thread.
+	// Each side gets its own cache line, so the EE writing packets doesn't keep stealing the
+	// line the MTGS reads its position from (and vice versa).
+
+	// -- MTGS thread side --
+	__aligned(64) std::atomic<unsigned int> m_ReadPos;  // cur pos gs is reading from
+
+	// Raised by the MTGS thread before it sleeps on an empty ring, cleared by
+	// whoever posts the wake up. Only set when the thread really needs a post.
+	std::atomic<bool>	m_Sleeping;
+
+	// -- EE thread side --
+	__aligned(64) std::atomic<unsigned int> m_WritePos; // cur pos ee thread is writing to
+
+	// Last m_ReadPos seen by the EE, only reloaded when it doesn't leave room for a packet.
+	uint			m_CachedReadPos;
+
+	// Used to delay the sending of events.  Performance is better if the ringbuffer
+	// has more than one command in it when the thread is kicked: the thread is only
+	// woken up once EmuConfig.GS.MtgsWakeupQwc qwords are queued (or on vsyncs/stalls).
+	int				m_CopyDataTally;
+
+	// These vars maintain instance data for sending Data Packets.
+	// Only one data packet can be constructed and uploaded at a time.
+
+	uint			m_packet_startpos;	// size of the packet (data only, ie. not including the 16 byte command!)
+	uint			m_packet_size;		// size of the packet (data only, ie. not including the 16 byte command!)
+	uint			m_packet_writepos;	// index of the data location in the ringbuffer.
 
-	std::atomic<bool>	m_RingBufferIsBusy;
+	MTGS_RingStats		m_RingStats;		// current window, updated by the EE thread
+	std::atomic<u32>	m_WakeupCount;		// SetEvent() is also called from the MTVU thread
+	MTGS_RingStats		m_FrameStats;		// last complete window, read by the GUI
+	Mutex				m_mtx_Stats;
+
+	// -- Shared --
 	std::atomic<bool>	m_SignalRingEnable;
 	std::atomic<int>	m_SignalRingPosition;
 
 	std::atomic<int>	m_QueuedFrameCount;
 	std::atomic<bool>	m_VsyncSignalListener;
 
+	// The ring itself is lock free, these only let WaitGS() wait for the MTGS thread to go idle.
 	Mutex			m_mtx_RingBufferBusy;  // Is obtained while processing ring-buffer data
 	Mutex			m_mtx_RingBufferBusy2; // This one gets released on semaXGkick waiting...
 	Mutex			m_mtx_WaitGS;
@@ -334,20 +376,9 @@ public:
 	// (currently not used or implemented -- is a planned feature for a future threaded VU1)
 	//MutexLockRecursive m_PacketLocker;
 
-	// Used to delay the sending of events.  Performance is better if the ringbuffer
-	// has more than one command in it when the thread is kicked.
-	int				m_CopyDataTally;
-
 	Semaphore			m_sem_OpenDone;
 	std::atomic<bool>	m_PluginOpened;
 
-	// These vars maintain instance data for sending Data Packets.
-	// Only one data packet can be constructed and uploaded at a time.
-
-	uint			m_packet_startpos;	// size of the packet (data only, ie. not including the 16 byte command!)
-	uint			m_packet_size;		// size of the packet (data only, ie. not including the 16 byte command!)
-	uint			m_packet_writepos;	// index of the data location in the ringbuffer.
-
 #ifdef RINGBUF_DEBUG_STACK
 	Threading::Mutex m_lock_Stack;
 #endif
@@ -377,6 +408,10 @@ public:
 
 	bool IsPluginOpened() const { return m_PluginOpened; }
 
+	// Counters over the last complete window of vsyncs (Frames is 0 until there's one)
+	MTGS_RingStats GetFrameStats();
+	void ResetRingStats();
+
 protected:
 	void OpenPlugin();
 	void ClosePlugin();
@@ -390,6 +425,8 @@ protected:
 	void OnCleanupInThread();
 
 	void GenericStall( uint size );
+	uint GetFreeRoom( uint readpos ) const;
+	void SampleRingStats();
 
 	// Used internally by SendSimplePacket type functions
 	void _FinishSimplePacket();
@@ -460,18 +497,24 @@ extern int g_nLeftGSFrames;
 // (actual size is 1<<m_RingBufferSizeFactor simd vectors [128-bit values])
 // A value of 19 is a 8meg ring buffer.  18 would be 4 megs, and 20 would be 16 megs.
 // Default was 2mb, but some games with lots of MTGS activity want 8mb to run fast (rama)
+// The size in use is picked from EmuConfig.GS.MtgsRingSizeFactor when the MTGS thread
+// starts, up to RingBufferMaxSizeFactor.
 static const uint RingBufferSizeFactor = 19;
+static const uint RingBufferMinSizeFactor = 16;
+static const uint RingBufferMaxSizeFactor = 20;
+
+static const uint RingBufferMaxSize = 1<<RingBufferMaxSizeFactor;
 
 // size of the ringbuffer in simd128's.
-static const uint RingBufferSize = 1<<RingBufferSizeFactor;
+extern uint RingBufferSize;
 
 // Mask to apply to ring buffer indices to wrap the pointer from end to
 // start (the wrapping is what makes it a ringbuffer, yo!)
-static const uint RingBufferMask = RingBufferSize - 1;
+extern uint RingBufferMask;
 
 struct MTGS_BufferedData
 {
-	u128		m_Ring[RingBufferSize];
+	u128		m_Ring[RingBufferMaxSize];
 	u8			Regs[Ps2MemSize::GSregs];
 
 	MTGS_BufferedData() {}
@@ -163,6 +163,7 @@ __ri bool hwMFIFOWrite(u32 addr, const u128* data, uint qwc)
 		pxAssertMsg( PSM(dmacRegs.rbor.ADDR+ringsize-1) != NULL, "Scratchpad/MFIFO ringbuffer spans into invalid (unmapped) physical memory!" );
 		uint startpos = (addr & dmacRegs.rbsr.RMSK)/16;
 		MemCopy_WrappedDest( data, dst, startpos, ringsize, qwc );
+		mmap_MarkDmaWrite();
 	}
 	else
 	{
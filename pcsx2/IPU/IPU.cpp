@@ -34,7 +34,7 @@ __aligned16 tIPU_cmd ipu_cmd;
 __aligned16 tIPU_BP g_BP;
 __aligned16 decoder_t decoder;
 
-void IPUWorker();
+static bool IPUWorker();
 
 // Color conversion stuff, the memory layout is a total hack
 // convert_data_buffer is a pointer to the internal rgb struct (the first param in convert_init_t)
@@ -54,16 +54,23 @@ uint eecount_on_last_vdec = 0;
 bool FMVstarted = false;
 bool EnableFMV = false;
 
+// EE cycle the current IPUProcess run was started at (the worker can't read cpuRegs)
+static u32 ipu_cycle = 0;
+
+IPU_Thread ipuThread;
+
 void tIPU_cmd::clear()
 {
 	memzero_sse_a(*this);
 	current = 0xffffffff;
 }
 
-__fi void IPUProcessInterrupt()
+// Returns true if the current command completed and the IPU interrupt should be raised.
+static bool IPUProcess()
 {
+	bool irq = false;
 	if (ipuRegs.ctrl.BUSY) // && (g_BP.FP || g_BP.IFC || (ipu1ch.chcr.STR && ipu1ch.qwc > 0)))
-		IPUWorker();
+		irq = IPUWorker();
 	if (ipuRegs.ctrl.BUSY && ipuRegs.cmd.BUSY && ipuRegs.cmd.DATA == 0x000001B7) {
 		// 0x000001B7 is the MPEG2 sequence end code, signalling the end of a video.
 		// At the end of a video BUSY values should be automatically set to 0. 
@@ -71,6 +78,135 @@ __fi void IPUProcessInterrupt()
 		ipuRegs.cmd.BUSY = 0;
 		ipuRegs.ctrl.BUSY = 0;
 	}
+	return irq;
+}
+
+// FMV detection for the VDECs the last IPUProcess run went through; sets the flags
+// LogicalVsync switches the aspect ratio / renderer on (EE thread only, reads g_Conf).
+static void ipuDetectFMV(uint vdecs)
+{
+	if (EmuConfig.Gamefixes.FMVinSoftwareHack || g_Conf->GSWindow.FMVAspectRatioSwitch != FMV_AspectRatio_Switch_Off) {
+		static int count = 0;
+		while (vdecs--) {
+			if (count++ > 5) {
+				if (!FMVstarted) {
+					EnableFMV = true;
+					FMVstarted = true;
+				}
+				count = 0;
+			}
+		}
+		eecount_on_last_vdec = ipu_cycle;
+	}
+}
+
+// wait: the caller needs the result right away (register reads), so with the ipuThread
+// speedhack the command is run inline instead of being handed over and waited for.
+__fi void IPUProcessInterrupt(bool wait)
+{
+	ipuThread.Wait();
+	if (!ipuRegs.ctrl.BUSY) return;
+
+	ipu_cycle = cpuRegs.cycle;
+	if (THREAD_IPU && !wait)
+		ipuThread.Kick();
+	else
+		ipuThread.RunInline();
+}
+
+// --------------------------------------------------------------------------------------
+//  IPU_Thread Implementations
+// --------------------------------------------------------------------------------------
+IPU_Thread::IPU_Thread()
+{
+	m_name = L"IPU";
+	m_pending = false;
+	m_dmaWait = false;
+	m_dmaRequest = false;
+	m_irq = false;
+	m_vdecs = 0;
+}
+
+IPU_Thread::~IPU_Thread()
+{
+	try {
+		pxThread::Cancel();
+	}
+	DESTRUCTOR_CATCHALL
+}
+
+void IPU_Thread::ExecuteTaskInThread()
+{
+	PCSX2_PAGEFAULT_PROTECT {
+		for(;;) {
+			semaEvent.WaitWithoutYield();
+			m_irq = IPUProcess();
+			semaDone.Post();
+		}
+	} PCSX2_PAGEFAULT_EXCEPT;
+}
+
+void IPU_Thread::Kick()
+{
+	pxAssert(!m_pending);
+	if (!IsRunning()) Start();
+
+	m_dmaWait = cpuRegs.eCycle[DMAC_TO_IPU] == 0x9999;
+	m_dmaRequest = false;
+	m_irq = false;
+	m_vdecs = 0;
+	m_pending = true;
+	semaEvent.Post();
+
+	// Run inline, a low input FIFO restarts the DMA 32 cycles from now. Make sure an
+	// event test comes by then to deliver it, Poll() keeps them coming until it's done.
+	if (m_dmaWait) cpuSetNextEventDelta(32);
+}
+
+void IPU_Thread::Wait()
+{
+	if (!m_pending) return;
+
+	semaDone.WaitWithoutYield();
+	m_pending = false;
+
+	if (m_dmaRequest)
+	{
+		CPU_INT(DMAC_TO_IPU, 32);
+		cpuRegs.sCycle[DMAC_TO_IPU] = ipu_cycle;
+	}
+	if (m_vdecs) ipuDetectFMV(m_vdecs);
+	if (m_irq) hwIntcIrq(INTC_IPU);
+}
+
+void IPU_Thread::Poll()
+{
+	if (!m_pending) return;
+
+	// semaDone is posted after the results are written, the Wait() below takes it
+	if (semaDone.Count() > 0)
+		Wait();
+	else
+		cpuSetNextEventDelta(1024); // look again soon, games may spin on the interrupt
+}
+
+void IPU_Thread::RunInline()
+{
+	pxAssert(!m_pending);
+
+	// Not on the worker, so the input FIFO restarts the DMA itself
+	m_vdecs = 0;
+	const bool irq = IPUProcess();
+
+	if (m_vdecs) ipuDetectFMV(m_vdecs);
+	if (irq) hwIntcIrq(INTC_IPU);
+}
+
+void IPU_Thread::RequestDma()
+{
+	// Only the first request counts, CPU_INT clears the DMA's wait state.
+	m_dmaRequest |= m_dmaWait;
+	m_dmaWait = false;
 }
 
 /////////////////////////////////////////////////////////
@@ -78,6 +214,8 @@ __fi void IPUProcessInterrupt()
 
 void ipuReset()
 {
+	ipuThread.Wait();
+
 	memzero(ipuRegs);
 	memzero(g_BP);
 	memzero(decoder);
@@ -90,6 +228,8 @@ void ipuReset()
 
 void ReportIPU()
 {
+	ipuThread.Wait();
+
 	//Console.WriteLn(g_nDMATransfer.desc());
 	Console.WriteLn(ipu_fifo.in.desc());
 	Console.WriteLn(ipu_fifo.out.desc());
@@ -107,6 +247,7 @@ void SaveStateBase::ipuFreeze()
 {
 	// Get a report of the status of the ipu variables when saving and loading savestates.
 	//ReportIPU();
+	ipuThread.Wait();
 	FreezeTag("IPU");
 	Freeze(ipu_fifo);
 
@@ -201,7 +342,7 @@ __fi u32 ipuRead32(u32 mem)
 	pxAssert((mem & ~0xff) == 0x10002000);
 	mem &= 0xff;	// ipu repeats every 0x100
 
-	IPUProcessInterrupt();
+	IPUProcessInterrupt(true);
 
 	switch (mem)
 	{
@@ -243,7 +384,7 @@ __fi u64 ipuRead64(u32 mem)
 	pxAssert((mem & ~0xff) == 0x10002000);
 	mem &= 0xff;	// ipu repeats every 0x100
 
-	IPUProcessInterrupt();
+	IPUProcessInterrupt(true);
 
 	switch (mem)
 	{
@@ -294,6 +435,8 @@ __fi bool ipuWrite32(u32 mem, u32 value)
 	pxAssert((mem & ~0xfff) == 0x10002000);
 	mem &= 0xfff;
 
+	ipuThread.Wait();
+
 	switch (mem)
 	{
 		ipucase(IPU_CMD): // IPU_CMD
@@ -330,6 +473,8 @@ __fi bool ipuWrite64(u32 mem, u64 value)
 	pxAssert((mem & ~0xfff) == 0x10002000);
 	mem &= 0xfff;
 
+	ipuThread.Wait();
+
 	switch (mem)
 	{
 		ipucase(IPU_CMD):
@@ -344,7 +489,7 @@ __fi bool ipuWrite64(u32 mem, u64 value)
 
 
 //////////////////////////////////////////////////////
-// IPU Commands (exec on worker thread only)
+// IPU Commands (exec on worker thread only, see IPU_Thread)
 
 static void ipuBCLR(u32 val)
 {
@@ -409,17 +554,7 @@ static __ri void ipuBDEC(tIPU_CMD_BDEC bdec)
 
 static __fi bool ipuVDEC(u32 val)
 {
-	if (EmuConfig.Gamefixes.FMVinSoftwareHack || g_Conf->GSWindow.FMVAspectRatioSwitch != FMV_AspectRatio_Switch_Off) {
-		static int count = 0;
-		if (count++ > 5) {
-			if (!FMVstarted) {
-				EnableFMV = true;
-				FMVstarted = true;
-			}
-			count = 0;
-		}
-		eecount_on_last_vdec = cpuRegs.cycle;
-	}
+	ipuThread.CountVdec();
 	switch (ipu_cmd.pos[0])
 	{
 		case 0:
@@ -903,7 +1038,8 @@ __fi void IPUCMD_WRITE(u32 val)
 	//if(!ipu1ch.chcr.STR) hwIntcIrq(INTC_IPU);
 }
 
-__noinline void IPUWorker()
+// Returns true once the command completed, false if it stalled on a FIFO.
+static __noinline bool IPUWorker()
 {
 	pxAssert(ipuRegs.ctrl.BUSY);
 
@@ -915,7 +1051,7 @@ __noinline void IPUWorker()
 			//break;
 
 		case SCE_IPU_IDEC:
-			if (!mpeg2sliceIDEC()) return;
+			if (!mpeg2sliceIDEC()) return false;
 
 			//ipuRegs.ctrl.OFC = 0;
 			ipuRegs.topbusy = 0;
@@ -928,7 +1064,7 @@ __noinline void IPUWorker()
 			break;
 
 		case SCE_IPU_BDEC:
-			if (!mpeg2_slice()) return;
+			if (!mpeg2_slice()) return false;
 
 			ipuRegs.topbusy = 0;
 			ipuRegs.cmd.BUSY = 0;
@@ -937,33 +1073,33 @@ __noinline void IPUWorker()
 			break;
 
 		case SCE_IPU_VDEC:
-			if (!ipuVDEC(ipu_cmd.current)) return;
+			if (!ipuVDEC(ipu_cmd.current)) return false;
 
 			ipuRegs.topbusy = 0;
 			ipuRegs.cmd.BUSY = 0;
 			break;
 
 		case SCE_IPU_FDEC:
-			if (!ipuFDEC(ipu_cmd.current)) return;
+			if (!ipuFDEC(ipu_cmd.current)) return false;
 
 			ipuRegs.topbusy = 0;
 			ipuRegs.cmd.BUSY = 0;
 			break;
 
 		case SCE_IPU_SETIQ:
-			if (!ipuSETIQ(ipu_cmd.current)) return;
+			if (!ipuSETIQ(ipu_cmd.current)) return false;
 			break;
 
 		case SCE_IPU_SETVQ:
-			if (!ipuSETVQ(ipu_cmd.current)) return;
+			if (!ipuSETVQ(ipu_cmd.current)) return false;
 			break;
 
 		case SCE_IPU_CSC:
-			if (!ipuCSC(ipu_cmd.current)) return;
+			if (!ipuCSC(ipu_cmd.current)) return false;
 			break;
 
 		case SCE_IPU_PACK:
-			if (!ipuPACK(ipu_cmd.current)) return;
+			if (!ipuPACK(ipu_cmd.current)) return false;
 			break;
 
 		jNO_DEFAULT
@@ -972,5 +1108,5 @@ __noinline void IPUWorker()
 	// success
 	ipuRegs.ctrl.BUSY = 0;
 	ipu_cmd.current = 0xffffffff;
-	hwIntcIrq(INTC_IPU);
+	return true;
 }
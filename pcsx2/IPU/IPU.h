@@ -15,6 +15,7 @@
 
 #pragma once
 
+#include "System/SysThreads.h"
 #include "IPU_Fifo.h"
 
 #define ipumsk( src ) ( (src) & 0xff )
@@ -293,7 +294,60 @@ extern bool ipuWrite64(u32 mem,u64 value);
 
 extern void IPUCMD_WRITE(u32 val);
 extern void ipuSoftReset();
-extern void IPUProcessInterrupt();
+extern void IPUProcessInterrupt(bool wait = false);
+
+// --------------------------------------------------------------------------------------
+//  IPU_Thread
+// --------------------------------------------------------------------------------------
+// Runs IPUWorker on its own thread when the ipuThread speedhack is enabled.
+// IPUProcessInterrupt hands the current command over and returns, the worker then
+// decodes until the command completes or stalls on one of the FIFOs.  Anything the EE
+// can observe of the IPU (registers, FIFOs, DMA, savestates) calls Wait() first, so it
+// sees the same state it would have seen with the decode run inline.
+//
+// The worker never touches EE state: the IPU interrupt and the IPU1 DMA restart it
+// would raise are recorded and applied by Wait(), which the event test also calls.
+class IPU_Thread : public pxThread
+{
+	Semaphore semaEvent;	// EE -> worker: command handed over
+	Semaphore semaDone;		// worker -> EE: command completed or stalled
+
+	// Written by the EE before semaEvent is posted, or by the worker before semaDone
+	// is posted; the semaphores order the accesses.
+	bool m_pending;			// handed over and not waited for yet
+	bool m_dmaWait;			// IPU1 DMA is waiting for room in the input FIFO
+	bool m_dmaRequest;		// the worker ran the input FIFO low, restart the IPU1 DMA
+	bool m_irq;				// the worker completed the command
+	uint m_vdecs;			// VDECs run, the FMV detection happens in Wait()
+
+public:
+	IPU_Thread();
+	virtual ~IPU_Thread();
+
+	// Runs IPUProcessInterrupt's work on the worker (EE thread only)
+	void Kick();
+
+	// Waits for the worker and applies the interrupts it raised (EE thread only)
+	void Wait();
+
+	// Applies the interrupts if the worker is done, without blocking (EE thread only).
+	// The event test uses it, the accesses to the IPU state use Wait().
+	void Poll();
+
+	// Runs IPUProcessInterrupt's work on the EE thread, the worker must be idle
+	void RunInline();
+
+	// Called by the worker when it reads from a low input FIFO
+	void RequestDma();
+
+	// Called by IPUWorker for each VDEC, the worker can't read g_Conf or the FMV flags
+	void CountVdec() { m_vdecs++; }
+
+protected:
+	void ExecuteTaskInThread();
+};
+
+extern IPU_Thread ipuThread;
 
 extern u8 getBits128(u8 *address, bool advance);
 extern u8 getBits64(u8 *address, bool advance);
@@ -28,6 +28,8 @@ static tIPU_DMA g_nDMATransfer;
 
 void ipuDmaReset()
 {
+	ipuThread.Wait();
+
 	IPU1Status.InProgress	= false;
 	IPU1Status.DMAMode		= DMA_MODE_NORMAL;
 	IPU1Status.DMAFinished	= true;
@@ -37,6 +39,8 @@ void ipuDmaReset()
 
 void SaveStateBase::ipuDmaFreeze()
 {
+	ipuThread.Wait();
+
 	FreezeTag( "IPUdma" );
 	Freeze(g_nDMATransfer);
 	Freeze(IPU1Status);
@@ -112,6 +116,8 @@ int IPU1dma()
 	int ipu1cycles = 0;
 	int totalqwc = 0;
 
+	ipuThread.Wait();
+
 	//We need to make sure GIF has flushed before sending IPU data, it seems to REALLY screw FFX videos
 
 	if(!ipu1ch.chcr.STR || IPU1Status.DMAMode == 2)
@@ -194,6 +200,8 @@ int IPU1dma()
 
 void IPU0dma()
 {
+	ipuThread.Wait();
+
 	if(!ipuRegs.ctrl.OFC) 
 	{
 		IPU_INT_FROM( 64 );
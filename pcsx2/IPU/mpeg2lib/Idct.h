@@ -0,0 +1,226 @@
+/*
+ * idct.h
+ * Copyright (C) 2000-2002 Michel Lespinasse <walken@zoy.org>
+ * Copyright (C) 1999-2000 Aaron Holtzman <aholtzma@ess.engr.uvic.ca>
+ * Modified by Florin for PCSX2 emu
+ *
+ * This file is part of mpeg2dec, a free MPEG-2 video stream decoder.
+ * See http://libmpeg2.sourceforge.net/ for updates.
+ *
+ * mpeg2dec is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpeg2dec is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+// The idct of mpeg2_idct_copy/mpeg2_idct_add, in a header of its own so that
+// tools/ipuidct can check it against the scalar mpeg2dec code.  Only Idct.cpp
+// includes it in the emulator.
+
+#pragma once
+
+#define W1 2841 /* 2048*sqrt (2)*cos (1*pi/16) */
+#define W2 2676 /* 2048*sqrt (2)*cos (2*pi/16) */
+#define W3 2408 /* 2048*sqrt (2)*cos (3*pi/16) */
+#define W5 1609 /* 2048*sqrt (2)*cos (5*pi/16) */
+#define W6 1108 /* 2048*sqrt (2)*cos (6*pi/16) */
+#define W7 565  /* 2048*sqrt (2)*cos (7*pi/16) */
+
+// The idct runs on eight rows (then columns) at once in SSE2 registers.  The
+// results are bit exact with the scalar mpeg2dec code it replaces: same
+// constants, same rounding, and 16 bit truncation between the passes.
+
+static __fi __m128i idct_pair(int w0, int w1)
+{
+	return _mm_set1_epi32((u16)w0 | ((u32)(u16)w1 << 16));
+}
+
+// x * 181, wrapping around like the int multiply it replaces
+static __fi __m128i idct_mul181(__m128i x)
+{
+	__m128i r = _mm_add_epi32(x, _mm_slli_epi32(x, 2));
+	r = _mm_add_epi32(r, _mm_slli_epi32(x, 4));
+	r = _mm_add_epi32(r, _mm_slli_epi32(x, 5));
+	return _mm_add_epi32(r, _mm_slli_epi32(x, 7));
+}
+
+template< bool hi >
+static __fi __m128i idct_unpack(__m128i a, __m128i b)
+{
+	return hi ? _mm_unpackhi_epi16(a, b) : _mm_unpacklo_epi16(a, b);
+}
+
+// Four of the eight 1D transforms of idct_pass, widened to 32 bits.
+template< bool col, bool hi >
+static __fi void idct_pass_half(const __m128i (&v)[8], __m128i (&out)[8])
+{
+	const int shift = col ? 17 : 8;
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i d0 = _mm_srai_epi32(idct_unpack<hi>(zero, v[0]), 16 - 11);
+	__m128i d2 = _mm_srai_epi32(idct_unpack<hi>(zero, v[2]), 16 - 11);
+	d0 = _mm_add_epi32(d0, _mm_set1_epi32(col ? 65536 : 128));
+
+	__m128i t0 = _mm_add_epi32(d0, d2);
+	__m128i t1 = _mm_sub_epi32(d0, d2);
+	__m128i p = idct_unpack<hi>(v[3], v[1]);
+	__m128i t2 = _mm_madd_epi16(p, idct_pair(W6, W2));
+	__m128i t3 = _mm_madd_epi16(p, idct_pair(-W2, W6));
+	__m128i a0 = _mm_add_epi32(t0, t2);
+	__m128i a1 = _mm_add_epi32(t1, t3);
+	__m128i a2 = _mm_sub_epi32(t1, t3);
+	__m128i a3 = _mm_sub_epi32(t0, t2);
+
+	p = idct_unpack<hi>(v[7], v[4]);
+	t0 = _mm_madd_epi16(p, idct_pair(W7, W1));
+	t1 = _mm_madd_epi16(p, idct_pair(-W1, W7));
+	p = idct_unpack<hi>(v[5], v[6]);
+	t2 = _mm_madd_epi16(p, idct_pair(W3, W5));
+	t3 = _mm_madd_epi16(p, idct_pair(-W5, W3));
+	__m128i b0 = _mm_add_epi32(t0, t2);
+	__m128i b3 = _mm_add_epi32(t1, t3);
+	t0 = _mm_sub_epi32(t0, t2);
+	t1 = _mm_sub_epi32(t1, t3);
+
+	__m128i b1, b2;
+	if (col)
+	{
+		t0 = _mm_srai_epi32(t0, 8);
+		t1 = _mm_srai_epi32(t1, 8);
+		b1 = idct_mul181(_mm_add_epi32(t0, t1));
+		b2 = idct_mul181(_mm_sub_epi32(t0, t1));
+	}
+	else
+	{
+		b1 = _mm_srai_epi32(idct_mul181(_mm_add_epi32(t0, t1)), 8);
+		b2 = _mm_srai_epi32(idct_mul181(_mm_sub_epi32(t0, t1)), 8);
+	}
+
+	out[0] = _mm_srai_epi32(_mm_add_epi32(a0, b0), shift);
+	out[1] = _mm_srai_epi32(_mm_add_epi32(a1, b1), shift);
+	out[2] = _mm_srai_epi32(_mm_add_epi32(a2, b2), shift);
+	out[3] = _mm_srai_epi32(_mm_add_epi32(a3, b3), shift);
+	out[4] = _mm_srai_epi32(_mm_sub_epi32(a3, b3), shift);
+	out[5] = _mm_srai_epi32(_mm_sub_epi32(a2, b2), shift);
+	out[6] = _mm_srai_epi32(_mm_sub_epi32(a1, b1), shift);
+	out[7] = _mm_srai_epi32(_mm_sub_epi32(a0, b0), shift);
+}
+
+// Packs to 16 bits the way a store to s16 truncates
+static __fi __m128i idct_pack(__m128i lo, __m128i hi)
+{
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+
+// The row (col = false) or column pass of the idct over eight 1D transforms at once,
+// v[k] holding the kth input of each.  Same arithmetic as the scalar mpeg2dec code,
+// with the BUTTERFLY products coming out of pmaddwd.
+template< bool col >
+static __fi void idct_pass(__m128i (&v)[8])
+{
+	__m128i lo[8], hi[8];
+	idct_pass_half<col, false>(v, lo);
+	idct_pass_half<col, true>(v, hi);
+
+	for (int i = 0; i < 8; i++)
+		v[i] = idct_pack(lo[i], hi[i]);
+}
+
+static __fi void idct_transpose(__m128i (&r)[8])
+{
+	__m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+	__m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+	__m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+	__m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+	__m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+	__m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+	__m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+	__m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+	__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+	__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+	__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+	__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+	r[0] = _mm_unpacklo_epi64(b0, b4);
+	r[1] = _mm_unpackhi_epi64(b0, b4);
+	r[2] = _mm_unpacklo_epi64(b1, b5);
+	r[3] = _mm_unpackhi_epi64(b1, b5);
+	r[4] = _mm_unpacklo_epi64(b2, b6);
+	r[5] = _mm_unpackhi_epi64(b2, b6);
+	r[6] = _mm_unpacklo_epi64(b3, b7);
+	r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+// Loads the block and runs the idct on it, r[i] receiving row i.
+static __fi void idct(const s16 * block, __m128i (&r)[8])
+{
+	for (int i = 0; i < 8; i++)
+		r[i] = _mm_load_si128((const __m128i*)(block + 8 * i));
+
+	idct_transpose(r);
+	idct_pass<false>(r);
+	idct_transpose(r);
+	idct_pass<true>(r);
+}
+
+static __fi void idct_copy(s16 * block, u8 * dest, const int stride)
+{
+	__m128i r[8];
+	idct(block, r);
+
+	// In legal streams the output is between -384 and +384, saturate to 0..255
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < 8; i++)
+	{
+		_mm_storel_epi64((__m128i*)dest, _mm_packus_epi16(r[i], r[i]));
+		_mm_store_si128((__m128i*)(block + 8 * i), zero);
+		dest += stride;
+	}
+}
+
+
+// stride = increment for dest in 16-bit units (typically either 8 [128 bits] or 16 [256 bits]).
+static __fi void idct_add(const int last, s16 * block, s16 * dest, const int stride)
+{
+	// on the IPU, stride is always assured to be multiples of QWC (bottom 3 bits are 0).
+
+    if (last != 129 || (block[0] & 7) == 4)
+    {
+		__m128i r[8];
+		idct(block, r);
+
+		const __m128i zero = _mm_setzero_si128();
+		for (int i = 0; i < 8; i++)
+		{
+			_mm_store_si128((__m128i*)(dest + stride * i), r[i]);
+			_mm_store_si128((__m128i*)(block + 8 * i), zero);
+		}
+    }
+    else
+    {
+		s16 DC = ((int)block[0] + 4) >> 3;
+		s16 dcf[2] = { DC, DC };
+		block[0] = block[63] = 0;
+
+		__m128 dc128 = _mm_set_ps1(*(float*)dcf);
+
+		for(int i=0; i<8; ++i)
+			_mm_store_ps((float*)(dest+(stride*i)), dc128);
+    }
+}
@@ -50,6 +50,9 @@ const int non_linear_quantizer_scale [] =
 	back to the 1st slot when 128bits have been read.
 */
 const DCTtab * tab;
+
+static const __aligned16 DCTlookupSet DCTlookup;
+
 int mbaCount = 0;
 
 int bitstream_init ()
@@ -347,6 +350,7 @@ static bool get_intra_block()
 	const u8 (&quant_matrix)[64] = decoder.iq;
 	int quantizer_scale = decoder.quantizer_scale;
 	s16 * dest = decoder.DCTblock;
+	const int table = (decoder.intra_vlc_format && !decoder.mpeg1) ? DCTlookupSet::B15 : DCTlookupSet::B14_next;
 	u16 code; 
 
 	/* decode AC coefficients */
@@ -362,60 +366,9 @@ static bool get_intra_block()
 		}
 
 		code = UBITS(16);
+		tab = DCTlookup.get(table, code);
 
-		if (code >= 16384 && (!decoder.intra_vlc_format || decoder.mpeg1))
-		{
-		  tab = &DCT.next[(code >> 12) - 4];
-		}
-		else if (code >= 1024)
-		{
-			if (decoder.intra_vlc_format && !decoder.mpeg1)
-			{
-				tab = &DCT.tab0a[(code >> 8) - 4];
-			}
-			else
-			{
-				tab = &DCT.tab0[(code >> 8) - 4];
-			}
-		}
-		else if (code >= 512)
-		{
-			if (decoder.intra_vlc_format && !decoder.mpeg1)
-			{
-				tab = &DCT.tab1a[(code >> 6) - 8];
-			}
-			else
-			{
-				tab = &DCT.tab1[(code >> 6) - 8];
-			}
-		}
-
-		// [TODO] Optimization: Following codes can all be done by a single "expedited" lookup
-		// that should use a single unrolled DCT table instead of five separate tables used
-		// here.  Multiple conditional statements are very slow, while modern CPU data caches
-		// have lots of room to spare.
-
-		else if (code >= 256)
-		{
-			tab = &DCT.tab2[(code >> 4) - 16];
-		}
-		else if (code >= 128)
-		{    
-			tab = &DCT.tab3[(code >> 3) - 16];
-		}
-		else if (code >= 64)
-		{    
-			tab = &DCT.tab4[(code >> 2) - 16];
-		}
-		else if (code >= 32)
-		{    
-			tab = &DCT.tab5[(code >> 1) - 16];
-		}
-		else if (code >= 16)
-		{    
-			tab = &DCT.tab6[code - 16];
-		}
-		else
+		if (tab->run == 66)
 		{
 		  ipu_cmd.pos[4] = 0;
 		  return true;
@@ -520,53 +473,9 @@ static bool get_non_intra_block(int * last)
 			}
 
 			code = UBITS(16);
+			tab = DCTlookup.get(i ? DCTlookupSet::B14_next : DCTlookupSet::B14_first, code);
 
-			if (code >= 16384)
-			{
-				if (i==0)
-				{
-					tab = &DCT.first[(code >> 12) - 4];
-				}
-				else
-				{			
-					tab = &DCT.next[(code >> 12)- 4];
-				}
-			}
-			else if (code >= 1024)
-			{
-				tab = &DCT.tab0[(code >> 8) - 4];
-			}
-			else if (code >= 512)
-			{		
-				tab = &DCT.tab1[(code >> 6) - 8];
-			}
-
-			// [TODO] Optimization: Following codes can all be done by a single "expedited" lookup
-			// that should use a single unrolled DCT table instead of five separate tables used
-			// here.  Multiple conditional statements are very slow, while modern CPU data caches
-			// have lots of room to spare.
-
-			else if (code >= 256)
-			{		
-				tab = &DCT.tab2[(code >> 4) - 16];
-			}
-			else if (code >= 128)
-			{		
-				tab = &DCT.tab3[(code >> 3) - 16];
-			}
-			else if (code >= 64)
-			{		
-				tab = &DCT.tab4[(code >> 2) - 16];
-			}
-			else if (code >= 32)
-			{		
-				tab = &DCT.tab5[(code >> 1) - 16];
-			}
-			else if (code >= 16)
-			{		
-				tab = &DCT.tab6[code - 16];
-			}
-			else
+			if (tab->run == 66)
 			{
 				ipu_cmd.pos[4] = 0;
 				return true;
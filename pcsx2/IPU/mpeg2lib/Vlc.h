@@ -22,7 +22,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
  
-// WARNING!  This file should only be included into Mpeg.cpp AND NOWHERE ELSE.
+// WARNING!  This file should only be included into Mpeg.cpp AND NOWHERE ELSE (tools/ipuidct
+// aside, which checks DCTlookupSet against the table cascades).
 // All contents of this file are used only by Mpeg.cpp, and including it elsewhere will
 // just result in the linker having to remove a whole lot of redundant/unused decoder
 // tables and static functions. -- air
@@ -663,4 +664,60 @@ static const __aligned16 DCTtabSet DCT =
 
 };
 
+// The DCT tables above unrolled, so that the next 16 bits of the stream resolve a
+// coefficient code with a single lookup: codes >= 1024 by their top 8 bits, and the
+// longer ones (six or more leading zeros) by their low 10 bits.  Codes below 16 are
+// invalid and get run == 66.
+struct DCTlookupSet
+{
+	enum { B14_first, B14_next, B15 };
+
+	DCTtab hi[3][256];
+	DCTtab lo[3][1024];
+
+	DCTlookupSet();
+
+	const DCTtab* get(int table, u16 code) const
+	{
+		return (code >= 1024) ? &hi[table][code >> 8] : &lo[table][code];
+	}
+};
+
+static const DCTtab DCT_invalid = { 66, 0, 0 };
+
+// Range checks over the DCT tables, for the DCTlookupSet constructor.  Same as the
+// cascades the block decoders used before, tools/ipuidct checks the two decode alike.
+static const DCTtab* get_dct_tab(int table, u16 code)
+{
+	if (code >= 16384 && table != DCTlookupSet::B15)
+		return (table == DCTlookupSet::B14_first) ? &DCT.first[(code >> 12) - 4] : &DCT.next[(code >> 12) - 4];
+	else if (code >= 1024)
+		return (table == DCTlookupSet::B15) ? &DCT.tab0a[(code >> 8) - 4] : &DCT.tab0[(code >> 8) - 4];
+	else if (code >= 512)
+		return (table == DCTlookupSet::B15) ? &DCT.tab1a[(code >> 6) - 8] : &DCT.tab1[(code >> 6) - 8];
+	else if (code >= 256)
+		return &DCT.tab2[(code >> 4) - 16];
+	else if (code >= 128)
+		return &DCT.tab3[(code >> 3) - 16];
+	else if (code >= 64)
+		return &DCT.tab4[(code >> 2) - 16];
+	else if (code >= 32)
+		return &DCT.tab5[(code >> 1) - 16];
+	else if (code >= 16)
+		return &DCT.tab6[code - 16];
+
+	return &DCT_invalid;
+}
+
+inline DCTlookupSet::DCTlookupSet()
+{
+	for (int t = 0; t < 3; t++)
+	{
+		for (int i = 0; i < 256; i++)
+			hi[t][i] = *get_dct_tab(t, i << 8);
+		for (int i = 0; i < 1024; i++)
+			lo[t][i] = *get_dct_tab(t, i);
+	}
+}
+
 #endif//__VLC_H__
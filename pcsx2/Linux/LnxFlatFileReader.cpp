@@ -16,11 +16,27 @@
 #include "PrecompiledHeader.h"
 #include "AsyncFileReader.h"
 
+// Reads are done in aligned units of Cdvd.FlatFileUnitSectors sectors (by default
+// InputIsoFile's largest ReadUnit), and up to Cdvd.FlatFileQueueDepth units following
+// a sequential request are kept in flight so the device always has work queued.
+#define FLATFILE_MAX_QUEUE_DEPTH 62   // the request's two units on top fill the io_setup() queue
+#define FLATFILE_MIN_UNIT_SECTORS 16
+#define FLATFILE_MAX_UNIT_SECTORS 1024
+#define FLATFILE_ALIGNMENT 4096 // O_DIRECT buffer, offset and size alignment
+
 FlatFileReader::FlatFileReader(bool shareWrite) : shareWrite(shareWrite)
 {
 	m_blocksize = 2048;
 	m_fd = -1;
 	m_aio_context = 0;
+	m_units = NULL;
+	m_unitCount = 0;
+	m_unitSize = 0;
+	m_queueDepth = 0;
+	m_lastIndex = -1;
+	m_request_buffer = NULL;
+	m_request_offset = 0;
+	m_request_size = 0;
 }
 
 FlatFileReader::~FlatFileReader(void)
@@ -32,10 +48,13 @@ bool FlatFileReader::Open(const wxString& fileName)
 {
 	m_filename = fileName;
 
-	int err = io_setup(64, &m_aio_context);
+	int err = io_setup(FLATFILE_MAX_QUEUE_DEPTH + 2, &m_aio_context);
 	if (err) return false;
 
-    m_fd = wxOpen(fileName, O_RDONLY, 0);
+	// Bypass the page cache, the units are our cache. Not every filesystem supports it.
+	m_fd = wxOpen(fileName, O_RDONLY | O_DIRECT, 0);
+	if (m_fd == -1)
+		m_fd = wxOpen(fileName, O_RDONLY, 0);
 
 	return (m_fd != -1);
 }
@@ -46,40 +65,232 @@ int FlatFileReader::ReadSync(void* pBuffer, uint sector, uint count)
 	return FinishRead();
 }
 
+bool FlatFileReader::AllocateUnits()
+{
+	const uint sectors = std::min(std::max(EmuConfig.Cdvd.FlatFileUnitSectors, FLATFILE_MIN_UNIT_SECTORS), FLATFILE_MAX_UNIT_SECTORS);
+	m_queueDepth = std::min(std::max(EmuConfig.Cdvd.FlatFileQueueDepth, 1), FLATFILE_MAX_QUEUE_DEPTH);
+
+	m_unitSize = (sectors * m_blocksize + FLATFILE_ALIGNMENT - 1) & ~(FLATFILE_ALIGNMENT - 1);
+	// The units of the request, plus the read-ahead window
+	m_unitCount = m_queueDepth + 2;
+	m_units = new ReadUnit[m_unitCount];
+
+	for (uint i = 0; i < m_unitCount; i++) {
+		m_units[i].buffer = (u8*)_aligned_malloc(m_unitSize, FLATFILE_ALIGNMENT);
+		m_units[i].index = -1;
+		m_units[i].result = 0;
+		m_units[i].pending = false;
+		if (!m_units[i].buffer) {
+			m_unitCount = i;
+			FreeUnits();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void FlatFileReader::FreeUnits()
+{
+	if (!m_units)
+		return;
+
+	for (uint i = 0; i < m_unitCount; i++)
+		_aligned_free(m_units[i].buffer);
+	delete[] m_units;
+
+	m_units = NULL;
+	m_unitCount = 0;
+	m_lastIndex = -1;
+}
+
+FlatFileReader::ReadUnit* FlatFileReader::FindUnit(s64 index)
+{
+	for (uint i = 0; i < m_unitCount; i++) {
+		if (m_units[i].index == index)
+			return &m_units[i];
+	}
+	return NULL;
+}
+
+// Collects the completed reads, blocking for at least one when wait is set.
+bool FlatFileReader::ReapUnits(bool wait)
+{
+	struct io_event events[FLATFILE_MAX_QUEUE_DEPTH + 2];
+
+	if (wait) {
+		bool pending = false;
+		for (uint i = 0; i < m_unitCount; i++)
+			pending |= m_units[i].pending;
+		if (!pending)
+			return false;
+	}
+
+	int count;
+	do {
+		count = io_getevents(m_aio_context, wait ? 1 : 0, m_unitCount, events, NULL);
+	} while (count == -EINTR);
+
+	for (int i = 0; i < count; i++) {
+		ReadUnit* unit = (ReadUnit*)events[i].data;
+		unit->result = (int)events[i].res;
+		unit->pending = false;
+	}
+
+	return count > 0;
+}
+
+// Starts reading a unit into a free buffer. Buffers behind the current request
+// are recycled first, then the ones furthest ahead. When every buffer is still
+// being read, either wait for one or give up (read-ahead).
+FlatFileReader::ReadUnit* FlatFileReader::SubmitUnit(s64 index, bool wait)
+{
+	const s64 first = m_request_offset / m_unitSize;
+	const s64 last = (m_request_offset + std::max(m_request_size, 1u) - 1) / m_unitSize;
+
+	while (true) {
+		ReadUnit* victim = NULL;
+		u64 victimKey = 0;
+
+		for (uint i = 0; i < m_unitCount; i++) {
+			ReadUnit& unit = m_units[i];
+			if (unit.pending || (unit.index >= first && unit.index <= last))
+				continue;
+
+			u64 key;
+			if (unit.index < 0)
+				key = UINT64_MAX;
+			else if (unit.index < first)
+				key = (UINT64_MAX >> 1) + (first - unit.index);
+			else
+				key = unit.index - last;
+
+			if (!victim || key > victimKey) {
+				victim = &unit;
+				victimKey = key;
+			}
+		}
+
+		if (victim) {
+			struct iocb* cbs = &victim->cb;
+			io_prep_pread(&victim->cb, m_fd, victim->buffer, m_unitSize, index * m_unitSize);
+			victim->cb.data = victim;
+			victim->index = index;
+			victim->result = 0;
+			victim->pending = true;
+
+			if (io_submit(m_aio_context, 1, &cbs) != 1) {
+				victim->index = -1;
+				victim->pending = false;
+				return NULL;
+			}
+			return victim;
+		}
+
+		if (!wait || !ReapUnits(true))
+			return NULL;
+	}
+}
+
 void FlatFileReader::BeginRead(void* pBuffer, uint sector, uint count)
 {
-	u64 offset;
-	offset = sector * (s64)m_blocksize + m_dataoffset;
+	if (!m_units && !AllocateUnits())
+		return;
 
-	u32 bytesToRead = count * m_blocksize;
+	m_request_buffer = pBuffer;
+	m_request_offset = sector * (s64)m_blocksize + m_dataoffset;
+	m_request_size = count * m_blocksize;
 
-	struct iocb iocb;
-	struct iocb* iocbs = &iocb;
+	// Free the buffers of the reads done since the last request
+	ReapUnits(false);
 
-	io_prep_pread(&iocb, m_fd, pBuffer, bytesToRead, offset);
-	io_submit(m_aio_context, 1, &iocbs);
+	const s64 first = m_request_offset / m_unitSize;
+	const s64 last = (m_request_offset + std::max(m_request_size, 1u) - 1) / m_unitSize;
+	const bool sequential = first == m_lastIndex || first == m_lastIndex + 1;
+	m_lastIndex = last;
+
+	// FinishRead() waits for the units in order, queue as many as fit.
+	for (s64 index = first; index <= last && index < first + m_unitCount - 1; index++) {
+		if (!FindUnit(index) && !SubmitUnit(index, true))
+			return;
+	}
+
+	// Only read ahead of sequential accesses, a seek shouldn't flush the window.
+	if (!sequential)
+		return;
+
+	for (s64 index = last + 1; index <= last + m_queueDepth; index++) {
+		if (!FindUnit(index) && !SubmitUnit(index, false))
+			break;
+	}
 }
 
 int FlatFileReader::FinishRead(void)
 {
-	int min_nr = 1;
-	int max_nr = 1;
-	struct io_event events[max_nr];
-
-	int event = io_getevents(m_aio_context, min_nr, max_nr, events, NULL);
-	if (event < 1) {
+	if (!m_request_buffer)
 		return -1;
+
+	u8* dest = (u8*)m_request_buffer;
+	const u64 start = m_request_offset;
+	const u64 end = m_request_offset + m_request_size;
+	u64 pos = start;
+	m_request_buffer = NULL;
+
+	while (pos < end) {
+		// Only the rest of the request is protected from recycling
+		m_request_offset = pos;
+		m_request_size = (uint)(end - pos);
+
+		const s64 index = pos / m_unitSize;
+		ReadUnit* unit = FindUnit(index);
+		if (!unit)
+			unit = SubmitUnit(index, true);
+		if (!unit)
+			return -1;
+
+		while (unit->pending) {
+			if (!ReapUnits(true))
+				return -1;
+		}
+
+		if (unit->result < 0) {
+			unit->index = -1;
+			return -1;
+		}
+
+		const u64 unitPos = pos - index * (u64)m_unitSize;
+		if (unitPos >= (u64)unit->result)
+			break; // EOF
+
+		const uint bytes = (uint)std::min<u64>(unit->result - unitPos, end - pos);
+		memcpy(dest, unit->buffer + unitPos, bytes);
+		dest += bytes;
+		pos += bytes;
 	}
 
-	return 1;
+	return (int)(pos - start);
 }
 
 void FlatFileReader::CancelRead(void)
 {
-	// Will be done when m_aio_context context is destroyed
-	// Note: io_cancel exists but need the iocb structure as parameter
-	// int io_cancel(aio_context_t ctx_id, struct iocb *iocb,
-	//                struct io_event *result);
+	// The units in flight are kept as read-ahead, only forget the request.
+	m_request_buffer = NULL;
+}
+
+// Queues the units of a hinted region, leaving room for the requests and their read-ahead.
+void FlatFileReader::Prefetch(uint sector, uint count)
+{
+	if (!m_units && !AllocateUnits())
+		return;
+
+	const u64 offset = sector * (s64)m_blocksize + m_dataoffset;
+	const s64 first = offset / m_unitSize;
+	const s64 last = (offset + std::max(count * m_blocksize, 1u) - 1) / m_unitSize;
+
+	for (s64 index = first; index <= last && index < first + std::max(m_queueDepth / 2, 1u); index++) {
+		if (!FindUnit(index) && !SubmitUnit(index, false))
+			break;
+	}
 }
 
 void FlatFileReader::Close(void)
@@ -87,7 +298,9 @@ void FlatFileReader::Close(void)
 
 	if (m_fd != -1) close(m_fd);
 
+	// Waits for the reads in flight, the units can be freed after it.
 	io_destroy(m_aio_context);
+	FreeUnits();
 
 	m_fd = -1;
 	m_aio_context = 0;
@@ -28,6 +28,12 @@
 // Uncomment this to enable profiling of the GS RingBufferCopy function.
 //#define PCSX2_GSRING_SAMPLING_STATS
 
+// Uncomment this to log the EE/MTGS handoff counters (MTGS_RingStats) of each window.
+//#define PCSX2_MTGS_RING_STATS
+
+// Frames in a window of stats
+static const u32 StatsFrames = 60;
+
 using namespace Threading;
 
 #if 0 //PCSX2_DEBUG
@@ -41,6 +47,8 @@ using namespace Threading;
 // =====================================================================================================
 
 __aligned(32) MTGS_BufferedData RingBuffer;
+uint RingBufferSize = 1 << RingBufferSizeFactor;
+uint RingBufferMask = RingBufferSize - 1;
 extern bool renderswitch;
 
 
@@ -64,9 +72,17 @@ void SysMtgsThread::OnStart()
 {
 	m_PluginOpened		= false;
 
+	// The ring is empty until the thread runs, it can be resized safely.
+	const uint sizeFactor = std::min<uint>(std::max<int>(EmuConfig.GS.MtgsRingSizeFactor, RingBufferMinSizeFactor), RingBufferMaxSizeFactor);
+	RingBufferSize		= 1 << sizeFactor;
+	RingBufferMask		= RingBufferSize - 1;
+	if (sizeFactor != RingBufferSizeFactor)
+		DevCon.WriteLn( "MTGS: ringbuffer size is %u KB", RingBufferSize * 16 / 1024 );
+
 	m_ReadPos			= 0;
 	m_WritePos			= 0;
-	m_RingBufferIsBusy  = false;
+	m_CachedReadPos		= 0;
+	m_Sleeping			= false;
 	m_packet_size		= 0;
 	m_packet_writepos	= 0;
 
@@ -76,6 +92,7 @@ void SysMtgsThread::OnStart()
 	m_SignalRingPosition  = 0;
 
 	m_CopyDataTally		= 0;
+	ResetRingStats();
 
 	_parent::OnStart();
 }
@@ -103,6 +120,7 @@ void SysMtgsThread::ResetGS()
 	//  * clear the path and byRegs structs (used by GIFtagDummy)
 
 	m_ReadPos             = m_WritePos.load();
+	m_CachedReadPos       = m_ReadPos.load();
 	m_QueuedFrameCount    = 0;
 	m_VsyncSignalListener = 0;
 
@@ -138,6 +156,7 @@ void SysMtgsThread::PostVsyncStart()
 	m_packet_writepos = (m_packet_writepos + 1) & RingBufferMask;
 
 	SendDataPacket();
+	SampleRingStats();
 
 	// Vsyncs should always start the GS thread, regardless of how little has actually be queued.
 	if (m_CopyDataTally != 0) SetEvent();
@@ -160,11 +179,13 @@ void SysMtgsThread::PostVsyncStart()
 
 	// We will wait a vsync event from the MTGS ring. If the ring is already purged, the event will never come !
 	// To avoid this potential deadlock, ring must be wake up after m_VsyncSignalListener
-	// Note: potentially we can also miss the previous wake up if we optimize away the post just before the release of busy signal of the ring
-	// So let's ensure the ring doesn't sleep
+	// Note: SetEvent() isn't enough here, the thread only rechecks m_WritePos (not the listener)
+	// before it sleeps. So let's ensure the ring doesn't sleep
 	m_sem_event.Post();
 
+	const u64 start = GetCPUTicks();
 	m_sem_Vsync.WaitNoCancel();
+	m_RingStats.VsyncWaitTicks += GetCPUTicks() - start;
 }
 
 union PacketTagType
@@ -248,18 +269,14 @@ class RingBufferLock {
 		: m_lock1(mtgs.m_mtx_RingBufferBusy),
 		  m_lock2(mtgs.m_mtx_RingBufferBusy2),
 		  m_mtgs(mtgs) {
-		m_mtgs.m_RingBufferIsBusy.store(true, std::memory_order_relaxed);
 	}
 	virtual ~RingBufferLock() {
-		m_mtgs.m_RingBufferIsBusy.store(false, std::memory_order_relaxed);
 	}
 	void Acquire() {
 		m_lock1.Acquire();
 		m_lock2.Acquire();
-		m_mtgs.m_RingBufferIsBusy.store(true, std::memory_order_relaxed);
 	}
 	void Release() {
-		m_mtgs.m_RingBufferIsBusy.store(false, std::memory_order_relaxed);
 		m_lock2.Release();
 		m_lock1.Release();
 	}
@@ -289,7 +306,15 @@ void SysMtgsThread::ExecuteTaskInThread()
 		// is very optimized (only 1 instruction test in most cases), so no point in trying
 		// to avoid it.
 
-		m_sem_event.WaitWithoutYield();
+		// Sleep unless packets were queued since the ring was drained. m_Sleeping has to be
+		// visible before m_WritePos is checked, so that either the EE sees it and posts the
+		// event in SetEvent(), or we see its packets here.
+		m_Sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_ReadPos.load(std::memory_order_relaxed) == m_WritePos.load(std::memory_order_acquire))
+			m_sem_event.WaitWithoutYield();
+		m_Sleeping.store(false, std::memory_order_relaxed);
+
 		StateCheckInThread();
 		busy.Acquire();
 
@@ -407,11 +432,9 @@ void SysMtgsThread::ExecuteTaskInThread()
 				}
 
 				case GS_RINGTYPE_MTVU_GSPACKET: {
-					MTVU_LOG("MTGS - Waiting on semaXGkick!");
-					vu1Thread.KickStart(true);
 					busy.PartialRelease();
 					// Wait for MTVU to complete vu1 program
-					vu1Thread.semaXGkick.WaitWithoutYield();
+					vu1Thread.WaitXGkick();
 					busy.PartialAcquire();
 					Gif_Path& path   = gifUnit.gifPath[GIF_PATH_1];
 					GS_Packet gsPack = path.GetGSPacketMTVU(); // Get vu1 program's xgkick packet(s)
@@ -635,16 +658,62 @@ void SysMtgsThread::WaitGS(bool syncRegs, bool weakWait, bool isMTVU)
 	}
 }
 
-// Sets the gsEvent flag and releases a timeslice.
+// Wakes up the GS thread if it's sleeping on an empty ring.
 // For use in loops that wait on the GS thread to do certain things.
 void SysMtgsThread::SetEvent()
 {
-	if(!m_RingBufferIsBusy.load(std::memory_order_relaxed))
+	// Pairs with the fence in ExecuteTaskInThread(), see there.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_Sleeping.load(std::memory_order_relaxed) && m_Sleeping.exchange(false))
+	{
 		m_sem_event.Post();
+		m_WakeupCount.fetch_add(1, std::memory_order_relaxed);
+	}
 
 	m_CopyDataTally = 0;
 }
 
+MTGS_RingStats SysMtgsThread::GetFrameStats()
+{
+	ScopedLock lock(m_mtx_Stats);
+	return m_FrameStats;
+}
+
+void SysMtgsThread::ResetRingStats()
+{
+	ScopedLock lock(m_mtx_Stats);
+	memzero(m_RingStats);
+	memzero(m_FrameStats);
+	m_WakeupCount = 0;
+}
+
+// Called by the EE on each vsync, closes a window of stats every StatsFrames frames.
+void SysMtgsThread::SampleRingStats()
+{
+	const uint used = RingBufferSize - GetFreeRoom(m_ReadPos.load(std::memory_order_relaxed));
+	m_RingStats.FillLevels[std::min<uint>(used / (RingBufferSize / 8), 7)]++;
+	if (++m_RingStats.Frames < StatsFrames) return;
+
+	MTGS_RingStats window = m_RingStats;
+	window.Wakeups = m_WakeupCount.exchange(0, std::memory_order_relaxed);
+	memzero(m_RingStats);
+
+	{
+		ScopedLock lock(m_mtx_Stats);
+		m_FrameStats = window;
+	}
+
+#ifdef PCSX2_MTGS_RING_STATS
+	const double msPerFrame = 1000.0 / GetTickFrequency() / window.Frames;
+	const u32* fill = window.FillLevels;
+
+	Console.WriteLn( Color_Gray, "MTGS: per frame: %.2f ms stalled (%u stalls), %.2f ms in vsync queue, %.2f wakeups",
+		window.StallTicks * msPerFrame, window.Stalls, window.VsyncWaitTicks * msPerFrame, (double)window.Wakeups / window.Frames );
+	Console.WriteLn( Color_Gray, "MTGS: ring fill at vsync (eighths): %u %u %u %u %u %u %u %u",
+		fill[0], fill[1], fill[2], fill[3], fill[4], fill[5], fill[6], fill[7] );
+#endif
+}
+
 u8* SysMtgsThread::GetDataPacketPtr() const
 {
 	return (u8*)&RingBuffer[m_packet_writepos & RingBufferMask];
@@ -669,10 +738,18 @@ void SysMtgsThread::SendDataPacket()
 	{
 		WaitGS();
 	}
-	else if(!m_RingBufferIsBusy.load(std::memory_order_relaxed))
+	else
 	{
-		m_CopyDataTally += m_packet_size;
-		if( m_CopyDataTally > 0x2000 ) SetEvent();
+		// Pairs with the fence in ExecuteTaskInThread(): either the GS thread sees the new
+		// write position before sleeping, or we see m_Sleeping here.
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		// Only worth counting while the thread sleeps, a busy thread finds the packet by itself.
+		if(m_Sleeping.load(std::memory_order_relaxed))
+		{
+			m_CopyDataTally += m_packet_size;
+			if( m_CopyDataTally > EmuConfig.GS.MtgsWakeupQwc ) SetEvent();
+		}
 	}
 
 	m_packet_size = 0;
@@ -680,6 +757,17 @@ void SysMtgsThread::SendDataPacket()
 	//m_PacketLocker.Release();
 }
 
+// Room left between the EE write position and readpos.
+uint SysMtgsThread::GetFreeRoom( uint readpos ) const
+{
+	const uint writepos = m_WritePos.load(std::memory_order_relaxed);
+
+	if (writepos < readpos)
+		return readpos - writepos;
+	else
+		return RingBufferSize - (writepos - readpos);
+}
+
 void SysMtgsThread::GenericStall( uint size )
 {
 	// Note on volatiles: m_WritePos is not modified by the GS thread, so there's no need
@@ -696,16 +784,18 @@ void SysMtgsThread::GenericStall( uint size )
 	// But if not then we need to make sure the readpos is outside the scope of
 	// the block about to be written (writepos + size)
 
-	uint readpos = m_ReadPos.load(std::memory_order_acquire);
-	uint freeroom;
+	// The GS thread only moves readpos forward, so the room seen last time is still there:
+	// most packets don't need to look at m_ReadPos (and its cache line) at all.
+	if (GetFreeRoom(m_CachedReadPos) > size) return;
 
-	if (writepos < readpos)
-		freeroom = readpos - writepos;
-	else
-		freeroom = RingBufferSize - (writepos - readpos);
+	uint readpos = m_ReadPos.load(std::memory_order_acquire);
+	uint freeroom = GetFreeRoom(readpos);
+	m_CachedReadPos = readpos;
 
 	if (freeroom <= size)
 	{
+		const u64 start = GetCPUTicks();
+
 		// writepos will overlap readpos if we commit the data, so we need to wait until
 		// readpos is out past the end of the future write pos, or until it wraps around
 		// (in which case writepos will be >= readpos).
@@ -735,12 +825,7 @@ void SysMtgsThread::GenericStall( uint size )
 				readpos = m_ReadPos.load(std::memory_order_acquire);
 				//Console.WriteLn( Color_Blue, "(EEcore Awake) Report!\tringpos=0x%06x", readpos );
 
-				if (writepos < readpos)
-					freeroom = readpos - writepos;
-				else
-					freeroom = RingBufferSize - (writepos - readpos);
-
-				if (freeroom > size) break;
+				if (GetFreeRoom(readpos) > size) break;
 			}
 
 			pxAssertDev( m_SignalRingPosition <= 0, "MTGS Thread Synchronization Error" );
@@ -753,14 +838,13 @@ void SysMtgsThread::GenericStall( uint size )
 				SpinWait();
 				readpos = m_ReadPos.load(std::memory_order_acquire);
 
-				if (writepos < readpos)
-					freeroom = readpos - writepos;
-				else
-					freeroom = RingBufferSize - (writepos - readpos);
-
-				if (freeroom > size) break;
+				if (GetFreeRoom(readpos) > size) break;
 			}
 		}
+
+		m_CachedReadPos = readpos;
+		m_RingStats.StallTicks += GetCPUTicks() - start;
+		m_RingStats.Stalls++;
 	}
 }
 
@@ -825,9 +909,11 @@ void SysMtgsThread::SendSimpleGSPacket(MTGS_RingCommand type, u32 offset, u32 si
 	SendSimplePacket(type, (int)offset, (int)size, (int)path);
 
 	if(!EmuConfig.GS.SynchronousMTGS) {
-		if(!m_RingBufferIsBusy.load(std::memory_order_relaxed)) {
+		// Same pairing as SendDataPacket(), the write position is already published
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(m_Sleeping.load(std::memory_order_relaxed)) {
 			m_CopyDataTally += size / 16;
-			if (m_CopyDataTally > 0x2000) SetEvent();
+			if (m_CopyDataTally > EmuConfig.GS.MtgsWakeupQwc) SetEvent();
 		}
 	}
 }
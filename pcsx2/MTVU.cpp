@@ -24,6 +24,12 @@ __aligned16 VU_Thread vu1Thread(CpuVU1, VU1);
 #define MTVU_ALWAYS_KICK 0
 #define MTVU_SYNC_MODE   0
 
+// Uncomment this to log the EE/MTVU handoff counters (MTVU_Stats) of each window.
+//#define PCSX2_MTVU_RING_STATS
+
+// Frames in a window of stats
+static const u32 StatsFrames = 60;
+
 // Rounds up a size in bytes for size in u32's
 static __fi u32 size_u32(u32 x) { return (x + 3) >> 2; }
 
@@ -60,11 +66,46 @@ void SaveStateBase::mtvuFreeze()
 	Freeze(vu1Thread.vuCycleIdx);
 }
 
+template<typename T>
+void MTVU_Waiter::Wait(const T& ready)
+{
+	for (u32 i = 0; i < spins; i++) {
+		if (ready()) {
+			spins = std::min(spins * 2, MaxSpins);
+			return;
+		}
+		Threading::SpinWait();
+	}
+
+	// 'sleeping' has to be visible before the condition is checked, so that either
+	// the other side sees it and posts, or we see what it did. Pairs with Wake().
+	for (;;) {
+		sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ready()) break;
+		sema.WaitWithoutYield();
+	}
+	sleeping.store(false, std::memory_order_relaxed);
+	spins = std::max(spins / 2, MinSpins);
+}
+
+// Returns true if the waiter was sleeping (and got posted)
+__fi bool MTVU_Waiter::Wake()
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+		sema.Post();
+		return true;
+	}
+	return false;
+}
+
 VU_Thread::VU_Thread(BaseVUmicroCPU*& _vuCPU, VURegs& _vuRegs) :
 		vuCPU(_vuCPU), vuRegs(_vuRegs)
 {
 	m_name = L"MTVU";
 	Reset();
+	ResetStats();
 }
 
 VU_Thread::~VU_Thread()
@@ -80,7 +121,6 @@ void VU_Thread::Reset()
 	ScopedLock lock(mtxBusy);
 
 	vuCycleIdx   = 0;
-	isBusy       = false;
 	m_ato_write_pos = 0;
 	m_write_pos     = 0;
 	m_ato_read_pos  = 0;
@@ -101,8 +141,8 @@ void VU_Thread::ExecuteTaskInThread()
 void VU_Thread::ExecuteRingBuffer()
 {
 	for(;;) {
-		semaEvent.WaitWithoutYield();
-		ScopedLockBool lock(mtxBusy, isBusy);
+		WaitForPackets();
+		ScopedLock lock(mtxBusy);
 		while (m_ato_read_pos.load(std::memory_order_relaxed) != GetWritePos()) {
 			u32 tag = Read();
 			switch (tag) {
@@ -160,27 +200,36 @@ void VU_Thread::ExecuteRingBuffer()
 }
 
 
+__ri void VU_Thread::WaitForPackets()
+{
+	if (m_ato_read_pos.load(std::memory_order_relaxed) != GetWritePos()) return;
+
+	const u64 start = GetCPUTicks();
+	vuWait.Wait([this]() { return m_ato_read_pos.load(std::memory_order_relaxed) != GetWritePos(); });
+	m_IdleTicks.fetch_add(GetCPUTicks() - start, std::memory_order_relaxed);
+}
+
 // Should only be called by ReserveSpace()
 __ri void VU_Thread::WaitOnSize(s32 size)
 {
-	for(;;) {
+	auto hasRoom = [this, size]() {
 		s32 readPos  = GetReadPos();
-		if (readPos <= m_write_pos) break; // MTVU is reading in back of write_pos
+		if (readPos <= m_write_pos) return true; // MTVU is reading in back of write_pos
 		// FIXME greg: there is a bug somewhere in the queue pointer
 		// management. It creates a deadlock/corruption in SotC intro (before
 		// the first menu). I added a 4KB safety net which seem to avoid to
 		// trigger the bug.
-		// Note: a wait lock instead of a yield also helps to avoid the bug.
-		if (readPos >  m_write_pos + size + _4kb) break; // Enough free front space
-		{ // Let MTVU run to free up buffer space
-			KickStart();
-			// Locking might trigger a full flush of the ring buffer. Yield
-			// will be more aggressive, and only flush the minimal size.
-			// Performance will be smoother but it will consume extra CPU cycle
-			// on the EE thread (not an issue on 4 cores).
-			std::this_thread::yield();
-		}
-	}
+		return readPos > m_write_pos + size + _4kb; // Enough free front space
+	};
+	if (hasRoom()) return;
+
+	// Let MTVU run to free up buffer space. The VU thread wakes us up as soon as
+	// it commits a packet, so only the minimal size gets flushed.
+	const u64 start = GetCPUTicks();
+	KickStart();
+	eeWait.Wait(hasRoom);
+	m_StallTicks.fetch_add(GetCPUTicks() - start, std::memory_order_relaxed);
+	m_Stalls.fetch_add(1, std::memory_order_relaxed);
 }
 
 // Makes sure theres enough room in the ring buffer
@@ -232,6 +281,7 @@ __fi void VU_Thread::CommitWritePos()
 __fi void VU_Thread::CommitReadPos()
 {
 	m_ato_read_pos.store(m_read_pos, std::memory_order_release);
+	eeWait.Wake();
 }
 
 __fi u32 VU_Thread::Read()
@@ -293,10 +343,10 @@ u32 VU_Thread::Get_vuCycles()
 			vuCycles[3].load(std::memory_order_acquire)) >> 2;
 }
 
-void VU_Thread::KickStart(bool forceKick)
+void VU_Thread::KickStart()
 {
-	if ((forceKick && !semaEvent.Count())
-	|| (!isBusy.load(std::memory_order_acquire) && GetReadPos() != m_ato_write_pos.load(std::memory_order_relaxed))) semaEvent.Post();
+	if (GetReadPos() != GetWritePos() && vuWait.Wake())
+		m_Wakeups.fetch_add(1, std::memory_order_relaxed);
 }
 
 bool VU_Thread::IsDone()
@@ -307,14 +357,97 @@ bool VU_Thread::IsDone()
 void VU_Thread::WaitVU()
 {
 	MTVU_LOG("MTVU - WaitVU!");
-	for(;;) {
-		if (IsDone()) break;
-		//DevCon.WriteLn("WaitVU()");
-		pxAssert(THREAD_VU1);
-		KickStart();
-		std::this_thread::yield(); // Give a chance to the MTVU thread to actually start
-		ScopedLock lock(mtxBusy);
+	if (IsDone()) return;
+	pxAssert(THREAD_VU1);
+
+	const u64 start = GetCPUTicks();
+	KickStart();
+	eeWait.Wait([this]() { return IsDone(); });
+	m_SyncTicks.fetch_add(GetCPUTicks() - start, std::memory_order_relaxed);
+	m_Syncs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void VU_Thread::WaitXGkick()
+{
+	MTVU_LOG("MTGS - Waiting on semaXGkick!");
+	KickStart();
+	if (semaXGkick.Count() > 0) {
+		semaXGkick.WaitWithoutYield();
+		return;
 	}
+
+	const u64 start = GetCPUTicks();
+	semaXGkick.WaitWithoutYield();
+	m_XgkickTicks.fetch_add(GetCPUTicks() - start, std::memory_order_relaxed);
+	m_Xgkicks.fetch_add(1, std::memory_order_relaxed);
+}
+
+MTVU_Stats VU_Thread::GetStats() const
+{
+	MTVU_Stats stats;
+	stats.StallTicks  = m_StallTicks.load(std::memory_order_relaxed);
+	stats.SyncTicks   = m_SyncTicks.load(std::memory_order_relaxed);
+	stats.IdleTicks   = m_IdleTicks.load(std::memory_order_relaxed);
+	stats.XgkickTicks = m_XgkickTicks.load(std::memory_order_relaxed);
+	stats.Stalls      = m_Stalls.load(std::memory_order_relaxed);
+	stats.Syncs       = m_Syncs.load(std::memory_order_relaxed);
+	stats.Xgkicks     = m_Xgkicks.load(std::memory_order_relaxed);
+	stats.Wakeups     = m_Wakeups.load(std::memory_order_relaxed);
+	stats.Frames      = m_Frames;
+	return stats;
+}
+
+MTVU_Stats VU_Thread::GetFrameStats()
+{
+	ScopedLock lock(mtxStats);
+	return m_FrameStats;
+}
+
+void VU_Thread::ResetStats()
+{
+	ScopedLock lock(mtxStats);
+	m_StallTicks  = 0;
+	m_SyncTicks   = 0;
+	m_IdleTicks   = 0;
+	m_XgkickTicks = 0;
+	m_Stalls      = 0;
+	m_Syncs       = 0;
+	m_Xgkicks     = 0;
+	m_Wakeups     = 0;
+	m_Frames      = 0;
+	memzero(m_LastStats);
+	memzero(m_FrameStats);
+}
+
+void VU_Thread::Vsync()
+{
+	if (++m_Frames - m_LastStats.Frames < StatsFrames) return;
+
+	const MTVU_Stats now = GetStats();
+	MTVU_Stats& last = m_LastStats;
+	MTVU_Stats window;
+	window.StallTicks  = now.StallTicks  - last.StallTicks;
+	window.SyncTicks   = now.SyncTicks   - last.SyncTicks;
+	window.IdleTicks   = now.IdleTicks   - last.IdleTicks;
+	window.XgkickTicks = now.XgkickTicks - last.XgkickTicks;
+	window.Stalls      = now.Stalls      - last.Stalls;
+	window.Syncs       = now.Syncs       - last.Syncs;
+	window.Xgkicks     = now.Xgkicks     - last.Xgkicks;
+	window.Wakeups     = now.Wakeups     - last.Wakeups;
+	window.Frames      = now.Frames      - last.Frames;
+
+	{
+		ScopedLock lock(mtxStats);
+		m_FrameStats = window;
+		m_LastStats  = now;
+	}
+
+#ifdef PCSX2_MTVU_RING_STATS
+	const double msPerFrame = 1000.0 / GetTickFrequency() / window.Frames;
+	Console.WriteLn(Color_Gray, "MTVU: per frame: %.2f ms stalled (%u stalls), %.2f ms in WaitVU (%u), %.2f ms idle, %.2f ms XGKICK sync (%u), %.2f wakeups",
+		window.StallTicks * msPerFrame, window.Stalls, window.SyncTicks * msPerFrame, window.Syncs,
+		window.IdleTicks * msPerFrame, window.XgkickTicks * msPerFrame, window.Xgkicks, (double)window.Wakeups / window.Frames);
+#endif
 }
 
 void VU_Thread::ExecuteVU(u32 vu_addr, u32 vif_top, u32 vif_itop)
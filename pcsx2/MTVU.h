@@ -22,29 +22,77 @@
 #define MTVU_LOG(...) do{} while(0)
 //#define MTVU_LOG DevCon.WriteLn
 
+// EE <-> MTVU handoff counters, see VU_Thread::GetFrameStats().
+struct MTVU_Stats
+{
+	u64 StallTicks;		// EE time spent waiting for room in the ring
+	u64 SyncTicks;		// EE time spent waiting in WaitVU()
+	u64 IdleTicks;		// VU thread time spent waiting for packets
+	u64 XgkickTicks;	// MTGS time spent waiting for VU1 programs to finish their XGKICKs
+	u32 Stalls;
+	u32 Syncs;
+	u32 Xgkicks;		// XGKICK waits that had to block
+	u32 Wakeups;		// times the VU thread was woken up
+	u32 Frames;
+};
+
+// Spin-then-sleep wait for one thread of the ring.  The waiter polls for a while before
+// it raises 'sleeping' and sleeps on the semaphore; the other side only posts it after
+// clearing that flag, so a running thread is never posted and a wakeup can't be lost.
+// The polling budget doubles when polling was enough and halves when it wasn't, so a
+// thread that waits for long doesn't keep a core busy for nothing.
+struct MTVU_Waiter
+{
+	static const u32 MinSpins = 16;
+	static const u32 MaxSpins = 4096;
+
+	std::atomic<bool> sleeping;
+	Semaphore         sema;
+	u32               spins; // only used by the waiting thread
+
+	MTVU_Waiter() : sleeping(false), spins(MinSpins) {}
+
+	template<typename T> void Wait(const T& ready);
+	bool Wake();
+};
+
 // Notes:
 // - This class should only be accessed from the EE thread...
 // - buffer_size must be power of 2
 // - ring-buffer has no complete pending packets when read_pos==write_pos
+// - Single producer (EE) single consumer (VU thread), the positions are the only
+//   synchronization; mtxBusy is only held so Reset() can't run under the VU thread.
 class VU_Thread : public pxThread {
 	static const s32 buffer_size = (_1mb * 16) / sizeof(s32);
 
 	u32 buffer[buffer_size];
 	// Note: keep atomic on separate cache line to avoid CPU conflict
-	__aligned(64) std::atomic<bool> isBusy;   // Is thread processing data?
 	__aligned(64) std::atomic<int> m_ato_read_pos; // Only modified by VU thread
+	int  m_read_pos; // temporary read pos (local to the VU thread)
+	MTVU_Waiter         vuWait;    // VU thread waiting for packets
+	std::atomic<u64>    m_IdleTicks;
 	__aligned(64) std::atomic<int> m_ato_write_pos;    // Only modified by EE thread
-	__aligned(64) int  m_read_pos; // temporary read pos (local to the VU thread)
 	int  m_write_pos; // temporary write pos (local to the EE thread)
+	MTVU_Waiter         eeWait;    // EE waiting for the VU thread to read packets
+	std::atomic<u64>    m_StallTicks;
+	std::atomic<u64>    m_SyncTicks;
+	std::atomic<u32>    m_Stalls;
+	std::atomic<u32>    m_Syncs;
+	std::atomic<u32>    m_Wakeups;
+	u32                 m_Frames;
+	__aligned(64) std::atomic<u64> m_XgkickTicks; // Only modified by MTGS thread
+	std::atomic<u32>    m_Xgkicks;
+	Semaphore semaXGkick;
 	Mutex     mtxBusy;
-	Semaphore semaEvent;
+	Mutex     mtxStats;
+	MTVU_Stats m_LastStats;  // counters at the start of the current window
+	MTVU_Stats m_FrameStats; // counters over the last complete window
 	BaseVUmicroCPU*& vuCPU;
 	VURegs&          vuRegs;
 
 public:
 	__aligned16  vifStruct        vif;
 	__aligned16  VIFregisters     vifRegs;
-	__aligned(4) Semaphore semaXGkick;
 	__aligned(4) std::atomic<unsigned int> vuCycles[4]; // Used for VU cycle stealing hack
 	__aligned(4) u32 vuCycleIdx;  // Used for VU cycle stealing hack
 
@@ -54,7 +102,7 @@ public:
 	void Reset();
 
 	// Get MTVU to start processing its packets if it isn't already
-	void KickStart(bool forceKick = false);
+	void KickStart();
 
 	// Used for assertions...
 	bool IsDone();
@@ -62,6 +110,16 @@ public:
 	// Waits till MTVU is done processing
 	void WaitVU();
 
+	// Called by the MTGS thread, waits till the next VU1 program is done with its XGKICKs
+	void WaitXGkick();
+
+	// Called by the EE on each vsync, closes a window of stats every StatsFrames frames
+	void Vsync();
+
+	// Counters over the last complete window (Frames is 0 until there's one)
+	MTVU_Stats GetFrameStats();
+	void ResetStats();
+
 	void ExecuteVU(u32 vu_addr, u32 vif_top, u32 vif_itop);
 
 	void VifUnpack(vifStruct& _vif, VIFregisters& _vifRegs, u8* data, u32 size);
@@ -81,6 +139,8 @@ protected:
 
 private:
 	void ExecuteRingBuffer();
+	void WaitForPackets();
+	MTVU_Stats GetStats() const;
 
 	void WaitOnSize(s32 size);
 	void ReserveSpace(s32 size);
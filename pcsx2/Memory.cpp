@@ -905,6 +905,10 @@ struct vtlb_PageProtectionInfo
 
 static __aligned16 vtlb_PageProtectionInfo m_PageProtectInfo[Ps2MemSize::MainRam >> 12];
 
+bool mmap_SubpageTracking = false;
+__aligned16 u32 mmap_SubpageWrites[mmap_SubpageCount];
+u32 mmap_DmaWrites = 0;
+
 
 // returns:
 //  ProtMode_NotRequired - unchecked block (resides in ROM, thus is integrity is constant)
@@ -994,4 +998,7 @@ void mmap_ResetBlockTracking()
 	//DbgCon.WriteLn( "vtlb/mmap: Block Tracking reset..." );
 	memzero( m_PageProtectInfo );
 	if (eeMem) HostSys::MemProtect( eeMem->Main, Ps2MemSize::MainRam, PageAccess_ReadWrite() );
+
+	// Latched here so that the stores and the block checks always agree
+	mmap_SubpageTracking = EmuConfig.Cpu.Recompiler.EESubpageTracking;
 }
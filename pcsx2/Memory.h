@@ -128,6 +128,29 @@ extern vtlb_ProtectionMode mmap_GetRamPageInfo( u32 paddr );
 extern void mmap_MarkCountedRamPage( u32 paddr );
 extern void mmap_ResetBlockTracking();
 
+// Subpage write tracking (EESubpageTracking): every EE store bumps the write counter of
+// its 1KB subpage of main RAM and DMA writes bump mmap_DmaWrites, so blocks under manual
+// protection only compare their code when one of their counters moved.
+static const uint mmap_SubpageBits = 10;
+static const uint mmap_SubpageCount = Ps2MemSize::MainRam >> mmap_SubpageBits;
+
+extern bool mmap_SubpageTracking;
+extern u32 mmap_SubpageWrites[mmap_SubpageCount];
+extern u32 mmap_DmaWrites;
+
+// ptr - host address of the write. Writes outside of main RAM bump some unrelated
+// subpage, which only costs its blocks a code compare.
+static __fi void mmap_MarkSubpageWrite( const void* ptr )
+{
+	if (mmap_SubpageTracking)
+		mmap_SubpageWrites[(((uptr)ptr - (uptr)eeMem->Main) >> mmap_SubpageBits) & (mmap_SubpageCount - 1)]++;
+}
+
+static __fi void mmap_MarkDmaWrite()
+{
+	mmap_DmaWrites++;
+}
+
 #define memRead8 vtlb_memRead<mem8_t>
 #define memRead16 vtlb_memRead<mem16_t>
 #define memRead32 vtlb_memRead<mem32_t>
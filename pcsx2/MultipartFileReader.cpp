@@ -181,6 +181,22 @@ void MultipartFileReader::BeginRead(void* pBuffer, uint sector, uint count)
 	}
 }
 
+void MultipartFileReader::Prefetch(uint sector, uint count)
+{
+	if (sector >= GetBlockCount())
+		return;
+
+	for(uint i = GetFirstPart(sector); i < m_numparts && count > 0; i++)
+	{
+		uint num = std::min(count, m_parts[i].end - sector);
+
+		m_parts[i].reader->Prefetch(sector - m_parts[i].start, num);
+
+		sector += num;
+		count -= num;
+	}
+}
+
 int MultipartFileReader::FinishRead(void)
 {
 	int ret = 0;
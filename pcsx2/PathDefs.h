@@ -62,6 +62,7 @@ namespace PathDefs
 	extern wxDirName GetCheats();
 	extern wxDirName GetCheatsWS();
 	extern wxDirName GetDocs();
+	extern wxDirName GetCache();
 
 	extern wxDirName Get( FoldersEnum_t folderidx );
 
@@ -73,6 +74,7 @@ namespace PathDefs
 		extern const wxDirName& Savestates();
 		extern const wxDirName& MemoryCards();
 		extern const wxDirName& Settings();
+		extern const wxDirName& Cache();
 		extern const wxDirName& Plugins();
 		extern const wxDirName& Logs();
 		extern const wxDirName& Dumps();
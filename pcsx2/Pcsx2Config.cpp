@@ -65,6 +65,7 @@ void Pcsx2Config::SpeedhackOptions::LoadSave( IniInterface& ini )
 	IniBitBool( WaitLoop );
 	IniBitBool( vuFlagHack );
 	IniBitBool( vuThread );
+	IniBitBool( ipuThread );
 }
 
 void Pcsx2Config::ProfilerOptions::LoadSave( IniInterface& ini )
@@ -89,6 +90,10 @@ Pcsx2Config::RecompilerOptions::RecompilerOptions()
 
 	EnableEE	= true;
 	EnableEECache = false;
+	EnableVifCache = false;
+	EnableVUCache = false;
+	EnableEETiering = false;
+	EESubpageTracking = false;
 	EnableIOP	= true;
 	EnableVU0	= true;
 	EnableVU1	= true;
@@ -147,6 +152,10 @@ void Pcsx2Config::RecompilerOptions::LoadSave( IniInterface& ini )
 	IniBitBool( EnableEE );
 	IniBitBool( EnableIOP );
 	IniBitBool( EnableEECache );
+	IniBitBool( EnableVifCache );
+	IniBitBool( EnableVUCache );
+	IniBitBool( EnableEETiering );
+	IniBitBool( EESubpageTracking );
 	IniBitBool( EnableVU0 );
 	IniBitBool( EnableVU1 );
 
@@ -205,6 +214,8 @@ Pcsx2Config::GSOptions::GSOptions()
 
 	SynchronousMTGS			= false;
 	VsyncQueueSize			= 2;
+	MtgsRingSizeFactor		= 19;
+	MtgsWakeupQwc			= 0x2000;
 
 	FramesToDraw			= 2;
 	FramesToSkip			= 2;
@@ -220,6 +231,8 @@ void Pcsx2Config::GSOptions::LoadSave( IniInterface& ini )
 
 	IniEntry( SynchronousMTGS );
 	IniEntry( VsyncQueueSize );
+	IniEntry( MtgsRingSizeFactor );
+	IniEntry( MtgsWakeupQwc );
 
 	IniEntry( FrameLimitEnable );
 	IniEntry( FrameSkipEnable );
@@ -415,7 +428,39 @@ void Pcsx2Config::DebugOptions::LoadSave( IniInterface& ini )
 }
 
 
+Pcsx2Config::RewindOptions::RewindOptions()
+{
+	Enabled			= false;
+	Interval		= 60;
+	BufferSizeMB	= 256;
+}
+
+void Pcsx2Config::RewindOptions::LoadSave( IniInterface& ini )
+{
+	ScopedIniGroup path( ini, L"Rewind" );
+
+	IniEntry( Enabled );
+	IniEntry( Interval );
+	IniEntry( BufferSizeMB );
+}
 
+Pcsx2Config::CdvdOptions::CdvdOptions()
+{
+	CsoDecodeThreads	= 3;
+	FlatFileQueueDepth	= 8;
+	FlatFileUnitSectors	= 128;
+	CompressedCacheMB	= 200;
+}
+
+void Pcsx2Config::CdvdOptions::LoadSave( IniInterface& ini )
+{
+	ScopedIniGroup path( ini, L"Cdvd" );
+
+	IniEntry( CsoDecodeThreads );
+	IniEntry( FlatFileQueueDepth );
+	IniEntry( FlatFileUnitSectors );
+	IniEntry( CompressedCacheMB );
+}
 
 Pcsx2Config::Pcsx2Config()
 {
@@ -434,6 +479,7 @@ void Pcsx2Config::LoadSave( IniInterface& ini )
 	IniBitBool( CdvdVerboseReads );
 	IniBitBool( CdvdDumpBlocks );
 	IniBitBool( CdvdShareWrite );
+	IniBitBool( CdvdTraceReads );
 	IniBitBool( EnablePatches );
 	IniBitBool( EnableCheats );
 	IniBitBool( EnableWideScreenPatches );
@@ -458,6 +504,8 @@ void Pcsx2Config::LoadSave( IniInterface& ini )
 	Profiler		.LoadSave( ini );
 
 	Debugger		.LoadSave( ini );
+	Rewind			.LoadSave( ini );
+	Cdvd			.LoadSave( ini );
 	Trace			.LoadSave( ini );
 
 	ini.Flush();
@@ -1560,7 +1560,9 @@ bool SysCorePlugins::DoFreeze( PluginsEnum_t pid, int mode, freezeData* data )
 //   as it has special handlers to ensure that GS freeze commands are executed appropriately on the
 //   GS thread.
 //
-void SysCorePlugins::Freeze( PluginsEnum_t pid, SaveStateBase& state )
+// quiet - don't log the plugin being saved/loaded (rewind snapshots are taken every few frames).
+//
+void SysCorePlugins::Freeze( PluginsEnum_t pid, SaveStateBase& state, bool quiet )
 {
 	// No locking leeded -- DoFreeze locks as needed, and this avoids MTGS deadlock.
 	//ScopedLock lock( m_mtx_PluginStatus );
@@ -1572,8 +1574,9 @@ void SysCorePlugins::Freeze( PluginsEnum_t pid, SaveStateBase& state )
 	int fsize = fP.size;
 	state.Freeze( fsize );
 
-	Console.Indent().WriteLn( "%s %s", state.IsSaving() ? "Saving" : "Loading",
-		tbl_PluginInfo[pid].shortname );
+	if( !quiet )
+		Console.Indent().WriteLn( "%s %s", state.IsSaving() ? "Saving" : "Loading",
+			tbl_PluginInfo[pid].shortname );
 
 	if( state.IsLoading() && (fsize == 0) )
 	{
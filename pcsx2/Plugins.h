@@ -376,7 +376,7 @@ public:
 	virtual void FreezeOut( PluginsEnum_t pid, void* dest );
 	virtual void FreezeOut( PluginsEnum_t pid, pxOutputStream& outfp );
 	virtual void FreezeIn( PluginsEnum_t pid, pxInputStream& infp );
-	virtual void Freeze( PluginsEnum_t pid, SaveStateBase& state );
+	virtual void Freeze( PluginsEnum_t pid, SaveStateBase& state, bool quiet = false );
 	virtual bool DoFreeze( PluginsEnum_t pid, int mode, freezeData* data );
 
 	virtual bool KeyEvent( const keyEvent& evt );
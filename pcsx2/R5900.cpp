@@ -374,6 +374,10 @@ __fi void _cpuEventTest_Shared()
 	// Done first because exceptions raised during event tests need to be postponed a few
 	// cycles (fixes Grandia II [PAL], which does a spin loop on a vsync and expects to
 	// be able to read the value before the exception handler clears it).
+	// The IPU thread's interrupts are delivered here too once it's done, without
+	// waiting for it.
+
+	ipuThread.Poll();
 
 	uint mask = intcInterrupt() | dmacInterrupt();
 	if (cpuIntsEnabled(mask)) cpuException(mask, cpuRegs.branch);
@@ -0,0 +1,383 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PrecompiledHeader.h"
+#include "Common.h"
+#include "Rewind.h"
+#include "SaveState.h"
+
+Rewind_Thread rewindThread;
+
+// Uncomment this to log the rewind counters (Rewind_Stats) of each window.
+//#define PCSX2_REWIND_STATS
+
+// Frames in a window of stats
+static const u32 StatsFrames = 60;
+
+// --------------------------------------------------------------------------------------
+//  memRewindSavingState
+// --------------------------------------------------------------------------------------
+// Same layout as memSavingState::FreezeAll, so memLoadingState can load it back, but the
+// plugins are frozen without logging each of them on every capture.
+class memRewindSavingState : public memSavingState
+{
+public:
+	memRewindSavingState( VmStateBuffer& save_to ) : memSavingState( save_to ) {}
+	virtual ~memRewindSavingState() = default;
+
+	SaveStateBase& FreezePlugins()
+	{
+		for (uint i=0; i<PluginId_Count; ++i)
+		{
+			FreezeTag( FastFormatAscii().Write("Plugin:%s", tbl_PluginInfo[i].shortname) );
+			GetCorePlugins().Freeze( (PluginsEnum_t)i, *this, true );
+		}
+
+		return *this;
+	}
+};
+
+// --------------------------------------------------------------------------------------
+//  Delta encoding
+// --------------------------------------------------------------------------------------
+// A delta rebuilds the older state from the newer one: older = newer XOR delta, with the
+// newer state read as zeroes past its end.  It is a list of runs, each one a count of
+// unchanged bytes to skip and a count of XOR bytes that follow.  States are compared
+// 8 bytes at a time, and a run of changes only ends on two unchanged words in a row, so a
+// lone unchanged word doesn't cost a whole run header.
+
+static __fi u64 LoadWord( const u8* src )
+{
+	return *(const u64*)src;
+}
+
+static __fi void PutRun( std::vector<u8>& out, u32 skip, u32 length )
+{
+	const size_t pos = out.size();
+	out.resize( pos + sizeof(u32)*2 + length );
+	memcpy( &out[pos], &skip, sizeof(u32) );
+	memcpy( &out[pos + sizeof(u32)], &length, sizeof(u32) );
+}
+
+static void EncodeDelta( std::vector<u8>& out, const u8* older, uint olderSize, const u8* newer, uint newerSize )
+{
+	const uint common = std::min(olderSize, newerSize) & ~7u;
+	uint pos = 0;
+
+	out.clear();
+	while (pos < olderSize)
+	{
+		const uint skipStart = pos;
+		while (pos < common && LoadWord(older + pos) == LoadWord(newer + pos))
+			pos += 8;
+
+		const uint start = pos;
+		while (pos < common)
+		{
+			if (LoadWord(older + pos) == LoadWord(newer + pos)
+				&& (pos + 8 >= common || LoadWord(older + pos + 8) == LoadWord(newer + pos + 8)))
+				break;
+			pos += 8;
+		}
+
+		// Past the words both states have, the rest of the older state goes in whole.
+		const uint end = (pos >= common) ? olderSize : pos;
+
+		PutRun( out, start - skipStart, end - start );
+		u8* dest = &out[out.size() - (end - start)];
+
+		uint i = start;
+		for (; i + 8 <= std::min(end, common); i += 8, dest += 8)
+		{
+			const u64 x = LoadWord(older + i) ^ LoadWord(newer + i);
+			memcpy( dest, &x, 8 );
+		}
+		for (; i < end; ++i)
+			*dest++ = older[i] ^ ((i < newerSize) ? newer[i] : 0);
+
+		pos = end;
+	}
+}
+
+// Turns the newer state in buf into the older one; buf must have room for olderSize bytes.
+static void DecodeDelta( u8* buf, uint newerSize, uint olderSize, const std::vector<u8>& delta )
+{
+	if (olderSize > newerSize)
+		memset( buf + newerSize, 0, olderSize - newerSize );
+
+	const u8* src = delta.data();
+	const u8* const end = src + delta.size();
+	uint pos = 0;
+
+	while (src < end)
+	{
+		u32 skip, length;
+		memcpy( &skip, src, sizeof(u32) );
+		memcpy( &length, src + sizeof(u32), sizeof(u32) );
+		src += sizeof(u32)*2;
+		pos += skip;
+
+		pxAssert( pos + length <= olderSize );
+		for (u32 i = 0; i < length; ++i)
+			buf[pos + i] ^= src[i];
+
+		src += length;
+		pos += length;
+	}
+}
+
+// --------------------------------------------------------------------------------------
+//  Rewind_Thread  (implementations)
+// --------------------------------------------------------------------------------------
+Rewind_Thread::Rewind_Thread()
+	: m_snapshot( new VmStateBuffer( L"Rewind Snapshot" ) )
+	, m_current( new VmStateBuffer( L"Rewind State" ) )
+	, m_snapshotSize( 0 )
+	, m_currentSize( 0 )
+	, m_deltaBytes( 0 )
+	, m_pending( false )
+	, m_failed( false )
+	, m_warned( false )
+	, m_elapsed( 0 )
+	, m_CaptureTicks( 0 )
+	, m_MaxCaptureTicks( 0 )
+	, m_Captures( 0 )
+	, m_Skipped( 0 )
+	, m_Frames( 0 )
+	, m_EncodeTicks( 0 )
+	, m_Bytes( 0 )
+	, m_States( 0 )
+{
+	m_name = L"Rewind";
+	memzero(m_LastStats);
+	memzero(m_FrameStats);
+}
+
+Rewind_Thread::~Rewind_Thread()
+{
+	try {
+		pxThread::Cancel();
+	}
+	DESTRUCTOR_CATCHALL
+}
+
+void Rewind_Thread::ExecuteTaskInThread()
+{
+	for(;;) {
+		m_sem.WaitWithoutYield();
+		ScopedLock lock(m_mtx);
+		Encode();
+	}
+}
+
+void Rewind_Thread::Vsync()
+{
+	if (EmuConfig.Rewind.Enabled)
+	{
+		if (++m_elapsed >= (u32)std::max(EmuConfig.Rewind.Interval, 1))
+		{
+			m_elapsed = 0;
+			Capture();
+		}
+	}
+	else if (m_Bytes.load(std::memory_order_relaxed) || m_pending.load(std::memory_order_relaxed))
+	{
+		Clear();
+	}
+
+	UpdateCounters();
+}
+
+void Rewind_Thread::Capture()
+{
+	if (m_failed) return;
+
+	if (THREAD_VU1)
+	{
+		// FreezeInternals has to flush the VU thread and warns that the state may not be
+		// stable, which would be every capture.
+		if (!m_warned) Console.Warning("Rewind: disabled while the MTVU speedhack is enabled.");
+		m_warned = true;
+		return;
+	}
+
+	if (m_pending.load(std::memory_order_acquire))
+	{
+		m_Skipped++;
+		return;
+	}
+
+	if (!IsRunning()) Start();
+
+	const u64 start = GetCPUTicks();
+	try {
+		memRewindSavingState saveme( *m_snapshot );
+		saveme.FreezeAll();
+		m_snapshotSize = saveme.GetCurrentPos();
+	}
+	catch( Exception::BaseException& ex ) {
+		Console.Error( L"Rewind: capture failed, rewind is off until the next reset.\n\t%s", WX_STR(ex.FormatDiagnosticMessage()) );
+		m_failed = true;
+		return;
+	}
+	const u64 ticks = GetCPUTicks() - start;
+
+	m_CaptureTicks += ticks;
+	m_MaxCaptureTicks = std::max(m_MaxCaptureTicks, ticks);
+	m_Captures++;
+
+	m_pending.store(true, std::memory_order_release);
+	m_sem.Post();
+}
+
+// Adds the pending snapshot to the ring (m_mtx must be held)
+void Rewind_Thread::Encode()
+{
+	if (!m_pending.load(std::memory_order_acquire)) return;
+
+	const u64 start = GetCPUTicks();
+
+	if (m_currentSize)
+	{
+		EncodeDelta( m_scratch, m_current->GetPtr(), m_currentSize, m_snapshot->GetPtr(), m_snapshotSize );
+
+		Delta delta;
+		delta.size = m_currentSize;
+		delta.data.assign( m_scratch.begin(), m_scratch.end() );
+		m_deltaBytes += delta.data.size();
+		m_deltas.push_back( std::move(delta) );
+	}
+
+	std::swap( m_current, m_snapshot );
+	m_currentSize = m_snapshotSize;
+
+	const u64 budget = (u64)std::max(EmuConfig.Rewind.BufferSizeMB, 1) * _1mb;
+	while (!m_deltas.empty() && m_currentSize + m_deltaBytes > budget)
+	{
+		m_deltaBytes -= m_deltas.front().data.size();
+		m_deltas.pop_front();
+	}
+
+	m_Bytes.store(m_currentSize + m_deltaBytes, std::memory_order_relaxed);
+	m_States.store((u32)m_deltas.size() + 1, std::memory_order_relaxed);
+	m_EncodeTicks.fetch_add(GetCPUTicks() - start, std::memory_order_relaxed);
+	m_pending.store(false, std::memory_order_release);
+}
+
+bool Rewind_Thread::Pop( VmStateBuffer& dest )
+{
+	ScopedLock lock(m_mtx);
+
+	// The last snapshot might not have reached the worker yet.
+	Encode();
+	if (!m_currentSize) return false;
+
+	dest.MakeRoomFor( m_currentSize );
+	memcpy( dest.GetPtr(), m_current->GetPtr(), m_currentSize );
+
+	if (m_deltas.empty())
+	{
+		m_currentSize = 0;
+	}
+	else
+	{
+		const Delta& delta = m_deltas.back();
+		m_current->MakeRoomFor( delta.size );
+		DecodeDelta( m_current->GetPtr(), m_currentSize, delta.size, delta.data );
+
+		m_currentSize = delta.size;
+		m_deltaBytes -= delta.data.size();
+		m_deltas.pop_back();
+	}
+
+	m_Bytes.store(m_currentSize ? m_currentSize + m_deltaBytes : 0, std::memory_order_relaxed);
+	m_States.store(m_currentSize ? (u32)m_deltas.size() + 1 : 0, std::memory_order_relaxed);
+	m_elapsed = 0;
+	return true;
+}
+
+void Rewind_Thread::Clear()
+{
+	ScopedLock lock(m_mtx);
+
+	m_pending.store(false, std::memory_order_relaxed);
+	m_deltas.clear();
+	m_deltaBytes = 0;
+	m_currentSize = 0;
+	m_snapshotSize = 0;
+	m_current->Dispose();
+	m_snapshot->Dispose();
+	std::vector<u8>().swap(m_scratch);
+
+	m_failed = false;
+	m_warned = false;
+	m_elapsed = 0;
+	m_Bytes.store(0, std::memory_order_relaxed);
+	m_States.store(0, std::memory_order_relaxed);
+}
+
+Rewind_Stats Rewind_Thread::GetStats() const
+{
+	Rewind_Stats stats;
+	stats.CaptureTicks    = m_CaptureTicks;
+	stats.MaxCaptureTicks = m_MaxCaptureTicks;
+	stats.EncodeTicks     = m_EncodeTicks.load(std::memory_order_relaxed);
+	stats.Bytes           = m_Bytes.load(std::memory_order_relaxed);
+	stats.Captures        = m_Captures;
+	stats.Skipped         = m_Skipped;
+	stats.States          = m_States.load(std::memory_order_relaxed);
+	stats.Frames          = m_Frames;
+	return stats;
+}
+
+Rewind_Stats Rewind_Thread::GetFrameStats()
+{
+	ScopedLock lock(mtxStats);
+	return m_FrameStats;
+}
+
+void Rewind_Thread::UpdateCounters()
+{
+	if (++m_Frames - m_LastStats.Frames < StatsFrames) return;
+
+	const Rewind_Stats now = GetStats();
+	Rewind_Stats& last = m_LastStats;
+	Rewind_Stats window;
+	window.CaptureTicks    = now.CaptureTicks - last.CaptureTicks;
+	window.MaxCaptureTicks = now.MaxCaptureTicks;
+	window.EncodeTicks     = now.EncodeTicks  - last.EncodeTicks;
+	window.Bytes           = now.Bytes;
+	window.Captures        = now.Captures     - last.Captures;
+	window.Skipped         = now.Skipped      - last.Skipped;
+	window.States          = now.States;
+	window.Frames          = now.Frames       - last.Frames;
+
+	{
+		ScopedLock lock(mtxStats);
+		m_FrameStats = window;
+		m_LastStats  = now;
+	}
+	m_MaxCaptureTicks = 0;
+
+#ifdef PCSX2_REWIND_STATS
+	if (window.Captures)
+	{
+		const double ms = 1000.0 / GetTickFrequency();
+		Console.WriteLn(Color_Gray, "Rewind: %u states, %.1f MB, capture %.2f ms/frame (%.2f ms max), encode %.2f ms per state, %u skipped",
+			window.States, (double)window.Bytes / _1mb, window.CaptureTicks * ms / window.Frames,
+			window.MaxCaptureTicks * ms, window.EncodeTicks * ms / window.Captures, window.Skipped);
+	}
+#endif
+}
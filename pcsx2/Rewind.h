@@ -0,0 +1,122 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "System/SysThreads.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Rewind buffer counters, see Rewind_Thread::GetFrameStats().
+struct Rewind_Stats
+{
+	u64 CaptureTicks;		// EE time spent taking snapshots
+	u64 MaxCaptureTicks;	// longest single snapshot
+	u64 EncodeTicks;		// worker time spent delta encoding them
+	u64 Bytes;				// memory held by the ring (newest state + deltas)
+	u32 Captures;
+	u32 Skipped;			// snapshots dropped, the worker was still busy with the previous one
+	u32 States;
+	u32 Frames;
+};
+
+// --------------------------------------------------------------------------------------
+//  Rewind_Thread
+// --------------------------------------------------------------------------------------
+// In-memory ring of recent VM states, to step emulation backwards.
+//
+// Every EmuConfig.Rewind.Interval frames the EE snapshots the whole VM into a flat buffer,
+// in the same layout as memSavingState::FreezeAll (main/IOP/VU memory, the internal
+// structures, then the plugins, with GS local memory in the GS freeze data).  The worker
+// thread then XORs it against the previous snapshot and run length encodes the result, so
+// each older state only costs the bytes that changed since.  Deltas go backwards (each
+// one rebuilds a state from the next newer one): only the newest state is kept whole, and
+// the oldest deltas are the ones dropped when the ring outgrows EmuConfig.Rewind.BufferSizeMB.
+//
+// The EE never waits for the worker; a capture that comes while the previous one is still
+// being encoded is skipped.  The capture itself is a full FreezeAll on the EE thread though,
+// so a single one can take longer than a frame's budget and stutter; the average spreads it
+// over Interval frames, the OSD shows the longest capture of the window next to it.
+class Rewind_Thread : public pxThread
+{
+	typedef pxThread _parent;
+
+	struct Delta
+	{
+		uint size;					// size of the older state
+		std::vector<u8> data;		// (u32 skip, u32 length, length bytes of XOR) runs
+	};
+
+	Semaphore	m_sem;				// EE -> worker: snapshot ready
+	Mutex		m_mtx;				// the ring and the snapshot, while encoding
+
+	std::unique_ptr<VmStateBuffer>	m_snapshot;		// written by the EE while !m_pending
+	std::unique_ptr<VmStateBuffer>	m_current;		// newest state, whole
+	uint		m_snapshotSize;
+	uint		m_currentSize;		// 0 when the ring is empty
+	std::deque<Delta>	m_deltas;	// oldest first
+	u64			m_deltaBytes;
+	std::vector<u8>		m_scratch;	// encoder output, reused
+
+	std::atomic<bool>	m_pending;	// a snapshot waits for the worker
+	bool		m_failed;			// a capture threw, stop until the next Clear()
+	bool		m_warned;
+	u32			m_elapsed;			// frames since the last capture (EE only)
+
+	// Counters, see Rewind_Stats
+	u64			m_CaptureTicks;
+	u64			m_MaxCaptureTicks;
+	u32			m_Captures;
+	u32			m_Skipped;
+	u32			m_Frames;
+	std::atomic<u64>	m_EncodeTicks;	// Only modified by the worker
+	std::atomic<u64>	m_Bytes;
+	std::atomic<u32>	m_States;
+
+	Mutex			mtxStats;
+	Rewind_Stats	m_LastStats;	// counters at the start of the current window
+	Rewind_Stats	m_FrameStats;	// counters over the last complete window
+
+public:
+	Rewind_Thread();
+	virtual ~Rewind_Thread();
+
+	// Called by the EE on each vsync, takes a snapshot every EmuConfig.Rewind.Interval frames
+	void Vsync();
+
+	// Copies the newest state to dest and drops it from the ring; the state before it
+	// becomes the newest.  Returns false if the ring is empty.  The core must be paused.
+	bool Pop(VmStateBuffer& dest);
+
+	// Drops every state (EE thread, or with the core paused)
+	void Clear();
+
+	// Counters over the last complete window (Frames is 0 until there's one)
+	Rewind_Stats GetFrameStats();
+
+protected:
+	void ExecuteTaskInThread();
+
+private:
+	void Capture();
+	void Encode();
+	void UpdateCounters();
+	Rewind_Stats GetStats() const;
+};
+
+extern Rewind_Thread rewindThread;
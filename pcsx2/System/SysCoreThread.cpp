@@ -24,6 +24,7 @@
 #include "Patch.h"
 #include "SysThreads.h"
 #include "MTVU.h"
+#include "Rewind.h"
 
 #include "../DebugTools/MIPSAnalyst.h"
 #include "../DebugTools/SymbolMap.h"
@@ -191,6 +192,7 @@ void SysCoreThread::_reset_stuff_as_needed()
 	if( m_resetVirtualMachine )
 	{
 		DoCpuReset();
+		rewindThread.Clear();
 
 		m_resetVirtualMachine	= false;
 		m_resetVsyncTimers		= false;
@@ -225,6 +227,7 @@ void SysCoreThread::DoCpuReset()
 void SysCoreThread::VsyncInThread()
 {
 	ApplyLoadedPatches(PPT_CONTINUOUSLY);
+	rewindThread.Vsync();
 }
 
 void SysCoreThread::GameStartingInThread()
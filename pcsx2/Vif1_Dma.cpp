@@ -35,7 +35,7 @@ __fi void vif1FLUSH()
 
 void vif1TransferToMemory()
 {
-	u128* pMem = (u128*)dmaGetAddr(vif1ch.madr, false);
+	u128* pMem = (u128*)dmaGetAddr(vif1ch.madr, true);
 
 	// VIF from gsMemory
 	if (pMem == NULL) { // Is vif0ptag empty?
@@ -18,9 +18,12 @@
 #include "Utilities/PersistentThread.h"
 #include "Utilities/pxStreams.h"
 #include "wx/zipstrm.h"
+#include "wx/ffile.h"
 
 using namespace Threading;
 
+typedef struct z_stream_s z_stream;
+
 // --------------------------------------------------------------------------------------
 //  ArchiveEntry
 // --------------------------------------------------------------------------------------
@@ -96,6 +99,12 @@ public:
 		: m_data(&data)
 	{
 	}
+
+	// Gives up ownership of the data buffer (so it can be reused by the next list)
+	ArchiveDataBuffer* ReleaseBuffer()
+	{
+		return m_data.release();
+	}
 	
 	const VmStateBuffer* GetBuffer() const
 	{
@@ -139,6 +148,104 @@ public:
 	}
 };
 
+// --------------------------------------------------------------------------------------
+//  ParallelZipWriter
+// --------------------------------------------------------------------------------------
+// Writes a zip archive straight to disk, deflating each entry in chunks on a pool of
+// threads.  Every chunk but the last of an entry ends with a sync flush, which leaves
+// the deflate stream byte aligned, so the compressed chunks are simply concatenated
+// (the way pigz does it).  Each chunk is primed with the 32k of data preceding it, so
+// the ratio is close to a single stream.  The archive is a plain zip (deflate method,
+// no zip64), readable by wxZipInputStream.
+//
+class ParallelZipWriter
+{
+	DeclareNoncopyableObject( ParallelZipWriter );
+
+public:
+	static const uint ChunkSize		= _1mb;
+	static const uint MaxThreads	= 4;
+
+	ParallelZipWriter( const wxString& filename, int level=1 );
+	virtual ~ParallelZipWriter();
+
+	bool IsOk() const { return m_file.IsOpened(); }
+	wxString GetStreamName() const { return m_filename; }
+
+	// Throws Exception::BadStream on write errors
+	void AddStored( const wxString& name, const void* data, size_t size );
+	void AddDeflated( const wxString& name, const void* data, size_t size );
+	void Close();
+
+	// Bytes given to Add*() and written to the file
+	u64 GetDataSize() const { return m_dataSize; }
+	u64 GetFileSize() const { return m_offset; }
+
+protected:
+	struct Chunk
+	{
+		const u8*			src;
+		uint				size;
+		uint				dict;		// bytes preceding src used as dictionary
+		bool				last;
+		std::vector<u8>		out;
+		u32					crc;
+		std::atomic<bool>	done;
+	};
+
+	struct Entry
+	{
+		wxString	name;
+		u16			method;
+		u32			crc;
+		u32			csize;
+		u32			usize;
+		u32			offset;
+	};
+
+	// Deflates the chunks of the entry being written, with its own zlib stream.
+	class DeflateThread : public pxThread
+	{
+		typedef pxThread _parent;
+
+	public:
+		DeflateThread( ParallelZipWriter& writer );
+		virtual ~DeflateThread();
+
+		bool Init();
+
+	protected:
+		void ExecuteTaskInThread();
+
+		ParallelZipWriter&	m_writer;
+		z_stream*			m_strm;
+	};
+
+	void StartThreads();
+	void StopThreads();
+	void StartEntry( Entry& entry );
+	void FinishEntry( Entry& entry );
+	void Write( const void* data, size_t size );
+	static void DeflateChunk( z_stream& strm, Chunk& chunk );
+
+	wxString			m_filename;
+	wxFFile				m_file;
+	int					m_level;
+	u32					m_dosTime;
+	u64					m_offset;
+	u64					m_dataSize;
+	std::vector<Entry>	m_entries;
+
+	std::vector<DeflateThread*>	m_threads;
+	std::unique_ptr<Chunk[]>	m_chunks;		// chunks of the entry being written
+	z_stream*					m_strm;			// for the chunks deflated by the writer
+	uint						m_chunkCount;
+	std::atomic<uint>			m_nextChunk;	// next chunk for the deflate threads
+	std::atomic<bool>			m_quit;
+	Semaphore					m_sem_work;		// posted once per chunk that can be deflated
+	Semaphore					m_sem_done;		// posted once per deflated chunk
+};
+
 // --------------------------------------------------------------------------------------
 //  BaseCompressThread
 // --------------------------------------------------------------------------------------
@@ -148,7 +255,7 @@ class BaseCompressThread
 	typedef pxThread _parent;
 
 protected:
-	pxOutputStream*					m_gzfp;
+	ParallelZipWriter*				m_zip;
 	ArchiveEntryList*				m_src_list;
 	bool							m_PendingSaveFlag;
 	
@@ -169,15 +276,15 @@ public:
 		return *this;
 	}
 
-	BaseCompressThread& SetOutStream( pxOutputStream* out )
+	BaseCompressThread& SetOutStream( ParallelZipWriter* out )
 	{
-		m_gzfp = out;
+		m_zip = out;
 		return *this;
 	}
 
-	BaseCompressThread& SetOutStream( pxOutputStream& out )
+	BaseCompressThread& SetOutStream( ParallelZipWriter& out )
 	{
-		m_gzfp = &out;
+		m_zip = &out;
 		return *this;
 	}
 
@@ -187,7 +294,7 @@ public:
 		return *this;
 	}
 
-	wxString GetStreamName() const { return m_gzfp->GetStreamName(); }
+	wxString GetStreamName() const { return m_zip->GetStreamName(); }
 
 	BaseCompressThread& SetTargetFilename(const wxString& filename)
 	{
@@ -198,7 +305,7 @@ public:
 protected:
 	BaseCompressThread()
 	{
-		m_gzfp				= NULL;
+		m_zip				= NULL;
 		m_src_list			= NULL;
 		m_PendingSaveFlag	= false;
 	}
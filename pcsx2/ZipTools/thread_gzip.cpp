@@ -19,8 +19,346 @@
 #include "SaveState.h"
 #include "ThreadedZipTools.h"
 #include "Utilities/SafeArray.inl"
+#include "x86emitter/tools.h"
 #include "wx/wfstream.h"
 
+#ifdef __POSIX__
+#include <zlib.h>
+#else
+#include <zlib/zlib.h>
+#endif
+
+// --------------------------------------------------------------------------------------
+//  ParallelZipWriter  (implementations)
+// --------------------------------------------------------------------------------------
+static const u32 ZipLocalHeaderSig		= 0x04034b50;
+static const u32 ZipCentralHeaderSig	= 0x02014b50;
+static const u32 ZipEndOfDirSig			= 0x06054b50;
+static const u16 ZipVersion				= 20;			// 2.0, deflate
+static const u16 ZipFlagUTF8			= 1 << 11;
+static const u16 ZipMethodStore			= 0;
+static const u16 ZipMethodDeflate		= 8;
+static const uint ZipDictSize			= 32 * 1024;
+
+static void PutLE16( std::vector<u8>& buf, u16 v )
+{
+	buf.push_back( (u8)v );
+	buf.push_back( (u8)(v >> 8) );
+}
+
+static void PutLE32( std::vector<u8>& buf, u32 v )
+{
+	PutLE16( buf, (u16)v );
+	PutLE16( buf, (u16)(v >> 16) );
+}
+
+ParallelZipWriter::DeflateThread::DeflateThread( ParallelZipWriter& writer )
+	: m_writer( writer )
+	, m_strm( NULL )
+{
+	m_name = L"ZipDeflate";
+}
+
+ParallelZipWriter::DeflateThread::~DeflateThread()
+{
+	try {
+		_parent::Cancel();
+	}
+	DESTRUCTOR_CATCHALL
+
+	if (m_strm) {
+		deflateEnd(m_strm);
+		delete m_strm;
+	}
+}
+
+bool ParallelZipWriter::DeflateThread::Init()
+{
+	m_strm = new z_stream;
+	memzero(*m_strm);
+	if (deflateInit2(m_strm, m_writer.m_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		delete m_strm;
+		m_strm = NULL;
+		return false;
+	}
+	return true;
+}
+
+void ParallelZipWriter::DeflateThread::ExecuteTaskInThread()
+{
+	while (true) {
+		m_writer.m_sem_work.WaitWithoutYield();
+		if (m_writer.m_quit)
+			return;
+
+		Chunk& chunk = m_writer.m_chunks[m_writer.m_nextChunk.fetch_add(1)];
+		DeflateChunk(*m_strm, chunk);
+		chunk.done.store(true, std::memory_order_release);
+		m_writer.m_sem_done.Post();
+	}
+}
+
+ParallelZipWriter::ParallelZipWriter( const wxString& filename, int level )
+	: m_filename( filename )
+	, m_file( filename, L"wb" )
+	, m_level( level )
+	, m_offset( 0 )
+	, m_dataSize( 0 )
+	, m_strm( NULL )
+	, m_chunkCount( 0 )
+	, m_nextChunk( 0 )
+	, m_quit( false )
+{
+	const wxDateTime now( wxDateTime::Now() );
+	m_dosTime = ((u32)(now.GetYear() - 1980) << 25) | ((u32)(now.GetMonth() + 1) << 21) | ((u32)now.GetDay() << 16)
+		| ((u32)now.GetHour() << 11) | ((u32)now.GetMinute() << 5) | ((u32)now.GetSecond() / 2);
+
+	if (IsOk())
+		StartThreads();
+}
+
+ParallelZipWriter::~ParallelZipWriter()
+{
+	StopThreads();
+}
+
+void ParallelZipWriter::StartThreads()
+{
+	// Leave a core for the EE and one for the GS
+	const uint threads = std::min<uint>(MaxThreads, std::max<uint>(x86caps.LogicalCores, 3) - 2);
+
+	m_quit = false;
+	for (uint i = 0; i < threads; i++) {
+		DeflateThread* thread = new DeflateThread(*this);
+		if (!thread->Init()) {
+			delete thread;
+			break;
+		}
+		thread->Start();
+		m_threads.push_back(thread);
+	}
+
+	// No thread, the writer deflates the chunks itself
+	if (m_threads.empty()) {
+		m_strm = new z_stream;
+		memzero(*m_strm);
+		if (deflateInit2(m_strm, m_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			safe_delete(m_strm);
+	}
+}
+
+void ParallelZipWriter::StopThreads()
+{
+	m_quit = true;
+	m_sem_work.Post(m_threads.size());
+	for (auto thread : m_threads) {
+		if (thread->IsRunning())
+			thread->Block();
+		delete thread;
+	}
+	m_threads.clear();
+
+	if (m_strm) {
+		deflateEnd(m_strm);
+		safe_delete(m_strm);
+	}
+}
+
+void ParallelZipWriter::DeflateChunk( z_stream& strm, Chunk& chunk )
+{
+	deflateReset(&strm);
+	if (chunk.dict)
+		deflateSetDictionary(&strm, chunk.src - chunk.dict, chunk.dict);
+
+	// Room for the sync flush on top of the bound for a whole stream
+	chunk.out.resize(deflateBound(&strm, chunk.size) + 16);
+	strm.next_in	= (Bytef*)chunk.src;
+	strm.avail_in	= chunk.size;
+	strm.next_out	= chunk.out.data();
+	strm.avail_out	= (uInt)chunk.out.size();
+
+	const int flush = chunk.last ? Z_FINISH : Z_SYNC_FLUSH;
+	while (true) {
+		const int ret = deflate(&strm, flush);
+		if (chunk.last ? (ret == Z_STREAM_END) : (strm.avail_in == 0 && strm.avail_out != 0))
+			break;
+
+		const size_t used = chunk.out.size() - strm.avail_out;
+		chunk.out.resize(chunk.out.size() * 2);
+		strm.next_out	= chunk.out.data() + used;
+		strm.avail_out	= (uInt)(chunk.out.size() - used);
+	}
+
+	chunk.out.resize(chunk.out.size() - strm.avail_out);
+	chunk.crc = crc32(0, chunk.src, chunk.size);
+}
+
+void ParallelZipWriter::Write( const void* data, size_t size )
+{
+	if (m_file.Write(data, size) != size || m_offset + size > 0xffffffffull)
+		throw Exception::BadStream( m_filename )
+			.SetDiagMsg(L"Failed to write the zip archive.")
+			.SetUserMsg(_("The savestate could not be written. The disk may be full or the file is too large."));
+	m_offset += size;
+}
+
+void ParallelZipWriter::StartEntry( Entry& entry )
+{
+	const wxScopedCharBuffer name( entry.name.ToUTF8() );
+
+	entry.offset = (u32)m_offset;
+
+	std::vector<u8> header;
+	PutLE32( header, ZipLocalHeaderSig );
+	PutLE16( header, ZipVersion );
+	PutLE16( header, ZipFlagUTF8 );
+	PutLE16( header, entry.method );
+	PutLE32( header, m_dosTime );
+	PutLE32( header, 0 );	// crc and sizes, filled by FinishEntry()
+	PutLE32( header, 0 );
+	PutLE32( header, 0 );
+	PutLE16( header, (u16)name.length() );
+	PutLE16( header, 0 );
+	header.insert( header.end(), name.data(), name.data() + name.length() );
+
+	Write( header.data(), header.size() );
+}
+
+void ParallelZipWriter::FinishEntry( Entry& entry )
+{
+	const wxScopedCharBuffer name( entry.name.ToUTF8() );
+	entry.csize = (u32)(m_offset - entry.offset - 30 - name.length());
+
+	std::vector<u8> sizes;
+	PutLE32( sizes, entry.crc );
+	PutLE32( sizes, entry.csize );
+	PutLE32( sizes, entry.usize );
+
+	if (!m_file.Seek( entry.offset + 14 ) || m_file.Write( sizes.data(), sizes.size() ) != sizes.size() || !m_file.SeekEnd())
+		throw Exception::BadStream( m_filename )
+			.SetDiagMsg(L"Failed to write the zip archive.")
+			.SetUserMsg(_("The savestate could not be written. The disk may be full or the file is too large."));
+
+	m_dataSize += entry.usize;
+	m_entries.push_back( entry );
+}
+
+void ParallelZipWriter::AddStored( const wxString& name, const void* data, size_t size )
+{
+	Entry entry;
+	entry.name		= name;
+	entry.method	= ZipMethodStore;
+	entry.crc		= crc32(0, (const Bytef*)data, size);
+	entry.usize		= (u32)size;
+
+	StartEntry( entry );
+	Write( data, size );
+	FinishEntry( entry );
+}
+
+void ParallelZipWriter::AddDeflated( const wxString& name, const void* data, size_t size )
+{
+	Entry entry;
+	entry.name		= name;
+	entry.method	= ZipMethodDeflate;
+	entry.crc		= 0;
+	entry.usize		= (u32)size;
+
+	StartEntry( entry );
+
+	const u8* src = (const u8*)data;
+	m_chunkCount = std::max<uint>((size + ChunkSize - 1) / ChunkSize, 1);
+	m_chunks.reset(new Chunk[m_chunkCount]);
+	for (uint i = 0; i < m_chunkCount; i++) {
+		Chunk& chunk = m_chunks[i];
+		chunk.src	= src + (size_t)i * ChunkSize;
+		chunk.size	= std::min<size_t>(ChunkSize, size - (size_t)i * ChunkSize);
+		chunk.dict	= i ? ZipDictSize : 0;
+		chunk.last	= (i == m_chunkCount - 1);
+		chunk.crc	= 0;
+		chunk.done	= false;
+	}
+
+	// Keep a few chunks queued per thread, so the deflated data waiting to be written
+	// stays small
+	const uint window = std::min<uint>(m_chunkCount, m_threads.size() * 2);
+	m_nextChunk = 0;
+	m_sem_work.Post(window);
+	uint queued = window;
+
+	for (uint i = 0; i < m_chunkCount; i++) {
+		Chunk& chunk = m_chunks[i];
+		if (m_threads.empty()) {
+			if (!m_strm)
+				throw Exception::RuntimeError().SetDiagMsg(L"ParallelZipWriter: zlib initialization failed.");
+			DeflateChunk(*m_strm, chunk);
+		} else {
+			while (!chunk.done.load(std::memory_order_acquire))
+				m_sem_done.WaitWithoutYield();
+		}
+
+		Write( chunk.out.data(), chunk.out.size() );
+		entry.crc = i ? crc32_combine(entry.crc, chunk.crc, chunk.size) : chunk.crc;
+		std::vector<u8>().swap(chunk.out);
+
+		if (queued < m_chunkCount) {
+			m_sem_work.Post();
+			queued++;
+		}
+	}
+
+	FinishEntry( entry );
+}
+
+void ParallelZipWriter::Close()
+{
+	StopThreads();
+
+	const u32 dirOffset = (u32)m_offset;
+	std::vector<u8> dir;
+	for (const Entry& entry : m_entries) {
+		const wxScopedCharBuffer name( entry.name.ToUTF8() );
+
+		PutLE32( dir, ZipCentralHeaderSig );
+		PutLE16( dir, ZipVersion );		// made by
+		PutLE16( dir, ZipVersion );		// needed
+		PutLE16( dir, ZipFlagUTF8 );
+		PutLE16( dir, entry.method );
+		PutLE32( dir, m_dosTime );
+		PutLE32( dir, entry.crc );
+		PutLE32( dir, entry.csize );
+		PutLE32( dir, entry.usize );
+		PutLE16( dir, (u16)name.length() );
+		PutLE16( dir, 0 );				// extra
+		PutLE16( dir, 0 );				// comment
+		PutLE16( dir, 0 );				// disk
+		PutLE16( dir, 0 );				// internal attributes
+		PutLE32( dir, 0 );				// external attributes
+		PutLE32( dir, entry.offset );
+		dir.insert( dir.end(), name.data(), name.data() + name.length() );
+	}
+
+	const u32 dirSize = (u32)dir.size();
+	PutLE32( dir, ZipEndOfDirSig );
+	PutLE16( dir, 0 );
+	PutLE16( dir, 0 );
+	PutLE16( dir, (u16)m_entries.size() );
+	PutLE16( dir, (u16)m_entries.size() );
+	PutLE32( dir, dirSize );
+	PutLE32( dir, dirOffset );
+	PutLE16( dir, 0 );
+
+	Write( dir.data(), dir.size() );
+
+	if (!m_file.Close())
+		throw Exception::BadStream( m_filename )
+			.SetDiagMsg(L"Failed to close the zip archive.");
+}
+
+// --------------------------------------------------------------------------------------
+//  BaseCompressThread  (implementations)
+// --------------------------------------------------------------------------------------
+
 
 BaseCompressThread::~BaseCompressThread()
 {
@@ -55,31 +393,25 @@ void BaseCompressThread::ExecuteTaskInThread()
 	
 	Yield( 3 );
 
+	const u64 start = GetCPUTicks();
+
 	uint listlen = m_src_list->GetLength();
 	for( uint i=0; i<listlen; ++i )
 	{
 		const ArchiveEntry& entry = (*m_src_list)[i];
 		if (!entry.GetDataSize()) continue;
 
-		wxArchiveOutputStream& woot = *(wxArchiveOutputStream*)m_gzfp->GetWxStreamBase();
-		woot.PutNextEntry( entry.GetFilename() );
-
-		static const uint BlockSize = 0x64000;
-		uint curidx = 0;
-
-		do {
-			uint thisBlockSize = std::min( BlockSize, entry.GetDataSize() - curidx );
-			m_gzfp->Write(m_src_list->GetPtr( entry.GetDataIndex() + curidx ), thisBlockSize);
-			curidx += thisBlockSize;
-			Yield( 2 );
-		} while( curidx < entry.GetDataSize() );
-		
-		woot.CloseEntry();
+		m_zip->AddDeflated( entry.GetFilename(), m_src_list->GetPtr( entry.GetDataIndex() ), entry.GetDataSize() );
+		TestCancel();
 	}
 
-	m_gzfp->Close();
+	m_zip->Close();
+
+	DevCon.WriteLn( Color_Gray, "(gzipThread) %.1f MB deflated to %.1f MB in %u ms",
+		m_zip->GetDataSize() / (double)_1mb, m_zip->GetFileSize() / (double)_1mb,
+		(u32)((GetCPUTicks() - start) * 1000 / GetTickFrequency()) );
 
-	if( !wxRenameFile( m_gzfp->GetStreamName(), m_final_filename, true ) )
+	if( !wxRenameFile( m_zip->GetStreamName(), m_final_filename, true ) )
 		throw Exception::BadStream( m_final_filename )
 		.SetDiagMsg(L"Failed to move or copy the temporary archive to the destination filename.")
 		.SetUserMsg(_("The savestate was not properly saved. The temporary file was created successfully but could not be moved to its final resting place."));
@@ -92,7 +424,7 @@ void BaseCompressThread::OnCleanupInThread()
 	_parent::OnCleanupInThread();
 	wxGetApp().DeleteThread( this );
 
-	safe_delete(m_gzfp);
+	safe_delete(m_zip);
 	safe_delete(m_src_list);
 }
 
@@ -73,6 +73,12 @@ namespace PathDefs
 			return retval;
 		}
 
+		const wxDirName& Cache()
+		{
+			static const wxDirName retval( L"cache" );
+			return retval;
+		}
+
 		const wxDirName& Bios()
 		{
 			static const wxDirName retval(L"bios");
@@ -242,6 +248,12 @@ namespace PathDefs
 		return GetDocuments() + Base::Logs();
 	}
 
+	// Data PCSX2 can always rebuild, not user configurable.
+	wxDirName GetCache()
+	{
+		return GetDocuments() + Base::Cache();
+	}
+
 	wxDirName GetLangs()
 	{
 		return AppRoot() + Base::Langs();
@@ -457,6 +469,11 @@ wxDirName GetLogFolder()
 	return GetResolvedFolder(FolderId_Logs);
 }
 
+wxDirName GetCacheFolder()
+{
+	return PathDefs::GetCache();
+}
+
 wxDirName GetCheatsFolder()
 {
 	return GetResolvedFolder(FolderId_Cheats);
@@ -65,6 +65,7 @@ extern wxString  GetUiSettingsFilename();
 extern wxString  GetUiKeysFilename();
 
 extern wxDirName GetLogFolder();
+extern wxDirName GetCacheFolder();
 extern wxDirName GetCheatsFolder();
 extern wxDirName GetCheatsWsFolder();
 
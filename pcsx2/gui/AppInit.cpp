@@ -19,6 +19,8 @@
 #include "ConsoleLogger.h"
 #include "MSWstuff.h"
 #include "MTVU.h" // for thread cancellation on shutdown
+#include "IPU/IPU.h"
+#include "Rewind.h"
 
 #include "Utilities/IniInterface.h"
 #include "DebugTools/Debug.h"
@@ -778,6 +780,8 @@ Pcsx2App::~Pcsx2App()
 	pxDoAssert = pxAssertImpl_LogIt;	
 	try {
 		vu1Thread.Cancel();
+		ipuThread.Cancel();
+		rewindThread.Cancel();
 	}
 	DESTRUCTOR_CATCHALL
 }
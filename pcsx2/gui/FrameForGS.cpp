@@ -20,6 +20,8 @@
 #include "AppSaveStates.h"
 #include "Counters.h"
 #include "GS.h"
+#include "MTVU.h"
+#include "Rewind.h"
 #include "MSWstuff.h"
 
 #include "ConsoleLogger.h"
@@ -54,6 +56,7 @@ void GSPanel::InitDefaultAccelerators()
 	m_Accels->Map( AAC( WXK_F3 ).Shift(),		"States_DefrostCurrentSlotBackup");
 	m_Accels->Map( AAC( WXK_F2 ),				"States_CycleSlotForward" );
 	m_Accels->Map( AAC( WXK_F2 ).Shift(),		"States_CycleSlotBackward" );
+	m_Accels->Map( AAC( WXK_BACK ),				"States_Rewind" );
 
 	m_Accels->Map( AAC( WXK_F4 ),				"Framelimiter_MasterToggle");
 	m_Accels->Map( AAC( WXK_F4 ).Shift(),		"Frameskip_Toggle");
@@ -680,11 +683,50 @@ void GSFrame::OnUpdateTitle( wxTimerEvent& evt )
 			pxNonReleaseCode(cpuUsage.Write(L" | UI: %3d%%", m_CpuUsage.GetGuiPct()));
 		}
 
-		if (THREAD_VU1)
+		if (THREAD_VU1) {
 			OSDmonitor(Color_StrongGreen, "VU:", std::to_string(m_CpuUsage.GetVUPct()).c_str());
 
+			// EE stalled on the ring or in WaitVU / VU thread idle / GS waiting on XGKICKs, in ms per frame
+			const MTVU_Stats vuStats = vu1Thread.GetFrameStats();
+			if (vuStats.Frames) {
+				const double msPerFrame = 1000.0 / GetTickFrequency() / vuStats.Frames;
+				std::ostringstream vuWaits;
+				vuWaits << std::fixed << std::setprecision(2)
+					<< (vuStats.StallTicks + vuStats.SyncTicks) * msPerFrame << " / "
+					<< vuStats.IdleTicks * msPerFrame << " / "
+					<< vuStats.XgkickTicks * msPerFrame;
+				OSDmonitor(Color_StrongGreen, "VU waits:", vuWaits.str());
+			}
+		}
+
+		if (EmuConfig.Rewind.Enabled) {
+			// EE time spent on rewind captures in ms per frame and the longest one, states and memory held
+			const Rewind_Stats rwStats = rewindThread.GetFrameStats();
+			if (rwStats.Frames) {
+				const double ms = 1000.0 / GetTickFrequency();
+				std::ostringstream rewind;
+				rewind << std::fixed << std::setprecision(2)
+					<< rwStats.CaptureTicks * ms / rwStats.Frames << " ms (max "
+					<< rwStats.MaxCaptureTicks * ms << ") / "
+					<< rwStats.States << " / " << std::setprecision(0) << (double)rwStats.Bytes / _1mb << " MB";
+				OSDmonitor(Color_StrongGreen, "Rewind:", rewind.str());
+			}
+		}
+
 		OSDmonitor(Color_StrongGreen, "EE:", std::to_string(m_CpuUsage.GetEEcorePct()).c_str());
 		OSDmonitor(Color_StrongGreen, "GS:", std::to_string(m_CpuUsage.GetGsPct()).c_str());
+
+		// EE stalled on the ring / in the vsync queue, in ms per frame, and MTGS wakeups per frame
+		const MTGS_RingStats gsStats = GetMTGS().GetFrameStats();
+		if (gsStats.Frames) {
+			const double msPerFrame = 1000.0 / GetTickFrequency() / gsStats.Frames;
+			std::ostringstream gsWaits;
+			gsWaits << std::fixed << std::setprecision(2)
+				<< gsStats.StallTicks * msPerFrame << " / "
+				<< gsStats.VsyncWaitTicks * msPerFrame << " / "
+				<< (double)gsStats.Wakeups / gsStats.Frames;
+			OSDmonitor(Color_StrongGreen, "GS waits:", gsWaits.str());
+		}
 		pxNonReleaseCode(OSDmonitor(Color_StrongGreen, "UI:", std::to_string(m_CpuUsage.GetGuiPct()).c_str()));
 	}
 
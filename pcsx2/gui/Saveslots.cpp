@@ -125,6 +125,25 @@ void States_DefrostCurrentSlotBackup()
 	_States_DefrostCurrentSlot(true);
 }
 
+void States_Rewind()
+{
+	if (!SysHasValidState())
+	{
+		Console.WriteLn("Rewind: Aborting (VM is not active).");
+		return;
+	}
+
+	if (IsSavingOrLoading.exchange(true))
+	{
+		Console.WriteLn("Load or save action is already pending.");
+		return;
+	}
+
+	StateCopy_Rewind();
+
+	GetSysExecutorThread().PostIdleEvent(SysExecEvent_ClearSavingLoadingFlag());
+}
+
 // I'd keep an eye on this function, as it may still be problematic.
 void Sstates_updateLoadBackupMenuItem(bool isBeforeSave)
 {
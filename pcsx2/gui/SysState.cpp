@@ -20,6 +20,7 @@
 #include "System/SysThreads.h"
 #include "SaveState.h"
 #include "VUmicro.h"
+#include "Rewind.h"
 
 #include "ZipTools/ThreadedZipTools.h"
 #include "Utilities/pxStreams.h"
@@ -27,6 +28,7 @@
 #include "ConsoleLogger.h"
 
 #include <wx/wfstream.h>
+#include <wx/mstream.h>
 #include <memory>
 
 #include "Patch.h"
@@ -53,6 +55,7 @@ public:
 	virtual wxString GetFilename() const=0;
 	virtual void FreezeIn( pxInputStream& reader ) const=0;
 	virtual void FreezeOut( SaveStateBase& writer ) const=0;
+	virtual uint GetFreezeSize() const=0;
 	virtual bool IsRequired() const=0;
 };
 
@@ -65,6 +68,7 @@ protected:
 public:
 	virtual void FreezeIn( pxInputStream& reader ) const;
 	virtual void FreezeOut( SaveStateBase& writer ) const;
+	virtual uint GetFreezeSize() const { return GetDataSize(); }
 	virtual bool IsRequired() const { return true; }
 
 protected:
@@ -88,6 +92,7 @@ public:
 	virtual wxString GetFilename() const;
 	virtual void FreezeIn( pxInputStream& reader ) const;
 	virtual void FreezeOut( SaveStateBase& writer ) const;
+	virtual uint GetFreezeSize() const { return GetCorePlugins().GetFreezeSize( GetPluginId() ); }
 
 	virtual bool IsRequired() const { return false; }
 
@@ -278,6 +283,24 @@ static const std::unique_ptr<BaseSavestateEntry> SavestateEntries[] = {
 //
 static Mutex mtx_CompressToDisk;
 
+// The buffer of the last saved state, kept for the next save so it doesn't have to be
+// allocated (and page faulted in) again while the VM is paused.
+static Mutex mtx_StateBuffer;
+static std::unique_ptr<VmStateBuffer> state_buffer;
+
+static VmStateBuffer* GetStateBuffer()
+{
+	ScopedLock lock( mtx_StateBuffer );
+	if (state_buffer) return state_buffer.release();
+	return new VmStateBuffer( L"Zippable Savestate" );
+}
+
+static void RecycleStateBuffer( VmStateBuffer* buffer )
+{
+	ScopedLock lock( mtx_StateBuffer );
+	state_buffer.reset( buffer );
+}
+
 static void CheckVersion( pxInputStream& thr )
 {
 	u32 savever;
@@ -333,6 +356,15 @@ protected:
 				.SetDiagMsg(L"SysExecEvent_DownloadState: Cannot freeze/download an invalid VM state!")
 				.SetUserMsg(_("There is no active virtual machine state to download or save." ));
 
+		const u64 start = GetCPUTicks();
+
+		// Size the buffer for the whole state up front, growing it while copying the
+		// large blocks would copy them again.
+		uint size = _8mb; // internal structures
+		for (uint i=0; i<ArraySize(SavestateEntries); ++i)
+			size += SavestateEntries[i]->GetFreezeSize();
+		m_dest_list->GetBuffer()->MakeRoomFor( size );
+
 		memSavingState saveme( m_dest_list->GetBuffer() );
 		ArchiveEntry internals( EntryFilename_InternalStructures );
 		internals.SetDataIndex( saveme.GetCurrentPos() );
@@ -353,6 +385,9 @@ protected:
 			);
 		}
 
+		DevCon.WriteLn( Color_Gray, "(SysState) %.1f MB downloaded in %u ms",
+			saveme.GetCurrentPos() / (double)_1mb, (u32)((GetCPUTicks() - start) * 1000 / GetTickFrequency()) );
+
 		UI_EnableStateActions();
 		paused_core.AllowResume();
 	}
@@ -386,6 +421,9 @@ protected:
 
 	void OnCleanupInThread()
 	{
+		if (m_src_list)
+			RecycleStateBuffer( m_src_list->ReleaseBuffer() );
+
 		m_lock_Compress.Release();
 		_parent::OnCleanupInThread();
 	}
@@ -430,8 +468,8 @@ protected:
 
 		wxString tempfile( m_filename + L".tmp" );
 
-		wxFFileOutputStream* woot = new wxFFileOutputStream(tempfile);
-		if (!woot->IsOk())
+		std::unique_ptr<ParallelZipWriter> out(new ParallelZipWriter(tempfile));
+		if (!out->IsOk())
 			throw Exception::CannotCreateStream(tempfile);
 
 		// Scheduler hint (yield) -- creating and saving the file is low priority compared to
@@ -441,26 +479,15 @@ protected:
 		pxYield(4);
 
 		// Write the version and screenshot:
-		std::unique_ptr<pxOutputStream> out(new pxOutputStream(tempfile, new wxZipOutputStream(woot)));
-		wxZipOutputStream* gzfp = (wxZipOutputStream*)out->GetWxStreamBase();
-
-		{
-			wxZipEntry* vent = new wxZipEntry(EntryFilename_StateVersion);
-			vent->SetMethod( wxZIP_METHOD_STORE );
-			gzfp->PutNextEntry( vent );
-			out->Write(g_SaveVersion);
-			gzfp->CloseEntry();
-		}
+		out->AddStored( EntryFilename_StateVersion, &g_SaveVersion, sizeof(g_SaveVersion) );
 
 		std::unique_ptr<wxImage> m_screenshot;
 
 		if (m_screenshot)
 		{
-			wxZipEntry* vent = new wxZipEntry(EntryFilename_Screenshot);
-			vent->SetMethod( wxZIP_METHOD_STORE );
-			gzfp->PutNextEntry( vent );
-			m_screenshot->SaveFile( *gzfp, wxBITMAP_TYPE_JPEG );
-			gzfp->CloseEntry();
+			wxMemoryOutputStream jpeg;
+			m_screenshot->SaveFile( jpeg, wxBITMAP_TYPE_JPEG );
+			out->AddStored( EntryFilename_Screenshot, jpeg.GetOutputStreamBuffer()->GetBufferStart(), jpeg.GetSize() );
 		}
 
 		(*new VmStateCompressThread())
@@ -636,6 +663,38 @@ protected:
 	}
 };
 
+// --------------------------------------------------------------------------------------
+//  SysExecEvent_Rewind
+// --------------------------------------------------------------------------------------
+// Loads the newest state of the rewind buffer, each time going one state further back.
+//
+class SysExecEvent_Rewind : public SysExecEvent
+{
+public:
+	wxString GetEventName() const { return L"VM_Rewind"; }
+
+	virtual ~SysExecEvent_Rewind() = default;
+	SysExecEvent_Rewind* Clone() const { return new SysExecEvent_Rewind( *this ); }
+
+protected:
+	void InvokeEvent()
+	{
+		ScopedCoreThreadPause paused_core;
+
+		VmStateBuffer buffer( L"StateBuffer_Rewind" );
+		if( !rewindThread.Pop( buffer ) )
+		{
+			Console.WriteLn( "Rewind: no state to go back to." );
+			paused_core.AllowResume();
+			return;
+		}
+
+		PatchesVerboseReset();
+		GetCoreThread().UploadStateCopy( buffer );
+		paused_core.AllowResume();
+	}
+};
+
 // =====================================================================================================
 //  StateCopy Public Interface
 // =====================================================================================================
@@ -644,7 +703,7 @@ void StateCopy_SaveToFile( const wxString& file )
 {
 	UI_DisableStateActions();
 
-	std::unique_ptr<ArchiveEntryList> ziplist(new ArchiveEntryList(new VmStateBuffer(L"Zippable Savestate")));
+	std::unique_ptr<ArchiveEntryList> ziplist(new ArchiveEntryList(GetStateBuffer()));
 
 	GetSysExecutorThread().PostEvent(new SysExecEvent_DownloadState(ziplist.get()));
 	GetSysExecutorThread().PostEvent(new SysExecEvent_ZipToDisk(ziplist.get(), file));
@@ -658,6 +717,11 @@ void StateCopy_LoadFromFile( const wxString& file )
 	GetSysExecutorThread().PostEvent(new SysExecEvent_UnzipFromDisk( file ));
 }
 
+void StateCopy_Rewind()
+{
+	GetSysExecutorThread().PostEvent(new SysExecEvent_Rewind());
+}
+
 // Saves recovery state info to the given saveslot, or saves the active emulation state
 // (if one exists) and no recovery data was found.  This is needed because when a recovery
 // state is made, the emulation state is usually reset so the only persisting state is
@@ -107,6 +107,7 @@ __fi tDMA_TAG* SPRdmaGetAddr(u32 addr, bool write)
 
 	if (addr < Ps2MemSize::MainRam)
 	{
+		if (write) mmap_MarkDmaWrite();
 		return (tDMA_TAG*)&eeMem->Main[addr];
 	}
 	else if (addr < 0x10000000)
@@ -170,6 +171,7 @@ __ri tDMA_TAG *dmaGetAddr(u32 addr, bool write)
 
 	if (addr < Ps2MemSize::MainRam)
 	{
+		if (write) mmap_MarkDmaWrite();
 		return (tDMA_TAG*)&eeMem->Main[addr];
 	}
 	else if (addr < 0x10000000)
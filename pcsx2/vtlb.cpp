@@ -235,6 +235,7 @@ void __fastcall vtlb_memWrite(u32 addr, DataType data)
 		}
 
 		*reinterpret_cast<DataType*>(ppf)=data;
+		mmap_MarkSubpageWrite((void*)ppf);
 	}
 	else
 	{
@@ -273,6 +274,7 @@ void __fastcall vtlb_memWrite64(u32 mem, const mem64_t* value)
 		}
 
 		*(mem64_t*)ppf = *value;
+		mmap_MarkSubpageWrite((void*)ppf);
 	}
 	else
 	{
@@ -301,6 +303,7 @@ void __fastcall vtlb_memWrite128(u32 mem, const mem128_t *value)
 		}
 
 		CopyQWC((void*)ppf, value);
+		mmap_MarkSubpageWrite((void*)ppf);
 	}
 	else
 	{
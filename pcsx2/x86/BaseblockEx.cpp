@@ -45,6 +45,30 @@ int BaseBlocks::LastIndex(u32 startpc) const
 	return imin;
 }
 
+// Drops the blocks compiled in [begin, end) and the links patched in there, so
+// that the range can be reused. Links to the dropped blocks go back to the
+// recompiler.
+int BaseBlocks::RemoveCode(uptr begin, uptr end)
+{
+	for (linkiter_t i = links.begin(); i != links.end(); ) {
+		if (i->second >= begin && i->second < end)
+			i = links.erase(i);
+		else
+			++i;
+	}
+
+	for (u32 idx = 0; idx < blocks.size(); idx++) {
+		if (blocks[idx].fnptr < begin || blocks[idx].fnptr >= end)
+			continue;
+
+		std::pair<linkiter_t, linkiter_t> range = links.equal_range(blocks[idx].startpc);
+		for (linkiter_t i = range.first; i != range.second; ++i)
+			*(u32*)i->second = recompiler - (i->second + 4);
+	}
+
+	return blocks.erase_code(begin, end);
+}
+
 #if 0
 BASEBLOCKEX* BaseBlocks::GetByX86(uptr ip)
 {
@@ -128,6 +128,24 @@ public:
 		return _Size;
 	}
 
+	// Removes the blocks whose code starts in [begin, end), returns how many
+	s32 erase_code(uptr begin, uptr end)
+	{
+		s32 kept = 0;
+
+		for (s32 i = 0; i < _Size; i++) {
+			if (blocks[i].fnptr >= begin && blocks[i].fnptr < end)
+				continue;
+			if (kept != i)
+				blocks[kept] = blocks[i];
+			kept++;
+		}
+
+		s32 removed = _Size - kept;
+		_Size = kept;
+		return removed;
+	}
+
 	__fi void erase(s32 first, s32 last)
 	{
 		int range = last - first;
@@ -220,6 +238,7 @@ public:
 	}
 
 	void Link(u32 pc, s32* jumpptr);
+	int RemoveCode(uptr begin, uptr end);
 
 	__fi void Reset()
 	{
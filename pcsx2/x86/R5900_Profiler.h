@@ -226,6 +226,7 @@ static const char eeOpcodeName[][16] = {
 #ifdef eeProfileProg
 #include <utility>
 #include <algorithm>
+#include <map>
 
 using namespace x86Emitter;
 
@@ -238,6 +239,7 @@ struct eeProfiler {
 	u64 memStatsSlow;
 	u64 memStatsFast;
 	u32 memMask;
+	std::map<u32, u64> blockStats; // entries of each block (HW start pc)
 
 	void Reset() {
 		memzero(opStats);
@@ -246,9 +248,16 @@ struct eeProfiler {
 		memStatsSlow = 0;
 		memStatsFast = 0;
 		memMask = 0xF700FFF0;
+		blockStats.clear();
 		pxAssert(eeOpcodeName[static_cast<int>(eeOpcode::LAST)][0] == '!');
 	}
 
+	void EmitBlock(u32 startpc) {
+		u64& count = blockStats[startpc];
+		xADD(ptr32[(u32*)&count], 1);
+		xADC(ptr32[(u32*)&count + 1], 0);
+	}
+
 	void EmitOp(eeOpcode opcode) {
 		int op = static_cast<int>(opcode);
 		xADD(ptr32[&(((u32*)opStats)[op*2+0])], 1);
@@ -363,6 +372,24 @@ struct eeProfiler {
 				break;
 		}
 
+		// Compute block stat
+		u64 total_blocks = 0;
+		std::vector< std::pair<u64, u32> > vb;
+		for (const auto& b : blockStats) {
+			total_blocks += b.second;
+			vb.push_back(std::make_pair(b.second, b.first));
+		}
+		std::sort   (vb.begin(), vb.end());
+		std::reverse(vb.begin(), vb.end());
+
+		DevCon.WriteLn("\nEE Block Profiler:");
+		for(u32 i = 0; i < vb.size(); i++) {
+			double stat  = per(vb[i].first, total_blocks);
+			DevCon.WriteLn("%08x - [%3.4f%%][count=%u]",
+					vb[i].second, stat, (u32)vb[i].first);
+			if (stat < 0.1)
+				break;
+		}
 	}
 
 	// Warning dirty ebx
@@ -395,6 +422,7 @@ struct eeProfiler {
 #else
 struct eeProfiler {
 	__fi void Reset() {}
+	__fi void EmitBlock(u32 startpc) {}
 	__fi void EmitOp(eeOpcode op) {}
 	__fi void Print() {}
 	__fi void EmitMem() {}
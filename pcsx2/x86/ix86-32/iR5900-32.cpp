@@ -43,6 +43,7 @@
 #include "Utilities/MemsetFast.inl"
 #include "Utilities/Perf.h"
 
+#include <unordered_set>
 
 using namespace x86Emitter;
 using namespace R5900;
@@ -71,6 +72,7 @@ eeProfiler EE::Profiler;
 
 #define X86
 static const int RECCONSTBUF_SIZE = 16384 * 2; // 64 bit consts in 32 bit units
+static const int RECHOTCOUNTERS_SIZE = 0x100000; // one per counted block (EnableEETiering)
 
 static RecompiledCodeReserve* recMem = NULL;
 static u8* recRAMCopy = NULL;
@@ -87,15 +89,40 @@ static BASEBLOCK *recROM1 = NULL;		// also here
 static BaseBlocks recBlocks;
 static u8* recPtr = NULL;
 static u32 *recConstBufPtr = NULL;
+static u32* recHotCounters = NULL;
+static u32* recHotCounterPtr = NULL;
 EEINST* s_pInstCache = NULL;
 static u32 s_nInstCacheSize = 0;
 
+// The code cache is split in regions. When the current one is full, the one that
+// ran least recently is evicted: its blocks are removed and the links into it
+// unpatched, the rest of the cache stays compiled. The constant
+// buffer and the hot block counters are split the same way, so a block and its
+// constants share a region.
+static const int EE_CODE_REGIONS = 8;
+static int s_nCodeRegions = 1;
+static int s_nCodeRegion = 0;
+static u32 s_nCodeResets = 0;
+static u32 s_nCodeEvictions = 0;
+static u64 s_nRegionClock = 0;
+static u64 s_nRegionStamp[EE_CODE_REGIONS];	// s_nRegionClock when the region last ran, 0 = empty
+
 static BASEBLOCK* s_pCurBlock = NULL;
 static BASEBLOCKEX* s_pCurBlockEx = NULL;
 u32 s_nEndBlock = 0; // what pc the current block ends
 u32 s_branchTo;
 static bool s_nBlockFF;
 
+// Hot block tiering (EnableEETiering). Blocks count their executions down
+// from EE_HOT_BLOCK_THRESHOLD; the block reaching 0 is cleared and compiled
+// again as a trace that runs through the blocks that follow it (up to the
+// next branch or page boundary), so constants and x86 registers stay live
+// across what used to be block boundaries.
+static const u32 EE_HOT_BLOCK_THRESHOLD = 2000;
+static std::unordered_set<u32> s_hotBlocks;	// HW start pc of the blocks compiled as traces
+static bool s_nBlockHot;
+static bool s_nBlockJoinable;	// the scan stopped at a compiled block, a trace would be longer
+
 // save states for branches
 GPR_reg64 s_saveConstRegs[32];
 static u32 s_saveHasConstReg = 0, s_saveFlushedConstReg = 0;
@@ -258,13 +285,20 @@ u32* recGetImm64(u32 hi, u32 lo)
 	static u32 *imm64_cache[509];
 	int cacheidx = lo % (sizeof imm64_cache / sizeof *imm64_cache);
 
+	// Only reuse constants of the current region, the others can be evicted first
+	u32* regionConstBuf = recConstBuf + (RECCONSTBUF_SIZE / s_nCodeRegions) * s_nCodeRegion;
+
 	imm64 = imm64_cache[cacheidx];
-	if (imm64 && imm64[0] == lo && imm64[1] == hi)
+	if (imm64 && imm64 >= regionConstBuf && imm64 < recConstBufPtr && imm64[0] == lo && imm64[1] == hi)
 		return imm64;
 
-	if (recConstBufPtr >= recConstBuf + RECCONSTBUF_SIZE)
+	if (recConstBufPtr >= regionConstBuf + RECCONSTBUF_SIZE / s_nCodeRegions)
 	{
 		Console.WriteLn( "EErec const buffer filled; Resetting..." );
+
+		// Drop the block being compiled, or compiling its pc again would add a second
+		// entry for it. The links it patched point into code that will be reused.
+		recBlocks.RemoveCode(s_pCurBlockEx->fnptr, (uptr)xGetPtr() + 1);
 		throw Exception::ExitCpuExecute();
 
 		/*for (u32 *p = recConstBuf; p < recConstBuf + RECCONSTBUF_SIZE; p += 2)
@@ -317,6 +351,7 @@ void recCall( void (*func)() )
 static void __fastcall recRecompile( const u32 startpc );
 static void __fastcall dyna_block_discard(u32 start,u32 sz);
 static void __fastcall dyna_page_reset(u32 start,u32 sz);
+static void __fastcall dyna_block_promote(u32 start,u32 sz);
 
 // Recompiled code buffer for EE recompiler dispatchers!
 static u8 __pagealigned eeRecDispatchers[__pagesize];
@@ -331,10 +366,14 @@ static DynGenFunc* EnterRecompiledCode	= NULL;
 static DynGenFunc* ExitRecompiledCode	= NULL;
 static DynGenFunc* DispatchBlockDiscard = NULL;
 static DynGenFunc* DispatchPageReset    = NULL;
+static DynGenFunc* DispatchBlockPromote = NULL;
+
+static void recMarkRegionUsed();
 
 static void recEventTest()
 {
 	_cpuEventTest_Shared();
+	recMarkRegionUsed();
 }
 
 // The address for all cleared blocks.  It recompiles the current pc and then
@@ -426,6 +465,16 @@ static DynGenFunc* _DynGen_DispatchPageReset()
 	return (DynGenFunc*)retval;
 }
 
+// The block is already cleared when JITCompile runs, so it recompiles cpuRegs.pc
+// (the start of the promoted block) and jumps to the trace.
+static DynGenFunc* _DynGen_DispatchBlockPromote()
+{
+	u8* retval = xGetPtr();
+	xFastCall((void*)dyna_block_promote);
+	xJMP((void*)JITCompile);
+	return (DynGenFunc*)retval;
+}
+
 static void _DynGen_Dispatchers()
 {
 	// In case init gets called multiple times:
@@ -446,6 +495,7 @@ static void _DynGen_Dispatchers()
 	EnterRecompiledCode  = _DynGen_EnterRecompiledCode();
 	DispatchBlockDiscard = _DynGen_DispatchBlockDiscard();
 	DispatchPageReset    = _DynGen_DispatchPageReset();
+	DispatchBlockPromote = _DynGen_DispatchBlockPromote();
 
 	HostSys::MemProtectStatic( eeRecDispatchers, PageAccess_ExecOnly() );
 
@@ -551,6 +601,12 @@ static void recAlloc()
 	if( recConstBuf == NULL )
 		throw Exception::OutOfMemory( L"R5900-32 SIMD Constants Buffer" );
 
+	if( recHotCounters == NULL )
+		recHotCounters = (u32*) _aligned_malloc( RECHOTCOUNTERS_SIZE * sizeof(*recHotCounters), 64 );
+
+	if( recHotCounters == NULL )
+		throw Exception::OutOfMemory( L"R5900-32 Hot Block Counters" );
+
 	if( s_pInstCache == NULL )
 	{
 		s_nInstCacheSize = 128;
@@ -568,6 +624,10 @@ static void recAlloc()
 static __aligned16 u16 manual_page[Ps2MemSize::MainRam >> 12];
 static __aligned16 u8 manual_counter[Ps2MemSize::MainRam >> 12];
 
+// Manual block statistics, logged on reset
+static u32 manual_compares = 0;	// code compares done by the blocks (subpage tracking only)
+static u32 manual_discards = 0;
+
 static std::atomic<bool> eeRecIsReset(false);
 static std::atomic<bool> eeRecNeedsReset(false);
 static bool eeCpuExecuting = false;
@@ -602,16 +662,99 @@ static void recResetRaw()
 	recBlocks.Reset();
 	mmap_ResetBlockTracking();
 
+	s_nCodeRegions = (recMem->GetReserveSizeInBytes() >= EE_CODE_REGIONS * _1mb) ? EE_CODE_REGIONS : 1;
+	s_nCodeRegion = 0;
+	s_nCodeResets++;
+	memset(s_nRegionStamp, 0, sizeof(s_nRegionStamp));
+	s_nRegionStamp[0] = ++s_nRegionClock;
+
+	if (manual_compares || manual_discards)
+		DevCon.WriteLn(Color_Gray, "EE/iR5900-32: manual blocks: %u code compares, %u discarded", manual_compares, manual_discards);
+	manual_compares = manual_discards = 0;
+
+	if (!s_hotBlocks.empty())
+		DevCon.WriteLn(Color_Gray, "EE/iR5900-32: %u hot blocks recompiled as traces", (u32)s_hotBlocks.size());
+	s_hotBlocks.clear();
+
 	x86SetPtr(*recMem);
 
 	recPtr = *recMem;
 	recConstBufPtr = recConstBuf;
+	recHotCounterPtr = recHotCounters;
 
 	g_branch = 0;
 	g_resetEeScalingStats = true;
 	g_patchesNeedRedo = 1;
 }
 
+static u8* recRegionPtr(int region)
+{
+	return recMem->GetPtr() + (recMem->GetReserveSizeInBytes() / s_nCodeRegions) * region;
+}
+
+static u32* recRegionConstBuf(int region)
+{
+	return recConstBuf + (RECCONSTBUF_SIZE / s_nCodeRegions) * region;
+}
+
+static u32* recRegionHotCounters(int region)
+{
+	return recHotCounters + (RECHOTCOUNTERS_SIZE / s_nCodeRegions) * region;
+}
+
+// Called on the way back from the event tests to the dispatcher: stamps the region
+// of the block it's about to enter. Sampling the dispatches this way is enough to
+// tell the regions a game keeps running from the ones it left behind.
+static void recMarkRegionUsed()
+{
+	if (s_nCodeRegions == 1)
+		return;
+
+	const uptr fnptr = PC_GETBLOCK(cpuRegs.pc)->GetFnptr();
+	const uptr base = (uptr)recMem->GetPtr();
+	const uptr regionSize = recMem->GetReserveSizeInBytes() / s_nCodeRegions;
+	if (fnptr >= base && fnptr < base + regionSize * s_nCodeRegions)
+		s_nRegionStamp[(fnptr - base) / regionSize] = ++s_nRegionClock;
+}
+
+static void recEvictNextRegion()
+{
+	// Least recently used, empty regions first
+	int victim = -1;
+	for (int region = 0; region < s_nCodeRegions; region++) {
+		if (region != s_nCodeRegion && (victim < 0 || s_nRegionStamp[region] < s_nRegionStamp[victim]))
+			victim = region;
+	}
+
+	s_nCodeRegion = victim;
+	s_nRegionStamp[s_nCodeRegion] = ++s_nRegionClock;
+
+	const uptr begin = (uptr)recRegionPtr(s_nCodeRegion);
+	const uptr end   = (uptr)recRegionPtr(s_nCodeRegion + 1);
+
+	// Blocks compiled again elsewhere since (overlapping ones) keep their entry
+	BASEBLOCKEX* pexblock;
+	for (int i = 0; pexblock = recBlocks[i]; i++) {
+		if (pexblock->fnptr < begin || pexblock->fnptr >= end)
+			continue;
+
+		BASEBLOCK* pblock = PC_GETBLOCK(pexblock->startpc);
+		if (pblock->GetFnptr() == pexblock->fnptr)
+			pblock->SetFnptr((uptr)JITCompile);
+	}
+
+	int removed = recBlocks.RemoveCode(begin, end);
+	if (removed) {
+		s_nCodeEvictions++;
+		DevCon.WriteLn(Color_Gray, "EE/iR5900-32: evicted code region %d (%d blocks) [evictions=%u, resets=%u]",
+			s_nCodeRegion, removed, s_nCodeEvictions, s_nCodeResets);
+	}
+
+	recPtr = (u8*)begin;
+	recConstBufPtr = recRegionConstBuf(s_nCodeRegion);
+	recHotCounterPtr = recRegionHotCounters(s_nCodeRegion);
+}
+
 static void recShutdown()
 {
 	safe_delete( recMem );
@@ -623,6 +766,7 @@ static void recShutdown()
 	recRAM = recROM = recROM1 = NULL;
 
 	safe_aligned_free( recConstBuf );
+	safe_aligned_free( recHotCounters );
 	safe_free( s_pInstCache );
 	s_nInstCacheSize = 0;
 
@@ -834,6 +978,33 @@ void recClear(u32 addr, u32 size)
 		ClearRecLUT(PC_GETBLOCK(lowerextent), upperextent - lowerextent);
 }
 
+// Removes the blocks starting in [begin, end) (HW addresses). Unlike recClear, the
+// blocks starting before begin stay, even when they run into the range.
+static void recClearBlocksStarting(u32 begin, u32 end)
+{
+	int last = recBlocks.LastIndex(end - 4);
+	BASEBLOCKEX* pexblock = recBlocks[last];
+	if (!pexblock || pexblock->startpc >= end)
+		return;
+
+	int first = last;
+	while ((pexblock = recBlocks[first]) && pexblock->startpc >= begin)
+		first--;
+	if (++first > last)
+		return;
+
+	// Don't reset the entries of the blocks that follow, if the last one overlaps them
+	u32 ceiling = (pexblock = recBlocks[last + 1]) ? pexblock->startpc : (u32)-1;
+
+	for (int i = first; i <= last; i++) {
+		pexblock = recBlocks[i];
+		u32 blockend = std::min(pexblock->startpc + pexblock->size * 4, ceiling);
+		ClearRecLUT(PC_GETBLOCK(pexblock->startpc), blockend - pexblock->startpc);
+	}
+
+	recBlocks.Remove(first, last);
+}
+
 
 static int *s_pCode;
 
@@ -1479,6 +1650,7 @@ static u32 s_recblocks[] = {0};
 void __fastcall dyna_block_discard(u32 start,u32 sz)
 {
 	eeRecPerfLog.Write( Color_StrongGray, "Clearing Manual Block @ 0x%08X  [size=%d]", start, sz*4);
+	manual_discards++;
 	recClear(start, sz);
 }
 
@@ -1492,6 +1664,33 @@ void __fastcall dyna_page_reset(u32 start,u32 sz)
 	mmap_MarkCountedRamPage( start );
 }
 
+// Called when a counted block has run EE_HOT_BLOCK_THRESHOLD times. The block is
+// cleared (its callers are unlinked and go through JITCompile again) and its next
+// compilation is a trace.
+void __fastcall dyna_block_promote(u32 start,u32 sz)
+{
+	eeRecPerfLog.Write( Color_StrongGray, "Hot block @ 0x%08X  [size=%d]", start, sz*4);
+	s_hotBlocks.insert(start);
+	recClearBlocksStarting(start, start + 4);
+}
+
+// Compares the code of the block with its current memory, the block is discarded when
+// it changed. Expects ecx/edx to be set for dyna_block_discard.
+static void memory_compare_recompiled_code(u32 inpage_ptr, u32 inpage_sz)
+{
+	u32 lpc = inpage_ptr;
+	u32 stg = inpage_sz;
+
+	while(stg>0)
+	{
+		xCMP( ptr32[PSM(lpc)], *(u32*)PSM(lpc) );
+		xJNE(DispatchBlockDiscard);
+
+		stg -= 4;
+		lpc += 4;
+	}
+}
+
 static void memory_protect_recompiled_code(u32 startpc, u32 size)
 {
 	u32 inpage_ptr = HWADDR(startpc);
@@ -1520,17 +1719,31 @@ static void memory_protect_recompiled_code(u32 startpc, u32 size)
 			xMOV( edx, inpage_sz / 4 );
 			//xMOV( eax, startpc );		// uncomment this to access startpc (as eax) in dyna_block_discard
 
-			u32 lpc = inpage_ptr;
-			u32 stg = inpage_sz;
-
-			while(stg>0)
+			if (mmap_SubpageTracking)
 			{
-				xCMP( ptr32[PSM(lpc)], *(u32*)PSM(lpc) );
-				xJNE(DispatchBlockDiscard);
+				// The code is only compared when its subpages were written (or a DMA wrote
+				// to RAM) since the last compare: the sum of their write counters moved.
+				u32* checked = recConstBufPtr;
+				recConstBufPtr += 2;
+				*checked = mmap_DmaWrites;
+
+				xMOV( eax, ptr[&mmap_DmaWrites] );
+				for (u32 s = inpage_ptr >> mmap_SubpageBits; s <= (inpage_ptr + inpage_sz - 1) >> mmap_SubpageBits; s++)
+				{
+					*checked += mmap_SubpageWrites[s];
+					xADD( eax, ptr[&mmap_SubpageWrites[s]] );
+				}
+				xCMP( eax, ptr[checked] );
+				xForwardJE32 skipCompare;
+
+				xADD( ptr32[&manual_compares], 1 );
+				memory_compare_recompiled_code(inpage_ptr, inpage_sz);
+				xMOV( ptr[checked], eax );
 
-				stg -= 4;
-				lpc += 4;
+				skipCompare.SetTarget();
 			}
+			else
+				memory_compare_recompiled_code(inpage_ptr, inpage_sz);
 
 			// Tweakpoint!  3 is a 'magic' number representing the number of times a counted block
 			// is re-protected before the recompiler gives up and sets it up as an uncounted (permanent)
@@ -1621,13 +1834,21 @@ static void __fastcall recRecompile( const u32 startpc )
 
 	pxAssert( startpc );
 
-	// if recPtr reached the mem limit reset whole mem
-	if (recPtr >= (recMem->GetPtrEnd() - _64kb)) {
-		eeRecNeedsReset = true;
-	}
-	else if ((recConstBufPtr - recConstBuf) >= RECCONSTBUF_SIZE - 64) {
-		Console.WriteLn("EE recompiler stack reset");
-		eeRecNeedsReset = true;
+	// if recPtr reached the end of the region evict the next one, or reset
+	// whole mem when the cache isn't split
+	if (!eeRecNeedsReset) {
+		bool codeFull  = recPtr >= (recRegionPtr(s_nCodeRegion + 1) - _64kb);
+		bool constFull = recConstBufPtr >= recRegionConstBuf(s_nCodeRegion + 1) - 64;
+		bool countersFull = recHotCounterPtr >= recRegionHotCounters(s_nCodeRegion + 1);
+
+		if (codeFull || constFull || countersFull) {
+			if (s_nCodeRegions > 1)
+				recEvictNextRegion();
+			else {
+				if (!codeFull) Console.WriteLn("EE recompiler stack reset");
+				eeRecNeedsReset = true;
+			}
+		}
 	}
 
 	if (eeRecNeedsReset) recResetRaw();
@@ -1650,6 +1871,9 @@ static void __fastcall recRecompile( const u32 startpc )
 
 	pxAssert(s_pCurBlockEx);
 
+	s_nBlockHot = s_hotBlocks.count(HWADDR(startpc)) != 0;
+	s_nBlockJoinable = false;
+
 	if (HWADDR(startpc) == EELOAD_START)
 	{
 		// The EELOAD _start function is the same across all BIOS versions
@@ -1768,10 +1992,12 @@ static void __fastcall recRecompile( const u32 startpc )
 				break;
 			}
 
-			if (pblock->GetFnptr() != (uptr)JITCompile && pblock->GetFnptr() != (uptr)JITCompileInBlock)
+			// Traces run through the blocks that follow
+			if (!s_nBlockHot && pblock->GetFnptr() != (uptr)JITCompile && pblock->GetFnptr() != (uptr)JITCompileInBlock)
 			{
 				willbranch3 = 1;
 				s_nEndBlock = i;
+				s_nBlockJoinable = true;
 				break;
 			}
 		}
@@ -2012,9 +2238,31 @@ StartRecomp:
 	if (dumplog & 1) iDumpBlock(startpc, recPtr);
 #endif
 
+	if (s_nBlockHot) {
+		// The blocks the trace absorbed are entered through JITCompileInBlock from now on.
+		// Blocks starting before it stay, even if they run into it.
+		recClearBlocksStarting(HWADDR(startpc) + 4, HWADDR(s_nEndBlock));
+		s_pCurBlockEx = recBlocks.Get(HWADDR(startpc));
+		pxAssert(s_pCurBlockEx->startpc == HWADDR(startpc));
+	}
+
 	// Detect and handle self-modified code
 	memory_protect_recompiled_code(startpc, (s_nEndBlock-startpc) >> 2);
 
+	EE::Profiler.EmitBlock(HWADDR(startpc));
+
+	// Only blocks cut short by an already compiled one are counted, the trace of a
+	// block that ends on a branch or a page boundary would be the same block.
+	if (EmuConfig.Cpu.Recompiler.EnableEETiering && !s_nBlockHot && s_nBlockJoinable && HWADDR(startpc) < Ps2MemSize::MainRam) {
+		u32* counter = recHotCounterPtr++;
+		*counter = EE_HOT_BLOCK_THRESHOLD;
+
+		xSUB(ptr32[counter], 1);
+		xMOV(ecx, HWADDR(startpc)); // mov leaves the flags alone
+		xMOV(edx, (s_nEndBlock - startpc) / 4);
+		xJZ(DispatchBlockPromote);
+	}
+
 	// Skip Recompilation if sceMpegIsEnd Pattern detected
 	bool doRecompilation = !skipMPEG_By_Pattern(startpc);
 
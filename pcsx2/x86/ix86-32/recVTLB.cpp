@@ -222,6 +222,15 @@ namespace vtlb_private
 				iMOV128_SSE( ptr[ecx], ptr[edx] );
 			break;
 		}
+
+		if (mmap_SubpageTracking)
+		{
+			xMOV( eax, ecx );
+			xSUB( eax, (uptr)eeMem->Main );
+			xSHR( eax, mmap_SubpageBits );
+			xAND( eax, mmap_SubpageCount - 1 );
+			xADD( ptr32[(eax*4) + mmap_SubpageWrites], 1 );
+		}
 	}
 }
 
@@ -541,6 +550,8 @@ void vtlb_DynGenWrite_Const( u32 bits, u32 addr_const )
 			break;
 		}
 
+		if (mmap_SubpageTracking)
+			xADD( ptr32[&mmap_SubpageWrites[((ppf - (uptr)eeMem->Main) >> mmap_SubpageBits) & (mmap_SubpageCount - 1)]], 1 );
 	}
 	else
 	{
@@ -17,9 +17,15 @@
 
 #include "PrecompiledHeader.h"
 #include "microVU.h"
+#include "Elfheader.h"
+#include "AppConfig.h"
 
 #include "Utilities/Perf.h"
 
+#include <algorithm>
+#include <map>
+#include <set>
+
 //------------------------------------------------------------------
 // Micro VU - Main Functions
 //------------------------------------------------------------------
@@ -76,6 +82,7 @@ void mVUreset(microVU& mVU, bool resetReserve) {
 
 	// Restore reserve to uncommitted state
 	if (resetReserve) mVU.cache_reserve->Reset();
+	if (resetReserve) mVUprogCacheFlush(mVU);
 
 	HostSys::MemProtect(mVU.dispCache, mVUdispCacheSize, PageAccess_ReadWrite());
 	memset(mVU.dispCache, 0xcc, mVUdispCacheSize);
@@ -89,6 +96,15 @@ void mVUreset(microVU& mVU, bool resetReserve) {
 	//memset(&mVU.prog, 0, sizeof(mVU.prog));
 	memset(&mVU.prog.lpState, 0, sizeof(mVU.prog.lpState));
 	mVU.profiler.Reset(mVU.index);
+	mVUhashReset(mVU);
+
+	microProgStats& stats = mVU.prog.stats;
+	if (stats.searches) {
+		DevCon.WriteLn(Color_Gray, "microVU%d: %u program searches, %u hits [%3.1f%%], %3.1f programs looked at and %3.1f compared per search",
+			mVU.index, stats.searches, stats.hits, 100. * stats.hits / stats.searches,
+			(double)stats.probes / stats.searches, (double)stats.compares / stats.searches);
+	}
+	memzero(stats);
 
 	// Program Variables
 	mVU.prog.cleared	=  1;
@@ -127,6 +143,7 @@ void mVUreset(microVU& mVU, bool resetReserve) {
 // Free Allocated Resources
 void mVUclose(microVU& mVU) {
 
+	mVUprogCacheFlush(mVU);
 	safe_delete  (mVU.cache_reserve);
 
 	// Delete Programs and Block Managers
@@ -142,6 +159,7 @@ void mVUclose(microVU& mVU) {
 
 // Clears Block Data in specified range
 __fi void mVUclear(mV, u32 addr, u32 size) {
+	mVUhashDirty(mVU, addr, size);
 	if(!mVU.prog.cleared) {
 		mVU.prog.cleared = 1;		// Next execution searches/creates a new microprogram
 		memzero(mVU.prog.lpState); // Clear pipeline state
@@ -191,9 +209,107 @@ __ri microProgram* mVUcreateProg(microVU& mVU, int startPC) {
 __ri void mVUcacheProg(microVU& mVU, microProgram& prog) {
 	if (!mVU.index)	memcpy(prog.data, mVU.regs().Micro, 0x1000);
 	else			memcpy(prog.data, mVU.regs().Micro, 0x4000);
+	prog.hashValid = false;
 	mVUdumpProg(mVU, prog);
 }
 
+// Multiplier for the instruction at index i (odd, so no bit of the instruction is lost)
+static __fi u64 mVUhashWeight(u32 i) {
+	u64 z = (i + 1) * 0x9e3779b97f4a7c15ull;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (z ^ (z >> 31)) | 1;
+}
+
+// Hash of the micro memory the tree was built from, over instructions [start, end)
+static __fi u64 mVUhashSum(microMemHash& hash, u32 start, u32 end) {
+	u64 sum = 0;
+	for (u32 i = end;   i > 0; i -= i & (0 - i)) sum += hash.tree[i];
+	for (u32 i = start; i > 0; i -= i & (0 - i)) sum -= hash.tree[i];
+	return sum;
+}
+
+// Micro memory is all zero to the tree, and all dirty
+void mVUhashReset(microVU& mVU) {
+	microMemHash& hash = mVU.prog.hash;
+	memzero(hash.tree);
+	memzero(hash.data);
+	memset8<0xff>(hash.dirty);
+}
+
+// Marks micro memory in [addr, addr + size) (bytes) for rehashing
+void mVUhashDirty(microVU& mVU, u32 addr, u32 size) {
+	microMemHash& hash = mVU.prog.hash;
+	const u32 lines = mVU.microMemSize / 64;
+	if (!size) return;
+	if (size >= mVU.microMemSize) {
+		memset8<0xff>(hash.dirty);
+		return;
+	}
+	u32 line = (addr & (mVU.microMemSize - 1)) / 64;
+	u32 last = ((addr + size - 1) & (mVU.microMemSize - 1)) / 64;
+	for (;;) {
+		hash.dirty[line / 64] |= 1ull << (line % 64);
+		if (line == last) break;
+		line = (line + 1) % lines;
+	}
+}
+
+// Brings the tree up to date with the dirty lines of micro memory
+static void mVUhashUpdate(microVU& mVU) {
+	microMemHash& hash = mVU.prog.hash;
+	const u64* micro = (u64*)mVU.regs().Micro;
+	const u32  count = mVU.microMemSize / 8;
+
+	for (u32 line = 0; line < count / 8; line++) {
+		u64& dirty = hash.dirty[line / 64];
+		if (!dirty) { line |= 63; continue; }
+		if (!(dirty & (1ull << (line % 64)))) continue;
+		dirty &= ~(1ull << (line % 64));
+
+		for (u32 n = line * 8; n < line * 8 + 8; n++) {
+			if (micro[n] == hash.data[n]) continue;
+			const u64 delta = (micro[n] - hash.data[n]) * mVUhashWeight(n);
+			hash.data[n] = micro[n];
+			for (u32 i = n + 1; i <= count; i += i & (0 - i))
+				hash.tree[i] += delta;
+		}
+	}
+}
+
+// Instructions covered by a range, as compared by mVUcmpPartial
+static __fi bool mVUhashRangeBounds(microVU& mVU, const microRange& range, u32& start, u32& end) {
+	if (range.start < 0 || range.end + 8 <= range.start) return false;
+	start = range.start / 8;
+	end   = std::min<u32>(range.end + 8, mVU.microMemSize) / 8;
+	return start < end;
+}
+
+// False if the program's compiled ranges can't match micro memory.  Equal ranges always
+// hash the same, so this never rejects a program mVUcmpPartial would accept.
+static bool mVUhashCheck(microVU& mVU, microProgram& prog) {
+	std::deque<microRange>::const_iterator it(prog.ranges->begin());
+	u32 start, end;
+
+	if (!prog.hashValid) {
+		const u64* data = (u64*)prog.data;
+		prog.rangesHash = 0;
+		for (it = prog.ranges->begin(); it != prog.ranges->end(); ++it) {
+			if (!mVUhashRangeBounds(mVU, it[0], start, end)) continue;
+			for (u32 i = start; i < end; i++)
+				prog.rangesHash += data[i] * mVUhashWeight(i);
+		}
+		prog.hashValid = true;
+	}
+
+	u64 hash = 0;
+	for (it = prog.ranges->begin(); it != prog.ranges->end(); ++it) {
+		if (mVUhashRangeBounds(mVU, it[0], start, end))
+			hash += mVUhashSum(mVU.prog.hash, start, end);
+	}
+	return hash == prog.rangesHash;
+}
+
 // Generate Hash for partial program based on compiled ranges...
 u64 mVUrangesHash(microVU& mVU, microProgram& prog) {
 	union {
@@ -254,15 +370,219 @@ __fi bool mVUcmpProg(microVU& mVU, microProgram& prog, const bool cmpWholeProg)
 	return false;
 }
 
+//------------------------------------------------------------------
+// Micro VU - Program Cache
+//------------------------------------------------------------------
+// With EnableVUCache, the programs compiled for a game are saved to <cache>/<crc>.vu0
+// (and .vu1), and the first search after the game boots compiles all of them in one go
+// instead of when each scene first runs them.  The generated code refers to the VU state
+// and to other blocks by address, so it can't be reused by another session; what's kept
+// is what the code was compiled from, the micro memory (stored once for all the programs
+// sharing it), the startPC and the pipeline state.
+
+static const u32 mVUcacheMagic   = 0x4355564d; // MVUC
+static const u32 mVUcacheVersion = 1;
+
+struct microCacheKey {
+	u32 blob;							// Micro memory the program was compiled from
+	u32 startPC;
+	u8  pState[sizeof(microRegInfo)];	// Pipeline state at startPC
+
+	// By blob, then startPC, then pipeline state (a memcmp of the whole key would
+	// compare the little endian bytes of blob and startPC, not their values)
+	bool operator<(const microCacheKey& right) const {
+		if (blob != right.blob) return blob < right.blob;
+		if (startPC != right.startPC) return startPC < right.startPC;
+		return memcmp(pState, right.pState, sizeof(pState)) < 0;
+	}
+};
+
+struct microProgCache {
+	u32  crc;		// game the programs belong to, 0 when not caching
+	bool dirty;
+	std::set<microCacheKey> keys;
+	std::vector<u8>         blobs;		// micro memory images, microMemSize bytes each
+	std::multimap<u64, u32> blobIndex;	// digest -> blob
+
+	u32  preloaded;
+	u32  misses;	// programs compiled on demand
+};
+
+static microProgCache mVUprogCache[2];
+
+static wxString mVUprogCacheFilename(microVU& mVU, u32 crc) {
+	return Path::Combine(GetCacheFolder(), wxFileName(pxsFmt(L"%08X.vu%d", crc, mVU.index).c_str()));
+}
+
+static u64 mVUprogCacheDigest(const u8* data, u32 size) {
+	const u64* p = (const u64*)data;
+	u64 digest = 0xcbf29ce484222325ull;
+	for (u32 i = 0; i < size / 8; i++)
+		digest = (digest ^ p[i]) * 0x100000001b3ull;
+	return digest;
+}
+
+// Returns the index of the blob holding data, adding it if needed
+static u32 mVUprogCacheBlob(microVU& mVU, microProgCache& c, const u8* data) {
+	const u64 digest = mVUprogCacheDigest(data, mVU.microMemSize);
+	auto range = c.blobIndex.equal_range(digest);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (!memcmp(&c.blobs[(size_t)it->second * mVU.microMemSize], data, mVU.microMemSize))
+			return it->second;
+	}
+	const u32 blob = (u32)(c.blobs.size() / mVU.microMemSize);
+	c.blobs.insert(c.blobs.end(), data, data + mVU.microMemSize);
+	c.blobIndex.insert(std::make_pair(digest, blob));
+	return blob;
+}
+
+void mVUprogCacheFlush(microVU& mVU) {
+	microProgCache& c = mVUprogCache[mVU.index];
+
+	if (!c.crc) return;
+
+	Console.WriteLn(Color_Gray, "microVU%d: program cache %08X: %u preloaded, %u misses",
+		mVU.index, c.crc, c.preloaded, c.misses);
+
+	if (c.dirty) {
+		GetCacheFolder().Mkdir();
+
+		wxString filename(mVUprogCacheFilename(mVU, c.crc));
+		wxFFile fp(filename, L"wb");
+
+		std::vector<microCacheKey> keys(c.keys.begin(), c.keys.end());
+		const u32 header[5] = { mVUcacheMagic, mVUcacheVersion, sizeof(microCacheKey),
+								(u32)(c.blobs.size() / mVU.microMemSize), (u32)keys.size() };
+
+		if (!fp.IsOpened()
+			|| fp.Write(header, sizeof(header)) != sizeof(header)
+			|| fp.Write(c.blobs.data(), c.blobs.size()) != c.blobs.size()
+			|| fp.Write(keys.data(), keys.size() * sizeof(microCacheKey)) != keys.size() * sizeof(microCacheKey))
+			Console.Warning(L"microVU%d: unable to write the program cache '%s'", mVU.index, WX_STR(filename));
+	}
+
+	c.crc   = 0;
+	c.dirty = false;
+	c.keys.clear();
+	c.blobs.clear();
+	c.blobIndex.clear();
+}
+
+// Compiles the programs saved for the running game, as if each had been searched for
+// with its micro memory loaded
+static void mVUprogCacheLoad(microVU& mVU) {
+	microProgCache& c = mVUprogCache[mVU.index];
+
+	mVUprogCacheFlush(mVU); // previous game
+
+	c.crc       = ElfCRC;
+	c.preloaded = 0;
+	c.misses    = 0;
+
+	wxString filename(mVUprogCacheFilename(mVU, c.crc));
+	if (!wxFileExists(filename)) return;
+
+	wxFFile fp(filename, L"rb");
+	u32 header[5];
+
+	if (!fp.IsOpened() || fp.Read(header, sizeof(header)) != sizeof(header)
+		|| header[0] != mVUcacheMagic || header[1] != mVUcacheVersion || header[2] != sizeof(microCacheKey)) {
+		Console.Warning(L"microVU%d: ignoring invalid program cache '%s'", mVU.index, WX_STR(filename));
+		return;
+	}
+
+	const u32 blobs = header[3];
+	std::vector<u8> data((size_t)blobs * mVU.microMemSize);
+	std::vector<microCacheKey> keys(header[4]);
+	if (fp.Read(data.data(), data.size()) != data.size()) {
+		Console.Warning(L"microVU%d: ignoring invalid program cache '%s'", mVU.index, WX_STR(filename));
+		return;
+	}
+	keys.resize(fp.Read(keys.data(), keys.size() * sizeof(microCacheKey)) / sizeof(microCacheKey));
+	std::sort(keys.begin(), keys.end()); // files written with the old bytewise order
+
+	std::vector<u32> blobMap(blobs);
+	for (u32 i = 0; i < blobs; i++)
+		blobMap[i] = mVUprogCacheBlob(mVU, c, &data[(size_t)i * mVU.microMemSize]);
+
+	// Leave half of the cache to the programs the game hasn't used yet, so the
+	// preload doesn't end in a cache reset
+	u8* limit = mVU.prog.x86start + (mVU.prog.x86end - mVU.prog.x86start) / 2;
+
+	std::unique_ptr<u8[]> micro(new u8[mVU.microMemSize]);
+	memcpy(micro.get(), mVU.regs().Micro, mVU.microMemSize);
+
+	// Keys are sorted by blob then startPC (see microCacheKey), so each program is
+	// created once and compiled from all the pipeline states it was entered with
+	microProgram* prog = NULL;
+	u32 progBlob = 0;
+	for (const microCacheKey& key : keys) {
+		if (key.blob >= blobs || key.startPC >= mVU.microMemSize || (key.startPC & 7)) continue;
+
+		microCacheKey k = key;
+		k.blob = blobMap[key.blob];
+		c.keys.insert(k);
+
+		if (xGetPtr() > limit) continue;
+
+		if (!prog || prog->startPC != key.startPC / 8 || progBlob != key.blob) {
+			progBlob = key.blob;
+			memcpy(mVU.regs().Micro, &data[(size_t)key.blob * mVU.microMemSize], mVU.microMemSize);
+			prog = mVUcreateProg(mVU, key.startPC / 8);
+			mVU.prog.prog[key.startPC / 8]->push_front(prog);
+		}
+
+		microRegInfo pState;
+		memcpy(&pState, key.pState, sizeof(pState));
+
+		mVU.prog.cleared = 0;
+		mVU.prog.isSame  = 1;
+		mVU.prog.cur     = prog;
+		mVUblockFetch(mVU, key.startPC, (uptr)&pState);
+		c.preloaded++;
+	}
+
+	memcpy(mVU.regs().Micro, micro.get(), mVU.microMemSize);
+	mVU.prog.cleared = 1;
+	mVU.prog.isSame  = -1;
+	mVU.prog.cur     = NULL;
+
+	DevCon.WriteLn(L"microVU%d: preloaded %u programs from '%s'", mVU.index, c.preloaded, WX_STR(filename));
+}
+
+// Records a program compiled on demand
+static void mVUprogCacheAdd(microVU& mVU, u32 startPC, uptr pState) {
+	microProgCache& c = mVUprogCache[mVU.index];
+
+	microCacheKey key;
+	memzero(key);
+	key.blob    = mVUprogCacheBlob(mVU, c, mVU.regs().Micro);
+	key.startPC = startPC;
+	memcpy(key.pState, (void*)pState, sizeof(key.pState));
+
+	c.dirty |= c.keys.insert(key).second;
+	c.misses++;
+}
+
 // Searches for Cached Micro Program and sets prog.cur to it (returns entry-point to program)
 _mVUt __fi void* mVUsearchProg(u32 startPC, uptr pState) {
 	microVU& mVU = mVUx;
 	microProgramQuick& quick = mVU.prog.quick[startPC/8];
 	microProgramList*  list  = mVU.prog.prog [startPC/8];
 	if(!quick.prog) { // If null, we need to search for new program
+		if (EmuConfig.Cpu.Recompiler.EnableVUCache && ElfCRC && mVUprogCache[mVU.index].crc != ElfCRC) {
+			mVUprogCacheLoad(mVU);
+		}
+		mVUhashUpdate(mVU);
+		mVU.prog.stats.searches++;
 		std::deque<microProgram*>::iterator it(list->begin());
 		for ( ; it != list->end(); ++it) {
-			bool b = mVUcmpProg(mVU, *it[0], 0);
+			mVU.prog.stats.probes++;
+			bool b = false;
+			if (mVUhashCheck(mVU, *it[0])) {
+				mVU.prog.stats.compares++;
+				b = mVUcmpProg(mVU, *it[0], 0);
+			}
 			if (EmuConfig.Gamefixes.ScarfaceIbit) {
 				if (isVU1 && ((((u32*)mVU.regs().Micro)[startPC / 4 + 1]) == 0x80200118) &&
 						     ((((u32*)mVU.regs().Micro)[startPC / 4 + 3]) == 0x81000062)) {
@@ -283,6 +603,7 @@ _mVUt __fi void* mVUsearchProg(u32 startPC, uptr pState) {
                 }
             }
 			if (b) {
+				mVU.prog.stats.hits++;
 				quick.block = it[0]->block[startPC/8];
 				quick.prog  = it[0];
 				list->erase(it);
@@ -292,6 +613,7 @@ _mVUt __fi void* mVUsearchProg(u32 startPC, uptr pState) {
 		}
 
 		// If cleared and program not found, make a new program instance
+		if (mVUprogCache[mVU.index].crc) mVUprogCacheAdd(mVU, startPC, pState);
 		mVU.prog.cleared	= 0;
 		mVU.prog.isSame		= 1;
 		mVU.prog.cur		= mVUcreateProg(mVU,  startPC/8);
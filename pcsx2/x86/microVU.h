@@ -149,6 +149,26 @@ struct microProgram {
 	std::deque<microRange>* ranges;			   // The ranges of the microProgram that have already been recompiled
 	u32 startPC; // Start PC of this program
 	int idx;	 // Program index
+	u64  rangesHash;  // Hash of data over ranges (see microMemHash)
+	bool hashValid;   // rangesHash is up to date with data and ranges
+};
+
+// Hash of micro memory over any set of ranges, used to skip cached programs that can't
+// match without comparing their ranges.  Instructions (64 bits) are multiplied by a
+// constant derived from their address and summed; a Fenwick tree over the products
+// gives the sum over a range in log time.  mVUclear runs before micro memory is written,
+// so it only marks the written lines dirty, they're rehashed on the next search.
+struct microMemHash {
+	u64 tree [mProgSize/2 + 1];	// Fenwick tree of the weighted instructions (1-based)
+	u64 data [mProgSize/2];		// Instructions the tree was built from
+	u64 dirty[mProgSize/2/512];	// Lines (8 instructions) that may have changed since
+};
+
+struct microProgStats {
+	u32 searches;	// Program searches (micro memory changed since the last execution)
+	u32 probes;		// Cached programs looked at
+	u32 compares;	// Cached programs whose hash matched, so were compared
+	u32 hits;		// Searches that found a cached program
 };
 
 typedef std::deque<microProgram*> microProgramList;
@@ -171,6 +191,8 @@ struct microProgManager {
 	u8*					x86start;			// Start of program's rec-cache
 	u8*					x86end;				// Limit of program's rec-cache
 	microRegInfo		lpState;			// Pipeline state from where program left off (useful for continuing execution)
+	microMemHash		hash;				// Hash of micro memory for program searches
+	microProgStats		stats;				// Program search stats (logged on reset)
 };
 
 static const uint mVUdispCacheSize	= __pagesize; // Dispatcher Cache Size (in bytes)
@@ -250,6 +272,9 @@ mVUop(mVUopL);
 // Private Functions
 extern void  mVUcacheProg (microVU& mVU, microProgram&  prog);
 extern void  mVUdeleteProg(microVU& mVU, microProgram*& prog);
+extern void  mVUhashReset (microVU& mVU);
+extern void  mVUhashDirty (microVU& mVU, u32 addr, u32 size);
+extern void  mVUprogCacheFlush(microVU& mVU);
 _mVUt extern void* mVUsearchProg(u32 startPC, uptr pState);
 extern void* __fastcall mVUexecuteVU0(u32 startPC, u32 cycles);
 extern void* __fastcall mVUexecuteVU1(u32 startPC, u32 cycles);
@@ -61,6 +61,7 @@ void mVUsetupRange(microVU& mVU, s32 pc, bool isStartPC) {
 	}
 
 	mVUcheckIsSame(mVU);
+	mVUcurProg.hashValid = false;
 
 	if (isStartPC) {
 		microRange mRange = {pc, -1};
@@ -20,8 +20,12 @@
 #include "PrecompiledHeader.h"
 #include "newVif_UnpackSSE.h"
 #include "MTVU.h"
+#include "Elfheader.h"
+#include "AppConfig.h"
 #include "Utilities/Perf.h"
 
+#include <set>
+
 static void recReset(int idx) {
 	nVif[idx].vifBlocks.reset();
 
@@ -40,6 +44,7 @@ void dVifReserve(int idx) {
 void dVifReset(int idx) {
 	pxAssertDev(nVif[idx].recReserve, "Dynamic VIF recompiler reserve must be created prior to VIF use or reset!");
 
+	dVifFlushCache(idx);
 	recReset(idx);
 }
 
@@ -298,6 +303,142 @@ _vifT __fi nVifBlock* dVifCompile(nVifBlock& block, bool isFill) {
 	return &block;
 }
 
+// --------------------------------------------------------------------------------------
+//  Unpack routine cache
+// --------------------------------------------------------------------------------------
+// With EnableVifCache, the keys of the unpack routines compiled for a game are saved
+// to <cache>/<crc>.vif0 (and .vif1), and the first miss after the game boots compiles
+// all of them in one go instead of one at a time during gameplay. The generated code
+// refers to the VIF state by address, so only the keys are kept, the nVifBlock key
+// describes the routine completely.
+
+static const u32 VifCacheMagic   = 0x43464956; // VIFC
+static const u32 VifCacheVersion = 1;
+
+struct VifCacheKey {
+	u32 hash_key;
+	u32 key0;
+	u32 key1;
+
+	bool operator<(const VifCacheKey& right) const {
+		if (hash_key != right.hash_key) return hash_key < right.hash_key;
+		if (key0 != right.key0) return key0 < right.key0;
+		return key1 < right.key1;
+	}
+};
+
+struct VifCache {
+	u32  crc;		// game the keys belong to, 0 when not caching
+	bool dirty;
+	std::set<VifCacheKey> keys;
+
+	u32  preloaded;
+	u32  hits;		// lookups found in the hash bucket
+	u32  misses;	// routines compiled on demand
+};
+
+static VifCache vifCache[2];
+
+static wxString dVifCacheFilename(int idx, u32 crc) {
+	return Path::Combine(GetCacheFolder(), wxFileName(pxsFmt(L"%08X.vif%d", crc, idx).c_str()));
+}
+
+void dVifFlushCache(int idx) {
+	VifCache& c = vifCache[idx];
+
+	if (!c.crc) return;
+
+	Console.WriteLn(Color_Gray, "nVif%d: unpack cache %08X: %u preloaded, %u hits, %u misses",
+		idx, c.crc, c.preloaded, c.hits, c.misses);
+
+	if (c.dirty) {
+		GetCacheFolder().Mkdir();
+
+		wxString filename(dVifCacheFilename(idx, c.crc));
+		wxFFile fp(filename, L"wb");
+
+		std::vector<VifCacheKey> keys(c.keys.begin(), c.keys.end());
+		const u32 header[3] = { VifCacheMagic, VifCacheVersion, (u32)keys.size() };
+
+		if (!fp.IsOpened()
+			|| fp.Write(header, sizeof(header)) != sizeof(header)
+			|| fp.Write(keys.data(), keys.size() * sizeof(VifCacheKey)) != keys.size() * sizeof(VifCacheKey))
+			Console.Warning(L"nVif%d: unable to write the unpack cache '%s'", idx, WX_STR(filename));
+	}
+
+	c.crc   = 0;
+	c.dirty = false;
+	c.keys.clear();
+}
+
+_vifT static void dVifLoadCache() {
+	nVifStruct& v = nVif[idx];
+	VifCache&   c = vifCache[idx];
+
+	dVifFlushCache(idx); // previous game
+
+	c.crc       = ElfCRC;
+	c.preloaded = 0;
+	c.hits      = 0;
+	c.misses    = 0;
+
+	wxString filename(dVifCacheFilename(idx, c.crc));
+	if (!wxFileExists(filename)) return;
+
+	wxFFile fp(filename, L"rb");
+	u32 header[3];
+
+	if (!fp.IsOpened() || fp.Read(header, sizeof(header)) != sizeof(header)
+		|| header[0] != VifCacheMagic || header[1] != VifCacheVersion) {
+		Console.Warning(L"nVif%d: ignoring invalid unpack cache '%s'", idx, WX_STR(filename));
+		return;
+	}
+
+	std::vector<VifCacheKey> keys(header[2]);
+	keys.resize(fp.Read(keys.data(), keys.size() * sizeof(VifCacheKey)) / sizeof(VifCacheKey));
+
+	// Leave half of the reserve to the routines the game hasn't used yet
+	u8* limit = v.recReserve->GetPtr() + (v.recReserve->GetPtrEnd() - v.recReserve->GetPtr()) / 2;
+
+	for (const VifCacheKey& key : keys) {
+		c.keys.insert(key);
+
+		nVifBlock block;
+		memzero(block);
+		block.hash_key = key.hash_key;
+		block.key0     = key.key0;
+		block.key1     = key.key1;
+
+		if ((key.hash_key >> 8) > 0x3f) continue; // not an [usn:mask:upk] type
+		if (v.recWritePtr > limit || v.vifBlocks.find(block)) continue;
+
+		const uint wl = block.wl ? block.wl : 256;
+		dVifCompile<idx>(block, block.cl < wl);
+		c.preloaded++;
+	}
+
+	DevCon.WriteLn(L"nVif%d: preloaded %u unpack routines from '%s'", idx, c.preloaded, WX_STR(filename));
+}
+
+_vifT static nVifBlock* dVifCompileCached(nVifBlock& block, bool isFill) {
+	VifCache& c = vifCache[idx];
+
+	if (EmuConfig.Cpu.Recompiler.EnableVifCache && ElfCRC && c.crc != ElfCRC) {
+		dVifLoadCache<idx>();
+
+		if (nVifBlock* b = nVif[idx].vifBlocks.find(block))
+			return b;
+	}
+
+	if (c.crc) {
+		const VifCacheKey key = { block.hash_key, block.key0, block.key1 };
+		c.dirty |= c.keys.insert(key).second;
+		c.misses++;
+	}
+
+	return dVifCompile<idx>(block, isFill);
+}
+
 _vifT __fi void dVifUnpack(const u8* data, bool isFill) {
 
 	nVifStruct&   v       = nVif[idx];
@@ -338,8 +479,9 @@ _vifT __fi void dVifUnpack(const u8* data, bool isFill) {
 	// Seach in cache before trying to compile the block
 	nVifBlock*  b = v.vifBlocks.find(block);
 	if (unlikely(b == nullptr)) {
-		b = dVifCompile<idx>(block, isFill);
+		b = dVifCompileCached<idx>(block, isFill);
 	}
+	else vifCache[idx].hits++;
 
 	{ // Execute the block
 		const VURegs& VU         = vuRegs[idx];
@@ -54,57 +54,91 @@ union nVifBlock {
 // The hash function is determined by taking the first bytes of data and
 // performing a modulus the size of hSize. So the most diverse-data should
 // be in the first bytes of the struct. (hence why nVifBlock is specifically sorted)
+//
+// The first block of each bucket is stored inline, so most lookups are a single
+// 16 byte load with no pointer to follow. The other blocks with the same hash_key
+// go to an overflow chain ending with an empty cell, only looked at on a mismatch.
 class HashBucket {
 protected:
-	std::array<nVifBlock*, hSize> m_bucket;
+	nVifBlock* m_first;								// hSize blocks, startPtr == 0 when unused
+	std::array<nVifBlock*, hSize> m_chain;			// overflow chains, or null
+	u32 m_count;
+	u32 m_chained;
 
 public:
-	HashBucket() {
-		m_bucket.fill(nullptr);
+	HashBucket()
+		: m_first(nullptr)
+		, m_count(0)
+		, m_chained(0)
+	{
+		m_chain.fill(nullptr);
 	}
 
 	~HashBucket() { clear(); }
 
+	// key0 and key1 as one value
+	static __fi u64 key64(const nVifBlock& block) {
+		u64 key;
+		memcpy(&key, &block.key0, sizeof(key));
+		return key;
+	}
+
 	__fi nVifBlock* find(const nVifBlock& dataPtr) {
-		nVifBlock* chainpos = m_bucket[dataPtr.hash_key];
+		const u64 key = key64(dataPtr);
+		nVifBlock* first = &m_first[dataPtr.hash_key];
 
-		while (true) {
-			if (chainpos->key0 == dataPtr.key0 && chainpos->key1 == dataPtr.key1)
-				return chainpos;
+		// An unused bucket has a null key too, and never has an overflow chain
+		if (key64(*first) == key)
+			return first->startPtr ? first : nullptr;
 
-			if (chainpos->startPtr == 0)
-				return nullptr;
+		nVifBlock* chainpos = m_chain[dataPtr.hash_key];
+		if (chainpos == nullptr)
+			return nullptr;
+
+		while (chainpos->startPtr != 0) {
+			if (key64(*chainpos) == key)
+				return chainpos;
 
 			chainpos++;
 		}
+
+		return nullptr;
 	}
 
 	void add(const nVifBlock& dataPtr) {
 		u32 b = dataPtr.hash_key;
+		m_count++;
 
-		u32 size = bucket_size( dataPtr );
+		if (m_first[b].startPtr == 0) {
+			memcpy(&m_first[b], &dataPtr, sizeof(nVifBlock));
+			return;
+		}
+
+		u32 size = chain_size(dataPtr);
 
 		// Warning there is an extra +1 due to the empty cell
 		// Performance note: 64B align to reduce cache miss penalty in `find`
-		if( (m_bucket[b] = (nVifBlock*)pcsx2_aligned_realloc( m_bucket[b], sizeof(nVifBlock)*(size+2), 64, sizeof(nVifBlock)*(size+1) )) == NULL ) {
+		if( (m_chain[b] = (nVifBlock*)pcsx2_aligned_realloc( m_chain[b], sizeof(nVifBlock)*(size+2), 64, sizeof(nVifBlock)*(size+1) )) == NULL ) {
 			throw Exception::OutOfMemory(
 				wxsFormat(L"HashBucket Chain (bucket size=%d)", size+2)
 			);
 		}
 
 		// Replace the empty cell by the new block and create a new empty cell
-		memcpy(&m_bucket[b][size++], &dataPtr, sizeof(nVifBlock));
-		memset(&m_bucket[b][size], 0, sizeof(nVifBlock));
+		memcpy(&m_chain[b][size++], &dataPtr, sizeof(nVifBlock));
+		memset(&m_chain[b][size], 0, sizeof(nVifBlock));
+		m_chained++;
 
-		if( size > 3 ) DevCon.Warning( "recVifUnpk: Bucket 0x%04x has %d micro-programs", b, size );
+		if( size > 2 ) DevCon.Warning( "recVifUnpk: Bucket 0x%04x has %d micro-programs", b, size + 1 );
 	}
 
-	u32 bucket_size(const nVifBlock& dataPtr) {
-		nVifBlock* chainpos = m_bucket[dataPtr.hash_key];
+	// Blocks in the overflow chain of dataPtr's bucket
+	u32 chain_size(const nVifBlock& dataPtr) const {
+		const nVifBlock* chainpos = m_chain[dataPtr.hash_key];
 
 		u32 size = 0;
 
-		while (chainpos->startPtr != 0) {
+		while (chainpos && chainpos->startPtr != 0) {
 			size++;
 			chainpos++;
 		}
@@ -113,22 +147,26 @@ public:
 	}
 
 	void clear() {
-		for (auto& bucket : m_bucket)
-			safe_aligned_free(bucket);
+		if (m_count)
+			DevCon.WriteLn("recVifUnpk: %d blocks, %d of them in overflow chains", m_count, m_chained);
+
+		for (auto& chain : m_chain)
+			safe_aligned_free(chain);
+
+		safe_aligned_free(m_first);
+		m_count   = 0;
+		m_chained = 0;
 	}
 
 	void reset() {
 		clear();
 
-		// Allocate an empty cell for all buckets
-		for (auto& bucket : m_bucket) {
-			if( (bucket = (nVifBlock*)_aligned_malloc( sizeof(nVifBlock), 64 )) == nullptr ) {
-				throw Exception::OutOfMemory(
-						wxsFormat(L"HashBucket Chain (bucket size=%d)", 1)
-						);
-			}
-
-			memset(bucket, 0, sizeof(nVifBlock));
+		if( (m_first = (nVifBlock*)_aligned_malloc( sizeof(nVifBlock) * hSize, 64 )) == nullptr ) {
+			throw Exception::OutOfMemory(
+					wxsFormat(L"HashBucket (%d buckets)", hSize)
+					);
 		}
+
+		memset(m_first, 0, sizeof(nVifBlock) * hSize);
 	}
 };
@@ -84,6 +84,7 @@ void resetNewVif(int idx)
 }
 
 void closeNewVif(int idx) {
+	if (newVifDynaRec) dVifFlushCache(idx);
 }
 
 void releaseNewVif(int idx) {
@@ -1095,81 +1095,45 @@ EXPORT_C GSReplay(HWND hwnd, HINSTANCE hinst, LPSTR lpszCmdLine, int nCmdShow)
 
 	file->Read(regs.data(), 0x2000);
 
-	GSvsync(1);
-
-	struct Packet {uint8 type, param; uint32 size, addr; std::vector<uint8> buff;};
+	const uint64 first_packet = file->Tell();
 
-	auto read_packet = [&file](uint8 type) {
-		Packet p;
-		p.type = type;
+	GSDumpStream stream(std::move(file));
 
-		switch(p.type) {
-		case 0:
-			file->Read(&p.param, 1);
-			file->Read(&p.size, 4);
-			switch(p.param) {
-			case 0:
-				p.buff.resize(0x4000);
-				p.addr = 0x4000 - p.size;
-				file->Read(&p.buff[p.addr], p.size);
-				break;
-			case 1:
-			case 2:
-			case 3:
-				p.buff.resize(p.size);
-				file->Read(p.buff.data(), p.size);
-				break;
-			}
-			break;
-		case 1:
-			file->Read(&p.param, 1);
-			break;
-		case 2:
-			file->Read(&p.size, 4);
-			break;
-		case 3:
-			p.buff.resize(0x2000);
-			file->Read(p.buff.data(), 0x2000);
-			break;
-		}
-
-		return p;
-	};
-
-	std::list<Packet> packets;
-	uint8 type;
-	while(file->Read(&type, 1))
-		packets.push_back(read_packet(type));
+	GSvsync(1);
 
 	Sleep(100);
 
 	std::vector<uint8> buff;
 	while(IsWindowVisible(hWnd))
 	{
-		for(auto &p : packets)
+		stream.Start(first_packet);
+
+		while(GSDumpStream::Packet* p = stream.Front())
 		{
-			switch(p.type)
+			switch(p->type)
 			{
 			case 0:
-				switch(p.param)
+				switch(p->param)
 				{
-				case 0: GSgifTransfer1(p.buff.data(), p.addr); break;
-				case 1: GSgifTransfer2(p.buff.data(), p.size / 16); break;
-				case 2: GSgifTransfer3(p.buff.data(), p.size / 16); break;
-				case 3: GSgifTransfer(p.buff.data(), p.size / 16); break;
+				case 0: GSgifTransfer1(p->buff.data(), p->addr); break;
+				case 1: GSgifTransfer2(p->buff.data(), p->size / 16); break;
+				case 2: GSgifTransfer3(p->buff.data(), p->size / 16); break;
+				case 3: GSgifTransfer(p->buff.data(), p->size / 16); break;
 				}
 				break;
 			case 1:
-				GSvsync(p.param);
+				GSvsync(p->param);
 				break;
 			case 2:
-				if(buff.size() < p.size) buff.resize(p.size);
-				GSreadFIFO2(p.buff.data(), p.size / 16);
+				if(buff.size() < p->size) buff.resize(p->size);
+				GSreadFIFO2(buff.data(), p->size / 16);
 				break;
 			case 3:
-				memcpy(regs.data(), p.buff.data(), 0x2000);
+				memcpy(regs.data(), p->buff.data(), 0x2000);
 				break;
 			}
+
+			stream.Pop();
 		}
 	}
 
@@ -1412,9 +1376,6 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 		return;
 	}
 
-	struct Packet {uint8 type, param; uint32 size, addr; std::vector<uint8> buff;};
-
-	std::list<Packet*> packets;
 	std::vector<uint8> buff;
 	uint8 regs[0x2000];
 
@@ -1423,6 +1384,9 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 	s_vsync = theApp.GetConfigI("vsync");
 	int finished = theApp.GetConfigI("linux_replay");
 	bool repack_dump = (finished < 0);
+	// Take a key frame every index_interval frames (0 to disable) when no index exists
+	int index_interval = theApp.GetConfigI("linux_replay_index");
+	uint32 start_frame = std::max(0, theApp.GetConfigI("linux_replay_start"));
 
 	if (theApp.GetConfigI("dump")) {
 		fprintf(stderr, "Dump is enabled. Replay will be disabled\n");
@@ -1439,104 +1403,76 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 	}
 	if (s_gs->m_wnd == NULL) return;
 
-	{ // Read .gs content
-		std::string f(lpszCmdLine);
-		bool is_xz = (f.size() >= 4) && (f.compare(f.size()-3, 3, ".xz") == 0);
-		if (is_xz)
-			f.replace(f.end()-6, f.end(), "_repack.gs");
-		else
-			f.replace(f.end()-3, f.end(), "_repack.gs");
+	std::string f(lpszCmdLine);
+	bool is_xz = (f.size() >= 4) && (f.compare(f.size()-3, 3, ".xz") == 0);
+	if (is_xz)
+		f.replace(f.end()-6, f.end(), "_repack.gs");
+	else
+		f.replace(f.end()-3, f.end(), "_repack.gs");
 
-		GSDumpFile* file = is_xz
-			? (GSDumpFile*) new GSDumpLzma(lpszCmdLine, repack_dump ? f.c_str() : nullptr)
-			: (GSDumpFile*) new GSDumpRaw(lpszCmdLine, repack_dump ? f.c_str() : nullptr);
+	std::unique_ptr<GSDumpFile> file(is_xz
+		? (GSDumpFile*) new GSDumpLzma(lpszCmdLine, repack_dump ? f.c_str() : nullptr)
+		: (GSDumpFile*) new GSDumpRaw(lpszCmdLine, repack_dump ? f.c_str() : nullptr));
 
-		uint32 crc;
-		file->Read(&crc, 4);
-		GSsetGameCRC(crc, 0);
+	uint32 crc;
+	file->Read(&crc, 4);
+	GSsetGameCRC(crc, 0);
 
+	{
 		GSFreezeData fd;
 		file->Read(&fd.size, 4);
-		fd.data = new uint8[fd.size];
+		std::vector<uint8> freeze_data(fd.size);
+		fd.data = freeze_data.data();
 		file->Read(fd.data, fd.size);
 
 		GSfreeze(FREEZE_LOAD, &fd);
-		delete [] fd.data;
-
-		file->Read(regs, 0x2000);
-
-		uint8 type;
-		while(file->Read(&type, 1))
-		{
-			Packet* p = new Packet();
-
-			p->type = type;
-
-			switch(type)
-			{
-			case 0:
-				file->Read(&p->param, 1);
-				file->Read(&p->size, 4);
-
-				switch(p->param)
-				{
-				case 0:
-					p->buff.resize(0x4000);
-					p->addr = 0x4000 - p->size;
-					file->Read(&p->buff[p->addr], p->size);
-					break;
-				case 1:
-				case 2:
-				case 3:
-					p->buff.resize(p->size);
-					file->Read(&p->buff[0], p->size);
-					break;
-				}
-
-				break;
+	}
 
-			case 1:
-				file->Read(&p->param, 1);
-				frame_number++;
+	file->Read(regs, 0x2000);
 
-				break;
+	uint64 start_offset = file->Tell();
+	uint32 key_frame = 0;
 
-			case 2:
-				file->Read(&p->size, 4);
+	GSDumpStream stream(std::move(file));
 
-				break;
+	// Packets are decoded on the fly, only a bounded number of them is kept in memory
+	const std::string index_path = GSDumpIndex::GetPath(lpszCmdLine);
+	std::unique_ptr<GSDumpIndex> index_writer;
 
-			case 3:
-				p->buff.resize(0x2000);
-
-				file->Read(&p->buff[0], 0x2000);
-
-				break;
-			}
+	if (start_frame > 0 && !repack_dump) {
+		GSDumpIndex index;
+		std::vector<uint8> state;
 
-			packets.push_back(p);
+		if (index.Load(index_path, crc) && index.Restore(start_frame, key_frame, start_offset, state, regs)) {
+			GSFreezeData fd;
+			fd.size = state.size();
+			fd.data = state.data();
+			GSfreeze(FREEZE_LOAD, &fd);
 
-			if (repack_dump && frame_number > -finished)
-				break;
+			fprintf(stderr, "Replay starts at key frame %u\n", key_frame);
+		} else {
+			fprintf(stderr, "No key frame available for frame %u. Replay starts at the beginning\n", start_frame);
 		}
-
-		delete file;
+	} else if (index_interval > 0 && !repack_dump) {
+		index_writer.reset(new GSDumpIndex());
+		if (!index_writer->Create(index_path, crc))
+			index_writer.reset();
 	}
 
 	sleep(2);
 
-
-	frame_number = 0;
-
 	// Init vsync stuff
 	GSvsync(1);
 
-	while(finished > 0)
+	// A repack is a single pass over the first -linux_replay frames
+	while(finished > 0 || repack_dump)
 	{
-		for(auto i = packets.begin(); i != packets.end(); i++)
-		{
-			Packet* p = *i;
+		stream.Start(start_offset, repack_dump ? -finished : 0);
+
+		uint32 frame = key_frame;
 
+		while(GSDumpStream::Packet* p = stream.Front())
+		{
 			switch(p->type)
 			{
 				case 0:
@@ -1555,6 +1491,17 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 
 					GSvsync(p->param);
 					frame_number++;
+					frame++;
+
+					if (index_writer && (frame % index_interval) == 0) {
+						GSFreezeData fd;
+						GSfreeze(FREEZE_SIZE, &fd);
+						std::vector<uint8> state(fd.size);
+						fd.data = state.data();
+						GSfreeze(FREEZE_SAVE, &fd);
+
+						index_writer->Add(frame, p->end, fd, regs);
+					}
 
 					break;
 
@@ -1572,9 +1519,17 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 
 					break;
 			}
+
+			stream.Pop();
 		}
 
-		if (finished >= 200) {
+		// Only the first pass is repacked and indexed
+		stream.GetFile()->StopRepack();
+		index_writer.reset();
+
+		if (repack_dump) {
+			break;
+		} else if (finished >= 200) {
 			; // Nop for Nvidia Profiler
 		} else if (finished > 90) {
 			sleep(1);
@@ -1594,13 +1549,6 @@ EXPORT_C GSReplay(char* lpszCmdLine, int renderer)
 		   );
 #endif
 
-	for(auto i = packets.begin(); i != packets.end(); i++)
-	{
-		delete *i;
-	}
-
-	packets.clear();
-
 	sleep(2);
 
 	GSclose();
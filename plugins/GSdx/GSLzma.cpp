@@ -19,9 +19,27 @@
  */
 
 #include "stdafx.h"
+#include "GS.h"
 #include "GSLzma.h"
 
+static int fseek64(FILE* fp, uint64 offset, int origin) {
+#ifdef _WIN32
+	return _fseeki64(fp, offset, origin);
+#else
+	return fseeko(fp, offset, origin);
+#endif
+}
+
+static uint64 ftell64(FILE* fp) {
+#ifdef _WIN32
+	return _ftelli64(fp);
+#else
+	return ftello(fp);
+#endif
+}
+
 GSDumpFile::GSDumpFile(char* filename, const char* repack_filename) {
+	m_offset = 0;
 	m_fp = fopen(filename, "rb");
 	if (m_fp == nullptr) {
 		fprintf(stderr, "failed to open %s\n", filename);
@@ -46,6 +64,12 @@ void GSDumpFile::Repack(void* ptr, size_t size) {
 
 }
 
+void GSDumpFile::StopRepack() {
+	if (m_repack_fp)
+		fclose(m_repack_fp);
+	m_repack_fp = nullptr;
+}
+
 GSDumpFile::~GSDumpFile() {
 	if (m_fp)
 		fclose(m_fp);
@@ -56,8 +80,16 @@ GSDumpFile::~GSDumpFile() {
 /******************************************************************/
 GSDumpLzma::GSDumpLzma(char* filename, const char* repack_filename) : GSDumpFile(filename, repack_filename) {
 
+	m_buff_size = 1024*1024;
+	m_area      = (uint8_t*)_aligned_malloc(m_buff_size, 32);
+	m_inbuf     = (uint8_t*)_aligned_malloc(BUFSIZ, 32);
+
 	memset(&m_strm, 0, sizeof(lzma_stream));
 
+	Init();
+}
+
+void GSDumpLzma::Init() {
 	lzma_ret ret = lzma_stream_decoder(&m_strm, UINT32_MAX, 0);
 
 	if (ret != LZMA_OK) {
@@ -65,11 +97,9 @@ GSDumpLzma::GSDumpLzma(char* filename, const char* repack_filename) : GSDumpFile
 		throw "BAD"; // Just exit the program
 	}
 
-	m_buff_size = 1024*1024;
-	m_area      = (uint8_t*)_aligned_malloc(m_buff_size, 32);
-	m_inbuf     = (uint8_t*)_aligned_malloc(BUFSIZ, 32);
 	m_avail     = 0;
 	m_start     = 0;
+	m_offset    = 0;
 
 	m_strm.avail_in  = 0;
 	m_strm.next_in   = m_inbuf;
@@ -131,6 +161,8 @@ bool GSDumpLzma::Read(void* ptr, size_t size) {
 		off     += l;
 	}
 
+	m_offset += off;
+
 	if (size == 0) {
 		Repack(ptr, full_size);
 		return true;
@@ -139,6 +171,31 @@ bool GSDumpLzma::Read(void* ptr, size_t size) {
 	return false;
 }
 
+bool GSDumpLzma::Seek(uint64 offset) {
+	if (offset < m_offset) {
+		// An xz stream can only be decoded forward, restart from the beginning
+		lzma_end(&m_strm);
+		memset(&m_strm, 0, sizeof(lzma_stream));
+		rewind(m_fp);
+
+		Init();
+	}
+
+	// Skipped data is still decompressed but neither copied nor repacked
+	while (m_offset < offset && !IsEof()) {
+		if (m_avail == 0) {
+			Decompress();
+		}
+
+		size_t l = static_cast<size_t>(std::min<uint64>(offset - m_offset, m_avail));
+		m_avail  -= l;
+		m_start  += l;
+		m_offset += l;
+	}
+
+	return m_offset == offset;
+}
+
 GSDumpLzma::~GSDumpLzma() {
 	lzma_end(&m_strm);
 
@@ -169,6 +226,8 @@ bool GSDumpRaw::Read(void* ptr, size_t size) {
 		throw "BAD"; // Just exit the program
 	}
 
+	m_offset += ret;
+
 	if (ret == size) {
 		Repack(ptr, size);
 		return true;
@@ -176,3 +235,258 @@ bool GSDumpRaw::Read(void* ptr, size_t size) {
 
 	return false;
 }
+
+bool GSDumpRaw::Seek(uint64 offset) {
+	if (fseek64(m_fp, offset, SEEK_SET) != 0)
+		return false;
+
+	m_offset = offset;
+	return true;
+}
+
+/******************************************************************/
+
+GSDumpStream::GSDumpStream(std::unique_ptr<GSDumpFile> file, size_t slots)
+	: m_file(std::move(file))
+	, m_ring(slots)
+	, m_head(0)
+	, m_tail(0)
+	, m_count(0)
+	, m_frame_limit(0)
+	, m_eof(true)
+	, m_exit(false)
+{
+	// Big enough for path1 transfers and registers, larger packets grow their
+	// slot once and the buffer is reused afterward
+	for (auto& p : m_ring)
+		p.buff.resize(0x4000);
+}
+
+GSDumpStream::~GSDumpStream() {
+	Stop();
+}
+
+void GSDumpStream::Stop() {
+	if (!m_thread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		m_exit = true;
+	}
+	m_not_full.notify_one();
+
+	m_thread.join();
+
+	m_exit = false;
+}
+
+void GSDumpStream::Start(uint64 offset, long frame_limit) {
+	Stop();
+
+	m_head  = 0;
+	m_tail  = 0;
+	m_count = 0;
+	m_frame_limit = frame_limit;
+	m_eof   = !m_file->Seek(offset);
+
+	if (m_eof) {
+		fprintf(stderr, "GSDumpStream: failed to seek to %llu\n", (unsigned long long)offset);
+		return;
+	}
+
+	m_thread = std::thread(&GSDumpStream::ThreadProc, this);
+}
+
+bool GSDumpStream::ReadPacket(Packet& p) {
+	if (!m_file->Read(&p.type, 1))
+		return false;
+
+	switch(p.type) {
+	case 0:
+		m_file->Read(&p.param, 1);
+		m_file->Read(&p.size, 4);
+		switch(p.param) {
+		case 0:
+			p.addr = 0x4000 - p.size;
+			m_file->Read(&p.buff[p.addr], p.size);
+			break;
+		case 1:
+		case 2:
+		case 3:
+			if (p.buff.size() < p.size) p.buff.resize(p.size);
+			m_file->Read(p.buff.data(), p.size);
+			break;
+		}
+		break;
+	case 1:
+		m_file->Read(&p.param, 1);
+		break;
+	case 2:
+		m_file->Read(&p.size, 4);
+		break;
+	case 3:
+		m_file->Read(p.buff.data(), 0x2000);
+		break;
+	}
+
+	p.end = m_file->Tell();
+
+	return true;
+}
+
+void GSDumpStream::ThreadProc() {
+	long frames = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> l(m_lock);
+
+			while (m_count == m_ring.size() && !m_exit)
+				m_not_full.wait(l);
+
+			if (m_exit)
+				return;
+		}
+
+		// The slot at m_head is owned by the decoder until m_count is increased
+		Packet& p = m_ring[m_head];
+		bool valid;
+
+		try {
+			valid = ReadPacket(p);
+		} catch (...) {
+			valid = false;
+		}
+
+		if (valid && p.type == 1)
+			frames++;
+
+		bool last = !valid || (m_frame_limit > 0 && frames > m_frame_limit);
+
+		{
+			std::lock_guard<std::mutex> l(m_lock);
+
+			if (valid) {
+				m_head = (m_head + 1) % m_ring.size();
+				m_count++;
+			}
+			m_eof = last;
+		}
+		m_not_empty.notify_one();
+
+		if (last)
+			return;
+	}
+}
+
+GSDumpStream::Packet* GSDumpStream::Front() {
+	std::unique_lock<std::mutex> l(m_lock);
+
+	while (m_count == 0 && !m_eof)
+		m_not_empty.wait(l);
+
+	return m_count ? &m_ring[m_tail] : nullptr;
+}
+
+void GSDumpStream::Pop() {
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+
+		m_tail = (m_tail + 1) % m_ring.size();
+		m_count--;
+	}
+	m_not_full.notify_one();
+}
+
+/******************************************************************/
+
+static const uint32 s_index_magic   = 0x49445347; // "GSDI"
+static const uint32 s_index_version = 1;
+
+GSDumpIndex::GSDumpIndex() : m_fp(nullptr) {
+}
+
+GSDumpIndex::~GSDumpIndex() {
+	if (m_fp)
+		fclose(m_fp);
+}
+
+std::string GSDumpIndex::GetPath(const char* dump) {
+	return std::string(dump) + ".idx";
+}
+
+bool GSDumpIndex::Load(const std::string& fn, uint32 crc) {
+	m_fp = px_fopen(fn, "rb");
+	if (m_fp == nullptr)
+		return false;
+
+	uint32 header[3];
+	if (fread(header, sizeof(header), 1, m_fp) != 1 || header[0] != s_index_magic
+			|| header[1] != s_index_version || header[2] != crc) {
+		fprintf(stderr, "GSDumpIndex: %s doesn't match the dump\n", fn.c_str());
+		fclose(m_fp);
+		m_fp = nullptr;
+		return false;
+	}
+
+	KeyFrame k;
+	while (fread(&k.frame, 4, 1, m_fp) == 1 && fread(&k.offset, 8, 1, m_fp) == 1 && fread(&k.state_size, 4, 1, m_fp) == 1) {
+		k.file_pos = ftell64(m_fp);
+
+		if (fseek64(m_fp, k.state_size + 0x2000, SEEK_CUR) != 0)
+			break;
+
+		m_keys.push_back(k);
+	}
+
+	return !m_keys.empty();
+}
+
+bool GSDumpIndex::Create(const std::string& fn, uint32 crc) {
+	m_fp = px_fopen(fn, "wb");
+	if (m_fp == nullptr) {
+		fprintf(stderr, "GSDumpIndex: failed to create %s\n", fn.c_str());
+		return false;
+	}
+
+	uint32 header[3] = {s_index_magic, s_index_version, crc};
+	fwrite(header, sizeof(header), 1, m_fp);
+
+	return true;
+}
+
+void GSDumpIndex::Add(uint32 frame, uint64 offset, const GSFreezeData& fd, const void* regs) {
+	if (m_fp == nullptr)
+		return;
+
+	uint32 size = fd.size;
+
+	fwrite(&frame, 4, 1, m_fp);
+	fwrite(&offset, 8, 1, m_fp);
+	fwrite(&size, 4, 1, m_fp);
+	fwrite(fd.data, 1, size, m_fp);
+	fwrite(regs, 1, 0x2000, m_fp);
+}
+
+bool GSDumpIndex::Restore(uint32 frame, uint32& key_frame, uint64& offset, std::vector<uint8>& state, void* regs) {
+	auto it = std::upper_bound(m_keys.begin(), m_keys.end(), frame,
+			[](uint32 f, const KeyFrame& k) { return f < k.frame; });
+
+	if (m_fp == nullptr || it == m_keys.begin())
+		return false;
+
+	const KeyFrame& k = *(it - 1);
+
+	state.resize(k.state_size);
+
+	if (fseek64(m_fp, k.file_pos, SEEK_SET) != 0
+			|| fread(state.data(), 1, k.state_size, m_fp) != k.state_size
+			|| fread(regs, 1, 0x2000, m_fp) != 0x2000)
+		return false;
+
+	key_frame = k.frame;
+	offset    = k.offset;
+
+	return true;
+}
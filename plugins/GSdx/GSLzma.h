@@ -18,6 +18,8 @@
  *
  */
 
+#pragma once
+
 #include <lzma.h>
 
 class GSDumpFile {
@@ -25,12 +27,17 @@ class GSDumpFile {
 
 	protected:
 	FILE*		m_fp;
+	uint64		m_offset; // position in the uncompressed stream
 
 	void Repack(void* ptr, size_t size);
 
 	public:
 	virtual bool IsEof() = 0;
 	virtual bool Read(void* ptr, size_t size) = 0;
+	virtual bool Seek(uint64 offset) = 0;
+
+	uint64 Tell() const { return m_offset; }
+	void StopRepack();
 
 	GSDumpFile(char* filename, const char* repack_filename);
 	virtual ~GSDumpFile();
@@ -47,6 +54,7 @@ class GSDumpLzma : public GSDumpFile {
 	size_t		m_avail;
 	size_t		m_start;
 
+	void Init();
 	void Decompress();
 
 	public:
@@ -56,6 +64,7 @@ class GSDumpLzma : public GSDumpFile {
 
 	bool IsEof() final;
 	bool Read(void* ptr, size_t size) final;
+	bool Seek(uint64 offset) final;
 };
 
 class GSDumpRaw : public GSDumpFile {
@@ -74,4 +83,92 @@ class GSDumpRaw : public GSDumpFile {
 
 	bool IsEof() final;
 	bool Read(void* ptr, size_t size) final;
+	bool Seek(uint64 offset) final;
+};
+
+// Decodes the packets of a dump on a background thread into a bounded ring of
+// reusable buffers. Replay starts as soon as the first packets are available
+// and memory usage no longer depends on the size of the dump.
+class GSDumpStream {
+	public:
+
+	struct Packet {
+		uint8 type, param;
+		uint32 size, addr;
+		uint64 end; // stream offset following the packet
+		std::vector<uint8> buff;
+	};
+
+	private:
+
+	std::unique_ptr<GSDumpFile> m_file;
+	std::vector<Packet> m_ring;
+	size_t		m_head;
+	size_t		m_tail;
+	size_t		m_count;
+	long		m_frame_limit;
+	bool		m_eof;
+	bool		m_exit;
+
+	std::thread m_thread;
+	std::mutex m_lock;
+	std::condition_variable m_not_full;
+	std::condition_variable m_not_empty;
+
+	bool ReadPacket(Packet& p);
+	void ThreadProc();
+	void Stop();
+
+	public:
+
+	GSDumpStream(std::unique_ptr<GSDumpFile> file, size_t slots = 256);
+	~GSDumpStream();
+
+	// (Re)start decoding at offset. A positive frame_limit ends the stream
+	// after that many vsync packets.
+	void Start(uint64 offset, long frame_limit = 0);
+
+	// Block until a packet is decoded. Return nullptr at the end of the stream
+	Packet* Front();
+	void Pop();
+
+	// Only safe to use when decoding is stopped (before Start or at the end of the stream)
+	GSDumpFile* GetFile() { return m_file.get(); }
+};
+
+/*
+
+Sidecar frame index (.idx), optional key frames to start a replay in the middle of a dump:
+- [magic/4] [version/4] [crc/4] [key frame] .. [key frame]
+
+Key frame
+- [frame/4] [stream offset/8] [state size/4] [state data/size] [PMODE/0x2000]
+
+*/
+
+class GSDumpIndex {
+	struct KeyFrame {
+		uint32 frame;
+		uint64 offset;
+		uint32 state_size;
+		uint64 file_pos; // position of the state data in the index file
+	};
+
+	FILE*		m_fp;
+	std::vector<KeyFrame> m_keys;
+
+	public:
+
+	GSDumpIndex();
+	~GSDumpIndex();
+
+	static std::string GetPath(const char* dump);
+
+	bool Load(const std::string& fn, uint32 crc);
+	bool Create(const std::string& fn, uint32 crc);
+
+	void Add(uint32 frame, uint64 offset, const GSFreezeData& fd, const void* regs);
+
+	// Load the closest key frame at or before frame. Return false if none exists
+	bool Restore(uint32 frame, uint32& key_frame, uint64& offset, std::vector<uint8>& state, void* regs);
 };
@@ -36,6 +36,8 @@ public:
 	enum counter_t 
 	{
 		Frame, Prim, Draw, Swizzle, Unswizzle, Fillrate, Quad, SyncPoint,
+		TextureLookup, TextureWalk, // hw texture cache lookups and candidates checked
+		Steal, // sw rasterizer bins taken from another worker
 		CounterLast,
 	};
 
@@ -358,6 +358,8 @@ void GSdxApp::Init()
 	m_default_configuration["windowed"]                                   = "1";
 #else
 	m_default_configuration["linux_replay"]                               = "1";
+	m_default_configuration["linux_replay_index"]                         = "0";
+	m_default_configuration["linux_replay_start"]                         = "0";
 #endif
 	m_default_configuration["aa1"]                                        = "0";
 	m_default_configuration["accurate_date"]                              = "1";
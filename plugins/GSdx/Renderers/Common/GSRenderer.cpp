@@ -379,13 +379,36 @@ void GSRenderer::VSync(int field)
 				s += format(" | %.2f mpps", fps * fillrate / (1024 * 1024));
 
 				int sum = 0;
+				int busy_min = 100;
+				int busy_max = 0;
 
 				for(int i = 0; i < 16; i++)
 				{
-					sum += m_perfmon.CPU(GSPerfMon::WorkerDraw0 + i);
+					int busy = m_perfmon.CPU(GSPerfMon::WorkerDraw0 + i);
+
+					if(busy > 0)
+					{
+						busy_min = std::min(busy_min, busy);
+						busy_max = std::max(busy_max, busy);
+					}
+
+					sum += busy;
 				}
 
 				s += format(" | %d%% CPU", sum);
+
+				// Busy share of the least and most loaded workers, the rest of the time they wait for work
+				if(busy_max > 0)
+				{
+					s += format(" (%d-%d%%, %d steals)", busy_min, busy_max, (int)m_perfmon.Get(GSPerfMon::Steal));
+				}
+			}
+
+			double lookups = m_perfmon.Get(GSPerfMon::TextureLookup);
+
+			if(lookups > 0)
+			{
+				s += format(" | %d TC/%.1f walk", (int)lookups, m_perfmon.Get(GSPerfMon::TextureWalk) / lookups);
 			}
 		}
 		else
@@ -30,6 +30,7 @@ bool GSTextureCache::m_wrap_gs_mem = false;
 GSTextureCache::GSTextureCache(GSRenderer* r)
 	: m_renderer(r)
 	, m_palette_map(r)
+	, m_dst_lru(0)
 {
 	if (theApp.GetConfigB("UserHacks")) {
 		UserHacks_HalfPixelOffset      = theApp.GetConfigI("UserHacks_HalfPixelOffset") == 1;
@@ -75,24 +76,14 @@ void GSTextureCache::RemovePartial()
 {
 	//m_src.RemoveAll();
 
-	for (int type = 0; type < 2; type++)
-	{
-		for (auto t : m_dst[type]) delete t;
-
-		m_dst[type].clear();
-	}
+	ClearTargets();
 }
 
 void GSTextureCache::RemoveAll()
 {
 	m_src.RemoveAll();
 
-	for(int type = 0; type < 2; type++)
-	{
-		for (auto t : m_dst[type]) delete t;
-
-		m_dst[type].clear();
-	}
+	ClearTargets();
 
 	m_palette_map.Clear();
 }
@@ -119,7 +110,7 @@ GSTextureCache::Source* GSTextureCache::LookupDepthSource(const GIFRegTEX0& TEX0
 	uint32 bp = TEX0.TBP0;
 	uint32 psm = TEX0.PSM;
 
-	for(auto t : m_dst[DepthStencil]) {
+	for(auto t : FindTargets(DepthStencil, bp)) {
 		if(t->m_used && t->m_dirty.empty() && GSUtil::HasSharedBits(bp, psm, t->m_TEX0.TBP0, t->m_TEX0.PSM))
 		{
 			ASSERT(GSLocalMemory::m_psm[t->m_TEX0.PSM].depth);
@@ -136,7 +127,7 @@ GSTextureCache::Source* GSTextureCache::LookupDepthSource(const GIFRegTEX0& TEX0
 
 	if (!dst) {
 		// Retry on the render target (Silent Hill 4)
-		for(auto t : m_dst[RenderTarget]) {
+		for(auto t : FindTargets(RenderTarget, bp)) {
 			// FIXME: do I need to allow m_age == 1 as a potential match (as DepthStencil) ???
 			if(!t->m_age && t->m_used && t->m_dirty.empty() && GSUtil::HasSharedBits(bp, psm, t->m_TEX0.TBP0, t->m_TEX0.PSM))
 			{
@@ -211,14 +202,13 @@ GSTextureCache::Source* GSTextureCache::LookupSource(const GIFRegTEX0& TEX0, con
 
 	Source* src = NULL;
 
-	auto& m = m_src.m_map[TEX0.TBP0 >> 5];
+	m_renderer->m_perfmon.Put(GSPerfMon::TextureLookup, 1);
 
-	for(auto i = m.begin(); i != m.end(); ++i)
+	for(auto s : m_src.Find(TEX0))
 	{
-		Source* s = *i;
+		m_renderer->m_perfmon.Put(GSPerfMon::TextureWalk, 1);
 
-		if (((TEX0.u32[0] ^ s->m_TEX0.u32[0]) | ((TEX0.u32[1] ^ s->m_TEX0.u32[1]) & 3)) != 0) // TBP0 TBW PSM TW TH
-			continue;
+		ASSERT(((TEX0.u32[0] ^ s->m_TEX0.u32[0]) | ((TEX0.u32[1] ^ s->m_TEX0.u32[1]) & 3)) == 0);
 
 		// Target are converted (AEM & palette) on the fly by the GPU. They don't need extra check
 		if (!s->m_target) {
@@ -234,7 +224,7 @@ GSTextureCache::Source* GSTextureCache::LookupSource(const GIFRegTEX0& TEX0, con
 				continue;
 		}
 
-		m.MoveFront(i.Index());
+		m_src.MoveFront(s);
 
 		src = s;
 
@@ -268,7 +258,35 @@ GSTextureCache::Source* GSTextureCache::LookupSource(const GIFRegTEX0& TEX0, con
 
 		bool texture_inside_rt = ShallSearchTextureInsideRt();
 
-		for(auto t : m_dst[RenderTarget]) {
+		// Without the texture inside rt search, a target can only match on its base
+		// pointer or as the right half of a target with TBW >= 16 starting TBW * 0x10
+		// blocks before. Gather those in m_dst order, otherwise check everything.
+		m_dst_candidates.clear();
+
+		if(texture_inside_rt) {
+			for(auto t : m_dst[RenderTarget])
+				m_dst_candidates.push_back(t);
+		} else {
+			for(auto t : FindTargets(RenderTarget, bp))
+				m_dst_candidates.push_back(t);
+
+			for(uint32 tbw = 16; tbw < 64 && tbw * 0x10 <= bp; tbw++) {
+				for(auto t : FindTargets(RenderTarget, bp - tbw * 0x10)) {
+					if(t->m_TEX0.TBW == tbw)
+						m_dst_candidates.push_back(t);
+				}
+			}
+
+			if(m_dst_candidates.size() > 1) {
+				std::sort(m_dst_candidates.begin(), m_dst_candidates.end(), [](const Target* a, const Target* b) {
+					return a->m_lru > b->m_lru;
+				});
+			}
+		}
+
+		for(auto t : m_dst_candidates) {
+			m_renderer->m_perfmon.Put(GSPerfMon::TextureWalk, 1);
+
 			if(t->m_used && t->m_dirty.empty()) {
 				// Typical bug (MGS3 blue cloud):
 				// 1/ RT used as 32 bits => alpha channel written
@@ -408,7 +426,7 @@ GSTextureCache::Source* GSTextureCache::LookupSource(const GIFRegTEX0& TEX0, con
 			// Unfortunately, I don't have any Arc the Lad testcase
 			//
 			// 1/ Check only current frame, I guess it is only used as a postprocessing effect
-			for(auto t : m_dst[DepthStencil]) {
+			for(auto t : FindTargets(DepthStencil, bp)) {
 				if(!t->m_age && t->m_used && t->m_dirty.empty() && GSUtil::HasSharedBits(bp, psm, t->m_TEX0.TBP0, t->m_TEX0.PSM))
 				{
 					GL_INS("TC: Warning depth format read as color format. Pixels will be scrambled");
@@ -495,13 +513,14 @@ GSTextureCache::Target* GSTextureCache::LookupTarget(const GIFRegTEX0& TEX0, int
 
 	Target* dst = NULL;
 
-	auto& list = m_dst[type];
-	for(auto i = list.begin(); i != list.end(); ++i) {
-		Target* t = *i;
+	m_renderer->m_perfmon.Put(GSPerfMon::TextureLookup, 1);
+
+	for(auto t : FindTargets(type, bp)) {
+		m_renderer->m_perfmon.Put(GSPerfMon::TextureWalk, 1);
 
 		if(bp == t->m_TEX0.TBP0)
 		{
-			list.MoveFront(i.Index());
+			MoveTargetFront(t);
 
 			dst = t;
 
@@ -526,7 +545,7 @@ GSTextureCache::Target* GSTextureCache::LookupTarget(const GIFRegTEX0& TEX0, int
 		// Depth stencil/RT can be an older RT/DS but only check recent RT/DS to avoid to pick
 		// some bad data.
 		Target* dst_match = nullptr;
-		for(auto t : m_dst[rev_type]) {
+		for(auto t : FindTargets(rev_type, bp)) {
 			if (bp == t->m_TEX0.TBP0) {
 				if (t->m_age == 0) {
 					dst_match = t;
@@ -618,8 +637,10 @@ GSTextureCache::Target* GSTextureCache::LookupTarget(const GIFRegTEX0& TEX0, int
 	}
 #endif
 
+	m_renderer->m_perfmon.Put(GSPerfMon::TextureLookup, 1);
+
 	// Let's try to find a perfect frame that contains valid data
-	for(auto t : m_dst[RenderTarget]) {
+	for(auto t : FindTargets(RenderTarget, bp)) {
 		if(bp == t->m_TEX0.TBP0 && t->m_end_block >= bp) {
 			dst = t;
 
@@ -630,8 +651,11 @@ GSTextureCache::Target* GSTextureCache::LookupTarget(const GIFRegTEX0& TEX0, int
 	}
 
 	// 2nd try ! Try to find a frame that include the bp
+	// Only once per displayed frame, not worth an interval index of m_end_block
 	if (dst == NULL) {
 		for(auto t : m_dst[RenderTarget]) {
+			m_renderer->m_perfmon.Put(GSPerfMon::TextureWalk, 1);
+
 			if (t->m_TEX0.TBP0 < bp && bp <= t->m_end_block) {
 				dst = t;
 
@@ -644,7 +668,7 @@ GSTextureCache::Target* GSTextureCache::LookupTarget(const GIFRegTEX0& TEX0, int
 
 	// 3rd try ! Try to find a frame that doesn't contain valid data (honestly I'm not sure we need to do it)
 	if (dst == NULL) {
-		for(auto t : m_dst[RenderTarget]) {
+		for(auto t : FindTargets(RenderTarget, bp)) {
 			if(bp == t->m_TEX0.TBP0) {
 				dst = t;
 
@@ -719,18 +743,15 @@ void GSTextureCache::InvalidateVideoMemType(int type, uint32 bp)
 	if (!m_can_convert_depth)
 		return;
 
-	auto& list = m_dst[type];
-	for(auto i = list.begin(); i != list.end(); ++i)
+	for(auto t : FindTargets(type, bp))
 	{
-		Target* t = *i;
-
 		if(bp == t->m_TEX0.TBP0)
 		{
 			GL_CACHE("TC: InvalidateVideoMemType: Remove Target(%s) %d (0x%x)", to_string(type),
 					t->m_texture ? t->m_texture->GetID() : 0,
 					t->m_TEX0.TBP0);
 
-			list.erase(i);
+			RemoveTarget(t);
 			delete t;
 
 			break;
@@ -880,13 +901,46 @@ void GSTextureCache::InvalidateVideoMem(GSOffset* off, const GSVector4i& rect, b
 
 	if(!target) return;
 
+	// Only targets starting at bp or a whole number of bw wide rows of pages
+	// away from it can be hit below (same bp, dirty after, dirty in the middle)
+	const uint32 row_blocks = bw * 32;
+	const int row_height = GSLocalMemory::m_psm[psm].pgs.y;
+
+	m_renderer->m_perfmon.Put(GSPerfMon::TextureLookup, 1);
+
 	for(int type = 0; type < 2; type++)
 	{
-		auto& list = m_dst[type];
-		for(auto i = list.begin(); i != list.end(); )
+		m_dst_candidates.clear();
+
+		for(auto t : FindTargets(type, bp))
+			m_dst_candidates.push_back(t);
+
+		if(row_blocks > 0)
 		{
-			auto j = i++;
-			Target* t = *j;
+			for(uint32 tbp = bp + row_blocks, y = row_height; tbp < 0x4000 && (int)y < r.bottom; tbp += row_blocks, y += row_height)
+			{
+				for(auto t : FindTargets(type, tbp))
+					m_dst_candidates.push_back(t);
+			}
+
+			if(bw > 2)
+			{
+				for(uint32 tbp = bp; tbp >= row_blocks; )
+				{
+					tbp -= row_blocks;
+
+					for(auto t : FindTargets(type, tbp))
+					{
+						if(t->m_TEX0.TBW == bw)
+							m_dst_candidates.push_back(t);
+					}
+				}
+			}
+		}
+
+		for(auto t : m_dst_candidates)
+		{
+			m_renderer->m_perfmon.Put(GSPerfMon::TextureWalk, 1);
 
 			// GH: (I think) this code is completely broken. Typical issue:
 			// EE write an alpha channel into 32 bits texture
@@ -907,7 +961,7 @@ void GSTextureCache::InvalidateVideoMem(GSOffset* off, const GSVector4i& rect, b
 				}
 				else
 				{
-					list.erase(j);
+					RemoveTarget(t);
 					GL_CACHE("TC: Remove Target(%s) %d (0x%x)", to_string(type),
 								t->m_texture ? t->m_texture->GetID() : 0,
 								t->m_TEX0.TBP0);
@@ -988,7 +1042,7 @@ void GSTextureCache::InvalidateLocalMem(GSOffset* off, const GSVector4i& r)
 	if (psm == PSM_PSMZ32 || psm == PSM_PSMZ24 || psm == PSM_PSMZ16 || psm == PSM_PSMZ16S) {
 		GL_INS("ERROR: InvalidateLocalMem depth format isn't supported (%d,%d to %d,%d)", r.x, r.y, r.z, r.w);
 		if (m_can_convert_depth) {
-			for(auto t : m_dst[DepthStencil]) {
+			for(auto t : FindTargets(DepthStencil, bp)) {
 				if(GSUtil::HasSharedBits(bp, psm, t->m_TEX0.TBP0, t->m_TEX0.PSM)) {
 					if (GSUtil::HasCompatibleBits(psm, t->m_TEX0.PSM))
 						Read(t, r.rintersect(t->m_valid));
@@ -1002,7 +1056,7 @@ void GSTextureCache::InvalidateLocalMem(GSOffset* off, const GSVector4i& r)
 	// It works for all the games mentioned below and fixes a couple of other ones as well
 	// (Busen0: Wizardry and Chaos Legion).
 	// Also in a few games the below code ran the Grandia3 case when it shouldn't :p
-	for(auto t : m_dst[RenderTarget])
+	for(auto t : FindTargets(RenderTarget, bp))
 	{
 		if (t->m_TEX0.PSM != PSM_PSMZ32 && t->m_TEX0.PSM != PSM_PSMZ24 && t->m_TEX0.PSM != PSM_PSMZ16 && t->m_TEX0.PSM != PSM_PSMZ16S)
 		{
@@ -1121,7 +1175,8 @@ void GSTextureCache::InvalidateVideoMemSubTarget(GSTextureCache::Target* rt)
 			GL_INS("InvalidateVideoMemSubTarget: rt 0x%x -> 0x%x, sub rt 0x%x -> 0x%x",
 					rt->m_TEX0.TBP0, rt->m_end_block, t->m_TEX0.TBP0, t->m_end_block);
 
-			i = list.erase(i);
+			++i;
+			RemoveTarget(t);
 			delete t;
 		} else {
 			++i;
@@ -1177,7 +1232,8 @@ void GSTextureCache::IncAge()
 
 			if(++t->m_age > maxage)
 			{
-				i = list.erase(i);
+				++i;
+				RemoveTarget(t);
 				GL_CACHE("TC: Remove Target(%s): %d (0x%x) due to age", to_string(type),
 							t->m_texture ? t->m_texture->GetID() : 0,
 							t->m_TEX0.TBP0);
@@ -1544,11 +1600,65 @@ GSTextureCache::Target* GSTextureCache::CreateTarget(const GIFRegTEX0& TEX0, int
 		t->m_texture = m_renderer->m_dev->CreateSparseDepthStencil(w, h);
 	}
 
-	m_dst[type].push_front(t);
+	AddTarget(t);
 
 	return t;
 }
 
+void GSTextureCache::AddTarget(Target* t)
+{
+	t->m_erase_it = m_dst[t->m_type].InsertFront(t);
+	t->m_lru = ++m_dst_lru;
+
+	auto& bucket = m_dst_index[t->m_type][t->m_TEX0.TBP0];
+	bucket.insert(bucket.begin(), t);
+}
+
+void GSTextureCache::RemoveTarget(Target* t)
+{
+	m_dst[t->m_type].EraseIndex(t->m_erase_it);
+
+	auto& index = m_dst_index[t->m_type];
+	auto it = index.find(t->m_TEX0.TBP0);
+	ASSERT(it != index.end());
+
+	auto& bucket = it->second;
+	bucket.erase(std::find(bucket.begin(), bucket.end(), t));
+
+	if(bucket.empty())
+		index.erase(it);
+}
+
+void GSTextureCache::MoveTargetFront(Target* t)
+{
+	m_dst[t->m_type].MoveFront(t->m_erase_it);
+	t->m_lru = ++m_dst_lru;
+
+	auto& bucket = m_dst_index[t->m_type][t->m_TEX0.TBP0];
+	auto it = std::find(bucket.begin(), bucket.end(), t);
+	std::rotate(bucket.begin(), it, it + 1);
+}
+
+const std::vector<GSTextureCache::Target*>& GSTextureCache::FindTargets(int type, uint32 bp)
+{
+	static const std::vector<Target*> none;
+
+	auto it = m_dst_index[type].find(bp);
+
+	return it != m_dst_index[type].end() ? it->second : none;
+}
+
+void GSTextureCache::ClearTargets()
+{
+	for(int type = 0; type < 2; type++)
+	{
+		for (auto t : m_dst[type]) delete t;
+
+		m_dst[type].clear();
+		m_dst_index[type].clear();
+	}
+}
+
 void GSTextureCache::PrintMemoryUsage()
 {
 #ifdef ENABLE_OGL_DEBUG
@@ -2011,6 +2121,9 @@ void GSTextureCache::SourceMap::Add(Source* s, const GIFRegTEX0& TEX0, GSOffset*
 
 		s->m_erase_it[page] = m_map[page].InsertFront(s);
 
+		auto& bucket = m_index[Key(s->m_TEX0)];
+		bucket.insert(bucket.begin(), s);
+
 		return;
 	}
 
@@ -2035,6 +2148,15 @@ void GSTextureCache::SourceMap::Add(Source* s, const GIFRegTEX0& TEX0, GSOffset*
 			}
 		}
 	}
+
+	// LookupSource only ever searched the first page of the texture
+	const uint32 page = s->m_TEX0.TBP0 >> 5;
+
+	if(s->m_pages_as_bit[page >> 5] & (1u << (page & 31)))
+	{
+		auto& bucket = m_index[Key(s->m_TEX0)];
+		bucket.insert(bucket.begin(), s);
+	}
 }
 
 void GSTextureCache::SourceMap::RemoveAll()
@@ -2047,6 +2169,8 @@ void GSTextureCache::SourceMap::RemoveAll()
 	{
 		m_map[i].clear();
 	}
+
+	m_index.clear();
 }
 
 void GSTextureCache::SourceMap::RemoveAt(Source* s)
@@ -2057,6 +2181,22 @@ void GSTextureCache::SourceMap::RemoveAt(Source* s)
 				s->m_texture ? s->m_texture->GetID() : 0,
 				s->m_TEX0.TBP0);
 
+	auto it = m_index.find(Key(s->m_TEX0));
+
+	if (it != m_index.end())
+	{
+		auto& bucket = it->second;
+		auto i = std::find(bucket.begin(), bucket.end(), s);
+
+		if (i != bucket.end())
+		{
+			bucket.erase(i);
+
+			if (bucket.empty())
+				m_index.erase(it);
+		}
+	}
+
 	if (s->m_target)
 	{
 		const size_t page = s->m_TEX0.TBP0 >> 5;
@@ -2089,6 +2229,26 @@ void GSTextureCache::SourceMap::RemoveAt(Source* s)
 	delete s;
 }
 
+void GSTextureCache::SourceMap::MoveFront(Source* s)
+{
+	const size_t page = s->m_TEX0.TBP0 >> 5;
+
+	m_map[page].MoveFront(s->m_erase_it[page]);
+
+	auto& bucket = m_index[Key(s->m_TEX0)];
+	auto it = std::find(bucket.begin(), bucket.end(), s);
+	std::rotate(bucket.begin(), it, it + 1);
+}
+
+const std::vector<GSTextureCache::Source*>& GSTextureCache::SourceMap::Find(const GIFRegTEX0& TEX0) const
+{
+	static const std::vector<Source*> none;
+
+	auto it = m_index.find(Key(TEX0));
+
+	return it != m_index.end() ? it->second : none;
+}
+
 void GSTextureCache::AttachPaletteToSource(Source* s, uint16 pal, bool need_gs_texture)
 {
 	s->m_palette_obj = m_palette_map.LookupPalette(pal, need_gs_texture);
@@ -139,6 +139,10 @@ public:
 		bool m_depth_supported;
 		bool m_dirty_alpha;
 		uint32 m_end_block; // Hint of the target area
+		// Keep the m_dst iterator to allow fast erase, and when the target was last
+		// moved to the front of it to merge candidates of several index buckets
+		uint16 m_erase_it;
+		uint64 m_lru;
 
 	public:
 		Target(GSRenderer* r, const GIFRegTEX0& TEX0, uint8* temp, bool depth_supported);
@@ -174,15 +178,22 @@ public:
 	public:
 		std::unordered_set<Source*> m_surfaces;
 		std::array<FastList<Source*>, MAX_PAGES> m_map;
+		// Sources by TBP0/TBW/PSM/TW/TH, each bucket in the same order as the
+		// sources appear in the m_map list of their first page
+		std::unordered_map<uint64, std::vector<Source*>> m_index;
 		uint32 m_pages[16]; // bitmap of all pages
 		bool m_used;
 
 		SourceMap() : m_used(false) {memset(m_pages, 0, sizeof(m_pages));}
 
+		static uint64 Key(const GIFRegTEX0& TEX0) {return TEX0.u32[0] | ((uint64)(TEX0.u32[1] & 3) << 32);}
+
 		void Add(Source* s, const GIFRegTEX0& TEX0, GSOffset* off);
 		void RemoveAll();
 		void RemovePartial();
 		void RemoveAt(Source* s);
+		void MoveFront(Source* s);
+		const std::vector<Source*>& Find(const GIFRegTEX0& TEX0) const;
 	};
 
 	struct TexInsideRtCacheEntry
@@ -203,6 +214,11 @@ protected:
 	PaletteMap m_palette_map;
 	SourceMap m_src;
 	FastList<Target*> m_dst[2];
+	// Targets by TBP0, each bucket in m_dst order. TBW and PSM of a target are
+	// updated in place, only the base pointer is fixed for its whole life.
+	std::unordered_map<uint32, std::vector<Target*>> m_dst_index[2];
+	std::vector<Target*> m_dst_candidates;
+	uint64 m_dst_lru;
 	bool m_paltex;
 	bool m_preload_frame;
 	uint8* m_temp;
@@ -220,6 +236,12 @@ protected:
 
 	virtual int Get8bitFormat() = 0;
 
+	void AddTarget(Target* t);
+	void RemoveTarget(Target* t);
+	void MoveTargetFront(Target* t);
+	const std::vector<Target*>& FindTargets(int type, uint32 bp);
+	void ClearTargets();
+
 	// TODO: virtual void Write(Source* s, const GSVector4i& r) = 0;
 	// TODO: virtual void Write(Target* t, const GSVector4i& r) = 0;
 
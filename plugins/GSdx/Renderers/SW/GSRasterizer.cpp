@@ -39,31 +39,36 @@ static int compute_best_thread_height(int threads) {
 		return 4;
 }
 
-GSRasterizer::GSRasterizer(IDrawScanline* ds, int id, int threads, GSPerfMon* perfmon)
+// Maps each band of 1 << thread_height lines to its bin. The table has one
+// period of padding so a bin always finds its next band.
+static uint8* create_scanline_bins(int bins, int thread_height)
+{
+	int rows = (2048 >> thread_height) + bins;
+	uint8* scanline = (uint8*)_aligned_malloc(rows, 64);
+
+	for(int row = 0; row < rows; row++)
+	{
+		scanline[row] = (uint8)(row % bins);
+	}
+
+	return scanline;
+}
+
+GSRasterizer::GSRasterizer(IDrawScanline* ds, int id, int bins, GSPerfMon* perfmon)
 	: m_perfmon(perfmon)
 	, m_ds(ds)
 	, m_id(id)
-	, m_threads(threads)
+	, m_bins(bins)
+	, m_bin(0)
 {
 	memset(&m_pixels, 0, sizeof(m_pixels));
 
-	m_thread_height = compute_best_thread_height(threads);
+	m_thread_height = compute_best_thread_height(bins);
 
 	m_edge.buff = (GSVertexSW*)vmalloc(sizeof(GSVertexSW) * 2048, false);
 	m_edge.count = 0;
 
-	int rows = (2048 >> m_thread_height) + 16;
-	m_scanline = (uint8*)_aligned_malloc(rows, 64);
-
-	int row = 0;
-
-	while(row < rows)
-	{
-		for(int i = 0; i < threads; i++, row++)
-		{
-			m_scanline[row] = i == id ? 1 : 0;
-		}
-	}
+	m_scanline = create_scanline_bins(bins, m_thread_height);
 }
 
 GSRasterizer::~GSRasterizer()
@@ -79,7 +84,7 @@ bool GSRasterizer::IsOneOfMyScanlines(int top) const
 {
 	ASSERT(top >= 0 && top < 2048);
 
-	return m_scanline[top >> m_thread_height] != 0;
+	return m_scanline[top >> m_thread_height] == m_bin;
 }
 
 bool GSRasterizer::IsOneOfMyScanlines(int top, int bottom) const
@@ -91,7 +96,7 @@ bool GSRasterizer::IsOneOfMyScanlines(int top, int bottom) const
 
 	while(top < bottom)
 	{
-		if(m_scanline[top++])
+		if(m_scanline[top++] == m_bin)
 		{
 			return true;
 		}
@@ -104,9 +109,9 @@ int GSRasterizer::FindMyNextScanline(int top) const
 {
 	int i = top >> m_thread_height;
 
-	if(m_scanline[i] == 0)
+	if(m_scanline[i] != m_bin)
 	{
-		while(m_scanline[++i] == 0);
+		while(m_scanline[++i] != m_bin);
 
 		top = i << m_thread_height;
 	}
@@ -131,12 +136,14 @@ int GSRasterizer::GetPixels(bool reset)
 	return pixels;
 }
 
-void GSRasterizer::Draw(GSRasterizerData* data)
+void GSRasterizer::Draw(GSRasterizerData* data, int bin)
 {
 	GSPerfMonAutoTimer pmat(m_perfmon, GSPerfMon::WorkerDraw0 + m_id);
 
 	if(data->vertex != NULL && data->vertex_count == 0 || data->index != NULL && data->index_count == 0) return;
 
+	m_bin = bin;
+
 	m_pixels.actual = 0;
 	m_pixels.total = 0;
 
@@ -575,7 +582,7 @@ void GSRasterizer::DrawTriangleSection(int top, int bottom, GSVertexSW2& edge, c
 
 		if(!IsOneOfMyScanlines(top))
 		{
-			top += (m_threads - 1) << m_thread_height;
+			top += (m_bins - 1) << m_thread_height;
 		}
 	}
 
@@ -766,7 +773,7 @@ void GSRasterizer::DrawTriangleSection(int top, int bottom, GSVertexSW& edge, co
 
 		if(!IsOneOfMyScanlines(top))
 		{
-			top += (m_threads - 1) << m_thread_height;
+			top += (m_bins - 1) << m_thread_height;
 		}
 	}
 
@@ -801,7 +808,7 @@ void GSRasterizer::DrawSprite(const GSVertexSW* vertex, const uint32* index)
 
 	if(m_ds->IsSolidRect())
 	{
-		if(m_threads == 1)
+		if(m_bins == 1)
 		{
 			m_ds->DrawRect(r, scan);
 
@@ -827,7 +834,7 @@ void GSRasterizer::DrawSprite(const GSVertexSW* vertex, const uint32* index)
 				m_pixels.actual += pixels;
 				m_pixels.total += pixels;
 
-				top = r.bottom + ((m_threads - 1) << m_thread_height);
+				top = r.bottom + ((m_bins - 1) << m_thread_height);
 			}
 		}
 
@@ -1139,28 +1146,70 @@ void GSRasterizer::DrawEdge(int pixels, int left, int top, const GSVertexSW& sca
 
 GSRasterizerList::GSRasterizerList(int threads, GSPerfMon* perfmon)
 	: m_perfmon(perfmon)
+	, m_ready(0)
+	, m_pending(0)
+	, m_sleeping(0)
+	, m_exit(false)
 {
-	m_thread_height = compute_best_thread_height(threads);
+	int bins = GetBinCount(threads);
 
-	int rows = (2048 >> m_thread_height) + 16;
-	m_scanline = (uint8*)_aligned_malloc(rows, 64);
+	m_thread_height = compute_best_thread_height(bins);
 
-	int row = 0;
+	m_scanline = create_scanline_bins(bins, m_thread_height);
 
-	while(row < rows)
+	for(int i = 0; i < bins; i++)
 	{
-		for(int i = 0; i < threads; i++, row++)
-		{
-			m_scanline[row] = (uint8)i;
-		}
+		m_bins.push_back(std::unique_ptr<Bin>(new Bin()));
+	}
+
+	for(auto& ready : m_ready_bins)
+	{
+		ready = 0;
 	}
 }
 
 GSRasterizerList::~GSRasterizerList()
 {
+	{
+		std::lock_guard<std::mutex> l(m_lock);
+		m_exit = true;
+	}
+	m_notempty.notify_all();
+
+	for(auto& w : m_workers)
+	{
+		w->thread.join();
+	}
+
 	_aligned_free(m_scanline);
 }
 
+int GSRasterizerList::GetBinCount(int threads)
+{
+	// More bins than workers, so there is something left to steal when the
+	// bands of a draw aren't evenly loaded. Every bin drawn means one more
+	// primitive setup though. At most 32 * countof(m_ready_bins).
+	return std::min<int>(threads * 2, 128);
+}
+
+void GSRasterizerList::Start()
+{
+	for(size_t i = 0; i < m_r.size(); i++)
+	{
+		m_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+
+	for(size_t bin = 0; bin < m_bins.size(); bin++)
+	{
+		m_workers[bin % m_workers.size()]->home[bin >> 5] |= 1u << (bin & 31);
+	}
+
+	for(size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i]->thread = std::thread(&GSRasterizerList::ThreadProc, this, (int)i);
+	}
+}
+
 void GSRasterizerList::Queue(const std::shared_ptr<GSRasterizerData>& data)
 {
 	GSVector4i r = data->bbox.rintersect(data->scissor);
@@ -1168,48 +1217,178 @@ void GSRasterizerList::Queue(const std::shared_ptr<GSRasterizerData>& data)
 	ASSERT(r.top >= 0 && r.top < 2048 && r.bottom >= 0 && r.bottom < 2048);
 
 	int top = r.top >> m_thread_height;
-	int bottom = std::min<int>((r.bottom + (1 << m_thread_height) - 1) >> m_thread_height, top + m_workers.size());
+	int bottom = std::min<int>((r.bottom + (1 << m_thread_height) - 1) >> m_thread_height, top + m_bins.size());
 
 	while(top < bottom)
 	{
-		m_workers[m_scanline[top++]]->Push(data);
+		Push(m_scanline[top++], data);
 	}
 }
 
-void GSRasterizerList::Sync()
+void GSRasterizerList::Push(int bin, const std::shared_ptr<GSRasterizerData>& data)
 {
-	if(!IsSynced())
+	Bin& b = *m_bins[bin];
+
+	m_pending++;
+
+	while(!b.queue.push(data))
+	{
+		std::this_thread::yield();
+	}
+
+	if(b.count++ > 0)
+	{
+		return; // already ready, or being drawn
+	}
+
+	m_ready++;
+	m_ready_bins[bin >> 5].fetch_or(1u << (bin & 31));
+
+	// Paired with ThreadProc: either it sees m_ready or we see it sleeping
+	if(m_sleeping > 0)
 	{
-		for(size_t i = 0; i < m_workers.size(); i++)
 		{
-			m_workers[i]->Wait();
+			std::lock_guard<std::mutex> l(m_lock);
 		}
+		m_notempty.notify_one();
+	}
+}
 
-		m_perfmon->Put(GSPerfMon::SyncPoint, 1);
+int GSRasterizerList::Take(int id)
+{
+	Worker& w = *m_workers[id];
+
+	for(int steal = 0; steal < 2; steal++)
+	{
+		for(size_t i = 0; i < countof(m_ready_bins); i++)
+		{
+			uint32 ready = m_ready_bins[i].load(std::memory_order_relaxed) & (steal ? ~w.home[i] : w.home[i]);
+			unsigned long bit;
+
+			while(_BitScanForward(&bit, ready))
+			{
+				uint32 mask = 1u << bit;
+
+				// Whoever clears the bit owns the bin
+				if(m_ready_bins[i].fetch_and(~mask) & mask)
+				{
+					m_ready--;
+
+					if(steal)
+					{
+						w.steals++;
+					}
+
+					return (int)(i << 5) + (int)bit;
+				}
+
+				ready &= ~mask;
+			}
+		}
 	}
+
+	return -1;
 }
 
-bool GSRasterizerList::IsSynced() const
+void GSRasterizerList::DrawBin(int id, int bin)
 {
-	for(size_t i = 0; i < m_workers.size(); i++)
+	Bin& b = *m_bins[bin];
+	GSRasterizer& r = *m_r[id];
+
+	std::shared_ptr<GSRasterizerData> item;
+
+	// The count was raised after the push of each draw it accounts for
+	do
 	{
-		if(!m_workers[i]->IsEmpty())
+		b.queue.pop(item);
+
+		ASSERT(item);
+
+		r.Draw(item.get(), bin);
+
+		item.reset();
+
+		if(--m_pending == 0)
 		{
-			return false;
+			{
+				std::lock_guard<std::mutex> l(m_wait_lock);
+			}
+			m_empty.notify_all();
 		}
 	}
+	while(--b.count > 0);
+}
+
+void GSRasterizerList::ThreadProc(int id)
+{
+	while(true)
+	{
+		int bin = Take(id);
 
-	return true;
+		if(bin >= 0)
+		{
+			DrawBin(id, bin);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> l(m_lock);
+
+		m_sleeping++;
+
+		while(m_ready == 0 && !m_exit)
+		{
+			m_notempty.wait(l);
+		}
+
+		m_sleeping--;
+
+		if(m_exit)
+		{
+			return;
+		}
+	}
+}
+
+void GSRasterizerList::Sync()
+{
+	if(!IsSynced())
+	{
+		std::unique_lock<std::mutex> l(m_wait_lock);
+
+		while(m_pending > 0)
+		{
+			m_empty.wait(l);
+		}
+
+		m_perfmon->Put(GSPerfMon::SyncPoint, 1);
+	}
+}
+
+bool GSRasterizerList::IsSynced() const
+{
+	return m_pending == 0;
 }
 
 int GSRasterizerList::GetPixels(bool reset)
 {
 	int pixels = 0;
 
-	for(size_t i = 0; i < m_workers.size(); i++)
+	for(size_t i = 0; i < m_r.size(); i++)
 	{
 		pixels += m_r[i]->GetPixels(reset);
 	}
 
 	return pixels;
 }
+
+int GSRasterizerList::GetSteals(bool reset)
+{
+	int steals = 0;
+
+	for(auto& w : m_workers)
+	{
+		steals += reset ? w->steals.exchange(0) : w->steals.load();
+	}
+
+	return steals;
+}
@@ -119,6 +119,7 @@ public:
 	virtual void Sync() = 0;
 	virtual bool IsSynced() const = 0;
 	virtual int GetPixels(bool reset = true) = 0;
+	virtual int GetSteals(bool reset = true) = 0;
 	virtual void PrintStats() = 0;
 };
 
@@ -128,7 +129,8 @@ protected:
 	GSPerfMon* m_perfmon;
 	IDrawScanline* m_ds;
 	int m_id;
-	int m_threads;
+	int m_bins;
+	int m_bin;
 	int m_thread_height;
 	uint8* m_scanline;
 	GSVector4i m_scissor;
@@ -160,14 +162,14 @@ protected:
 	__forceinline void DrawEdge(int pixels, int left, int top, const GSVertexSW& scan);
 
 public:
-	GSRasterizer(IDrawScanline* ds, int id, int threads, GSPerfMon* perfmon);
+	GSRasterizer(IDrawScanline* ds, int id, int bins, GSPerfMon* perfmon);
 	virtual ~GSRasterizer();
 
 	__forceinline bool IsOneOfMyScanlines(int top) const;
 	__forceinline bool IsOneOfMyScanlines(int top, int bottom) const;
 	__forceinline int FindMyNextScanline(int top) const;
 
-	void Draw(GSRasterizerData* data);
+	void Draw(GSRasterizerData* data, int bin = 0);
 
 	// IRasterizer
 
@@ -175,23 +177,65 @@ public:
 	void Sync() {}
 	bool IsSynced() const {return true;}
 	int GetPixels(bool reset);
+	int GetSteals(bool reset) {return 0;}
 	void PrintStats() {m_ds->PrintStats();}
 };
 
 class GSRasterizerList : public IRasterizer
 {
 protected:
-	using GSWorker = GSJobQueue<std::shared_ptr<GSRasterizerData>, 65536>;
+	// The screen is cut in bands of 1 << m_thread_height lines, interleaved over
+	// m_bins bins. A bin queues the draws touching its bands, in order, and is
+	// drawn by one worker at a time so pixels are still written in draw order.
+	// The producer doesn't lock anything: a bin is a single producer single
+	// consumer ring, the push taking its count from 0 to 1 sets its bit in
+	// m_ready_bins, and the worker that cleared the bit owns the bin until the
+	// count drops back to 0. Workers take their home bins first, then steal.
+	struct Bin : public GSAlignedClass<64>
+	{
+		ringbuffer_base<std::shared_ptr<GSRasterizerData>, 32768> queue;
+		std::atomic<int> count; // pushed and not drawn, > 0 while ready or being drawn
+
+		Bin() : count(0) {}
+	};
+
+	struct Worker : public GSAlignedClass<64>
+	{
+		std::thread thread;
+		uint32 home[4]; // its bins in m_ready_bins
+		std::atomic<int> steals;
+
+		Worker() : steals(0) { memset(home, 0, sizeof(home)); }
+	};
 
 	GSPerfMon* m_perfmon;
 	// Worker threads depend on the rasterizers, so don't change the order.
 	std::vector<std::unique_ptr<GSRasterizer>> m_r;
-	std::vector<std::unique_ptr<GSWorker>> m_workers;
+	std::vector<std::unique_ptr<Bin>> m_bins;
+	std::vector<std::unique_ptr<Worker>> m_workers;
 	uint8* m_scanline;
 	int m_thread_height;
 
+	std::atomic<uint32> m_ready_bins[4]; // one bit per bin waiting for a worker, 128 bins at most
+	std::atomic<int> m_ready;   // bins waiting for a worker, set before their bit
+	std::atomic<int> m_pending; // draws queued in the bins, not drawn yet
+	std::atomic<int> m_sleeping;
+	bool m_exit;
+	std::mutex m_lock;
+	std::mutex m_wait_lock;
+	std::condition_variable m_notempty;
+	std::condition_variable m_empty;
+
 	GSRasterizerList(int threads, GSPerfMon* perfmon);
 
+	static int GetBinCount(int threads);
+
+	void Start();
+	void Push(int bin, const std::shared_ptr<GSRasterizerData>& data);
+	int Take(int id);
+	void DrawBin(int id, int bin);
+	void ThreadProc(int id);
+
 public:
 	virtual ~GSRasterizerList();
 
@@ -208,12 +252,11 @@ public:
 
 		for(int i = 0; i < threads; i++)
 		{
-			rl->m_r.push_back(std::unique_ptr<GSRasterizer>(new GSRasterizer(new DS(), i, threads, perfmon)));
-			auto &r = *rl->m_r[i];
-			rl->m_workers.push_back(std::unique_ptr<GSWorker>(new GSWorker(
-				[&r](std::shared_ptr<GSRasterizerData> &item) { r.Draw(item.get()); })));
+			rl->m_r.push_back(std::unique_ptr<GSRasterizer>(new GSRasterizer(new DS(), i, GetBinCount(threads), perfmon)));
 		}
 
+		rl->Start();
+
 		return rl;
 	}
 
@@ -223,5 +266,6 @@ public:
 	void Sync();
 	bool IsSynced() const;
 	int GetPixels(bool reset);
+	int GetSteals(bool reset);
 	void PrintStats() {}
 };
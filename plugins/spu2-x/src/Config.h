@@ -64,6 +64,8 @@ extern wxString RegDumpFileName;
 extern int Interpolation;
 extern int numSpeakers;
 extern bool EffectsDisabled;
+extern bool SimdMixing;
+extern bool BatchMixing;
 extern float FinalVolume; // Global / pre-scale
 extern bool AdvancedVolumeControl;
 extern float VolumeAdjustFLdb;
@@ -72,6 +72,8 @@ static __forceinline bool RegDump() { return _RegDump & DebugEnabled; }*/
 
 extern int Interpolation;
 extern bool EffectsDisabled;
+extern bool SimdMixing;
+extern bool BatchMixing;
 extern float FinalVolume;
 extern bool postprocess_filter_enabled;
 extern bool postprocess_filter_dealias;
@@ -16,6 +16,7 @@
  */
 
 #include "Global.h"
+#include "MixerVoice.h"
 
 // Games have turned out to be surprisingly sensitive to whether a parked, silent voice is being fully emulated.
 // With Silent Hill: Shattered Memories requiring full processing for no obvious reason, we've decided to
@@ -33,24 +34,6 @@ static const s32 tbl_XA_Factor[16][2] =
         {122, -60}};
 
 
-// Performs a 64-bit multiplication between two values and returns the
-// high 32 bits as a result (discarding the fractional 32 bits).
-// The combined fractional bits of both inputs must be 32 bits for this
-// to work properly.
-//
-// This is meant to be a drop-in replacement for times when the 'div' part
-// of a MulDiv is a constant.  (example: 1<<8, or 4096, etc)
-//
-// [Air] Performance breakdown: This is over 10 times faster than MulDiv in
-//   a *worst case* scenario.  It's also more accurate since it forces the
-//   caller to  extend the inputs so that they make use of all 32 bits of
-//   precision.
-//
-static __forceinline s32 MulShr32(s32 srcval, s32 mulval)
-{
-    return (s64)srcval * mulval >> 32;
-}
-
 __forceinline s32 clamp_mix(s32 x, u8 bitshift)
 {
     assert(bitshift <= 15);
@@ -268,15 +251,6 @@ static s32 __forceinline GetNoiseValues()
 /////////////////////////////////////////////////////////////////////////////////////////
 //                                                                                     //
 
-// Data is expected to be 16 bit signed (typical stuff!).
-// volume is expected to be 32 bit signed (31 bits with reverse phase)
-// Data is shifted up by 1 bit to give the output an effective 16 bit range.
-static __forceinline s32 ApplyVolume(s32 data, s32 volume)
-{
-    //return (volume * data) >> 15;
-    return MulShr32(data << 1, volume);
-}
-
 static __forceinline StereoOut32 ApplyVolume(const StereoOut32 &data, const V_VolumeLR &volume)
 {
     return StereoOut32(
@@ -329,82 +303,10 @@ static __forceinline void CalculateADSR(V_Core &thiscore, uint voiceidx)
     pxAssume(vc.ADSR.Value >= 0); // ADSR should never be negative...
 }
 
-/*
-   Tension: 65535 is high, 32768 is normal, 0 is low
-*/
-template <s32 i_tension>
-__forceinline static s32 HermiteInterpolate(
-    s32 y0, // 16.0
-    s32 y1, // 16.0
-    s32 y2, // 16.0
-    s32 y3, // 16.0
-    s32 mu  //  0.12
-    )
-{
-    s32 m00 = ((y1 - y0) * i_tension) >> 16; // 16.0
-    s32 m01 = ((y2 - y1) * i_tension) >> 16; // 16.0
-    s32 m0 = m00 + m01;
-
-    s32 m10 = ((y2 - y1) * i_tension) >> 16; // 16.0
-    s32 m11 = ((y3 - y2) * i_tension) >> 16; // 16.0
-    s32 m1 = m10 + m11;
-
-    s32 val = ((2 * y1 + m0 + m1 - 2 * y2) * mu) >> 12;       // 16.0
-    val = ((val - 3 * y1 - 2 * m0 - m1 + 3 * y2) * mu) >> 12; // 16.0
-    val = ((val + m0) * mu) >> 11;                            // 16.0
-
-    return (val + (y1 << 1));
-}
-
-__forceinline static s32 CatmullRomInterpolate(
-    s32 y0, // 16.0
-    s32 y1, // 16.0
-    s32 y2, // 16.0
-    s32 y3, // 16.0
-    s32 mu  //  0.12
-    )
-{
-    //q(t) = 0.5 *(    	(2 * P1) +
-    //	(-P0 + P2) * t +
-    //	(2*P0 - 5*P1 + 4*P2 - P3) * t2 +
-    //	(-P0 + 3*P1- 3*P2 + P3) * t3)
-
-    s32 a3 = (-y0 + 3 * y1 - 3 * y2 + y3);
-    s32 a2 = (2 * y0 - 5 * y1 + 4 * y2 - y3);
-    s32 a1 = (-y0 + y2);
-    s32 a0 = (2 * y1);
-
-    s32 val = ((a3)*mu) >> 12;
-    val = ((a2 + val) * mu) >> 12;
-    val = ((a1 + val) * mu) >> 12;
-
-    return (a0 + val);
-}
-
-__forceinline static s32 CubicInterpolate(
-    s32 y0, // 16.0
-    s32 y1, // 16.0
-    s32 y2, // 16.0
-    s32 y3, // 16.0
-    s32 mu  //  0.12
-    )
-{
-    const s32 a0 = y3 - y2 - y0 + y1;
-    const s32 a1 = y0 - y1 - a0;
-    const s32 a2 = y2 - y0;
-
-    s32 val = ((a0)*mu) >> 12;
-    val = ((val + a1) * mu) >> 12;
-    val = ((val + a2) * mu) >> 11;
-
-    return (val + (y1 << 1));
-}
-
-// Returns a 16 bit result in Value.
-// Uses standard template-style optimization techniques to statically generate five different
-// versions of this function (one for each type of interpolation).
+// Decodes samples up to the voice's current position, shifting the previous values
+// kept for interpolation.  Only cubic and above use PV3 and PV4.
 template <int InterpType>
-static __forceinline s32 GetVoiceValues(V_Core &thiscore, uint voiceidx)
+static __forceinline void UpdateVoiceValues(V_Core &thiscore, uint voiceidx)
 {
     V_Voice &vc(thiscore.Voices[voiceidx]);
 
@@ -417,26 +319,6 @@ static __forceinline s32 GetVoiceValues(V_Core &thiscore, uint voiceidx)
         vc.PV1 = GetNextDataBuffered(thiscore, voiceidx);
         vc.SP -= 4096;
     }
-
-    const s32 mu = vc.SP + 4096;
-
-    switch (InterpType) {
-        case 0:
-            return vc.PV1 << 1;
-        case 1:
-            return (vc.PV1 << 1) - (((vc.PV2 - vc.PV1) * vc.SP) >> 11);
-
-        case 2:
-            return CubicInterpolate(vc.PV4, vc.PV3, vc.PV2, vc.PV1, mu);
-        case 3:
-            return HermiteInterpolate<16384>(vc.PV4, vc.PV3, vc.PV2, vc.PV1, mu);
-        case 4:
-            return CatmullRomInterpolate(vc.PV4, vc.PV3, vc.PV2, vc.PV1, mu);
-
-            jNO_DEFAULT;
-    }
-
-    return 0; // technically unreachable!
 }
 
 // Noise values need to be mixed without going through interpolation, since it
@@ -485,7 +367,11 @@ static __forceinline void spu2M_WriteFast(u32 addr, s16 value)
 }
 
 
-static __forceinline StereoOut32 MixVoice(uint coreidx, uint voiceidx)
+// Advances the voice by one sample: volume slides, pitch, decoding, envelope, and the
+// modulation and write-back outputs.  Returns false if the voice is silent.  Otherwise
+// PV1-PV4, SP and ADSR.Value hold everything needed to compute its output, and noise
+// voices get their value in NoiseValue.
+static __forceinline bool UpdateVoice(uint coreidx, uint voiceidx, s32 &NoiseValue)
 {
     V_Core &thiscore(Cores[coreidx]);
     V_Voice &vc(thiscore.Voices[voiceidx]);
@@ -507,44 +393,15 @@ static __forceinline StereoOut32 MixVoice(uint coreidx, uint voiceidx)
     if (vc.ADSR.Phase > 0) {
         UpdatePitch(coreidx, voiceidx);
 
-        s32 Value = 0;
-
         if (vc.Noise)
-            Value = GetNoiseValues(thiscore, voiceidx);
-        else {
-            // Optimization : Forceinline'd Templated Dispatch Table.  Any halfwit compiler will
-            // turn this into a clever jump dispatch table (no call/rets, no compares, uber-efficient!)
-
-            switch (Interpolation) {
-                case 0:
-                    Value = GetVoiceValues<0>(thiscore, voiceidx);
-                    break;
-                case 1:
-                    Value = GetVoiceValues<1>(thiscore, voiceidx);
-                    break;
-                case 2:
-                    Value = GetVoiceValues<2>(thiscore, voiceidx);
-                    break;
-                case 3:
-                    Value = GetVoiceValues<3>(thiscore, voiceidx);
-                    break;
-                case 4:
-                    Value = GetVoiceValues<4>(thiscore, voiceidx);
-                    break;
-
-                    jNO_DEFAULT;
-            }
-        }
-
-        // Update and Apply ADSR  (applies to normal and noise sources)
-        //
-        // Note!  It's very important that ADSR stay as accurate as possible.  By the way
-        // it is used, various sound effects can end prematurely if we truncate more than
-        // one or two bits.  Best result comes from no truncation at all, which is why we
-        // use a full 64-bit multiply/result here.
+            NoiseValue = GetNoiseValues(thiscore, voiceidx);
+        else if (Interpolation >= 2)
+            UpdateVoiceValues<2>(thiscore, voiceidx);
+        else
+            UpdateVoiceValues<1>(thiscore, voiceidx);
 
+        // Update ADSR  (applies to normal and noise sources)
         CalculateADSR(thiscore, voiceidx);
-        Value = MulShr32(Value, vc.ADSR.Value);
 
         // Store Value for eventual modulation later
         // Pseudonym's Crest calculation idea. Actually calculates a crest, unlike the old code which was just peak.
@@ -566,7 +423,7 @@ static __forceinline StereoOut32 MixVoice(uint coreidx, uint voiceidx)
         else if (voiceidx == 3)
             spu2M_WriteFast(((0 == coreidx) ? 0x600 : 0xe00) + OutPos, vc.OutX);
 
-        return ApplyVolume(StereoOut32(Value, Value), vc.Volume);
+        return true;
     } else {
         // Continue processing voice, even if it's "off". Or else we miss interrupts! (Fatal Frame engine died because of this.)
         if (NEVER_SKIP_VOICES || (*GetMemPtr(vc.NextA & 0xFFFF8) >> 8 & 3) != 3 || vc.LoopStartA != (vc.NextA & ~7)    // not in a tight loop
@@ -585,7 +442,135 @@ static __forceinline StereoOut32 MixVoice(uint coreidx, uint voiceidx)
         else if (voiceidx == 3)
             spu2M_WriteFast(((0 == coreidx) ? 0x600 : 0xe00) + OutPos, 0);
 
+        return false;
+    }
+}
+
+static __forceinline StereoOut32 MixVoice(uint coreidx, uint voiceidx)
+{
+    V_Voice &vc(Cores[coreidx].Voices[voiceidx]);
+    s32 Value = 0;
+
+    if (!UpdateVoice(coreidx, voiceidx, Value))
         return StereoOut32(0, 0);
+
+    if (!vc.Noise) {
+        // Optimization : Forceinline'd Templated Dispatch Table.  Any halfwit compiler will
+        // turn this into a clever jump dispatch table (no call/rets, no compares, uber-efficient!)
+
+        switch (Interpolation) {
+            case 0:
+                Value = GetVoiceValues<0>(vc.PV1, vc.PV2, vc.PV3, vc.PV4, vc.SP);
+                break;
+            case 1:
+                Value = GetVoiceValues<1>(vc.PV1, vc.PV2, vc.PV3, vc.PV4, vc.SP);
+                break;
+            case 2:
+                Value = GetVoiceValues<2>(vc.PV1, vc.PV2, vc.PV3, vc.PV4, vc.SP);
+                break;
+            case 3:
+                Value = GetVoiceValues<3>(vc.PV1, vc.PV2, vc.PV3, vc.PV4, vc.SP);
+                break;
+            case 4:
+                Value = GetVoiceValues<4>(vc.PV1, vc.PV2, vc.PV3, vc.PV4, vc.SP);
+                break;
+
+                jNO_DEFAULT;
+        }
+    }
+
+    // Apply ADSR
+    //
+    // Note!  It's very important that ADSR stay as accurate as possible.  By the way
+    // it is used, various sound effects can end prematurely if we truncate more than
+    // one or two bits.  Best result comes from no truncation at all, which is why we
+    // use a full 64-bit multiply/result here.
+
+    Value = MulShr32(Value, vc.ADSR.Value);
+
+    return ApplyVolume(StereoOut32(Value, Value), vc.Volume);
+}
+
+// --------------------------------------------------------------------------------------
+//  SIMD voice mixing (the lane math is in MixerVoice.h)
+// --------------------------------------------------------------------------------------
+
+static VoiceLanes VoiceLaneState;
+
+static_assert(V_Core::NumVoices == NumVoiceLanes, "One lane per voice");
+
+// Checks the lanes against the scalar interpolation, envelope and volume code.
+template <int InterpType>
+static void CheckVoiceLanes(const VoiceLanes &lanes, uint coreidx)
+{
+    for (uint i = 0; i < V_Core::NumVoices; ++i) {
+        s32 Value = lanes.Noise[i] ? lanes.NoiseValue[i] : GetVoiceValues<InterpType>(lanes.PV1[i], lanes.PV2[i], lanes.PV3[i], lanes.PV4[i], lanes.SP[i]);
+        Value = MulShr32(Value, lanes.ADSR[i]);
+
+        if (ApplyVolume(Value, lanes.VolL[i]) != lanes.OutL[i] || ApplyVolume(Value, lanes.VolR[i]) != lanes.OutR[i]) {
+            ConLog("* SPU2-X: SIMD mix mismatch on core %u voice %u: %d,%d != %d,%d\n", coreidx, i,
+                   lanes.OutL[i], lanes.OutR[i], ApplyVolume(Value, lanes.VolL[i]), ApplyVolume(Value, lanes.VolR[i]));
+            pxFailDev("SPU2-X: SIMD voice mixing doesn't match the scalar mixer");
+        }
+    }
+}
+
+static __forceinline void MixCoreVoicesSIMD(VoiceMixSet &dest, const uint coreidx)
+{
+    V_Core &thiscore(Cores[coreidx]);
+    VoiceLanes &lanes(VoiceLaneState);
+
+    for (uint voiceidx = 0; voiceidx < V_Core::NumVoices; ++voiceidx) {
+        const V_Voice &vc(thiscore.Voices[voiceidx]);
+        s32 NoiseValue = 0;
+
+        // A zero envelope is all it takes to silence a voice.
+        lanes.ADSR[voiceidx] = UpdateVoice(coreidx, voiceidx, NoiseValue) ? vc.ADSR.Value : 0;
+
+        lanes.PV1[voiceidx] = vc.PV1;
+        lanes.PV2[voiceidx] = vc.PV2;
+        lanes.PV3[voiceidx] = vc.PV3;
+        lanes.PV4[voiceidx] = vc.PV4;
+        lanes.SP[voiceidx] = vc.SP;
+        lanes.Noise[voiceidx] = vc.Noise ? -1 : 0;
+        lanes.NoiseValue[voiceidx] = NoiseValue;
+        lanes.VolL[voiceidx] = vc.Volume.Left.Value;
+        lanes.VolR[voiceidx] = vc.Volume.Right.Value;
+
+        lanes.DryL[voiceidx] = thiscore.VoiceGates[voiceidx].DryL;
+        lanes.DryR[voiceidx] = thiscore.VoiceGates[voiceidx].DryR;
+        lanes.WetL[voiceidx] = thiscore.VoiceGates[voiceidx].WetL;
+        lanes.WetR[voiceidx] = thiscore.VoiceGates[voiceidx].WetR;
+    }
+
+    switch (Interpolation) {
+        case 0:
+            MixVoiceLanes<0>(dest, lanes);
+            if (IsDevBuild)
+                CheckVoiceLanes<0>(lanes, coreidx);
+            break;
+        case 1:
+            MixVoiceLanes<1>(dest, lanes);
+            if (IsDevBuild)
+                CheckVoiceLanes<1>(lanes, coreidx);
+            break;
+        case 2:
+            MixVoiceLanes<2>(dest, lanes);
+            if (IsDevBuild)
+                CheckVoiceLanes<2>(lanes, coreidx);
+            break;
+        case 3:
+            MixVoiceLanes<3>(dest, lanes);
+            if (IsDevBuild)
+                CheckVoiceLanes<3>(lanes, coreidx);
+            break;
+        case 4:
+            MixVoiceLanes<4>(dest, lanes);
+            if (IsDevBuild)
+                CheckVoiceLanes<4>(lanes, coreidx);
+            break;
+
+            jNO_DEFAULT;
     }
 }
 
@@ -593,6 +578,11 @@ const VoiceMixSet VoiceMixSet::Empty((StereoOut32()), (StereoOut32())); // Don't
 
 static __forceinline void MixCoreVoices(VoiceMixSet &dest, const uint coreidx)
 {
+    if (SimdMixing) {
+        MixCoreVoicesSIMD(dest, coreidx);
+        return;
+    }
+
     V_Core &thiscore(Cores[coreidx]);
 
     for (uint voiceidx = 0; voiceidx < V_Core::NumVoices; ++voiceidx) {
@@ -779,8 +769,8 @@ static int p_cachestat_counter = 0;
 #ifndef __POSIX__
 __forceinline
 #endif
-    void
-    Mix()
+    static StereoOut32
+    MixSample()
 {
     // Note: Playmode 4 is SPDIF, which overrides other inputs.
     StereoOut32 InputData[2] =
@@ -855,8 +845,6 @@ __forceinline
     Out.Left *= FinalVolume;
     Out.Right *= FinalVolume;
 
-    SndBuffer::Write(Out);
-
     // Update AutoDMA output positioning
     OutPos++;
     if (OutPos >= 0x200)
@@ -877,4 +865,39 @@ __forceinline
                     g_counter_cache_ignores = 0;
         }
     }
+
+    return Out;
+}
+
+void Mix()
+{
+    SndBuffer::Write(MixSample());
+}
+
+// Mixes up to count samples back to back, advancing Cycles for each one.  The caller
+// makes sure nothing else happens in between (DMA interrupts, key ons); a sample that
+// hits an IRQ address ends the batch early, so the IRQ callback is made on the next
+// tick, just like with single stepping.  Returns the number of samples mixed.
+uint MixBatch(uint count)
+{
+    StereoOut32 Out[SndOutPacketSize];
+    uint done = 0;
+
+    while (done < count) {
+        const uint n = std::min<uint>(count - done, SndOutPacketSize);
+        uint i = 0;
+
+        while (i < n && !has_to_call_irq) {
+            Cycles++;
+            Out[i++] = MixSample();
+        }
+
+        SndBuffer::Write(Out, i);
+        done += i;
+
+        if (has_to_call_irq)
+            break;
+    }
+
+    return done;
 }
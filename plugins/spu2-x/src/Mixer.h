@@ -130,6 +130,7 @@ struct FrequencyResponseFilter
 };
 
 extern void Mix();
+extern uint MixBatch(uint count);
 extern s32 clamp_mix(s32 x, u8 bitshift = 0);
 
 extern StereoOut32 clamp_mix(const StereoOut32 &sample, u8 bitshift = 0);
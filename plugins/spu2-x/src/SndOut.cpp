@@ -111,8 +111,16 @@ int FindOutputModuleById(const wchar_t *omodid)
 
 StereoOut32 *SndBuffer::m_buffer;
 s32 SndBuffer::m_size;
-__aligned(4) volatile s32 SndBuffer::m_rpos;
-__aligned(4) volatile s32 SndBuffer::m_wpos;
+s32 SndBuffer::m_target;
+std::atomic<s32> SndBuffer::m_rpos;
+std::atomic<s32> SndBuffer::m_wpos;
+
+std::atomic<u32> SndBuffer::m_underruns;
+std::atomic<u32> SndBuffer::m_overruns;
+std::atomic<u32> SndBuffer::m_dropped;
+std::atomic<u32> SndBuffer::m_tempoAdjusts;
+int SndBuffer::m_statsSamples = 0;
+SndBufferStats SndBuffer::m_lastStats;
 
 bool SndBuffer::m_underrun_freeze;
 StereoOut32 *SndBuffer::sndTempBuffer = NULL;
@@ -150,6 +158,7 @@ bool SndBuffer::CheckUnderrunStatus(int &nSamples, int &quietSampleCount)
         nSamples = data;
         quietSampleCount = SndOutPacketSize - data;
         m_underrun_freeze = true;
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
 
         if (SynchMode == 0) // TimeStrech on
             timeStretchUnderrun();
@@ -171,7 +180,8 @@ void SndBuffer::_InitFail()
 int SndBuffer::_GetApproximateDataInBuffer()
 {
     // WARNING: not necessarily 100% up to date by the time it's used, but it will have to do.
-    return (m_wpos + m_size - m_rpos) % m_size;
+    // The acquire loads make the other side's samples (or free space) visible to us.
+    return (m_wpos.load(std::memory_order_acquire) + m_size - m_rpos.load(std::memory_order_acquire)) % m_size;
 }
 
 void SndBuffer::_WriteSamples_Internal(StereoOut32 *bData, int nSamples)
@@ -179,28 +189,30 @@ void SndBuffer::_WriteSamples_Internal(StereoOut32 *bData, int nSamples)
     // WARNING: This assumes the write will NOT wrap around,
     // and also assumes there's enough free space in the buffer.
 
-    memcpy(m_buffer + m_wpos, bData, nSamples * sizeof(StereoOut32));
-    m_wpos = (m_wpos + nSamples) % m_size;
+    const s32 wpos = m_wpos.load(std::memory_order_relaxed);
+    memcpy(m_buffer + wpos, bData, nSamples * sizeof(StereoOut32));
+    m_wpos.store((wpos + nSamples) % m_size, std::memory_order_release);
 }
 
 void SndBuffer::_DropSamples_Internal(int nSamples)
 {
-    m_rpos = (m_rpos + nSamples) % m_size;
+    m_rpos.store((m_rpos.load(std::memory_order_relaxed) + nSamples) % m_size, std::memory_order_release);
 }
 
 void SndBuffer::_ReadSamples_Internal(StereoOut32 *bData, int nSamples)
 {
     // WARNING: This assumes the read will NOT wrap around,
     // and also assumes there's enough data in the buffer.
-    memcpy(bData, m_buffer + m_rpos, nSamples * sizeof(StereoOut32));
+    memcpy(bData, m_buffer + m_rpos.load(std::memory_order_relaxed), nSamples * sizeof(StereoOut32));
     _DropSamples_Internal(nSamples);
 }
 
 void SndBuffer::_WriteSamples_Safe(StereoOut32 *bData, int nSamples)
 {
     // WARNING: This code assumes there's only ONE writing process.
-    if ((m_size - m_wpos) < nSamples) {
-        int b1 = m_size - m_wpos;
+    const s32 wpos = m_wpos.load(std::memory_order_relaxed);
+    if ((m_size - wpos) < nSamples) {
+        int b1 = m_size - wpos;
         int b2 = nSamples - b1;
 
         _WriteSamples_Internal(bData, b1);
@@ -213,8 +225,9 @@ void SndBuffer::_WriteSamples_Safe(StereoOut32 *bData, int nSamples)
 void SndBuffer::_ReadSamples_Safe(StereoOut32 *bData, int nSamples)
 {
     // WARNING: This code assumes there's only ONE reading process.
-    if ((m_size - m_rpos) < nSamples) {
-        int b1 = m_size - m_rpos;
+    const s32 rpos = m_rpos.load(std::memory_order_relaxed);
+    if ((m_size - rpos) < nSamples) {
+        int b1 = m_size - rpos;
         int b2 = nSamples - b1;
 
         _ReadSamples_Internal(bData, b1);
@@ -251,7 +264,8 @@ void SndBuffer::ReadSamples(T *bData)
         pxAssume(nSamples <= SndOutPacketSize);
 
         // WARNING: This code assumes there's only ONE reading process.
-        int b1 = m_size - m_rpos;
+        const s32 rpos = m_rpos.load(std::memory_order_relaxed);
+        int b1 = m_size - rpos;
 
         if (b1 > nSamples)
             b1 = nSamples;
@@ -259,7 +273,7 @@ void SndBuffer::ReadSamples(T *bData)
         if (AdvancedVolumeControl) {
             // First part
             for (int i = 0; i < b1; i++)
-                bData[i].AdjustFrom(m_buffer[i + m_rpos]);
+                bData[i].AdjustFrom(m_buffer[i + rpos]);
 
             // Second part
             int b2 = nSamples - b1;
@@ -268,7 +282,7 @@ void SndBuffer::ReadSamples(T *bData)
         } else {
             // First part
             for (int i = 0; i < b1; i++)
-                bData[i].ResampleFrom(m_buffer[i + m_rpos]);
+                bData[i].ResampleFrom(m_buffer[i + rpos]);
 
             // Second part
             int b2 = nSamples - b1;
@@ -351,6 +365,8 @@ void SndBuffer::_WriteSamples(StereoOut32 *bData, int nSamples)
         if (MsgOverruns())
             ConLog(" * SPU2 > Overrun! 1 packet tossed)\n");
         lastPct = 0.0; // normalize the timestretcher
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+        m_dropped.fetch_add(nSamples, std::memory_order_relaxed);
         return;
 #endif
     }
@@ -375,6 +391,7 @@ void SndBuffer::Init()
     try {
         const float latencyMS = SndOutLatencyMS * 16;
         m_size = GetAlignedBufferSize((int)(latencyMS * SampleRate / 1000.0f));
+        m_target = SndOutLatencyMS * SampleRate / 1000;
         m_buffer = new StereoOut32[m_size];
         m_underrun_freeze = false;
 
@@ -390,6 +407,14 @@ void SndBuffer::Init()
 
     sndTempProgress = 0;
 
+    m_underruns = 0;
+    m_overruns = 0;
+    m_dropped = 0;
+    m_tempoAdjusts = 0;
+    lastTempoAdjust = 1.0f;
+    m_statsSamples = 0;
+    m_lastStats = SndBufferStats();
+
     soundtouchInit(); // initializes the timestretching
 
     // initialize module
@@ -437,6 +462,74 @@ void SndBuffer::Write(const StereoOut32 &Sample)
         return;
     sndTempProgress = 0;
 
+    _WritePacket();
+}
+
+// Same as writing the samples one at a time, for the batched mixer.
+void SndBuffer::Write(const StereoOut32 *Samples, int nSamples)
+{
+    for (int i = 0; i < nSamples; ++i) {
+        WaveDump::WriteCore(1, CoreSrc_External, Samples[i].DownSample());
+
+        if (WavRecordEnabled)
+            RecordWrite(Samples[i].DownSample());
+    }
+
+    if (mods[OutputModule] == &NullOut)
+        return;
+
+    while (nSamples > 0) {
+        const int count = std::min(nSamples, SndOutPacketSize - sndTempProgress);
+        std::copy_n(Samples, count, sndTempBuffer + sndTempProgress);
+        Samples += count;
+        nSamples -= count;
+
+        sndTempProgress += count;
+        if (sndTempProgress < SndOutPacketSize)
+            return;
+        sndTempProgress = 0;
+
+        _WritePacket();
+    }
+}
+
+SndBufferStats SndBuffer::GetStats()
+{
+    SndBufferStats stats;
+    stats.Underruns = m_underruns.load(std::memory_order_relaxed);
+    stats.Overruns = m_overruns.load(std::memory_order_relaxed);
+    stats.DroppedSamples = m_dropped.load(std::memory_order_relaxed);
+    stats.TempoAdjusts = m_tempoAdjusts.load(std::memory_order_relaxed);
+    stats.BufferedMS = m_buffer ? _GetApproximateDataInBuffer() * 1000 / SampleRate : 0;
+    stats.TargetMS = m_target * 1000 / SampleRate;
+    return stats;
+}
+
+// Logs what happened to the output buffer over the last minute of audio.
+void SndBuffer::_UpdateStats(int nSamples)
+{
+    m_statsSamples += nSamples;
+    if (m_statsSamples < SampleRate * 60)
+        return;
+    m_statsSamples = 0;
+
+    const SndBufferStats stats = GetStats();
+    const u32 underruns = stats.Underruns - m_lastStats.Underruns;
+    const u32 overruns = stats.Overruns - m_lastStats.Overruns;
+
+    if (underruns || overruns || MsgOverruns())
+        ConLog(" * SPU2 > Output: %u underruns, %u overruns, %u samples dropped, %u tempo adjustments (buffer %d ms, target %d ms)\n",
+               underruns, overruns, stats.DroppedSamples - m_lastStats.DroppedSamples,
+               stats.TempoAdjusts - m_lastStats.TempoAdjusts, stats.BufferedMS, stats.TargetMS);
+
+    m_lastStats = stats;
+}
+
+// Hands a full sndTempBuffer over to the DSP, time stretcher or output buffer.
+void SndBuffer::_WritePacket()
+{
+    _UpdateStats(SndOutPacketSize);
+
     //Don't play anything directly after loading a savestate, avoids static killing your speakers.
     if (ssFreeze > 0) {
         ssFreeze--;
@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <atomic>
+
 // Number of stereo samples per SndOut block.
 // All drivers must work in units of this size when communicating with
 // SndOut.
@@ -561,6 +563,19 @@ struct Stereo51Out32
     }
 };
 
+// Output buffer health.  The counters only ever go up; SndBuffer also logs them once
+// per minute of output when something went wrong (or always, with overrun messages on).
+struct SndBufferStats
+{
+    u32 Underruns;      // reads that found the buffer (nearly) empty
+    u32 Overruns;       // writes that found the buffer full
+    u32 DroppedSamples; // samples thrown away by overruns
+    u32 TempoAdjusts;   // stretcher tempo or async mixing tick interval changes
+
+    int BufferedMS; // current fill level
+    int TargetMS;   // fill level the stretcher aims for (the configured latency)
+};
+
 // Developer Note: This is a static class only (all static members).
 class SndBuffer
 {
@@ -580,11 +595,23 @@ private:
 
     static StereoOut32 *m_buffer;
     static s32 m_size;
+    static s32 m_target; // target fill level in samples, from SndOutLatencyMS
+
+    // Single producer (the mixer) / single consumer (the output driver) ring.  Each side
+    // only writes its own position, publishing it with release ordering after touching
+    // the samples, and reads the other side's position with acquire ordering.
+    static std::atomic<s32> m_rpos;
+    static std::atomic<s32> m_wpos;
 
-    static __aligned(4) volatile s32 m_rpos;
-    static __aligned(4) volatile s32 m_wpos;
+    static std::atomic<u32> m_underruns;
+    static std::atomic<u32> m_overruns;
+    static std::atomic<u32> m_dropped;
+    static std::atomic<u32> m_tempoAdjusts;
+    static int m_statsSamples;
+    static SndBufferStats m_lastStats;
 
     static float lastEmergencyAdj;
+    static float lastTempoAdjust; // last tempo given to SoundTouch, to count the changes
     static float cTempo;
     static float eTempo;
     static int ssFreeze;
@@ -615,13 +642,18 @@ private:
 
     static int _GetApproximateDataInBuffer();
 
+    static void _WritePacket();
+    static void _UpdateStats(int nSamples);
+
 public:
     static void UpdateTempoChangeAsyncMixing();
     static void Init();
     static void Cleanup();
     static void Write(const StereoOut32 &Sample);
+    static void Write(const StereoOut32 *Samples, int nSamples);
     static s32 Test();
     static void ClearContents();
+    static SndBufferStats GetStats();
 
     // Note: When using with 32 bit output buffers, the user of this function is responsible
     // for shifting the values to where they need to be manually.  The fixed point depth of
@@ -33,6 +33,7 @@ s32 SndBuffer::m_predictData;
 float SndBuffer::lastPct;
 float SndBuffer::lastEmergencyAdj;
 
+float SndBuffer::lastTempoAdjust = 1;
 float SndBuffer::cTempo = 1;
 float SndBuffer::eTempo = 1;
 
@@ -56,8 +57,8 @@ float SndBuffer::GetStatusPct()
     //ConLog( "Data %d >>> driver: %d   predict: %d\n", m_data, drvempty, m_predictData );
 
     int data = _GetApproximateDataInBuffer();
-    float result = (float)(data + m_predictData - drvempty) - (m_size / 16);
-    result /= (m_size / 16);
+    float result = (float)(data + m_predictData - drvempty) - m_target;
+    result /= m_target;
     return result;
 }
 
@@ -150,7 +151,7 @@ bool IsInRange(const T &val, const T &min, const T &max)
 void SndBuffer::UpdateTempoChangeSoundTouch2()
 {
 
-    long targetSamplesReservoir = 48 * SndOutLatencyMS; //48000*SndOutLatencyMS/1000
+    long targetSamplesReservoir = m_target; //48000*SndOutLatencyMS/1000
     //base aim at buffer filled %
     float baseTargetFullness = (double)targetSamplesReservoir; ///(double)m_size;//0.05;
 
@@ -251,6 +252,11 @@ void SndBuffer::UpdateTempoChangeSoundTouch2()
         iters++;
     }
 
+    if (tempoAdjust != lastTempoAdjust) {
+        m_tempoAdjusts.fetch_add(1, std::memory_order_relaxed);
+        lastTempoAdjust = tempoAdjust;
+    }
+
     pSoundTouch->setTempo(tempoAdjust);
     if (gRequestStretcherReset >= STRETCHER_RESET_THRESHOLD)
         gRequestStretcherReset = 0;
@@ -367,6 +373,8 @@ void SndBuffer::UpdateTempoChangeSoundTouch()
         else if (cTempo > 7.5f)
             cTempo = 7.5f;
 
+        if ((float)newTempo != eTempo)
+            m_tempoAdjusts.fetch_add(1, std::memory_order_relaxed);
         pSoundTouch->setTempo(eTempo = (float)newTempo);
 
         /*ConLog("* SPU2-X: [Nominal %d%%] [Emergency: %d%%] (baseTempo: %d%% ) (newTempo: %d%%) (buffer: %d%%)\n",
@@ -396,6 +404,7 @@ extern uint TickInterval;
 void SndBuffer::UpdateTempoChangeAsyncMixing()
 {
     float statusPct = GetStatusPct();
+    const uint lastTickInterval = TickInterval;
 
     lastPct = statusPct;
     if (statusPct < -0.1f) {
@@ -412,6 +421,9 @@ void SndBuffer::UpdateTempoChangeAsyncMixing()
         //printf("++ %d, %f\n",TickInterval,statusPct);
     } else
         TickInterval = 768;
+
+    if (TickInterval != lastTickInterval)
+        m_tempoAdjusts.fetch_add(1, std::memory_order_relaxed);
 }
 
 void SndBuffer::timeStretchUnderrun()
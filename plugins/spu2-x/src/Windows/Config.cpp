@@ -39,6 +39,8 @@ int Interpolation = 4;
 */
 
 bool EffectsDisabled = false;
+bool SimdMixing = true; // mix voices four at a time, see MixCoreVoicesSIMD
+bool BatchMixing = true; // mix runs of samples between events, see TimeUpdate
 
 float FinalVolume; // Global
 bool AdvancedVolumeControl;
@@ -88,6 +90,8 @@ void ReadSettings()
     Interpolation = CfgReadInt(L"MIXING", L"Interpolation", 4);
 
     EffectsDisabled = CfgReadBool(L"MIXING", L"Disable_Effects", false);
+    SimdMixing = CfgReadBool(L"MIXING", L"SimdMixing", true);
+    BatchMixing = CfgReadBool(L"MIXING", L"BatchMixing", true);
     postprocess_filter_dealias = CfgReadBool(L"MIXING", L"DealiasFilter", false);
     FinalVolume = ((float)CfgReadInt(L"MIXING", L"FinalVolume", 100)) / 100;
     if (FinalVolume > 1.0f)
@@ -170,6 +174,8 @@ void WriteSettings()
     CfgWriteInt(L"MIXING", L"Interpolation", Interpolation);
 
     CfgWriteBool(L"MIXING", L"Disable_Effects", EffectsDisabled);
+    CfgWriteBool(L"MIXING", L"SimdMixing", SimdMixing);
+    CfgWriteBool(L"MIXING", L"BatchMixing", BatchMixing);
     CfgWriteBool(L"MIXING", L"DealiasFilter", postprocess_filter_dealias);
     CfgWriteInt(L"MIXING", L"FinalVolume", (int)(FinalVolume * 100 + 0.5f));
 
@@ -547,6 +547,7 @@ extern s16 *_spu2mem;
 extern int PlayMode;
 
 extern void SetIrqCall(int core);
+extern bool has_to_call_irq;
 extern void StartVoices(int core, u32 value);
 extern void StopVoices(int core, u32 value);
 extern void InitADSR();
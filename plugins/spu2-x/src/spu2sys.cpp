@@ -454,6 +454,28 @@ __forceinline void TimeUpdate(u32 cClocks)
         //SaveMMXRegs();
         Mix();
         //RestoreMMXRegs();
+
+        // Batch mixing: until the next DMA interrupt the ticks only advance the clock, so
+        // mix them in one go.  Pending IRQ callbacks and key ons are left to the loop above.
+        if (BatchMixing && !has_to_call_irq && !Cores[0].KeyOn && !Cores[1].KeyOn) {
+            uint batch = dClocks / TickInterval;
+            for (int i = 0; i < 2; i++)
+                if (Cores[i].DMAICounter > 0)
+                    batch = std::min<uint>(batch, (Cores[i].DMAICounter - 1) / TickInterval);
+
+            if (batch > 0) {
+                const u32 batchClocks = MixBatch(batch) * TickInterval;
+                dClocks -= batchClocks;
+                lClocks += batchClocks;
+
+                for (int i = 0; i < 2; i++) {
+                    if (Cores[i].DMAICounter > 0) {
+                        Cores[i].DMAICounter -= batchClocks;
+                        Cores[i].MADR += batchClocks << 1;
+                    }
+                }
+            }
+        }
     }
 }
 
@@ -0,0 +1,273 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// cdvdtrace - turns a CDVD read trace (EmuCore/CdvdTraceReads) into a prefetch
+// profile. The file formats are described in pcsx2/CDVD/IsoAccessTrace.h.
+//
+// Reads that follow each other closely are merged into regions, kept in the
+// order the game first reaches them. Regions already covered by an earlier
+// one are trimmed, so the profile holds disjoint extents.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#if _MSC_VER
+#	pragma warning(disable:4996)	// The POSIX name for this item is deprecated. Instead, use the ISO C++ conformant name.
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+// Must match pcsx2/CDVD/IsoAccessTrace.h
+#define ISO_TRACE_MAGIC "CDVDTRC"
+#define ISO_TRACE_VERSION 1
+#define ISO_PROFILE_MAGIC "CDVDPFP"
+#define ISO_PROFILE_VERSION 1
+
+enum { IsoTrace_Boot = 0, IsoTrace_Read, IsoTrace_Sector };
+
+#pragma pack(push, 1)
+struct IsoTraceHeader { char magic[8]; u32 version; u32 blocks; u32 blocksize; };
+struct IsoTraceRecord { u32 lsn; u32 time; u16 count; u8 mode; u8 kind; };
+struct IsoProfileHeader { char magic[8]; u32 version; u32 count; };
+struct IsoProfileExtent { u32 lsn; u32 count; };
+#pragma pack(pop)
+
+struct Region
+{
+	u32 start;
+	u32 end; // exclusive
+};
+
+static void usage()
+{
+	puts(
+		"USAGE: cdvdtrace <trace> [profile] [options]\n"
+		"  <trace>   = <iso name>.cdvdtrace from the PCSX2 logs folder\n"
+		"  [profile] = output, defaults to the trace name with a .prefetch extension\n"
+		"options:\n"
+		"  -gap N    = merge reads less than N sectors apart (default 64)\n"
+		"  -min N    = drop regions smaller than N sectors (default 16)\n"
+		"  -max N    = stop after N MB of regions (default 512)\n"
+	);
+}
+
+static bool load_trace(const char* filename, IsoTraceHeader& header, std::vector<IsoTraceRecord>& records)
+{
+	FILE* fp = fopen(filename, "rb");
+	if (!fp) {
+		printf("ERROR: can't open %s\n", filename);
+		return false;
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, ISO_TRACE_MAGIC, sizeof(header.magic)) != 0) {
+		printf("ERROR: %s is not a CDVD trace\n", filename);
+		fclose(fp);
+		return false;
+	}
+	if (header.version != ISO_TRACE_VERSION) {
+		printf("ERROR: unsupported trace version %u\n", header.version);
+		fclose(fp);
+		return false;
+	}
+
+	IsoTraceRecord record;
+	while (fread(&record, sizeof(record), 1, fp) == 1)
+		records.push_back(record);
+
+	fclose(fp);
+	return true;
+}
+
+// Merges the accesses into regions, in the order they are first reached.
+static std::vector<Region> build_regions(const std::vector<IsoTraceRecord>& records, u32 gap)
+{
+	// Sector records are what the game asked for; traces without them still
+	// have the reader requests.
+	u8 kind = IsoTrace_Read;
+	for (const IsoTraceRecord& r : records) {
+		if (r.kind == IsoTrace_Sector) {
+			kind = IsoTrace_Sector;
+			break;
+		}
+	}
+
+	std::vector<Region> regions;
+	Region current = {0, 0};
+	bool open = false;
+
+	for (const IsoTraceRecord& r : records) {
+		if (r.kind == IsoTrace_Boot) {
+			if (open)
+				regions.push_back(current);
+			open = false;
+			continue;
+		}
+		if (r.kind != kind || r.count == 0)
+			continue;
+
+		const u32 end = r.lsn + r.count;
+		if (open && r.lsn >= current.start && r.lsn <= current.end + gap) {
+			current.end = std::max(current.end, end);
+		} else {
+			if (open)
+				regions.push_back(current);
+			current.start = r.lsn;
+			current.end = end;
+			open = true;
+		}
+	}
+	if (open)
+		regions.push_back(current);
+
+	return regions;
+}
+
+// Keeps the parts of each region not covered by an earlier one.
+static std::vector<IsoProfileExtent> build_profile(const std::vector<Region>& regions, u32 blocks, u32 min, u64 maxSectors)
+{
+	std::vector<IsoProfileExtent> extents;
+	std::map<u32, u32> covered; // start -> end
+	u64 total = 0;
+
+	for (const Region& region : regions) {
+		u32 pos = region.start;
+		const u32 end = std::min(region.end, blocks);
+
+		while (pos < end && total < maxSectors) {
+			// First covered interval ending after pos
+			auto it = covered.upper_bound(pos);
+			if (it != covered.begin() && std::prev(it)->second > pos)
+				--it;
+
+			u32 pieceEnd = end;
+			if (it != covered.end() && it->first <= pos) {
+				pos = it->second; // inside a covered interval, skip it
+				continue;
+			}
+			if (it != covered.end())
+				pieceEnd = std::min(pieceEnd, it->first);
+
+			pieceEnd = (u32)std::min<u64>(pieceEnd, pos + (maxSectors - total));
+			if (pieceEnd - pos >= min) {
+				IsoProfileExtent e = {pos, pieceEnd - pos};
+				extents.push_back(e);
+				total += e.count;
+			}
+			covered[pos] = pieceEnd;
+			pos = pieceEnd;
+		}
+	}
+
+	return extents;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string traceName, profileName;
+	u32 gap = 64;
+	u32 min = 16;
+	u32 maxMB = 512;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-gap") && i + 1 < argc)
+			gap = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-min") && i + 1 < argc)
+			min = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-max") && i + 1 < argc)
+			maxMB = strtoul(argv[++i], NULL, 0);
+		else if (argv[i][0] == '-') {
+			usage();
+			return 1;
+		} else if (traceName.empty())
+			traceName = argv[i];
+		else if (profileName.empty())
+			profileName = argv[i];
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (traceName.empty()) {
+		usage();
+		return 1;
+	}
+
+	if (profileName.empty()) {
+		profileName = traceName;
+		const size_t dot = profileName.rfind(".cdvdtrace");
+		if (dot != std::string::npos)
+			profileName.erase(dot);
+		profileName += ".prefetch";
+	}
+
+	IsoTraceHeader header;
+	std::vector<IsoTraceRecord> records;
+	if (!load_trace(traceName.c_str(), header, records))
+		return 2;
+
+	const u64 maxSectors = (u64)maxMB * 1024 * 1024 / std::max(header.blocksize, 1u);
+	const std::vector<Region> regions = build_regions(records, gap);
+	const std::vector<IsoProfileExtent> extents = build_profile(regions, header.blocks, min, maxSectors);
+
+	FILE* fp = fopen(profileName.c_str(), "wb");
+	if (!fp) {
+		printf("ERROR: can't create %s\n", profileName.c_str());
+		return 3;
+	}
+
+	IsoProfileHeader profile = {};
+	memcpy(profile.magic, ISO_PROFILE_MAGIC, sizeof(profile.magic));
+	profile.version = ISO_PROFILE_VERSION;
+	profile.count = (u32)extents.size();
+
+	bool ok = fwrite(&profile, sizeof(profile), 1, fp) == 1;
+	if (!extents.empty())
+		ok = ok && fwrite(extents.data(), sizeof(IsoProfileExtent), extents.size(), fp) == extents.size();
+	ok = (fclose(fp) == 0) && ok;
+	if (!ok) {
+		printf("ERROR: can't write %s\n", profileName.c_str());
+		return 3;
+	}
+
+	u32 boots = 0;
+	u64 sectorsRead = 0;
+	for (const IsoTraceRecord& r : records) {
+		if (r.kind == IsoTrace_Boot)
+			boots++;
+		else if (r.kind == IsoTrace_Read)
+			sectorsRead += r.count;
+	}
+
+	u64 profiled = 0;
+	for (const IsoProfileExtent& e : extents)
+		profiled += e.count;
+
+	printf("%s: %u boot(s), %u records, %.1f MB requested from the reader\n",
+		traceName.c_str(), boots, (u32)records.size(), (double)sectorsRead * header.blocksize / (1024 * 1024));
+	printf("%s: %u regions, %u extents, %.1f MB\n",
+		profileName.c_str(), (u32)regions.size(), (u32)extents.size(), (double)profiled * header.blocksize / (1024 * 1024));
+
+	return 0;
+}
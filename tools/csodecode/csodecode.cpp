@@ -0,0 +1,422 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// csodecode - times the frame decoding of pcsx2/CDVD/CsoFileReader on the caller's
+// thread against the pool of decoding threads (Cdvd.CsoDecodeThreads in the ini).
+//
+// The image is a CSOv1 file, or a synthetic one: sectors of zeroes, of repeated
+// records and of noise, compressed the way maxcso/ciso do it (raw deflate frames,
+// stored as is when that doesn't make them smaller).  It is loaded in memory first,
+// so only the inflating is timed, which is the part the pool runs in parallel.
+//
+// Like the reader, the pool is given runs of frames (CSO_JOB_SIZE bytes of them)
+// and each thread has its own zlib stream.  The decoded image has to match the
+// serial one byte for byte, and the source data for a synthetic image, before
+// anything is reported.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#if _MSC_VER
+#	pragma warning(disable:4996)	// The POSIX name for this item is deprecated. Instead, use the ISO C++ conformant name.
+#endif
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+// Same layout as in CsoFileReader.cpp
+struct CsoHeader {
+	u8 magic[4];
+	u32 header_size;
+	u64 total_bytes;
+	u32 frame_size;
+	u8 ver;
+	u8 align;
+	u8 reserved[2];
+};
+
+static const u32 SectorSize = 2048;
+
+struct CsoImage
+{
+	std::vector<u8> file;
+	const u32* index;
+	u32 frameSize;
+	u32 indexShift;
+	u32 frames;
+	u64 totalBytes;
+	u64 compressedBytes;
+	u32 storedFrames;
+};
+
+static void usage()
+{
+	puts(
+		"USAGE: csodecode [options]\n"
+		"options:\n"
+		"  -file FILE  = decode FILE (a CSOv1 image) instead of a synthetic one\n"
+		"  -size N     = synthetic image size in MB (default 128)\n"
+		"  -frame N    = synthetic image frame size, a power of two (default 2048)\n"
+		"  -level N    = deflate level of the synthetic image (default 9)\n"
+		"  -threads N  = time the pool with 1 to N threads (default 3)\n"
+		"  -job N      = bytes of frames per pool job (default 65536, CSO_JOB_SIZE)\n"
+		"  -passes N   = timed passes, the best one is reported (default 3)\n"
+		"  -seed N     = random seed (default 1)\n"
+	);
+}
+
+static bool load_image(const char* filename, CsoImage& img)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f) {
+		printf("Error: can't open %s\n", filename);
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	const long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	img.file.resize(size > 0 ? size : 0);
+	const bool read = size > 0 && fread(img.file.data(), 1, size, f) == (size_t)size;
+	fclose(f);
+
+	CsoHeader hdr;
+	if (!read || img.file.size() < sizeof(hdr)) {
+		printf("Error: can't read %s\n", filename);
+		return false;
+	}
+	memcpy(&hdr, img.file.data(), sizeof(hdr));
+
+	if (memcmp(hdr.magic, "CISO", 4) || hdr.ver > 1 || hdr.frame_size < SectorSize || (hdr.frame_size & (hdr.frame_size - 1))) {
+		printf("Error: %s isn't a CSOv1 image\n", filename);
+		return false;
+	}
+
+	img.frameSize = hdr.frame_size;
+	img.indexShift = hdr.align;
+	img.totalBytes = hdr.total_bytes;
+	img.frames = (u32)((img.totalBytes + img.frameSize - 1) / img.frameSize);
+	if (sizeof(hdr) + (u64)(img.frames + 1) * sizeof(u32) > img.file.size()) {
+		printf("Error: %s is truncated\n", filename);
+		return false;
+	}
+	img.index = (const u32*)(img.file.data() + sizeof(hdr));
+	img.compressedBytes = img.file.size();
+	img.storedFrames = 0;
+	for (u32 frame = 0; frame < img.frames; frame++)
+		img.storedFrames += (img.index[frame] & 0x80000000) ? 1 : 0;
+
+	return true;
+}
+
+// What a disc mostly is: runs of zeroed sectors, tables and text with a lot of
+// repetition, and already compressed video/audio that deflate can't shrink.
+static void random_data(std::mt19937& rng, std::vector<u8>& data)
+{
+	const u32 sectors = (u32)(data.size() / SectorSize);
+	u32 sector = 0;
+	while (sector < sectors) {
+		const u32 run = std::min<u32>(1 + rng() % 64, sectors - sector);
+		u8* dst = &data[(size_t)sector * SectorSize];
+		const size_t bytes = (size_t)run * SectorSize;
+
+		switch (rng() % 4) {
+			case 0: // padding
+				memset(dst, 0, bytes);
+				break;
+
+			case 1: // noise
+				for (size_t i = 0; i < bytes; i++)
+					dst[i] = (u8)rng();
+				break;
+
+			default: // records: a few bytes change between copies of the same pattern
+			{
+				u8 record[64];
+				const u32 len = 8 + rng() % 56;
+				for (u32 i = 0; i < len; i++)
+					record[i] = (u8)(32 + rng() % 64);
+				for (size_t i = 0; i < bytes; i++)
+					dst[i] = (rng() % 16) ? record[i % len] : (u8)rng();
+				break;
+			}
+		}
+		sector += run;
+	}
+}
+
+static bool build_image(const std::vector<u8>& data, u32 frameSize, int level, CsoImage& img)
+{
+	img.frameSize = frameSize;
+	img.indexShift = 0;
+	img.totalBytes = data.size();
+	img.frames = (u32)((data.size() + frameSize - 1) / frameSize);
+	img.storedFrames = 0;
+
+	const size_t header = sizeof(CsoHeader) + (size_t)(img.frames + 1) * sizeof(u32);
+	img.file.assign(header, 0);
+
+	std::vector<u32> index(img.frames + 1);
+	std::vector<u8> frame(frameSize);
+	std::vector<u8> packed(deflateBound(NULL, frameSize) + 64);
+
+	z_stream strm = {};
+	if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		printf("Error: deflateInit2 failed\n");
+		return false;
+	}
+
+	for (u32 n = 0; n < img.frames; n++) {
+		const size_t pos = (size_t)n * frameSize;
+		const size_t len = std::min<size_t>(frameSize, data.size() - pos);
+		memset(frame.data(), 0, frameSize);
+		memcpy(frame.data(), &data[pos], len);
+
+		strm.next_in = frame.data();
+		strm.avail_in = frameSize;
+		strm.next_out = packed.data();
+		strm.avail_out = (uInt)packed.size();
+		if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+			printf("Error: deflate failed\n");
+			deflateEnd(&strm);
+			return false;
+		}
+		const size_t packedSize = packed.size() - strm.avail_out;
+		deflateReset(&strm);
+
+		index[n] = (u32)(img.file.size() >> img.indexShift);
+		if (packedSize < frameSize) {
+			img.file.insert(img.file.end(), packed.data(), packed.data() + packedSize);
+		} else {
+			index[n] |= 0x80000000;
+			img.file.insert(img.file.end(), frame.data(), frame.data() + frameSize);
+			img.storedFrames++;
+		}
+	}
+	index[img.frames] = (u32)(img.file.size() >> img.indexShift);
+	deflateEnd(&strm);
+
+	CsoHeader hdr = {};
+	memcpy(hdr.magic, "CISO", 4);
+	hdr.header_size = sizeof(hdr);
+	hdr.total_bytes = img.totalBytes;
+	hdr.frame_size = frameSize;
+	hdr.ver = 1;
+	memcpy(img.file.data(), &hdr, sizeof(hdr));
+	memcpy(img.file.data() + sizeof(hdr), index.data(), index.size() * sizeof(u32));
+
+	img.index = (const u32*)(img.file.data() + sizeof(hdr));
+	img.compressedBytes = img.file.size();
+	return true;
+}
+
+// ReadRawFrame and DecompressFrame of the reader, minus the file access
+static bool decode_frame(const CsoImage& img, z_stream* strm, u32 frame, u8* out)
+{
+	const u32 index0 = img.index[frame + 0] & 0x7FFFFFFF;
+	const u32 index1 = img.index[frame + 1] & 0x7FFFFFFF;
+	const u64 rawPos = (u64)index0 << img.indexShift;
+	const u64 rawSize = std::min((u64)(index1 - index0) << img.indexShift, (u64)img.file.size() - rawPos);
+
+	if (img.index[frame] & 0x80000000) {
+		memcpy(out, &img.file[rawPos], std::min<u64>(rawSize, img.frameSize));
+		return true;
+	}
+
+	strm->next_in = const_cast<u8*>(&img.file[rawPos]);
+	strm->avail_in = (uInt)rawSize;
+	strm->next_out = out;
+	strm->avail_out = img.frameSize;
+
+	const int status = inflate(strm, Z_FINISH);
+	const bool success = status == Z_STREAM_END && strm->total_out == img.frameSize;
+	inflateReset(strm);
+	return success;
+}
+
+static bool decode_frames(const CsoImage& img, u32 first, u32 last, z_stream* strm, u8* out)
+{
+	for (u32 frame = first; frame < last; frame++) {
+		if (!decode_frame(img, strm, frame, out + (size_t)frame * img.frameSize))
+			return false;
+	}
+	return true;
+}
+
+static bool init_stream(z_stream* strm)
+{
+	memset(strm, 0, sizeof(*strm));
+	return inflateInit2(strm, -15) == Z_OK;
+}
+
+static double time_serial(const CsoImage& img, std::vector<u8>& out, bool& ok)
+{
+	z_stream strm;
+	ok = init_stream(&strm);
+	if (!ok)
+		return 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	ok = decode_frames(img, 0, img.frames, &strm, out.data());
+	const auto end = std::chrono::steady_clock::now();
+
+	inflateEnd(&strm);
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// The threads take the next run of frames until there are none left, the way the
+// decoders take jobs off CsoFileReader::m_jobs.
+static double time_pool(const CsoImage& img, u32 threads, u32 framesPerJob, std::vector<u8>& out, bool& ok)
+{
+	const u32 jobs = (img.frames + framesPerJob - 1) / framesPerJob;
+	std::vector<z_stream> streams(threads);
+	std::atomic<u32> nextJob(0);
+	std::atomic<bool> failed(false);
+
+	ok = true;
+	for (z_stream& strm : streams)
+		ok &= init_stream(&strm);
+	if (!ok)
+		return 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (u32 t = 0; t < threads; t++) {
+		pool.emplace_back([&, t]() {
+			u32 job;
+			while ((job = nextJob.fetch_add(1)) < jobs && !failed) {
+				const u32 first = job * framesPerJob;
+				const u32 last = std::min(first + framesPerJob, img.frames);
+				if (!decode_frames(img, first, last, &streams[t], out.data()))
+					failed = true;
+			}
+		});
+	}
+	for (std::thread& thread : pool)
+		thread.join();
+	const auto end = std::chrono::steady_clock::now();
+
+	for (z_stream& strm : streams)
+		inflateEnd(&strm);
+	ok = !failed;
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	u32 sizeMB = 128;
+	u32 frameSize = SectorSize;
+	int level = 9;
+	u32 maxThreads = 3;
+	u32 jobSize = 64 * 1024;
+	u32 passes = 3;
+	u32 seed = 1;
+	const char* filename = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-file") && i + 1 < argc)
+			filename = argv[++i];
+		else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+			sizeMB = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-frame") && i + 1 < argc)
+			frameSize = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-level") && i + 1 < argc)
+			level = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-threads") && i + 1 < argc)
+			maxThreads = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-job") && i + 1 < argc)
+			jobSize = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-passes") && i + 1 < argc)
+			passes = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (!sizeMB || frameSize < SectorSize || (frameSize & (frameSize - 1)) || level < 0 || level > 9 || !maxThreads || !passes) {
+		usage();
+		return 1;
+	}
+
+	CsoImage img;
+	std::vector<u8> data;
+	if (filename) {
+		if (!load_image(filename, img))
+			return 1;
+	} else {
+		std::mt19937 rng(seed);
+		data.resize((size_t)sizeMB * 1024 * 1024);
+		random_data(rng, data);
+		if (!build_image(data, frameSize, level, img))
+			return 1;
+	}
+
+	const u32 framesPerJob = std::max(1u, jobSize / img.frameSize);
+	const double mb = (double)img.frames * img.frameSize / (1024 * 1024);
+	printf("%u frames of %u bytes, %.1f MB in %.1f MB (%u stored), %u frames per job\n",
+		img.frames, img.frameSize, mb, (double)img.compressedBytes / (1024 * 1024), img.storedFrames, framesPerJob);
+
+	std::vector<u8> serial((size_t)img.frames * img.frameSize);
+	std::vector<u8> pooled(serial.size());
+	bool ok;
+
+	double best = 1e9;
+	for (u32 pass = 0; pass < passes; pass++) {
+		best = std::min(best, time_serial(img, serial, ok));
+		if (!ok) {
+			printf("serial FAILED: a frame doesn't inflate\n");
+			return 2;
+		}
+	}
+	if (!data.empty() && memcmp(serial.data(), data.data(), data.size())) {
+		printf("serial FAILED: the decoded image differs from the source\n");
+		return 2;
+	}
+	const double serialTime = best;
+	printf("serial     %8.1f MB/s\n", mb / serialTime);
+
+	for (u32 threads = 1; threads <= maxThreads; threads++) {
+		best = 1e9;
+		for (u32 pass = 0; pass < passes; pass++) {
+			std::fill(pooled.begin(), pooled.end(), 0xcd);
+			best = std::min(best, time_pool(img, threads, framesPerJob, pooled, ok));
+			if (!ok) {
+				printf("%u threads FAILED: a frame doesn't inflate\n", threads);
+				return 2;
+			}
+			if (memcmp(pooled.data(), serial.data(), serial.size())) {
+				printf("%u threads FAILED: the decoded image differs from the serial one\n", threads);
+				return 2;
+			}
+		}
+		printf("%2u threads %8.1f MB/s (x%.2f)\n", threads, mb / best, serialTime / best);
+	}
+
+	return 0;
+}
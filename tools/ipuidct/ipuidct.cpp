@@ -0,0 +1,581 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// ipuidct - checks and times the IPU's block decoding (pcsx2/IPU/mpeg2lib):
+//
+// * the SSE2 idct of Idct.h against the scalar mpeg2dec idct_row/idct_col it replaced,
+//   through both mpeg2_idct_copy and mpeg2_idct_add.  Blocks are random (dense, sparse,
+//   DC only and full scale ones, with the coefficients saturated like the decoder does),
+//   or read from a file of raw blocks (64 little endian s16 each, as they are passed to
+//   mpeg2_idct_copy/add).
+// * the DCTlookupSet of Vlc.h against the range check cascades get_intra_block and
+//   get_non_intra_block used, for every 16 bit code of the three tables.
+//
+// Everything has to match bit for bit before it's timed.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include <emmintrin.h>
+
+#if _MSC_VER
+#	pragma warning(disable:4996)	// The POSIX name for this item is deprecated. Instead, use the ISO C++ conformant name.
+#endif
+
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef unsigned int uint;
+
+// Just enough of the emulator for Idct.h and Vlc.h to build as is
+#define __fi inline
+#if _MSC_VER
+#	define __aligned16 __declspec(align(16))
+#else
+#	define __aligned16 __attribute__((aligned(16)))
+#endif
+
+enum macroblock_modes
+{
+	MACROBLOCK_INTRA = 1,
+	MACROBLOCK_PATTERN = 2,
+	MACROBLOCK_MOTION_BACKWARD = 4,
+	MACROBLOCK_MOTION_FORWARD = 8,
+	MACROBLOCK_QUANT = 16,
+};
+
+static struct
+{
+	int FillBuffer(int) { return 0; }
+	void Advance(uint) {}
+} g_BP;
+
+static u32 UBITS(uint) { return 0; }
+
+#include "../../pcsx2/IPU/mpeg2lib/Idct.h"
+#include "../../pcsx2/IPU/mpeg2lib/Vlc.h"
+
+// --------------------------------------------------------------------------------------
+//  The scalar idct, as Idct.cpp had it
+// --------------------------------------------------------------------------------------
+// clip_lut only covered -384..639, corrupt streams read past it.  Clamping instead is
+// what the SSE2 code does, and matches the table wherever it was in bounds.
+static u8 clip(int i)
+{
+	return (i < 0) ? 0 : ((i > 255) ? 255 : i);
+}
+
+static void BUTTERFLY(int& t0, int& t1, int w0, int w1, int d0, int d1)
+{
+	int tmp = w0 * (d0 + d1);
+	t0 = tmp + (w1 - w0) * d1;
+	t1 = tmp - (w1 + w0) * d0;
+}
+
+static void idct_row(s16 * const block)
+{
+	int d0, d1, d2, d3;
+	int a0, a1, a2, a3, b0, b1, b2, b3;
+	int t0, t1, t2, t3;
+
+	/* shortcut */
+	if (!(block[1] | ((s32 *)block)[1] | ((s32 *)block)[2] |
+		  ((s32 *)block)[3])) {
+		u32 tmp = (u16) (block[0] << 3);
+		tmp |= tmp << 16;
+		((s32 *)block)[0] = tmp;
+		((s32 *)block)[1] = tmp;
+		((s32 *)block)[2] = tmp;
+		((s32 *)block)[3] = tmp;
+		return;
+	}
+
+	d0 = (block[0] << 11) + 128;
+	d1 = block[1];
+	d2 = block[2] << 11;
+	d3 = block[3];
+	t0 = d0 + d2;
+	t1 = d0 - d2;
+	BUTTERFLY (t2, t3, W6, W2, d3, d1);
+	a0 = t0 + t2;
+	a1 = t1 + t3;
+	a2 = t1 - t3;
+	a3 = t0 - t2;
+
+	d0 = block[4];
+	d1 = block[5];
+	d2 = block[6];
+	d3 = block[7];
+	BUTTERFLY (t0, t1, W7, W1, d3, d0);
+	BUTTERFLY (t2, t3, W3, W5, d1, d2);
+	b0 = t0 + t2;
+	b3 = t1 + t3;
+	t0 -= t2;
+	t1 -= t3;
+	b1 = ((t0 + t1) * 181) >> 8;
+	b2 = ((t0 - t1) * 181) >> 8;
+
+	block[0] = (a0 + b0) >> 8;
+	block[1] = (a1 + b1) >> 8;
+	block[2] = (a2 + b2) >> 8;
+	block[3] = (a3 + b3) >> 8;
+	block[4] = (a3 - b3) >> 8;
+	block[5] = (a2 - b2) >> 8;
+	block[6] = (a1 - b1) >> 8;
+	block[7] = (a0 - b0) >> 8;
+}
+
+static void idct_col(s16 * const block)
+{
+	int d0, d1, d2, d3;
+	int a0, a1, a2, a3, b0, b1, b2, b3;
+	int t0, t1, t2, t3;
+
+	d0 = (block[8*0] << 11) + 65536;
+	d1 = block[8*1];
+	d2 = block[8*2] << 11;
+	d3 = block[8*3];
+	t0 = d0 + d2;
+	t1 = d0 - d2;
+	BUTTERFLY (t2, t3, W6, W2, d3, d1);
+	a0 = t0 + t2;
+	a1 = t1 + t3;
+	a2 = t1 - t3;
+	a3 = t0 - t2;
+
+	d0 = block[8*4];
+	d1 = block[8*5];
+	d2 = block[8*6];
+	d3 = block[8*7];
+	BUTTERFLY (t0, t1, W7, W1, d3, d0);
+	BUTTERFLY (t2, t3, W3, W5, d1, d2);
+	b0 = t0 + t2;
+	b3 = t1 + t3;
+	t0 = (t0 - t2) >> 8;
+	t1 = (t1 - t3) >> 8;
+	b1 = (t0 + t1) * 181;
+	b2 = (t0 - t1) * 181;
+
+	block[8*0] = (a0 + b0) >> 17;
+	block[8*1] = (a1 + b1) >> 17;
+	block[8*2] = (a2 + b2) >> 17;
+	block[8*3] = (a3 + b3) >> 17;
+	block[8*4] = (a3 - b3) >> 17;
+	block[8*5] = (a2 - b2) >> 17;
+	block[8*6] = (a1 - b1) >> 17;
+	block[8*7] = (a0 - b0) >> 17;
+}
+
+static void scalar_copy(s16 * block, u8 * dest, const int stride)
+{
+	for (int i = 0; i < 8; i++)
+		idct_row(block + 8 * i);
+	for (int i = 0; i < 8; i++)
+		idct_col(block + i);
+
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < 8; j++)
+			dest[j] = clip(block[j]);
+		memset(block, 0, 8 * sizeof(s16));
+		dest += stride;
+		block += 8;
+	}
+}
+
+static void scalar_add(const int last, s16 * block, s16 * dest, const int stride)
+{
+	if (last != 129 || (block[0] & 7) == 4) {
+		for (int i = 0; i < 8; i++)
+			idct_row(block + 8 * i);
+		for (int i = 0; i < 8; i++)
+			idct_col(block + i);
+
+		for (int i = 0; i < 8; i++) {
+			memcpy(dest + stride * i, block + 8 * i, 8 * sizeof(s16));
+			memset(block + 8 * i, 0, 8 * sizeof(s16));
+		}
+	} else {
+		s16 DC = ((int)block[0] + 4) >> 3;
+		block[0] = block[63] = 0;
+
+		for (int i = 0; i < 8; i++)
+			for (int j = 0; j < 8; j++)
+				dest[stride * i + j] = DC;
+	}
+}
+
+// --------------------------------------------------------------------------------------
+//  The DCT code cascades, as get_intra_block/get_non_intra_block had them
+// --------------------------------------------------------------------------------------
+static const DCTtab* walk_intra(u16 code, bool b15)
+{
+	if (code >= 16384 && !b15)
+		return &DCT.next[(code >> 12) - 4];
+	else if (code >= 1024)
+		return b15 ? &DCT.tab0a[(code >> 8) - 4] : &DCT.tab0[(code >> 8) - 4];
+	else if (code >= 512)
+		return b15 ? &DCT.tab1a[(code >> 6) - 8] : &DCT.tab1[(code >> 6) - 8];
+	else if (code >= 256)
+		return &DCT.tab2[(code >> 4) - 16];
+	else if (code >= 128)
+		return &DCT.tab3[(code >> 3) - 16];
+	else if (code >= 64)
+		return &DCT.tab4[(code >> 2) - 16];
+	else if (code >= 32)
+		return &DCT.tab5[(code >> 1) - 16];
+	else if (code >= 16)
+		return &DCT.tab6[code - 16];
+	return NULL;
+}
+
+static const DCTtab* walk_non_intra(u16 code, bool first)
+{
+	if (code >= 16384)
+		return first ? &DCT.first[(code >> 12) - 4] : &DCT.next[(code >> 12) - 4];
+	else if (code >= 1024)
+		return &DCT.tab0[(code >> 8) - 4];
+	else if (code >= 512)
+		return &DCT.tab1[(code >> 6) - 8];
+	else if (code >= 256)
+		return &DCT.tab2[(code >> 4) - 16];
+	else if (code >= 128)
+		return &DCT.tab3[(code >> 3) - 16];
+	else if (code >= 64)
+		return &DCT.tab4[(code >> 2) - 16];
+	else if (code >= 32)
+		return &DCT.tab5[(code >> 1) - 16];
+	else if (code >= 16)
+		return &DCT.tab6[code - 16];
+	return NULL;
+}
+
+static const DCTtab* walk(int table, u16 code)
+{
+	switch (table) {
+		case DCTlookupSet::B14_first: return walk_non_intra(code, true);
+		case DCTlookupSet::B14_next: return walk_non_intra(code, false);
+		default: return walk_intra(code, true);
+	}
+}
+
+// The intra decoder uses B14_next when intra_vlc_format is off, check that path too
+static const DCTtab* walk_intra_b14(int, u16 code)
+{
+	return walk_intra(code, false);
+}
+
+static const char* const TableNames[] = { "B14 first", "B14 next", "B15" };
+
+// --------------------------------------------------------------------------------------
+//  Checks and timings
+// --------------------------------------------------------------------------------------
+struct __aligned16 Block
+{
+	s16 c[64];
+};
+
+static volatile u32 sink; // keeps the timed results alive
+
+static void usage()
+{
+	puts(
+		"USAGE: ipuidct [options]\n"
+		"options:\n"
+		"  -blocks N   = random blocks (default 100000)\n"
+		"  -file FILE  = read the blocks from FILE instead, raw 64 x s16 each\n"
+		"  -codes N    = random codes for the VLC timing (default 1000000)\n"
+		"  -passes N   = timed passes, the best one is reported (default 5)\n"
+		"  -seed N     = random seed (default 1)\n"
+	);
+}
+
+static s16 saturate(int val)
+{
+	return std::max(-2048, std::min(2047, val));
+}
+
+// Sets last the way the block decoders do: 129 for a DC only intra block
+static void random_block(std::mt19937& rng, Block& b, int& last)
+{
+	std::uniform_int_distribution<int> coef(-2048, 2047);
+	std::normal_distribution<double> small(0.0, 40.0);
+	memset(&b, 0, sizeof(b));
+	last = 0;
+
+	switch (rng() % 4) {
+		case 0: // dense
+			for (int i = 0; i < 64; i++)
+				b.c[i] = coef(rng);
+			break;
+
+		case 1: // sparse, low frequencies, like most real blocks
+		{
+			const int n = 1 + rng() % 8;
+			for (int k = 0; k < n; k++) {
+				const int row = std::min<int>(rng() % 8, rng() % 8);
+				const int col = std::min<int>(rng() % 8, rng() % 8);
+				b.c[row * 8 + col] = saturate((int)small(rng));
+			}
+			b.c[0] = saturate(coef(rng) / 2 + 1024);
+			break;
+		}
+
+		case 2: // DC only
+			b.c[0] = coef(rng);
+			last = 129;
+			break;
+
+		default: // full scale, the most the 16 bit truncation between the passes sees
+			for (int i = 0; i < 64; i++)
+				b.c[i] = (rng() % 3 == 0) ? 0 : ((rng() & 1) ? 2047 : -2048);
+			break;
+	}
+}
+
+static bool read_blocks(const char* filename, std::vector<Block>& blocks, std::vector<int>& lasts)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f) {
+		printf("Error: can't open %s\n", filename);
+		return false;
+	}
+
+	Block b;
+	u8 raw[128];
+	while (fread(raw, sizeof(raw), 1, f) == 1) {
+		bool dc_only = true;
+		for (int i = 0; i < 64; i++) {
+			b.c[i] = (s16)(raw[i * 2] | (raw[i * 2 + 1] << 8));
+			dc_only = dc_only && (i == 0 || b.c[i] == 0);
+		}
+		blocks.push_back(b);
+		lasts.push_back(dc_only ? 129 : 0);
+	}
+
+	fclose(f);
+	if (blocks.empty()) {
+		printf("Error: no blocks in %s\n", filename);
+		return false;
+	}
+	return true;
+}
+
+static const int Stride = 16;
+
+// Returns the number of blocks the two paths decode differently
+static u64 check_idct(const std::vector<Block>& blocks, const std::vector<int>& lasts)
+{
+	u64 mismatches = 0;
+	Block a, b;
+	__aligned16 u8 copy_a[8 * Stride], copy_b[8 * Stride];
+	__aligned16 s16 add_a[8 * Stride], add_b[8 * Stride];
+
+	for (size_t n = 0; n < blocks.size(); n++) {
+		a = blocks[n];
+		b = blocks[n];
+		scalar_copy(a.c, copy_a, Stride);
+		idct_copy(b.c, copy_b, Stride);
+		bool ok = true;
+		for (int i = 0; i < 8; i++)
+			ok = ok && !memcmp(copy_a + Stride * i, copy_b + Stride * i, 8);
+		ok = ok && !memcmp(&a, &b, sizeof(a));
+
+		a = blocks[n];
+		b = blocks[n];
+		scalar_add(lasts[n], a.c, add_a, Stride);
+		idct_add(lasts[n], b.c, add_b, Stride);
+		for (int i = 0; i < 8; i++)
+			ok = ok && !memcmp(add_a + Stride * i, add_b + Stride * i, 8 * sizeof(s16));
+		ok = ok && !memcmp(&a, &b, sizeof(a));
+
+		if (!ok) {
+			if (!mismatches) {
+				printf("block %u differs:", (u32)n);
+				for (int i = 0; i < 64; i++)
+					printf("%s%d", (i % 8) ? " " : "\n  ", blocks[n].c[i]);
+				printf("\n");
+			}
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+template <void (*Copy)(s16*, u8*, int), void (*Add)(int, s16*, s16*, int)>
+static double time_idct(const std::vector<Block>& blocks, const std::vector<int>& lasts, std::vector<Block>& work)
+{
+	__aligned16 u8 copy[8 * Stride];
+	__aligned16 s16 add[8 * Stride];
+	work = blocks;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < work.size(); n++) {
+		if (n & 1)
+			Add(lasts[n], work[n].c, add, Stride);
+		else
+			Copy(work[n].c, copy, Stride);
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	sink = copy[0] + add[0];
+	return std::chrono::duration<double, std::nano>(end - start).count() / work.size();
+}
+
+static void copy_scalar(s16* block, u8* dest, int stride) { scalar_copy(block, dest, stride); }
+static void copy_sse2(s16* block, u8* dest, int stride) { idct_copy(block, dest, stride); }
+static void add_scalar(int last, s16* block, s16* dest, int stride) { scalar_add(last, block, dest, stride); }
+static void add_sse2(int last, s16* block, s16* dest, int stride) { idct_add(last, block, dest, stride); }
+
+// Returns the number of codes the lookup resolves differently from the cascade
+template <const DCTtab* (*Walk)(int, u16)>
+static u64 check_vlc(const DCTlookupSet& lookup, int table, int lookup_table)
+{
+	u64 mismatches = 0;
+
+	for (u32 code = 0; code < 0x10000; code++) {
+		const DCTtab* a = Walk(table, (u16)code);
+		const DCTtab* b = lookup.get(lookup_table, (u16)code);
+		const bool ok = a ? (a->run == b->run && a->level == b->level && a->len == b->len) : (b->run == 66);
+
+		if (!ok) {
+			if (!mismatches)
+				printf("%s: code 0x%04x: walk %d,%d,%d lookup %d,%d,%d\n", TableNames[lookup_table], code,
+					a ? a->run : 66, a ? a->level : 0, a ? a->len : 0, b->run, b->level, b->len);
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+template <const DCTtab* (*Get)(const DCTlookupSet&, int, u16)>
+static double time_vlc(const DCTlookupSet& lookup, const std::vector<u16>& codes)
+{
+	u32 sum = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < codes.size(); n++) {
+		const DCTtab* tab = Get(lookup, n % 3, codes[n]);
+		sum += tab ? tab->len : 0;
+	}
+	const auto end = std::chrono::steady_clock::now();
+
+	sink = sum;
+	return std::chrono::duration<double, std::nano>(end - start).count() / codes.size();
+}
+
+static const DCTtab* get_walk(const DCTlookupSet&, int table, u16 code) { return walk(table, code); }
+static const DCTtab* get_lookup(const DCTlookupSet& lookup, int table, u16 code) { return lookup.get(table, code); }
+
+int main(int argc, char* argv[])
+{
+	u32 count = 100000;
+	u32 code_count = 1000000;
+	u32 passes = 5;
+	u32 seed = 1;
+	const char* filename = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-blocks") && i + 1 < argc)
+			count = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-file") && i + 1 < argc)
+			filename = argv[++i];
+		else if (!strcmp(argv[i], "-codes") && i + 1 < argc)
+			code_count = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-passes") && i + 1 < argc)
+			passes = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (!count || !code_count || !passes) {
+		usage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	std::vector<Block> blocks;
+	std::vector<int> lasts;
+
+	if (filename) {
+		if (!read_blocks(filename, blocks, lasts))
+			return 1;
+	} else {
+		blocks.resize(count);
+		lasts.resize(count);
+		for (u32 n = 0; n < count; n++)
+			random_block(rng, blocks[n], lasts[n]);
+	}
+
+	bool ok = true;
+
+	// idct
+	const u64 idct_mismatches = check_idct(blocks, lasts);
+	if (idct_mismatches) {
+		printf("idct FAILED: %llu of %u blocks differ\n", (unsigned long long)idct_mismatches, (u32)blocks.size());
+		ok = false;
+	} else {
+		std::vector<Block> work;
+		double scalar = 1e9, sse2 = 1e9;
+		for (u32 pass = 0; pass < passes; pass++) {
+			scalar = std::min(scalar, time_idct<copy_scalar, add_scalar>(blocks, lasts, work));
+			sse2 = std::min(sse2, time_idct<copy_sse2, add_sse2>(blocks, lasts, work));
+		}
+		printf("idct  %u blocks bit exact, scalar %6.2f ns/block, sse2 %6.2f ns/block (x%.2f)\n",
+			(u32)blocks.size(), scalar, sse2, scalar / sse2);
+	}
+
+	// VLC
+	static const DCTlookupSet lookup;
+	u64 vlc_mismatches = 0;
+	vlc_mismatches += check_vlc<walk>(lookup, DCTlookupSet::B14_first, DCTlookupSet::B14_first);
+	vlc_mismatches += check_vlc<walk>(lookup, DCTlookupSet::B14_next, DCTlookupSet::B14_next);
+	vlc_mismatches += check_vlc<walk>(lookup, DCTlookupSet::B15, DCTlookupSet::B15);
+	vlc_mismatches += check_vlc<walk_intra_b14>(lookup, DCTlookupSet::B14_next, DCTlookupSet::B14_next);
+
+	if (vlc_mismatches) {
+		printf("vlc FAILED: %llu codes differ\n", (unsigned long long)vlc_mismatches);
+		ok = false;
+	} else {
+		// Codes with 0 to 11 leading zeros alike, so that every step of the cascade is taken
+		std::vector<u16> codes(code_count);
+		for (u16& code : codes)
+			code = (u16)(((rng() & 0xffff) | 0x8000) >> (rng() % 12));
+
+		double cascade = 1e9, table = 1e9;
+		for (u32 pass = 0; pass < passes; pass++) {
+			cascade = std::min(cascade, time_vlc<get_walk>(lookup, codes));
+			table = std::min(table, time_vlc<get_lookup>(lookup, codes));
+		}
+		printf("vlc   all codes of the 3 tables match, cascade %5.2f ns/code, lookup %5.2f ns/code (x%.2f)\n",
+			cascade, table, cascade / table);
+	}
+
+	return ok ? 0 : 2;
+}
@@ -0,0 +1,241 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// spu2mix - checks and times the SPU2-X voice mixing math (plugins/spu2-x/src/MixerVoice.h):
+// the scalar path of MixVoice against the four voices at a time MixVoiceLanes.
+//
+// Every interpolation mode is run over the same random voices (16 bit samples, any
+// position between two samples, random envelopes, volumes and gates, some noise and
+// some silent voices). Each voice's output and the dry/wet sums have to match bit for
+// bit before the two paths are timed. Build with -msse4.1 to check the SSE4.1 multiplies
+// instead of the SSE2 ones.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#if _MSC_VER
+#	pragma warning(disable:4996)	// The POSIX name for this item is deprecated. Instead, use the ISO C++ conformant name.
+#endif
+
+typedef int32_t s32;
+typedef int64_t s64;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef unsigned int uint;
+
+// Just enough of the emulator for MixerVoice.h to build as is
+#define __forceinline inline
+#define __aligned16 alignas(16)
+#define jNO_DEFAULT default: break;
+
+#include "../../plugins/spu2-x/src/MixerVoice.h"
+
+// Same layout as VoiceMixSet
+struct MixSums
+{
+	struct { s32 Left, Right; } Dry, Wet;
+};
+
+static const char* const InterpNames[] = { "nearest", "linear", "cubic", "hermite", "catmull-rom" };
+
+static void usage()
+{
+	puts(
+		"USAGE: spu2mix [options]\n"
+		"options:\n"
+		"  -mode N   = only this interpolation mode, 0-4 (default all)\n"
+		"  -sets N   = random sets of 24 voices (default 2000)\n"
+		"  -passes N = timed passes, the best one is reported (default 5)\n"
+		"  -seed N   = random seed (default 1)\n"
+	);
+}
+
+static void random_lanes(std::mt19937& rng, VoiceLanes& lanes)
+{
+	std::uniform_int_distribution<s32> sample(-32768, 32767);
+	std::uniform_int_distribution<s32> pos(-4095, 0);
+	std::uniform_int_distribution<s32> any(INT32_MIN, INT32_MAX);
+	std::uniform_int_distribution<s32> envelope(0, 0x7fffffff);
+
+	for (uint i = 0; i < NumVoiceLanes; i++) {
+		// Full scale samples now and then, the interpolators overshoot the most there
+		const bool full = rng() % 8 == 0;
+		lanes.PV1[i] = full ? ((rng() & 1) ? 32767 : -32768) : sample(rng);
+		lanes.PV2[i] = full ? ((rng() & 1) ? 32767 : -32768) : sample(rng);
+		lanes.PV3[i] = full ? ((rng() & 1) ? 32767 : -32768) : sample(rng);
+		lanes.PV4[i] = full ? ((rng() & 1) ? 32767 : -32768) : sample(rng);
+		lanes.SP[i] = pos(rng);
+
+		lanes.Noise[i] = rng() % 16 == 0 ? -1 : 0;
+		lanes.NoiseValue[i] = sample(rng);
+		lanes.ADSR[i] = rng() % 4 == 0 ? 0 : envelope(rng);
+		lanes.VolL[i] = any(rng);
+		lanes.VolR[i] = any(rng);
+
+		lanes.DryL[i] = rng() % 4 ? -1 : 0;
+		lanes.DryR[i] = rng() % 4 ? -1 : 0;
+		lanes.WetL[i] = rng() % 2 ? -1 : 0;
+		lanes.WetR[i] = rng() % 2 ? -1 : 0;
+	}
+}
+
+// The scalar path, as MixVoice and MixCoreVoices do it
+template <int InterpType>
+static void mix_scalar(MixSums& dest, VoiceLanes& lanes)
+{
+	for (uint i = 0; i < NumVoiceLanes; i++) {
+		s32 Value = lanes.Noise[i] ? lanes.NoiseValue[i] : GetVoiceValues<InterpType>(lanes.PV1[i], lanes.PV2[i], lanes.PV3[i], lanes.PV4[i], lanes.SP[i]);
+		Value = MulShr32(Value, lanes.ADSR[i]);
+
+		const s32 left = ApplyVolume(Value, lanes.VolL[i]);
+		const s32 right = ApplyVolume(Value, lanes.VolR[i]);
+		lanes.OutL[i] = left;
+		lanes.OutR[i] = right;
+
+		dest.Dry.Left += left & lanes.DryL[i];
+		dest.Dry.Right += right & lanes.DryR[i];
+		dest.Wet.Left += left & lanes.WetL[i];
+		dest.Wet.Right += right & lanes.WetR[i];
+	}
+}
+
+template <int InterpType>
+static void mix_simd(MixSums& dest, VoiceLanes& lanes)
+{
+	MixVoiceLanes<InterpType>(dest, lanes);
+}
+
+// Returns the number of mismatching voices (sums count as one voice)
+template <int InterpType>
+static u64 check(std::vector<VoiceLanes>& sets)
+{
+	u64 mismatches = 0;
+	VoiceLanes scalar;
+
+	for (size_t s = 0; s < sets.size(); s++) {
+		MixSums a = {}, b = {};
+		scalar = sets[s];
+		mix_scalar<InterpType>(a, scalar);
+		mix_simd<InterpType>(b, sets[s]);
+
+		for (uint i = 0; i < NumVoiceLanes; i++) {
+			if (scalar.OutL[i] == sets[s].OutL[i] && scalar.OutR[i] == sets[s].OutR[i])
+				continue;
+			if (!mismatches)
+				printf("%s: set %u voice %u: scalar %d,%d simd %d,%d (PV %d %d %d %d, SP %d, ADSR %d)\n",
+					InterpNames[InterpType], (u32)s, i, scalar.OutL[i], scalar.OutR[i], sets[s].OutL[i], sets[s].OutR[i],
+					scalar.PV1[i], scalar.PV2[i], scalar.PV3[i], scalar.PV4[i], scalar.SP[i], scalar.ADSR[i]);
+			mismatches++;
+		}
+
+		if (memcmp(&a, &b, sizeof(a))) {
+			if (!mismatches)
+				printf("%s: set %u: dry/wet sums differ\n", InterpNames[InterpType], (u32)s);
+			mismatches++;
+		}
+	}
+
+	return mismatches;
+}
+
+static volatile s32 sink; // keeps the timed sums alive
+
+template <void (*Mix)(MixSums&, VoiceLanes&)>
+static double time_pass(std::vector<VoiceLanes>& sets)
+{
+	MixSums dest = {};
+	const auto start = std::chrono::steady_clock::now();
+	for (VoiceLanes& lanes : sets)
+		Mix(dest, lanes);
+	const auto end = std::chrono::steady_clock::now();
+
+	sink = dest.Dry.Left + dest.Dry.Right + dest.Wet.Left + dest.Wet.Right;
+	return std::chrono::duration<double, std::nano>(end - start).count() / (sets.size() * NumVoiceLanes);
+}
+
+template <int InterpType>
+static bool run(std::vector<VoiceLanes>& sets, u32 passes)
+{
+	const u64 mismatches = check<InterpType>(sets);
+	if (mismatches) {
+		printf("%-12s FAILED: %llu of %llu voices differ\n", InterpNames[InterpType],
+			(unsigned long long)mismatches, (unsigned long long)sets.size() * NumVoiceLanes);
+		return false;
+	}
+
+	double scalar = 1e9, simd = 1e9;
+	for (u32 pass = 0; pass < passes; pass++) {
+		scalar = std::min(scalar, time_pass<mix_scalar<InterpType>>(sets));
+		simd = std::min(simd, time_pass<mix_simd<InterpType>>(sets));
+	}
+
+	printf("%-12s bit exact, scalar %5.2f ns/voice, simd %5.2f ns/voice (x%.2f)\n", InterpNames[InterpType],
+		scalar, simd, scalar / simd);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	int mode = -1;
+	u32 count = 2000;
+	u32 passes = 5;
+	u32 seed = 1;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-mode") && i + 1 < argc)
+			mode = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-sets") && i + 1 < argc)
+			count = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-passes") && i + 1 < argc)
+			passes = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (mode < -1 || mode > 4 || !count || !passes) {
+		usage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	std::vector<VoiceLanes> sets(count);
+	for (VoiceLanes& lanes : sets)
+		random_lanes(rng, lanes);
+
+#ifdef __SSE4_1__
+	printf("%u sets of %u voices, SSE4.1 multiplies\n", count, NumVoiceLanes);
+#else
+	printf("%u sets of %u voices, SSE2 multiplies\n", count, NumVoiceLanes);
+#endif
+
+	bool ok = true;
+	if (mode == -1 || mode == 0) ok = run<0>(sets, passes) && ok;
+	if (mode == -1 || mode == 1) ok = run<1>(sets, passes) && ok;
+	if (mode == -1 || mode == 2) ok = run<2>(sets, passes) && ok;
+	if (mode == -1 || mode == 3) ok = run<3>(sets, passes) && ok;
+	if (mode == -1 || mode == 4) ok = run<4>(sets, passes) && ok;
+
+	return ok ? 0 : 2;
+}
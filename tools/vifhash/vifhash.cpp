@@ -0,0 +1,363 @@
+/*  PCSX2 - PS2 Emulator for PCs
+ *  Copyright (C) 2002-2019  PCSX2 Dev Team
+ *
+ *  PCSX2 is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU Lesser General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  PCSX2 is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with PCSX2.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// vifhash - microbenchmark of the VIF unpack block lookup (pcsx2/x86/newVif_HashBucket.h,
+// inline first block per bucket) against the all chained buckets it replaced.
+//
+// Both tables are filled with the same random unpack keys, then timed over the same
+// lookup stream: a skewed mix of known keys (a few routines do most of the unpacks)
+// and keys that were never added. Every lookup result is checked against the other
+// table before timing.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdarg>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <emmintrin.h>
+
+#if _MSC_VER
+#	pragma warning(disable:4996)	// The POSIX name for this item is deprecated. Instead, use the ISO C++ conformant name.
+#	include <malloc.h>
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uintptr_t uptr;
+
+// Just enough of the emulator for newVif_HashBucket.h to build as is
+#define __fi inline
+
+#if !_MSC_VER
+static void* _aligned_malloc(size_t size, size_t align)
+{
+	void* ptr = NULL;
+	return posix_memalign(&ptr, align, size) ? NULL : ptr;
+}
+
+static void _aligned_free(void* ptr)
+{
+	free(ptr);
+}
+#endif
+
+#define safe_aligned_free(ptr) ((void)(_aligned_free(ptr), (ptr) = NULL))
+
+static void* pcsx2_aligned_realloc(void* handle, size_t new_size, size_t align, size_t old_size)
+{
+	void* newbuf = _aligned_malloc(new_size, align);
+	if (newbuf && handle)
+		memcpy(newbuf, handle, std::min(old_size, new_size));
+	_aligned_free(handle);
+	return newbuf;
+}
+
+namespace Exception
+{
+	struct OutOfMemory
+	{
+		std::wstring msg;
+		explicit OutOfMemory(const std::wstring& msg) : msg(msg) {}
+	};
+}
+
+static std::wstring wxsFormat(const wchar_t* fmt, ...)
+{
+	wchar_t buf[256];
+	va_list list;
+	va_start(list, fmt);
+	vswprintf(buf, sizeof(buf) / sizeof(buf[0]), fmt, list);
+	va_end(list);
+	return buf;
+}
+
+static bool verbose = false;
+
+static struct
+{
+	void Log(const char* fmt, va_list list) const
+	{
+		if (verbose) {
+			vprintf(fmt, list);
+			putchar('\n');
+		}
+	}
+
+	void WriteLn(const char* fmt, ...) const { va_list list; va_start(list, fmt); Log(fmt, list); va_end(list); }
+	void Warning(const char* fmt, ...) const { va_list list; va_start(list, fmt); Log(fmt, list); va_end(list); }
+} DevCon;
+
+#include "../../pcsx2/x86/newVif_HashBucket.h"
+
+// The block counters are only reported on reset, read them directly
+class InlineTable : public HashBucket
+{
+public:
+	u32 count() const { return m_count; }
+	u32 chained() const { return m_chained; }
+};
+
+// The previous HashBucket: 64k chains selected by num and upkType, each one ending
+// with an empty cell.
+class ChainedTable
+{
+	nVifBlock* m_bucket[hSize];
+
+public:
+	ChainedTable() { memset(m_bucket, 0, sizeof(m_bucket)); }
+	~ChainedTable() { clear(); }
+
+	__fi nVifBlock* find(const nVifBlock& dataPtr) {
+		nVifBlock* chainpos = m_bucket[dataPtr.hash_key];
+
+		while (true) {
+			if (chainpos->key0 == dataPtr.key0 && chainpos->key1 == dataPtr.key1)
+				return chainpos;
+
+			if (chainpos->startPtr == 0)
+				return nullptr;
+
+			chainpos++;
+		}
+	}
+
+	void add(const nVifBlock& dataPtr) {
+		u32 b = dataPtr.hash_key;
+		u32 size = bucket_size(dataPtr);
+
+		if ((m_bucket[b] = (nVifBlock*)pcsx2_aligned_realloc(m_bucket[b], sizeof(nVifBlock) * (size + 2), 64, sizeof(nVifBlock) * (size + 1))) == NULL)
+			throw Exception::OutOfMemory(wxsFormat(L"HashBucket Chain (bucket size=%d)", size + 2));
+
+		memcpy(&m_bucket[b][size++], &dataPtr, sizeof(nVifBlock));
+		memset(&m_bucket[b][size], 0, sizeof(nVifBlock));
+	}
+
+	u32 bucket_size(const nVifBlock& dataPtr) {
+		nVifBlock* chainpos = m_bucket[dataPtr.hash_key];
+
+		u32 size = 0;
+		while (chainpos->startPtr != 0) {
+			size++;
+			chainpos++;
+		}
+
+		return size;
+	}
+
+	void clear() {
+		for (auto& bucket : m_bucket)
+			safe_aligned_free(bucket);
+	}
+
+	void reset() {
+		clear();
+
+		for (auto& bucket : m_bucket) {
+			if ((bucket = (nVifBlock*)_aligned_malloc(sizeof(nVifBlock), 64)) == nullptr)
+				throw Exception::OutOfMemory(wxsFormat(L"HashBucket Chain (bucket size=%d)", 1));
+			memset(bucket, 0, sizeof(nVifBlock));
+		}
+	}
+};
+
+static void usage()
+{
+	puts(
+		"USAGE: vifhash [options]\n"
+		"options:\n"
+		"  -blocks N  = distinct unpack routines in the tables (default 600)\n"
+		"  -lookups N = lookups per timed pass (default 4000000)\n"
+		"  -passes N  = timed passes, the best one is reported (default 5)\n"
+		"  -miss N    = percentage of lookups for keys never added (default 2)\n"
+		"  -skew X    = zipf exponent of the known key popularity (default 1.0)\n"
+		"  -seed N    = random seed (default 1)\n"
+		"  -overlap   = let the lookups overlap (throughput instead of latency)\n"
+		"  -v         = show the table logs\n"
+	);
+}
+
+// Keys shaped like the ones games use: a handful of unpack formats, small cl/wl,
+// few masks, and a num that's the most varied field
+static nVifBlock random_key(std::mt19937& rng)
+{
+	static const u8 upk[] = { 0x0c, 0x0d, 0x0e, 0x0f, 0x08, 0x09, 0x05, 0x06, 0x04, 0x01, 0x02, 0x00 };
+	static const u32 masks[] = { 0, 0, 0, 0xffffff00, 0x3f3f3f3f, 0x55555555 };
+
+	nVifBlock b;
+	memset(&b, 0, sizeof(b));
+	b.num = (u8)(1 + std::geometric_distribution<int>(0.02)(rng) % 255);
+	b.upkType = upk[rng() % sizeof(upk)] | ((rng() % 4 == 0) ? 0x10 : 0) | ((rng() % 8 == 0) ? 0x20 : 0);
+	b.mask = (b.upkType & 0x10) ? masks[rng() % (sizeof(masks) / sizeof(masks[0]))] : 0;
+	b.mode = (u8)(rng() % 4 == 0 ? rng() % 4 : 0);
+	b.aligned = (u8)(rng() % 4);
+	b.cl = (u8)(1 + rng() % 4);
+	b.wl = (rng() % 3) ? b.cl : (u8)(1 + rng() % 4);
+	b.length = (u16)(b.num * 16);
+	return b;
+}
+
+static std::tuple<u16, u32, u32> key_of(const nVifBlock& b)
+{
+	return std::make_tuple(b.hash_key, b.key0, b.key1);
+}
+
+// Always 0, but the compiler can't know it
+static volatile uptr zero = 0;
+
+// chase: each lookup waits for the previous one, like the unpack that runs the routine
+// it just looked up. Otherwise the lookups overlap, which only measures throughput.
+template <typename Table>
+static double time_pass(Table& table, const std::vector<nVifBlock>& stream, uptr& sum, bool chase)
+{
+	const uptr mask = zero;
+	uptr dep = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < stream.size(); i++) {
+		const nVifBlock* b = table.find(stream[chase ? i + (dep & mask) : i]);
+		dep = b ? b->startPtr : 1;
+		sum += dep;
+	}
+	const auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(end - start).count() / stream.size();
+}
+
+int main(int argc, char* argv[])
+{
+	u32 blocks = 600;
+	u32 lookups = 4000000;
+	u32 passes = 5;
+	u32 miss = 2;
+	double skew = 1.0;
+	u32 seed = 1;
+	bool chase = true;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-blocks") && i + 1 < argc)
+			blocks = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-lookups") && i + 1 < argc)
+			lookups = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-passes") && i + 1 < argc)
+			passes = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-miss") && i + 1 < argc)
+			miss = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-skew") && i + 1 < argc)
+			skew = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-seed") && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-overlap"))
+			chase = false;
+		else if (!strcmp(argv[i], "-v"))
+			verbose = true;
+		else {
+			usage();
+			return 1;
+		}
+	}
+
+	if (!blocks || !lookups || !passes || miss > 100) {
+		usage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+
+	// Distinct keys: the first `blocks` are added, the rest only looked up
+	const u32 absent = std::max(blocks / 4, 16u);
+	std::set<std::tuple<u16, u32, u32>> seen;
+	std::vector<nVifBlock> keys;
+	for (u32 tries = 0; keys.size() < blocks + absent && tries < (blocks + absent) * 1000; tries++) {
+		nVifBlock b = random_key(rng);
+		if (seen.insert(key_of(b)).second) {
+			b.startPtr = 0x1000 + keys.size() * 16; // any non null value, unique per block
+			keys.push_back(b);
+		}
+	}
+
+	if (keys.size() < blocks + absent) {
+		printf("ERROR: only %u distinct keys could be generated\n", (u32)keys.size());
+		return 2;
+	}
+
+	InlineTable inl;
+	ChainedTable chained;
+	inl.reset();
+	chained.reset();
+	for (u32 i = 0; i < blocks; i++) {
+		inl.add(keys[i]);
+		chained.add(keys[i]);
+	}
+
+	// Lookup stream. The length field isn't part of the key, scramble it to make sure.
+	std::vector<double> weights(blocks);
+	for (u32 i = 0; i < blocks; i++)
+		weights[i] = 1.0 / pow(i + 1.0, skew);
+	std::discrete_distribution<u32> popular(weights.begin(), weights.end());
+
+	std::vector<nVifBlock> stream(lookups);
+	for (nVifBlock& key : stream) {
+		key = (rng() % 100 < miss) ? keys[blocks + rng() % absent] : keys[popular(rng)];
+		key.length = (u16)rng();
+		key.startPtr = 0;
+	}
+
+	// Both tables have to agree on every lookup
+	for (u32 i = 0; i < blocks + absent; i++) {
+		nVifBlock key = keys[i];
+		key.length = (u16)~key.length;
+		const nVifBlock* a = inl.find(key);
+		const nVifBlock* b = chained.find(key);
+		const uptr expected = i < blocks ? keys[i].startPtr : 0;
+		if ((a ? a->startPtr : 0) != expected || (b ? b->startPtr : 0) != expected) {
+			printf("ERROR: key %u: inline %p, chained %p, expected %p\n",
+				i, (void*)(a ? a->startPtr : 0), (void*)(b ? b->startPtr : 0), (void*)expected);
+			return 3;
+		}
+	}
+
+	double bestInline = 1e9, bestChained = 1e9;
+	uptr sumInline = 0, sumChained = 0;
+	for (u32 pass = 0; pass < passes; pass++) {
+		bestChained = std::min(bestChained, time_pass(chained, stream, sumChained, chase));
+		bestInline = std::min(bestInline, time_pass(inl, stream, sumInline, chase));
+	}
+
+	if (sumInline != sumChained) {
+		printf("ERROR: the tables returned different blocks\n");
+		return 3;
+	}
+
+	u32 longestChain = 0;
+	for (u32 i = 0; i < blocks; i++)
+		longestChain = std::max(longestChain, chained.bucket_size(keys[i]));
+
+	printf("%u blocks, %u lookups x %u passes, %u%% misses, skew %.2f, %s lookups\n", blocks, lookups, passes, miss, skew,
+		chase ? "dependent" : "overlapped");
+	printf("chained:         %6.2f ns/lookup, longest chain %u\n", bestChained, longestChain);
+	printf("inline first:    %6.2f ns/lookup, %u of %u blocks in overflow chains\n",
+		bestInline, inl.chained(), inl.count());
+
+	return 0;
+}